@@ -53,6 +53,15 @@
 
 #include "crc32.h"
 
+#include <pthread.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+/// the folding is compiled for PCLMULQDQ with a target attribute and only called if CPUID reports it
+#define CRC32_PCLMUL_BUILD 1
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
 
 enum crc32ConstantDefinition
 {
@@ -107,6 +116,27 @@ static unsigned int crc32_tab[] =
    0xb40bbe37, 0xc30c8ea1, 0x5a05df1b, 0x2d02ef8d
 };
 
+
+/// tables of slicing-by-8, [0] is crc32_tab, [k] the crc of a byte followed by k zero bytes
+static unsigned int gCrc32Slice[8][256];
+
+/// the implementation of pclCrc32Ieee, selected once
+static pclCrc32Impl_e gCrc32Impl = PCL_CRC32_BYTEWISE;
+static int gCrc32HavePclmul = 0;
+static pthread_once_t gCrc32Once = PTHREAD_ONCE_INIT;
+
+
+// local function prototypes
+static void crc32Init(void);
+static unsigned int crc32Bytewise(unsigned int crc, const unsigned char *p, size_t theSize);
+static unsigned int crc32Slice8(unsigned int crc, const unsigned char *p, size_t theSize);
+#ifdef CRC32_PCLMUL_BUILD
+static unsigned int crc32Pclmul(unsigned int crc, const unsigned char *p, size_t theSize);
+#endif
+//----------------------------------------------------------
+
+
+
 unsigned int pclCrc32(unsigned int crc, const unsigned char *buf, size_t theSize)
 {
    const unsigned char *p = 0;
@@ -132,4 +162,215 @@ unsigned int pclCrc32(unsigned int crc, const unsigned char *buf, size_t theSize
 
 
 
+unsigned int pclCrc32Ieee(unsigned int crc, const unsigned char *buf, size_t theSize)
+{
+   (void)pthread_once(&gCrc32Once, crc32Init);
+
+   return pclCrc32IeeeUsing(gCrc32Impl, crc, buf, theSize);
+}
+
+
+
+int pclCrc32IeeeSupported(pclCrc32Impl_e impl)
+{
+   int rval = 0;
+
+   (void)pthread_once(&gCrc32Once, crc32Init);
+
+   switch(impl)
+   {
+      case PCL_CRC32_BYTEWISE:
+      case PCL_CRC32_SLICE8:
+         rval = 1;
+         break;
+      case PCL_CRC32_PCLMUL:
+         rval = gCrc32HavePclmul;
+         break;
+      default:
+         break;
+   }
+   return rval;
+}
+
+
+
+unsigned int pclCrc32IeeeUsing(pclCrc32Impl_e impl, unsigned int crc, const unsigned char *buf, size_t theSize)
+{
+   unsigned int rval = 0;
+
+   if(buf != 0 && pclCrc32IeeeSupported(impl) == 1)
+   {
+      crc = crc ^ ~0U;
+
+      switch(impl)
+      {
+         case PCL_CRC32_SLICE8:
+            crc = crc32Slice8(crc, buf, theSize);
+            break;
+#ifdef CRC32_PCLMUL_BUILD
+         case PCL_CRC32_PCLMUL:
+            crc = crc32Pclmul(crc, buf, theSize);
+            break;
+#endif
+         default:
+            crc = crc32Bytewise(crc, buf, theSize);
+            break;
+      }
+      rval = crc ^ ~0U;
+   }
+
+   return rval;
+}
+
+
+
+static void crc32Init(void)
+{
+   int i = 0, k = 0;
+
+   for(i = 0; i < 256; i++)
+   {
+      gCrc32Slice[0][i] = crc32_tab[i];
+   }
+   for(k = 1; k < 8; k++)
+   {
+      for(i = 0; i < 256; i++)
+      {
+         unsigned int prev = gCrc32Slice[k-1][i];
+         gCrc32Slice[k][i] = (prev >> 8) ^ crc32_tab[prev & 0xFF];
+      }
+   }
+
+#ifdef CRC32_PCLMUL_BUILD
+   {
+      unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+
+      if(__get_cpuid(1, &eax, &ebx, &ecx, &edx) != 0 && (ecx & bit_PCLMUL) != 0 && (edx & bit_SSE2) != 0)
+      {
+         gCrc32HavePclmul = 1;
+      }
+   }
+#endif
+
+   gCrc32Impl = (gCrc32HavePclmul == 1) ? PCL_CRC32_PCLMUL : PCL_CRC32_SLICE8;
+}
+
+
+
+static unsigned int crc32Bytewise(unsigned int crc, const unsigned char *p, size_t theSize)
+{
+   while(theSize--)
+   {
+      crc = crc32_tab[(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+   }
+   return crc;
+}
+
+
+
+static unsigned int crc32Slice8(unsigned int crc, const unsigned char *p, size_t theSize)
+{
+   while(theSize >= 8)
+   {
+      // assembled byte by byte, so the result does not depend on alignment or byte order
+      unsigned int one = crc ^ (  (unsigned int)p[0]        | ((unsigned int)p[1] << 8)
+                                | ((unsigned int)p[2] << 16) | ((unsigned int)p[3] << 24));
+      unsigned int two =          (unsigned int)p[4]        | ((unsigned int)p[5] << 8)
+                                | ((unsigned int)p[6] << 16) | ((unsigned int)p[7] << 24);
+
+      crc =   gCrc32Slice[7][one & 0xFF] ^ gCrc32Slice[6][(one >> 8) & 0xFF]
+            ^ gCrc32Slice[5][(one >> 16) & 0xFF] ^ gCrc32Slice[4][one >> 24]
+            ^ gCrc32Slice[3][two & 0xFF] ^ gCrc32Slice[2][(two >> 8) & 0xFF]
+            ^ gCrc32Slice[1][(two >> 16) & 0xFF] ^ gCrc32Slice[0][two >> 24];
+
+      p += 8;
+      theSize -= 8;
+   }
+
+   return crc32Bytewise(crc, p, theSize);
+}
+
+
+
+#ifdef CRC32_PCLMUL_BUILD
+/*
+ * Folding as described in "Fast CRC Computation for Generic Polynomials Using PCLMULQDQ
+ * Instruction" (Intel, 2009): four 128 bit accumulators are folded 64 bytes ahead, then
+ * into one, the rest of the 16 byte blocks is folded into it and the 128 bits are reduced
+ * to 32 with a Barrett reduction. The constants are those of the bit reflected polynomial.
+ */
+__attribute__((target("pclmul,sse2")))
+static unsigned int crc32Pclmul(unsigned int crc, const unsigned char *p, size_t theSize)
+{
+   const __m128i k1k2 = _mm_set_epi64x(0x01c6e41596LL, 0x0154442bd4LL);
+   const __m128i k3k4 = _mm_set_epi64x(0x00ccaa009eLL, 0x01751997d0LL);
+   const __m128i k5k0 = _mm_set_epi64x(0x0000000000LL, 0x0163cd6124LL);
+   const __m128i poly = _mm_set_epi64x(0x01f7011641LL, 0x01db710641LL);
+   const __m128i mask32 = _mm_setr_epi32(~0, 0, ~0, 0);
+   __m128i x1, x2, x3, x4, x5, x6, x7, x8;
+
+   if(theSize < 64)
+   {
+      return crc32Slice8(crc, p, theSize);
+   }
+
+   x1 = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(p + 0x00)), _mm_cvtsi32_si128((int)crc));
+   x2 = _mm_loadu_si128((const __m128i*)(p + 0x10));
+   x3 = _mm_loadu_si128((const __m128i*)(p + 0x20));
+   x4 = _mm_loadu_si128((const __m128i*)(p + 0x30));
+   p += 64;
+   theSize -= 64;
+
+   while(theSize >= 64)
+   {
+      x5 = _mm_clmulepi64_si128(x1, k1k2, 0x00);
+      x6 = _mm_clmulepi64_si128(x2, k1k2, 0x00);
+      x7 = _mm_clmulepi64_si128(x3, k1k2, 0x00);
+      x8 = _mm_clmulepi64_si128(x4, k1k2, 0x00);
+
+      x1 = _mm_clmulepi64_si128(x1, k1k2, 0x11);
+      x2 = _mm_clmulepi64_si128(x2, k1k2, 0x11);
+      x3 = _mm_clmulepi64_si128(x3, k1k2, 0x11);
+      x4 = _mm_clmulepi64_si128(x4, k1k2, 0x11);
+
+      x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), _mm_loadu_si128((const __m128i*)(p + 0x00)));
+      x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), _mm_loadu_si128((const __m128i*)(p + 0x10)));
+      x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), _mm_loadu_si128((const __m128i*)(p + 0x20)));
+      x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), _mm_loadu_si128((const __m128i*)(p + 0x30)));
+
+      p += 64;
+      theSize -= 64;
+   }
+
+   // four accumulators into one
+   x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+   x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k3k4, 0x11), x2), x5);
+   x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+   x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k3k4, 0x11), x3), x5);
+   x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+   x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k3k4, 0x11), x4), x5);
+
+   while(theSize >= 16)
+   {
+      x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+      x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k3k4, 0x11), _mm_loadu_si128((const __m128i*)p)), x5);
+      p += 16;
+      theSize -= 16;
+   }
+
+   // 128 bits to 64
+   x2 = _mm_clmulepi64_si128(x1, k3k4, 0x10);
+   x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+   x2 = _mm_srli_si128(x1, 4);
+   x1 = _mm_xor_si128(_mm_clmulepi64_si128(_mm_and_si128(x1, mask32), k5k0, 0x00), x2);
+
+   // Barrett reduction to 32 bits
+   x2 = _mm_clmulepi64_si128(_mm_and_si128(x1, mask32), poly, 0x10);
+   x2 = _mm_clmulepi64_si128(_mm_and_si128(x2, mask32), poly, 0x00);
+   x1 = _mm_xor_si128(x1, x2);
+   crc = (unsigned int)_mm_cvtsi128_si32(_mm_srli_si128(x1, 4));
 
+   // the bytes after the last 16 byte block
+   return crc32Slice8(crc, p, theSize);
+}
+#endif
@@ -25,7 +25,72 @@
 
 #include <string.h>
 
+
+/**
+ * @brief crc32 as used for the keys of the persistence client library
+ *        Note: a byte is skipped when the low byte of the crc xor the byte is 0xFF, so the
+ *        result is not the standard CRC-32 for every input. The function is kept as it is
+ *        because its values are stored (e.g. as default project IDs); use pclCrc32Ieee
+ *        for new checksums.
+ *
+ * @param crc the crc of the previous part, 0 for the first part
+ * @param buf the data
+ * @param theSize number of bytes
+ *
+ * @return the crc, 0 if buf is NULL
+ */
 unsigned int pclCrc32(unsigned int crc, const unsigned char *buf, size_t theSize);
 
 
+/// implementations of pclCrc32Ieee, all giving the same result
+typedef enum pclCrc32Impl_e_
+{
+   /// one table lookup per byte
+   PCL_CRC32_BYTEWISE = 0,
+   /// eight table lookups per 8 bytes (slicing-by-8)
+   PCL_CRC32_SLICE8,
+   /// folding of 64 byte blocks with carry-less multiplication (x86 PCLMULQDQ)
+   PCL_CRC32_PCLMUL,
+
+   PCL_CRC32_IMPL_COUNT
+
+} pclCrc32Impl_e;
+
+
+/**
+ * @brief Standard CRC-32 (IEEE 802.3, polynomial 0xEDB88320 reflected) with the
+ *        fastest implementation the CPU supports, selected once by CPUID
+ *
+ * @param crc the crc of the previous part, 0 for the first part
+ * @param buf the data
+ * @param theSize number of bytes
+ *
+ * @return the crc, 0 if buf is NULL
+ */
+unsigned int pclCrc32Ieee(unsigned int crc, const unsigned char *buf, size_t theSize);
+
+
+/**
+ * @brief Check if an implementation of pclCrc32Ieee can be used on this CPU
+ *
+ * @param impl the implementation
+ *
+ * @return 1 if supported, 0 if not
+ */
+int pclCrc32IeeeSupported(pclCrc32Impl_e impl);
+
+
+/**
+ * @brief pclCrc32Ieee with a given implementation, for tests and benchmarks
+ *
+ * @param impl the implementation, must be supported (see pclCrc32IeeeSupported)
+ * @param crc the crc of the previous part, 0 for the first part
+ * @param buf the data
+ * @param theSize number of bytes
+ *
+ * @return the crc, 0 if buf is NULL or the implementation is not supported
+ */
+unsigned int pclCrc32IeeeUsing(pclCrc32Impl_e impl, unsigned int crc, const unsigned char *buf, size_t theSize);
+
+
 #endif /* CRC32_H */
@@ -0,0 +1,360 @@
+/******************************************************************************
+ * Project         Persistency
+ * (c) copyright   2014
+ * Company         XS Embedded GmbH
+ *****************************************************************************/
+/******************************************************************************
+ * This Source Code Form is subject to the terms of the
+ * Mozilla Public License, v. 2.0. If a  copy of the MPL was not distributed
+ * with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
+******************************************************************************/
+ /**
+ * @file           persistence_hm_config_cache.c
+ * @ingroup        Persistence Health Monitor
+ * @author         Ingo Huerner
+ * @brief          Implementation of the persistence health monitor configuration cache.
+ *                 Layout: header, table directory ((offset, size) per table), the table
+ *                 images and the 0 terminated tokens; every part starts at a multiple
+ *                 of 8. The CRC-32 (pclCrc32Ieee) covers everything after the header.
+ * @see
+ */
+
+#include "persistence_hm_definitions.h"
+#include "persistence_hm_config_cache.h"
+#include "crc32.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <limits.h>
+#include <sys/mman.h>
+
+
+/// identifies a cache file
+#define CONFIG_CACHE_MAGIC "PHMC"
+/// format version, increment when the layout of the file or of a table image changes
+#define CONFIG_CACHE_VERSION 2
+
+/// size rounded up to a multiple of 8
+#define CONFIG_CACHE_ALIGN(size) (((size) + 7) & ~(size_t)7)
+
+
+/// start of a cache file
+typedef struct ConfigCacheHeader_s_
+{
+   char magic[4];
+   uint32_t version;
+   /// size of the file
+   uint32_t size;
+   /// CRC-32 (pclCrc32Ieee) of the file after the header
+   uint32_t crc;
+   /// the configuration file the cache belongs to
+   uint64_t sourceDev;
+   uint64_t sourceIno;
+   uint64_t sourceSize;
+   int64_t sourceMtimeSec;
+   int64_t sourceMtimeNsec;
+   /// the tokens of the '@' entries
+   uint32_t tokenCount;
+   uint32_t tokensOffset;
+   uint32_t tokensSize;
+   /// the directory of the limits tables
+   uint32_t tableCount;
+   uint32_t tablesOffset;
+   uint32_t reserved;
+} ConfigCacheHeader_s;
+
+
+/// position of a table image in the file
+typedef struct ConfigCacheTable_s_
+{
+   uint32_t offset;
+   uint32_t size;
+} ConfigCacheTable_s;
+
+
+struct ConfigCache_s_
+{
+   /// the mapped file
+   const char* map;
+   size_t size;
+};
+
+
+// local function prototypes
+static int isValid(const char* map, size_t size, const struct stat* source);
+static void setSource(ConfigCacheHeader_s* header, const struct stat* source);
+//----------------------------------------------------------
+
+
+
+ConfigCache_s* configCacheOpen(const char* path, const struct stat* source)
+{
+   ConfigCache_s* cache = NULL;
+   struct stat buf;
+   void* map = MAP_FAILED;
+   int fd = open(path, O_RDONLY | O_CLOEXEC);
+
+   if(fd == -1)
+   {
+      return NULL;      // not written yet
+   }
+
+   if(fstat(fd, &buf) == 0 && buf.st_size >= (off_t)sizeof(ConfigCacheHeader_s) && buf.st_size <= UINT32_MAX)
+   {
+      map = mmap(NULL, (size_t)buf.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+   }
+   close(fd);
+
+   if(map == MAP_FAILED)
+   {
+      return NULL;
+   }
+
+   if(isValid((const char*)map, (size_t)buf.st_size, source) == 0)
+   {
+      DLT_LOG(phmContext, DLT_LOG_INFO, DLT_STRING("configCache - outdated or damaged:"), DLT_STRING(path));
+      munmap(map, (size_t)buf.st_size);
+      return NULL;
+   }
+
+   cache = malloc(sizeof(ConfigCache_s));
+   if(cache == NULL)
+   {
+      munmap(map, (size_t)buf.st_size);
+      return NULL;
+   }
+   cache->map  = (const char*)map;
+   cache->size = (size_t)buf.st_size;
+
+   return cache;
+}
+
+
+
+void configCacheClose(ConfigCache_s* cache)
+{
+   if(cache != NULL)
+   {
+      munmap((void*)cache->map, cache->size);
+      free(cache);
+   }
+}
+
+
+
+int configCacheGetTokenCount(const ConfigCache_s* cache)
+{
+   return (int)((const ConfigCacheHeader_s*)cache->map)->tokenCount;
+}
+
+
+
+int configCacheGetTokens(const ConfigCache_s* cache, const char** tokens, int max)
+{
+   const ConfigCacheHeader_s* header = (const ConfigCacheHeader_s*)cache->map;
+   const char* token = cache->map + header->tokensOffset;
+   int i = 0;
+
+   for(i = 0; i < (int)header->tokenCount && i < max; i++)
+   {
+      tokens[i] = token;
+      token += strlen(token) + 1;
+   }
+   return i;
+}
+
+
+
+int configCacheGetTableCount(const ConfigCache_s* cache)
+{
+   return (int)((const ConfigCacheHeader_s*)cache->map)->tableCount;
+}
+
+
+
+LimitsTable_s* configCacheGetLimits(const ConfigCache_s* cache, int index)
+{
+   const ConfigCacheHeader_s* header = (const ConfigCacheHeader_s*)cache->map;
+   const ConfigCacheTable_s* table = (const ConfigCacheTable_s*)(cache->map + header->tablesOffset) + index;
+
+   return limitsTableFromImage(cache->map + table->offset, table->size);
+}
+
+
+
+int configCacheWrite(const char* path, const struct stat* source, const char* const* tokens, int tokenCount,
+                     LimitsTable_s* const* tables, int tableCount)
+{
+   int i = 0, fd = -1, rval = -1;
+   size_t size = sizeof(ConfigCacheHeader_s) + CONFIG_CACHE_ALIGN(tableCount * sizeof(ConfigCacheTable_s));
+   size_t tokensSize = 0, offset = 0;
+   char tmpPath[PATH_MAX];
+   char* buffer = NULL;
+   ConfigCacheHeader_s* header = NULL;
+   ConfigCacheTable_s* directory = NULL;
+
+   for(i = 0; i < tableCount; i++)
+   {
+      size_t imageSize = limitsTableGetImageSize(tables[i]);
+
+      if(imageSize == 0)
+      {
+         return -1;     // not sealed, the cache would miss sizes
+      }
+      size += imageSize;
+   }
+   for(i = 0; i < tokenCount; i++)
+   {
+      tokensSize += strlen(tokens[i]) + 1;
+   }
+   size += CONFIG_CACHE_ALIGN(tokensSize);
+
+   if(size > UINT32_MAX || snprintf(tmpPath, sizeof(tmpPath), "%s.tmp", path) >= (int)sizeof(tmpPath))
+   {
+      return -1;
+   }
+
+   buffer = calloc(1, size);
+   if(buffer == NULL)
+   {
+      return -1;
+   }
+
+   header    = (ConfigCacheHeader_s*)buffer;
+   directory = (ConfigCacheTable_s*)(buffer + sizeof(ConfigCacheHeader_s));
+   memcpy(header->magic, CONFIG_CACHE_MAGIC, sizeof(header->magic));
+   header->version      = CONFIG_CACHE_VERSION;
+   header->size         = (uint32_t)size;
+   header->tableCount   = (uint32_t)tableCount;
+   header->tablesOffset = (uint32_t)sizeof(ConfigCacheHeader_s);
+   setSource(header, source);
+
+   offset = sizeof(ConfigCacheHeader_s) + CONFIG_CACHE_ALIGN(tableCount * sizeof(ConfigCacheTable_s));
+   for(i = 0; i < tableCount; i++)
+   {
+      directory[i].offset = (uint32_t)offset;
+      directory[i].size   = (uint32_t)limitsTableGetImageSize(tables[i]);
+      limitsTableWriteImage(tables[i], buffer + offset);
+      offset += directory[i].size;
+   }
+
+   header->tokenCount   = (uint32_t)tokenCount;
+   header->tokensOffset = (uint32_t)offset;
+   header->tokensSize   = (uint32_t)tokensSize;
+   for(i = 0; i < tokenCount; i++)
+   {
+      size_t len = strlen(tokens[i]) + 1;
+      memcpy(buffer + offset, tokens[i], len);
+      offset += len;
+   }
+
+   header->crc = pclCrc32Ieee(0, (unsigned char*)buffer + sizeof(ConfigCacheHeader_s), size - sizeof(ConfigCacheHeader_s));
+
+   // a reader sees the old or the new file, never a partly written one
+   fd = open(tmpPath, O_CREAT | O_WRONLY | O_TRUNC | O_CLOEXEC, 0644);
+   if(fd != -1)
+   {
+      if(write(fd, buffer, size) == (ssize_t)size && fsync(fd) == 0)
+      {
+         rval = 0;
+      }
+      close(fd);
+
+      if(rval == 0 && rename(tmpPath, path) == -1)
+      {
+         rval = -1;
+      }
+      if(rval == -1)
+      {
+         unlink(tmpPath);
+      }
+   }
+
+   if(rval == -1)
+   {
+      DLT_LOG(phmContext, DLT_LOG_WARN, DLT_STRING("configCache - failed to write:"), DLT_STRING(path), DLT_STRING(strerror(errno)));
+   }
+
+   free(buffer);
+
+   return rval;
+}
+
+
+
+static int isValid(const char* map, size_t size, const struct stat* source)
+{
+   int i = 0;
+   ConfigCacheHeader_s expected;
+   const ConfigCacheHeader_s* header = (const ConfigCacheHeader_s*)map;
+   const ConfigCacheTable_s* directory = NULL;
+   const char* tokens = NULL;
+
+   memset(&expected, 0, sizeof(expected));
+   setSource(&expected, source);
+
+   if(   memcmp(header->magic, CONFIG_CACHE_MAGIC, sizeof(header->magic)) != 0
+      || header->version != CONFIG_CACHE_VERSION
+      || header->size != size
+      || header->sourceDev != expected.sourceDev
+      || header->sourceIno != expected.sourceIno
+      || header->sourceSize != expected.sourceSize
+      || header->sourceMtimeSec != expected.sourceMtimeSec
+      || header->sourceMtimeNsec != expected.sourceMtimeNsec)
+   {
+      return 0;
+   }
+
+   if(header->crc != pclCrc32Ieee(0, (const unsigned char*)map + sizeof(ConfigCacheHeader_s), size - sizeof(ConfigCacheHeader_s)))
+   {
+      return 0;
+   }
+
+   // the layout is checked once, the getters rely on it
+   if(   header->tablesOffset != sizeof(ConfigCacheHeader_s)
+      || header->tableCount > (size - header->tablesOffset) / sizeof(ConfigCacheTable_s)
+      || header->tokensOffset > size || header->tokensSize > size - header->tokensOffset
+      || (header->tokenCount > 0 && (header->tokensSize == 0 || map[header->tokensOffset + header->tokensSize - 1] != '\0')))
+   {
+      return 0;
+   }
+
+   directory = (const ConfigCacheTable_s*)(map + header->tablesOffset);
+   for(i = 0; i < (int)header->tableCount; i++)
+   {
+      if(directory[i].offset > size || directory[i].size > size - directory[i].offset || (directory[i].offset & 7) != 0)
+      {
+         return 0;
+      }
+   }
+
+   tokens = map + header->tokensOffset;
+   for(i = 0; i < (int)header->tokenCount; i++)
+   {
+      const char* end = memchr(tokens, '\0', (size_t)(map + header->tokensOffset + header->tokensSize - tokens));
+
+      if(end == NULL)
+      {
+         return 0;
+      }
+      tokens = end + 1;
+   }
+
+   return 1;
+}
+
+
+
+static void setSource(ConfigCacheHeader_s* header, const struct stat* source)
+{
+   header->sourceDev       = (uint64_t)source->st_dev;
+   header->sourceIno       = (uint64_t)source->st_ino;
+   header->sourceSize      = (uint64_t)source->st_size;
+   header->sourceMtimeSec  = (int64_t)source->st_mtim.tv_sec;
+   header->sourceMtimeNsec = (int64_t)source->st_mtim.tv_nsec;
+}
@@ -0,0 +1,116 @@
+#ifndef PERSISTENCE_HM_CONFIG_CACHE_H_
+#define PERSISTENCE_HM_CONFIG_CACHE_H_
+
+/******************************************************************************
+ * Project         Persistency
+ * (c) copyright   2014
+ * Company         XS Embedded GmbH
+ *****************************************************************************/
+/******************************************************************************
+ * This Source Code Form is subject to the terms of the
+ * Mozilla Public License, v. 2.0. If a  copy of the MPL was not distributed
+ * with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
+******************************************************************************/
+ /**
+ * @file           persistence_hm_config_cache.h
+ * @ingroup        Persistence Health Monitor
+ * @author         Ingo Huerner
+ * @brief          Header of the persistence health monitor configuration cache.
+ *                 The compiled form of the configuration file: the '@' entries as
+ *                 tokens and the sealed limits table of every root as an image. The
+ *                 file is mapped read-only and the tables are used in place, so a
+ *                 start does not parse the size entries or allocate memory for them.
+ *                 It belongs to one version of the configuration file (device, inode,
+ *                 size and modification time) and is checksummed with crc32.
+ * @see
+ */
+
+#include "persistence_hm_limits.h"
+
+#include <sys/stat.h>
+
+
+/// the configuration cache (a mapped cache file)
+typedef struct ConfigCache_s_ ConfigCache_s;
+
+
+/**
+ * @brief Map a cache file
+ *
+ * @param path the cache file
+ * @param source status of the configuration file the cache must belong to
+ *
+ * @return the cache or NULL if there is none, it belongs to another version of the
+ *         configuration file, has another format version or is damaged
+ */
+ConfigCache_s* configCacheOpen(const char* path, const struct stat* source);
+
+
+/**
+ * @brief Unmap a cache file; the tables taken from it must have been destroyed
+ *
+ * @param cache the cache
+ */
+void configCacheClose(ConfigCache_s* cache);
+
+
+/**
+ * @brief Get the number of tokens of the '@' entries
+ *
+ * @param cache the cache
+ *
+ * @return number of tokens
+ */
+int configCacheGetTokenCount(const ConfigCache_s* cache);
+
+
+/**
+ * @brief Get the tokens of the '@' entries ('@root' included), in the order of the file
+ *
+ * @param cache the cache
+ * @param tokens [out] pointers to the tokens in the mapped file
+ * @param max number of pointers fitting into tokens
+ *
+ * @return number of tokens
+ */
+int configCacheGetTokens(const ConfigCache_s* cache, const char** tokens, int max);
+
+
+/**
+ * @brief Get the number of limits tables (one per root, in the order the roots are added)
+ *
+ * @param cache the cache
+ *
+ * @return number of tables
+ */
+int configCacheGetTableCount(const ConfigCache_s* cache);
+
+
+/**
+ * @brief Get a limits table, it points into the mapped file
+ *
+ * @param cache the cache
+ * @param index number of the table
+ *
+ * @return the sealed table (release with limitsTableDestroy) or NULL if memory is exhausted
+ */
+LimitsTable_s* configCacheGetLimits(const ConfigCache_s* cache, int index);
+
+
+/**
+ * @brief Write a cache file; a new file is written and renamed onto the old one
+ *
+ * @param path the cache file
+ * @param source status of the configuration file the tokens and tables come from
+ * @param tokens the tokens of the '@' entries
+ * @param tokenCount number of tokens
+ * @param tables the sealed limits tables
+ * @param tableCount number of tables
+ *
+ * @return 0 on success, -1 on error
+ */
+int configCacheWrite(const char* path, const struct stat* source, const char* const* tokens, int tokenCount,
+                     LimitsTable_s* const* tables, int tableCount);
+
+
+#endif /* PERSISTENCE_HM_CONFIG_CACHE_H_ */
@@ -0,0 +1,303 @@
+/******************************************************************************
+ * Project         Persistency
+ * (c) copyright   2014
+ * Company         XS Embedded GmbH
+ *****************************************************************************/
+/******************************************************************************
+ * This Source Code Form is subject to the terms of the
+ * Mozilla Public License, v. 2.0. If a  copy of the MPL was not distributed
+ * with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
+******************************************************************************/
+ /**
+ * @file           persistence_hm_config_reader.c
+ * @ingroup        Persistence Health Monitor
+ * @author         Ingo Huerner
+ * @brief          Implementation of the persistence health monitor configuration file reader.
+ *                 The file is classified in blocks of 64 bytes: one bit mask marks the
+ *                 token bytes (0x21 ... 0x7E), one the line feeds. Token starts and ends
+ *                 are the edges of the first mask, so the bytes of a token are never
+ *                 looked at one by one. The masks come from AVX2 or SSE2 compares if
+ *                 the compiler targets them, from a byte loop otherwise. Tokens are
+ *                 terminated in place, the file is read into one buffer.
+ * @see
+ */
+
+#include "persistence_hm_definitions.h"
+#include "persistence_hm_config_reader.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+
+/// number of bytes classified at once
+#define CONFIG_BLOCK_SIZE 64
+
+
+struct ConfigReader_s_
+{
+   /// the file, followed by a line feed and blanks up to a multiple of CONFIG_BLOCK_SIZE
+   char* buffer;
+   size_t size;
+   /// offset of the current block, events of the current block not processed yet
+   size_t block;
+   uint64_t starts;
+   uint64_t ends;
+   uint64_t newlines;
+   /// 1 if the last byte of the previous block belongs to a token
+   uint64_t carry;
+   /// state of the current line
+   unsigned int line;
+   int tokenCount;
+   int comment;
+   char* tokens[2];
+   /// number of malformed lines
+   unsigned int errors;
+   /// name of the file for the error reports
+   const char* filename;
+};
+
+
+// local function prototypes
+static void classifyBlock(const char* block, uint64_t* tokenMask, uint64_t* newlineMask);
+static int readBlock(ConfigReader_s* reader);
+//----------------------------------------------------------
+
+
+
+ConfigReader_s* configReaderOpen(const char* filename)
+{
+   struct stat buf;
+   ConfigReader_s* reader = NULL;
+   size_t size = 0, done = 0;
+   int fd = open(filename, O_RDONLY | O_CLOEXEC);
+
+   if(fd == -1)
+   {
+      DLT_LOG(phmContext, DLT_LOG_ERROR, DLT_STRING("configReader::configReaderOpen ==> Error file open: "),
+              DLT_STRING(filename), DLT_STRING("err msg: "), DLT_STRING(strerror(errno)) );
+      return NULL;
+   }
+
+   if(fstat(fd, &buf) == -1 || buf.st_size <= 0)
+   {
+      DLT_LOG(phmContext, DLT_LOG_ERROR, DLT_STRING("configReader::configReaderOpen ==> Error file size is 0"));
+      close(fd);
+      return NULL;
+   }
+   size = (size_t)buf.st_size;
+
+   reader = calloc(1, sizeof(ConfigReader_s));
+   if(reader != NULL)
+   {
+      // the line feed ends the last line, the blanks fill the last block
+      reader->size   = (size + 1 + CONFIG_BLOCK_SIZE - 1) / CONFIG_BLOCK_SIZE * CONFIG_BLOCK_SIZE;
+      reader->buffer = malloc(reader->size);
+   }
+   if(reader == NULL || reader->buffer == NULL)
+   {
+      DLT_LOG(phmContext, DLT_LOG_ERROR, DLT_STRING("configReader::configReaderOpen ==> out of memory"));
+      free(reader);
+      close(fd);
+      return NULL;
+   }
+
+   while(done < size)
+   {
+      ssize_t len = read(fd, reader->buffer + done, size - done);
+
+      if(len == -1 && errno == EINTR)
+      {
+         continue;
+      }
+      if(len <= 0)
+      {
+         break;      // shrunk meanwhile, the rest is treated as blanks
+      }
+      done += (size_t)len;
+   }
+   close(fd);
+
+   reader->buffer[done] = '\n';
+   memset(reader->buffer + done + 1, ' ', reader->size - done - 1);
+
+   reader->block = (size_t)-CONFIG_BLOCK_SIZE;      // the first readBlock moves to 0
+   reader->line  = 1;
+   reader->filename = filename;
+
+   return reader;
+}
+
+
+
+void configReaderClose(ConfigReader_s* reader)
+{
+   if(reader != NULL)
+   {
+      free(reader->buffer);
+      free(reader);
+   }
+}
+
+
+
+int configReaderNext(ConfigReader_s* reader, const char** key, const char** value, unsigned int* line)
+{
+   for(;;)
+   {
+      uint64_t events = reader->starts | reader->ends | reader->newlines;
+      uint64_t bit = 0;
+      char* pos = NULL;
+
+      if(events == 0)
+      {
+         if(readBlock(reader) == 0)
+         {
+            return 0;
+         }
+         continue;
+      }
+
+      bit = events & (~events + 1);      // the first event
+      pos = reader->buffer + reader->block + __builtin_ctzll(events);
+
+      if(reader->ends & bit)
+      {
+         reader->ends &= ~bit;
+         *pos = '\0';         // a delimiter, its line feed is already in the mask
+      }
+
+      if(reader->starts & bit)
+      {
+         reader->starts &= ~bit;
+         if(reader->comment == 0)
+         {
+            if(*pos == '#')
+            {
+               reader->comment = 1;
+            }
+            else
+            {
+               if(reader->tokenCount < 2)
+               {
+                  reader->tokens[reader->tokenCount] = pos;
+               }
+               reader->tokenCount++;
+            }
+         }
+      }
+
+      if(reader->newlines & bit)
+      {
+         int tokenCount = reader->tokenCount;
+
+         reader->newlines &= ~bit;
+         reader->tokenCount = 0;
+         reader->comment    = 0;
+         reader->line++;
+
+         if(tokenCount == 2)
+         {
+            *key   = reader->tokens[0];
+            *value = reader->tokens[1];
+            *line  = reader->line - 1;
+            return 1;
+         }
+         if(tokenCount != 0)
+         {
+            reader->errors++;
+            DLT_LOG(phmContext, DLT_LOG_WARN, DLT_STRING("configReader::configReaderNext ==> malformed line skipped:"),
+                                              DLT_STRING(reader->filename), DLT_UINT(reader->line - 1),
+                                              DLT_STRING("tokens:"), DLT_INT(tokenCount));
+         }
+      }
+   }
+}
+
+
+
+unsigned int configReaderGetErrors(const ConfigReader_s* reader)
+{
+   return reader->errors;
+}
+
+
+
+static int readBlock(ConfigReader_s* reader)
+{
+   uint64_t token = 0, newline = 0, shifted = 0;
+
+   reader->block += CONFIG_BLOCK_SIZE;
+   if(reader->block >= reader->size)
+   {
+      reader->block = reader->size - CONFIG_BLOCK_SIZE;      // stay at the end
+      return 0;
+   }
+
+   classifyBlock(reader->buffer + reader->block, &token, &newline);
+
+   // a start is a token byte after a delimiter, an end a delimiter after a token byte
+   shifted = (token << 1) | reader->carry;
+   reader->starts   = token & ~shifted;
+   reader->ends     = ~token & shifted;
+   reader->newlines = newline;
+   reader->carry    = token >> 63;
+
+   return 1;
+}
+
+
+
+static void classifyBlock(const char* block, uint64_t* tokenMask, uint64_t* newlineMask)
+{
+   uint64_t token = 0, newline = 0;
+   int i = 0;
+
+#if defined(__AVX2__)
+   // signed compare: bytes from 0x80 on are negative and so delimiters like the control characters
+   const __m256i blank = _mm256_set1_epi8(0x20);
+   const __m256i del   = _mm256_set1_epi8(0x7F);
+   const __m256i lf    = _mm256_set1_epi8('\n');
+
+   for(i = 0; i < CONFIG_BLOCK_SIZE; i += 32)
+   {
+      __m256i v = _mm256_loadu_si256((const __m256i*)(block + i));
+      __m256i t = _mm256_andnot_si256(_mm256_cmpeq_epi8(v, del), _mm256_cmpgt_epi8(v, blank));
+
+      token   |= (uint64_t)(uint32_t)_mm256_movemask_epi8(t) << i;
+      newline |= (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, lf)) << i;
+   }
+#elif defined(__SSE2__)
+   const __m128i blank = _mm_set1_epi8(0x20);
+   const __m128i del   = _mm_set1_epi8(0x7F);
+   const __m128i lf    = _mm_set1_epi8('\n');
+
+   for(i = 0; i < CONFIG_BLOCK_SIZE; i += 16)
+   {
+      __m128i v = _mm_loadu_si128((const __m128i*)(block + i));
+      __m128i t = _mm_andnot_si128(_mm_cmpeq_epi8(v, del), _mm_cmpgt_epi8(v, blank));
+
+      token   |= (uint64_t)(uint16_t)_mm_movemask_epi8(t) << i;
+      newline |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, lf)) << i;
+   }
+#else
+   for(i = 0; i < CONFIG_BLOCK_SIZE; i++)
+   {
+      unsigned char c = (unsigned char)block[i];
+
+      token   |= (uint64_t)(c > 0x20 && c < 0x7F) << i;
+      newline |= (uint64_t)(c == '\n') << i;
+   }
+#endif
+
+   *tokenMask   = token;
+   *newlineMask = newline;
+}
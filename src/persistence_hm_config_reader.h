@@ -0,0 +1,74 @@
+#ifndef PERSISTENCE_HM_CONFIG_READER_H_
+#define PERSISTENCE_HM_CONFIG_READER_H_
+
+/******************************************************************************
+ * Project         Persistency
+ * (c) copyright   2014
+ * Company         XS Embedded GmbH
+ *****************************************************************************/
+/******************************************************************************
+ * This Source Code Form is subject to the terms of the
+ * Mozilla Public License, v. 2.0. If a  copy of the MPL was not distributed
+ * with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
+******************************************************************************/
+ /**
+ * @file           persistence_hm_config_reader.h
+ * @ingroup        Persistence Health Monitor
+ * @author         Ingo Huerner
+ * @brief          Header of the persistence health monitor configuration file reader.
+ *                 Every line of the file is one entry "<key> <value>", separated by
+ *                 blanks or tabs. Empty lines are skipped, a token starting with '#'
+ *                 starts a comment up to the end of the line. A line with one token
+ *                 or more than two is reported with its number and skipped.
+ *                 The entries are returned one after the other, there is no limit on
+ *                 their number.
+ * @see
+ */
+
+
+/// the reader of one configuration file
+typedef struct ConfigReader_s_ ConfigReader_s;
+
+
+/**
+ * @brief Read a configuration file
+ *
+ * @param filename the file, the name is used for error reports until the reader is closed
+ *
+ * @return the reader or NULL if the file can not be read, is empty or memory is exhausted
+ */
+ConfigReader_s* configReaderOpen(const char* filename);
+
+
+/**
+ * @brief Release a reader, the returned entries become invalid
+ *
+ * @param reader the reader
+ */
+void configReaderClose(ConfigReader_s* reader);
+
+
+/**
+ * @brief Get the next entry
+ *
+ * @param reader the reader
+ * @param key [out] the first token of the line, valid until the reader is closed
+ * @param value [out] the second token of the line, valid until the reader is closed
+ * @param line [out] number of the line, starting with 1
+ *
+ * @return 1 if an entry has been returned, 0 at the end of the file
+ */
+int configReaderNext(ConfigReader_s* reader, const char** key, const char** value, unsigned int* line);
+
+
+/**
+ * @brief Get the number of malformed lines skipped so far
+ *
+ * @param reader the reader
+ *
+ * @return number of lines
+ */
+unsigned int configReaderGetErrors(const ConfigReader_s* reader);
+
+
+#endif /* PERSISTENCE_HM_CONFIG_READER_H_ */
@@ -21,15 +21,51 @@
 #include "persistence_hm_dbus_service.h"
 #include "persistence_hm_definitions.h"
 #include "persistence_hm_fs_tools.h"
+#include "persistence_hm_disk_mon.h"
 
 #include <persistence_admin_service.h>		// use the PAS to setup new data on the partition
 #include <persComDataOrg.h>					// use defines for persistence data folder
 #include <string.h>
+#include <limits.h>
 
 // TODO: only for testing => replace with the path on the target
 static const char* gResourcePath = "/home/ihuerner/development/git_stash/persistence-client-library/test/data/PAS_data.tar.gz";
 
 
+/// maximum number of applications with a fresh getUsage request in flight
+#define USAGE_PENDING_MAX 16
+/// maximum number of getUsage requests waiting for the same fresh scan
+#define USAGE_WAITERS_MAX 8
+
+/// getUsage requests waiting for the fresh scan of one application
+typedef struct UsagePending_s_
+{
+	/// the AppID
+	char appId[NAME_MAX+1];
+	/// passed to the monitor with the scan request and returned when it is done
+	unsigned int id;
+	/// the connection the requests came in on
+	DBusConnection* connection;
+	/// the waiting requests (referenced until answered)
+	DBusMessage* waiters[USAGE_WAITERS_MAX];
+	int waiterCount;
+} UsagePending_s;
+
+/// fresh scans in flight, only used by the dbus mainloop thread
+static UsagePending_s gUsagePending[USAGE_PENDING_MAX];
+static int gUsagePendingCount = 0;
+static unsigned int gUsagePendingNextId = 0;
+
+
+// local function prototypes
+static void sendUsageReply(DBusConnection* connection, DBusMessage* message, const char* appId);
+static void sendError(DBusConnection* connection, DBusMessage* message, const char* name, const char* text);
+static void onFreshScanDone(unsigned int requestId, int result);
+static void appendTopConsumers(DBusMessageIter* iter, const ScanTopEntry_s* entries, int count);
+static void appendAppUsage(const PhmUsageApp_s* app, const PhmUsageRoot_s* root, void* data);
+//----------------------------------------------------------
+
+
 DBusHandlerResult checkPersPhmMsg(DBusConnection * connection, DBusMessage * message, void * user_data)
 {
 	DBusHandlerResult result = DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
@@ -58,6 +94,18 @@ DBusHandlerResult checkPersPhmMsg(DBusConnection * connection, DBusMessage * mes
 		{
 			result = msg_persFsCreatePartition(connection, message);
 		}
+		else if((0==strcmp("getUsage", dbus_message_get_member(message))))
+		{
+			result = msg_persGetUsage(connection, message);
+		}
+		else if((0==strcmp("getAllUsage", dbus_message_get_member(message))))
+		{
+			result = msg_persGetAllUsage(connection, message);
+		}
+		else if((0==strcmp("getTopConsumers", dbus_message_get_member(message))))
+		{
+			result = msg_persGetTopConsumers(connection, message);
+		}
 		else
 		{
 			 DLT_LOG(phmContext, DLT_LOG_WARN, DLT_STRING("   checkPersClientMsg -> unknown message"),
@@ -308,3 +356,303 @@ DBusHandlerResult msg_persFsCreatePartition(DBusConnection *connection, DBusMess
 
 	return result;
 }
+
+
+
+DBusHandlerResult msg_persGetUsage(DBusConnection *connection, DBusMessage *message)
+{
+	int i = 0;
+	char* appId = NULL;
+	dbus_bool_t fresh = FALSE;
+	UsagePending_s* pending = NULL;
+	DBusError error;
+
+	dbus_error_init(&error);
+
+	if (!dbus_message_get_args(message, &error, DBUS_TYPE_STRING,  &appId,
+	                                            DBUS_TYPE_BOOLEAN, &fresh,
+	                                            DBUS_TYPE_INVALID))
+	{
+		sendError(connection, message, error.name, error.message);
+		dbus_error_free(&error);
+		return DBUS_HANDLER_RESULT_HANDLED;
+	}
+
+	if(fresh == FALSE)
+	{
+		sendUsageReply(connection, message, appId);     // the last scan result, no file system access
+		return DBUS_HANDLER_RESULT_HANDLED;
+	}
+
+	// a fresh scan of this application already in flight answers this request too
+	for(i = 0; i < gUsagePendingCount; i++)
+	{
+		if(0 == strcmp(gUsagePending[i].appId, appId))
+		{
+			pending = &gUsagePending[i];
+			break;
+		}
+	}
+
+	if(pending == NULL && gUsagePendingCount < USAGE_PENDING_MAX && strlen(appId) <= NAME_MAX)
+	{
+		if(requestAppScan(appId, onFreshScanDone, gUsagePendingNextId) == 0)
+		{
+			pending = &gUsagePending[gUsagePendingCount++];
+			strcpy(pending->appId, appId);
+			pending->id          = gUsagePendingNextId++;
+			pending->connection  = connection;
+			pending->waiterCount = 0;
+		}
+		else
+		{
+			sendError(connection, message, "org.genivi.persistence.health.Error.Failed", "scan request rejected");
+			return DBUS_HANDLER_RESULT_HANDLED;
+		}
+	}
+
+	if(pending == NULL || pending->waiterCount == USAGE_WAITERS_MAX)
+	{
+		sendError(connection, message, "org.genivi.persistence.health.Error.Busy", "too many fresh usage requests");
+		return DBUS_HANDLER_RESULT_HANDLED;
+	}
+
+	pending->waiters[pending->waiterCount++] = dbus_message_ref(message);
+
+	return DBUS_HANDLER_RESULT_HANDLED;
+}
+
+
+
+DBusHandlerResult msg_persGetAllUsage(DBusConnection *connection, DBusMessage *message)
+{
+	DBusMessageIter iter, array;
+	DBusMessage* reply = dbus_message_new_method_return(message);
+
+	if(reply == NULL)
+	{
+		DLT_LOG(phmContext, DLT_LOG_ERROR, DLT_STRING("DBus No memory"));
+		return DBUS_HANDLER_RESULT_NEED_MEMORY;
+	}
+
+	// every application of every root, the snapshot may have left some out
+	dbus_message_iter_init_append(reply, &iter);
+	dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY, "(sstti)", &array);
+	forEachAppUsage(appendAppUsage, &array);
+	dbus_message_iter_close_container(&iter, &array);
+
+	if (!dbus_connection_send(connection, reply, 0))
+	{
+		DLT_LOG(phmContext, DLT_LOG_ERROR, DLT_STRING("DBus No memory"));
+	}
+	dbus_message_unref(reply);
+
+	return DBUS_HANDLER_RESULT_HANDLED;
+}
+
+
+
+DBusHandlerResult msg_persGetTopConsumers(DBusConnection *connection, DBusMessage *message)
+{
+	int fileCount = 0, folderCount = 0;
+	char* appId = NULL;
+	const char* rootPath = "";
+	PhmUsageApp_s app;
+	PhmUsageRoot_s root;
+	DBusMessageIter iter;
+	DBusMessage* reply = NULL;
+	DBusError error;
+	static ScanTopEntry_s files[SCAN_TOP_MAX_ENTRIES];     // only used by the mainloop thread
+	static ScanTopEntry_s folders[SCAN_TOP_MAX_ENTRIES];
+
+	dbus_error_init(&error);
+
+	if (!dbus_message_get_args(message, &error, DBUS_TYPE_STRING, &appId,
+	                                            DBUS_TYPE_INVALID))
+	{
+		sendError(connection, message, error.name, error.message);
+		dbus_error_free(&error);
+		return DBUS_HANDLER_RESULT_HANDLED;
+	}
+
+	// collected by the last scan, no file system access
+	fileCount   = getTopConsumers(appId, ScanTopKind_File, files, SCAN_TOP_MAX_ENTRIES);
+	folderCount = getTopConsumers(appId, ScanTopKind_Folder, folders, SCAN_TOP_MAX_ENTRIES);
+	if(fileCount == -1 || folderCount == -1)
+	{
+		sendError(connection, message, "org.genivi.persistence.health.Error.UnknownApp", appId);
+		return DBUS_HANDLER_RESULT_HANDLED;
+	}
+
+	if(getAppUsage(appId, &app, &root) == 0)
+	{
+		rootPath = root.path;
+	}
+
+	reply = dbus_message_new_method_return(message);
+	if(reply == NULL)
+	{
+		DLT_LOG(phmContext, DLT_LOG_ERROR, DLT_STRING("DBus No memory"));
+		return DBUS_HANDLER_RESULT_NEED_MEMORY;
+	}
+
+	dbus_message_iter_init_append(reply, &iter);
+	dbus_message_iter_append_basic(&iter, DBUS_TYPE_STRING, &rootPath);
+	appendTopConsumers(&iter, files, fileCount);
+	appendTopConsumers(&iter, folders, folderCount);
+
+	if (!dbus_connection_send(connection, reply, 0))
+	{
+		DLT_LOG(phmContext, DLT_LOG_ERROR, DLT_STRING("DBus No memory"));
+	}
+	dbus_message_unref(reply);
+
+	return DBUS_HANDLER_RESULT_HANDLED;
+}
+
+
+
+void msg_persUsageReady(unsigned int requestId, int result)
+{
+	int i = 0, j = 0;
+
+	for(i = 0; i < gUsagePendingCount; i++)
+	{
+		UsagePending_s* pending = &gUsagePending[i];
+
+		if(pending->id == requestId)
+		{
+			for(j = 0; j < pending->waiterCount; j++)
+			{
+				if(result == 0)
+				{
+					sendUsageReply(pending->connection, pending->waiters[j], pending->appId);
+				}
+				else
+				{
+					sendError(pending->connection, pending->waiters[j], "org.genivi.persistence.health.Error.UnknownApp", pending->appId);
+				}
+				dbus_message_unref(pending->waiters[j]);
+			}
+
+			gUsagePending[i] = gUsagePending[--gUsagePendingCount];
+			break;
+		}
+	}
+}
+
+
+
+static void onFreshScanDone(unsigned int requestId, int result)
+{
+	MainLoopData_u data;
+
+	// runs in the monitor thread, the replies are sent by the dbus mainloop
+	memset(&data, 0, sizeof(data));
+	data.message.cmd       = (uint32_t)CMD_USAGE_READY;
+	data.message.params[0] = (uint32_t)result;
+	data.message.params[1] = (uint32_t)requestId;
+
+	deliverToMainloop_NM(&data);
+}
+
+
+
+static void sendUsageReply(DBusConnection* connection, DBusMessage* message, const char* appId)
+{
+	PhmUsageApp_s app;
+	PhmUsageRoot_s root;
+	DBusMessage* reply = NULL;
+
+	if(getAppUsage(appId, &app, &root) == -1)
+	{
+		sendError(connection, message, "org.genivi.persistence.health.Error.UnknownApp", appId);
+		return;
+	}
+
+	reply = dbus_message_new_method_return(message);
+	if(reply != NULL)
+	{
+		const char* rootPath = root.path;
+		dbus_uint64_t size = app.size;
+		dbus_uint64_t limit = app.limit;
+		dbus_int32_t status = (dbus_int32_t)app.health;
+
+		dbus_message_append_args(reply, DBUS_TYPE_STRING, &rootPath,
+		                                DBUS_TYPE_UINT64, &size,
+		                                DBUS_TYPE_UINT64, &limit,
+		                                DBUS_TYPE_INT32,  &status,
+		                                DBUS_TYPE_INVALID);
+		if (!dbus_connection_send(connection, reply, 0))
+		{
+			DLT_LOG(phmContext, DLT_LOG_ERROR, DLT_STRING("DBus No memory"));
+		}
+		dbus_message_unref(reply);
+	}
+	else
+	{
+		DLT_LOG(phmContext, DLT_LOG_ERROR, DLT_STRING("DBus No memory"));
+	}
+}
+
+
+
+static void appendTopConsumers(DBusMessageIter* iter, const ScanTopEntry_s* entries, int count)
+{
+	int i = 0;
+	DBusMessageIter array, entry;
+
+	dbus_message_iter_open_container(iter, DBUS_TYPE_ARRAY, "(st)", &array);
+	for(i = 0; i < count; i++)
+	{
+		const char* path = entries[i].path;
+		dbus_uint64_t size = entries[i].size;
+
+		dbus_message_iter_open_container(&array, DBUS_TYPE_STRUCT, NULL, &entry);
+		dbus_message_iter_append_basic(&entry, DBUS_TYPE_STRING, &path);
+		dbus_message_iter_append_basic(&entry, DBUS_TYPE_UINT64, &size);
+		dbus_message_iter_close_container(&array, &entry);
+	}
+	dbus_message_iter_close_container(iter, &array);
+}
+
+
+
+static void appendAppUsage(const PhmUsageApp_s* app, const PhmUsageRoot_s* root, void* data)
+{
+	DBusMessageIter* array = (DBusMessageIter*)data;
+	DBusMessageIter entry;
+	const char* rootPath = root->path;
+	const char* name = app->appId;
+	dbus_uint64_t size = app->size;
+	dbus_uint64_t limit = app->limit;
+	dbus_int32_t status = (dbus_int32_t)app->health;
+
+	dbus_message_iter_open_container(array, DBUS_TYPE_STRUCT, NULL, &entry);
+	dbus_message_iter_append_basic(&entry, DBUS_TYPE_STRING, &rootPath);
+	dbus_message_iter_append_basic(&entry, DBUS_TYPE_STRING, &name);
+	dbus_message_iter_append_basic(&entry, DBUS_TYPE_UINT64, &size);
+	dbus_message_iter_append_basic(&entry, DBUS_TYPE_UINT64, &limit);
+	dbus_message_iter_append_basic(&entry, DBUS_TYPE_INT32,  &status);
+	dbus_message_iter_close_container(array, &entry);
+}
+
+
+
+static void sendError(DBusConnection* connection, DBusMessage* message, const char* name, const char* text)
+{
+	DBusMessage* reply = dbus_message_new_error(message, name, text);
+
+	if (reply == 0)
+	{
+		DLT_LOG(phmContext, DLT_LOG_ERROR, DLT_STRING("DBus No memory"));
+		return;
+	}
+
+	if (!dbus_connection_send(connection, reply, 0))
+	{
+		DLT_LOG(phmContext, DLT_LOG_ERROR, DLT_STRING("DBus No memory"));
+	}
+
+	dbus_message_unref(reply);
+}
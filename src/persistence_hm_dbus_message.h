@@ -34,5 +34,20 @@ DBusHandlerResult msg_persFsUnMount(DBusConnection *connection, DBusMessage *mes
 
 DBusHandlerResult msg_persFsCreatePartition(DBusConnection *connection, DBusMessage *message);
 
+DBusHandlerResult msg_persGetUsage(DBusConnection *connection, DBusMessage *message);
+
+DBusHandlerResult msg_persGetAllUsage(DBusConnection *connection, DBusMessage *message);
+
+DBusHandlerResult msg_persGetTopConsumers(DBusConnection *connection, DBusMessage *message);
+
+/**
+ * @brief Answer the getUsage requests waiting for a fresh scan of an application,
+ *        called in the dbus mainloop when the monitor thread has scanned it
+ *
+ * @param requestId the id the scan has been requested with
+ * @param result 0 if the application has been scanned, -1 if it is unknown
+ */
+void msg_persUsageReady(unsigned int requestId, int result);
+
 
 #endif /* PERSISTENCE_HM_DBUS_MESSAGE_H_ */
@@ -20,6 +20,7 @@
 #include "persistence_hm_definitions.h"
 #include "persistence_hm_dbus_message.h"
 #include "persistence_hm_disk_mon.h"
+#include "persistence_hm_thread_policy.h"
 
 #include <NodeStateTypes.h>
 
@@ -283,6 +284,9 @@ int setup_dbus_mainloop(void)
    printf("Set failure state to active\n");
    sendNsmMessage(conn, "SetSessionState", NsmSeat_Driver, NsmSessionState_Active);
 
+   // the mainloop runs in this thread, it must stay responsive while the disk monitor scans
+   (void)threadPolicyApply(ThreadPolicy_Dbus);
+
    // setup the dbus
    mainLoop(vtablePersHM, vtableFallback, conn);
 
@@ -591,6 +595,10 @@ int mainLoop(DBusObjectPathVTable vtable, DBusObjectPathVTable vtableFallback, v
 															bContinue = FALSE;
 														}
 														break;
+                                       case CMD_USAGE_READY:
+                                          printf(" CMD_USAGE_READY\n");
+                                          msg_persUsageReady(readData.message.params[1], (int)readData.message.params[0]);
+                                          break;
                                        default:
                                        	printf(" default -> nothing to do\n");
                                           DLT_LOG(phmContext, DLT_LOG_ERROR, DLT_STRING("mainLoop => command not handled"), DLT_INT(readData.message.cmd) );
@@ -642,7 +650,8 @@ int mainLoop(DBusObjectPathVTable vtable, DBusObjectPathVTable vtableFallback, v
 
       remove(gPidFileName);
 
-      freeRbTree();
+      stopMonitorThread();
+      freeLimits();
    }
    return 0;
 }
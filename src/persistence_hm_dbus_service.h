@@ -34,7 +34,9 @@ typedef enum ECmd
    /// quit command
    CMD_QUIT,
    ///  request dbus name
-   CMD_REQUEST_NAME
+   CMD_REQUEST_NAME,
+   /// a fresh usage scan is done (params[0]: result, params[1]: id of the pending request)
+   CMD_USAGE_READY
 } tCmd;
 
 
@@ -19,7 +19,22 @@
 
 #include "persistence_hm_definitions.h"
 #include "persistence_hm_disk_mon.h"
-#include "rbtree.h"
+#include "persistence_hm_disk_watch.h"
+#include "persistence_hm_disk_scan.h"
+#include "persistence_hm_scan_pool.h"
+#include "persistence_hm_usage_provider.h"
+#include "persistence_hm_scan_cache.h"
+#include "persistence_hm_usage_quota.h"
+#include "persistence_hm_quota_events.h"
+#include "persistence_hm_scan_schedule.h"
+#include "persistence_hm_forecast.h"
+#include "persistence_hm_scan_budget.h"
+#include "persistence_hm_thread_policy.h"
+#include "persistence_hm_usage_shm.h"
+#include "persistence_hm_limits.h"
+#include "persistence_hm_config_cache.h"
+#include "persistence_hm_config_reader.h"
+#include "persistence_hm_handoff.h"
 #include "crc32.h"
 
 #include <pthread.h>
@@ -29,441 +44,2276 @@
 #include <sys/stat.h>
 #include <unistd.h>
 #include <string.h>
-#include <sys/mman.h>
 #include <errno.h>
 #include <stdlib.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <time.h>
+#include <stdint.h>
+#include <sys/timerfd.h>
+#include <sys/statvfs.h>
+#include <sys/inotify.h>
+#include <sys/eventfd.h>
 
 
-/// structure definition for a key value item
-typedef struct _key_value_s
+/// default configuration file location
+const char* gDefaultConfig = "/etc/persistence_phm.conf";
+
+/// default location of the compiled configuration file
+const char* gDefaultConfigCache = "/var/cache/persistence_phm.conf.cache";
+
+// local function prototypes
+static int getConfiguration(void);
+static unsigned long long findMaxSize(const LimitsTable_s* limits, const char* appId, unsigned long long hash);
+static unsigned long long findMaxInodes(const LimitsTable_s* limits, const char* appId, unsigned long long hash);
+static long long getIntervalOption(const char* value, long long current);
+static int getPercentOption(const char* value, int current);
+static int addLimit(LimitsTable_s* limits, const char* appId, const char* value);
+static void* runConfigThread(void* dataPtr);
+static int readConfigCache(const char* cachePath, const struct stat* source);
+static void writeConfigCache(const char* cachePath, const struct stat* source, const char** options, int optionCount, int defaultRoot);
+//----------------------------------------------------------
+
+#define FILE_DIR_NOT_SELF_OR_PARENT(s) ((s)[0]!='.'&&(((s)[1]!='.'||(s)[2]!='\0')||(s)[1]=='\0'))
+
+
+/// usage bookkeeping of one application folder below a persistence root
+typedef struct AppUsage_s_
 {
+   /// the AppID (name of the top level folder)
+   char appId[NAME_MAX+1];
+   /// crc32 of the AppID, default project ID of the application folder
    unsigned int key;
-   unsigned int value;
-}key_value_s;
+   /// 64 bit hash of the AppID, used as key into the configuration
+   unsigned long long hash;
+   /// the size of the application folder measured by the last scan
+   unsigned long long size;
+   /// the inodes (files and folders) of the application folder measured by the last scan
+   unsigned long long inodes;
+   /// folder content has changed since the last scan
+   int dirty;
+   /// a client waits for the exact size, scanned in the next round whatever is due
+   int fresh;
+   /// found by the current full scan of the root folder
+   int seen;
+   /// folder size cache of the application folder, NULL if disabled
+   DiskScanCache_s* cache;
+   /// number of scans that may still use the cache before every file is checked again
+   int cachedScans;
+   /// project ID of the application folder, 0 if no limit is enforced by the kernel
+   unsigned int projectId;
+   /// the kernel limit has been set up (or failed and is not tried again)
+   int limitApplied;
+   /// when the application is scanned next
+   ScanSchedule_s schedule;
+   /// the schedule planned from the inodes, only used with an inode limit
+   ScanSchedule_s inodeSchedule;
+   /// the sizes and inodes measured by the recent scans
+   ForecastHistory_s history;
+   ForecastHistory_s inodeHistory;
+   /// predicted time until the size or the inodes reach their limit [ms], -1 if not growing or no limit
+   long long timeToLimitMs;
+   /// the largest files and folders found by the last walk and the lists filled by the
+   /// next one, NULL if not collected; largest is read by other threads (gAppsMtx)
+   ScanTop_s* largest;
+   ScanTop_s* largestNext;
+   /// the size or the inodes have reached the limit, the largest files and folders have been logged
+   int overLimit;
+   /// the values of the last publishUsage, read by other threads (gAppsMtx); appId is empty until then
+   PhmUsageApp_s published;
+} AppUsage_s;
+
+
+/// tuning options of the disk monitor ('@' entries of the configuration file)
+typedef struct MonitorOptions_s_
+{
+   /// number of threads scanning application folders in parallel, 0 = number of online CPUs
+   int scanWorkers;
+   /// every n-th scan of an application ignores the folder size cache, 0 = no cache
+   int scanCache;
+   /// where the usage of an application comes from
+   UsageProviderType_e provider;
+   /// options passed to the folder scanner
+   DiskScanOptions_s scan;
+   /// 1 = let the kernel enforce the configured sizes with project quotas
+   int enforceLimits;
+   /// bounds of the time between two scans of an application
+   ScanScheduleLimits_s schedule;
+   /// warn when an application or the partition is predicted to be full within this time [ms]
+   long long forecastWarnMs;
+   /// applications are only scanned if less than this percentage of the blocks is free, 0 = always
+   int lowWatermark;
+   /// applications are only scanned if less than this percentage of the inodes is free, 0 = always
+   int lowInodeWatermark;
+   /// metadata operations per second of all scans together, 0 = unlimited (global only)
+   unsigned int scanOpsPerSec;
+   /// percentage of time a scanning thread may be busy, 100 = unlimited (global only)
+   unsigned int scanDutyCycle;
+   /// number of the largest files and of the largest folders kept per application, 0 = none
+   int topConsumers;
+} MonitorOptions_s;
+
+
+static void setOption(MonitorOptions_s* options, const char* name, const char* value);
+
+
+/// one monitored persistence root ('@root' section of the configuration file)
+typedef struct MonitorRoot_s_
+{
+   /// the root folder, its subfolders are the application folders
+   char path[PATH_MAX];
+   /// the options of the root
+   MonitorOptions_s options;
+   /// the configured sizes of the applications
+   LimitsTable_s* limits;
+   /// the usage provider of the root
+   UsageProvider_s* provider;
+   /// project quota state used to enforce the limits, NULL if not enforced
+   void* quota;
+   /// quota warnings of the root, NULL if not available
+   QuotaEvents_s* quotaEvents;
+   /// change tracking of the root, NULL while polling or after an event queue overflow
+   DiskWatch_s* watch;
+   /// 1 = changes are tracked with inotify, 0 = polling
+   int incremental;
+   /// the next round scans every application, not only the changed ones
+   int scanAll;
+   /// time the root needs its next round [ms, CLOCK_MONOTONIC], -1 = only on events
+   long long nextRoundMs;
+   /// per application totals of the root
+   AppUsage_s* apps;
+   int appCount;
+   int appCapacity;
+   /// used bytes of the partition holding the root
+   ForecastHistory_s partitionHistory;
+   /// used inodes of the partition holding the root
+   ForecastHistory_s partitionInodeHistory;
+   /// predicted time until the blocks or the inodes of the partition are gone [ms], -1 if not growing
+   long long partitionTimeToFullMs;
+   /// used bytes and bytes usable by applications of the partition at the last check
+   unsigned long long partitionUsed;
+   unsigned long long partitionLimit;
+   /// used inodes and inodes usable by applications of the partition at the last check, 0 if not reported
+   unsigned long long partitionInodesUsed;
+   unsigned long long partitionInodesLimit;
+   /// health of the partition at the last check
+   PhmHealth_e partitionHealth;
+   /// when the partition is checked next while it is above the watermarks
+   ScanSchedule_s partitionSchedule;
+   /// the values of the last publishUsage, read by other threads (gAppsMtx)
+   PhmUsageRoot_s published;
+} MonitorRoot_s;
+
+
+/// one version of the configured sizes, replaced as a whole when the configuration file changes
+typedef struct LimitsConfig_s_
+{
+   /// the configured sizes per root (same index as gpRoots)
+   LimitsTable_s** limits;
+} LimitsConfig_s;
 
 
-/// the size of the token array
-enum configConstants
-{
-   TOKENARRAYSIZE = 1024
-};
+pthread_t gMonitorThread;
+pthread_t gConfigThread;
 
 
-static const char gCharLookup[] =
-{
-   0,0,0,0,0,0,0,0,  0,0,0,0,0,0,0,0,  0,0,0,0,0,0,0,0,  0,0,0,0,0,0,0,0,  // from 0x0 (NULL)  to 0x1F (unit seperator)
-   0,1,1,1,1,1,1,1,  1,1,1,1,1,1,1,1,  1,1,1,1,1,1,1,1,  1,1,1,1,1,1,1,1,  // from 020 (space) to 0x2F (?)
-   1,1,1,1,1,1,1,1,  1,1,1,1,1,1,1,1,  1,1,1,1,1,1,1,1,  1,1,1,1,1,1,1,1,  // from 040 (@)     to 0x5F (_)
-   1,1,1,1,1,1,1,1,  1,1,1,1,1,1,1,1,  1,1,1,1,1,1,1,1,  1,1,1,1,1,1,1     // from 060 (')     to 0x7E (~)
+/// the root monitored if the configuration file declares none
+static const char* gDefaultPersistencePath = "/Data/mnt-c";
 
-};
+/// the monitor options, defaults of every root ('@' entries before the first '@root')
+static MonitorOptions_s gOptions = { 0, 16, UsageProvider_Walk, { DiskScanBackend_Sync, DiskScanMetric_Apparent, NULL }, 0, { 1000, 60000 }, 600000, 0, 0, 0, 100, 8 };
 
+/// the budget of all background scans, NULL if unlimited
+static ScanBudget_s* gpScanBudget = NULL;
 
-static char* gpConfigFileMap = 0;
-static char* gpTokenArray[TOKENARRAYSIZE];
-static int gTokenCounter = 0;
-static unsigned int gConfigFileSize = 0;
+/// the monitored roots, all served by the monitor thread
+static MonitorRoot_s* gpRoots = NULL;
+static int gRootCount = 0;
 
-/// default configuration file location
-const char* gDefaultConfig = "/etc/persistence_phm.conf";
+/// held by the monitor thread while it changes the application tables of the roots or
+/// replaces a top consumer list, other threads read them only with it (getTopConsumers)
+static pthread_mutex_t gAppsMtx = PTHREAD_MUTEX_INITIALIZER;
 
-/// the rb tree
-static jsw_rbtree_t *gRb_tree_bl = NULL;
+/// the timer of the monitor thread, -1 until the thread runs
+static int gTimerFd = -1;
 
-// local function prototypes
-static int readConfigFile(const char* filename);
-static void releaseConfigFile(void);
-static void fillCharTokenArray();
-static int getConfiguration(void);
-static void  key_val_rel(void *p);
-static void* key_val_dup(void *p);
-static int key_val_cmp(const void *p1, const void *p2 );
-static unsigned int findMaxSize(unsigned int folderName);
-//----------------------------------------------------------
+/// the usage snapshot for the clients, NULL if it could not be created
+static PhmUsageShm_s* gpUsageShm = NULL;
 
-#define FILE_DIR_NOT_SELF_OR_PARENT(s) ((s)[0]!='.'&&(((s)[1]!='.'||(s)[2]!='\0')||(s)[1]=='\0'))
+/// the configured sizes (LimitsConfig_s), published by the configuration thread and taken
+/// over by the monitor thread between two rounds; generation 0 is read at startup
+static Handoff_s gLimitsHandoff = HANDOFF_INITIALIZER;
 
-#define SUBDIR_ARRAYSIZE 10
+/// 1 once the monitor thread has been started, until stopMonitorThread has joined it
+static int gMonitorStarted = 0;
 
-pthread_t gMonitorThread;
+/// set by stopMonitorThread, the monitor thread leaves its loop
+static int gStopRequested = 0;
 
+/// wakes the configuration thread for stopMonitorThread (eventfd), -1 if the thread does not run
+static int gConfigStopFd = -1;
 
-static const char* gPersistencePath = "/Data/mnt-c";
+/// the configuration file read at startup
+static const char* gpConfigFileName = NULL;
 
-static unsigned int gSizeSubDir[SUBDIR_ARRAYSIZE] = {0};
+/// the compiled configuration the first limits tables point into, NULL if the file has been parsed;
+/// it stays mapped until the process ends
+static ConfigCache_s* gpConfigCache = NULL;
 
+/// an application check has been requested (set from other threads)
+static int gCheckRequested = 0;
 
-//static int getConfigSize(const char* appID, unsigned int* sizes);
+/// maximum number of applications with a pending fresh scan request
+#define FRESH_REQUESTS_MAX 32
+
+/// a fresh scan requested by a client
+typedef struct FreshRequest_s_
+{
+   /// the AppID
+   char appId[NAME_MAX+1];
+   /// called by the monitor thread when the scan is done, with the id of the request
+   diskMonScanDone_f done;
+   unsigned int id;
+   /// 0 if the application has been scanned, -1 if it is unknown in all roots
+   int result;
+} FreshRequest_s;
+
+/// applications a client requested a fresh scan of (filled by other threads)
+static pthread_mutex_t gFreshMtx = PTHREAD_MUTEX_INITIALIZER;
+static FreshRequest_s gFreshRequests[FRESH_REQUESTS_MAX];
+static int gFreshCount = 0;
+
+
+/// which applications a scan covers; applications with a fresh request are always covered
+typedef enum ScanSelection_e_
+{
+   /// the applications that are due
+   ScanSelection_Due = 0,
+   /// the changed applications that are due
+   ScanSelection_DirtyDue,
+   /// only the applications with a fresh request
+   ScanSelection_Fresh,
+   /// only the applications with a fresh request, a client waits for them (not limited by the budget)
+   ScanSelection_Client
+
+} ScanSelection_e;
 
 
-static int checkDiskFreeSpace(const char* thePath, int theDepth)
+static AppUsage_s* findAppUsage(MonitorRoot_s* root, const char* appId)
 {
-   unsigned int sumSize = 0;
-   struct dirent *dirent = NULL;
+   int i = 0;
+   unsigned int key = pclCrc32(0, (unsigned char*)appId, strlen(appId));
 
-   DIR *dir = opendir(thePath);
-   if(NULL != dir)
+   for(i = 0; i < root->appCount; i++)
    {
-      for(dirent = readdir(dir); NULL != dirent; dirent = readdir(dir))
+      if(root->apps[i].key == key && 0 == strcmp(root->apps[i].appId, appId))
       {
-         if(FILE_DIR_NOT_SELF_OR_PARENT(dirent->d_name))
-         {
-            char path[256] = {0};
-            snprintf(path, 256, "%s/%s", thePath, dirent->d_name);
+         return &root->apps[i];
+      }
+   }
+   return NULL;
+}
 
-            if(DT_DIR == dirent->d_type)
-            {
-               gSizeSubDir[theDepth+1] = checkDiskFreeSpace(path, theDepth+1);
 
-               if(theDepth == 0)
-               {
-                  int i = 0;
-                  unsigned int size = 0;
-                  for(i = 1; i<SUBDIR_ARRAYSIZE; i++)
-                  {
-                     size += gSizeSubDir[i];
-                  }
-
-                  //size = (size/1024);
-                  if(size != 0)
-                  {
-                     unsigned int maxSize = findMaxSize(pclCrc32(0, (unsigned char*)dirent->d_name, strlen(dirent->d_name)));
-                     printf("       AppID: \"%s\" => Current: %u - Max: %d\n", dirent->d_name, size, maxSize);
-                     printf("        Size: %d -> Size + 10 Prozent : %d\n", size, (int)(double)(size * 1.1));
-                     if( (int)(double)(size * 1.1) >= maxSize)
-                     {
-                        printf("Disk space  A L M O S T  empty\n");
-                     }
-                     else if(size >= maxSize)
-                     {
-                        printf("Disk space E M P T Y\n");
-                     }
-                     else
-                     {
-                        printf("Disk space O K\n");
-                     }
-
-                     printf("\n");
-                  }
-               }
-            }
-            else if(DT_REG == dirent->d_type)
-            {
-               struct stat buf;
 
-               if(stat(path, &buf) != -1)
-               {
-                  sumSize += (int)buf.st_size;
-               }
-            }
+static AppUsage_s* addAppUsage(MonitorRoot_s* root, const char* appId)
+{
+   AppUsage_s* app = findAppUsage(root, appId);
+
+   if(app == NULL)
+   {
+      pthread_mutex_lock(&gAppsMtx);
+      if(root->appCount == root->appCapacity)
+      {
+         int newCapacity = (root->appCapacity == 0) ? 64 : root->appCapacity * 2;
+         AppUsage_s* newUsage = realloc(root->apps, newCapacity * sizeof(AppUsage_s));
+         if(newUsage == NULL)
+         {
+            pthread_mutex_unlock(&gAppsMtx);
+            DLT_LOG(phmContext, DLT_LOG_ERROR, DLT_STRING("addAppUsage - out of memory"));
+            return NULL;
+         }
+         root->apps = newUsage;
+         root->appCapacity = newCapacity;
+      }
+
+      app = &root->apps[root->appCount++];
+      memset(app, 0, sizeof(AppUsage_s));
+      strncpy(app->appId, appId, sizeof(app->appId)-1);
+      app->key  = pclCrc32(0, (unsigned char*)app->appId, strlen(app->appId));
+      app->hash = limitsHash(app->appId);
+      app->timeToLimitMs = -1;
+      if(root->options.scanCache > 0)
+      {
+         app->cache = diskScanCacheCreate();    // without a cache every file is checked
+      }
+      if(root->options.topConsumers > 0)
+      {
+         app->largest     = scanTopCreate((unsigned int)root->options.topConsumers);
+         app->largestNext = scanTopCreate((unsigned int)root->options.topConsumers);
+         if(app->largest == NULL || app->largestNext == NULL)
+         {
+            scanTopDestroy(app->largest);
+            scanTopDestroy(app->largestNext);
+            app->largest     = NULL;
+            app->largestNext = NULL;
          }
       }
-      closedir(dir);
+      pthread_mutex_unlock(&gAppsMtx);
    }
-   return sumSize;
+   return app;
 }
 
 
 
-static void* runMonitorThread(void* dataPtr)
+static void removeAppUsage(MonitorRoot_s* root, AppUsage_s* app)
+{
+   diskScanCacheDestroy(app->cache);
+   pthread_mutex_lock(&gAppsMtx);
+   scanTopDestroy(app->largest);
+   scanTopDestroy(app->largestNext);
+   *app = root->apps[--root->appCount];   // order of the table does not matter
+   pthread_mutex_unlock(&gAppsMtx);
+}
+
+
+
+static void logTopConsumers(const AppUsage_s* app)
 {
-   while(1) // run forever
+   int i = 0, kind = 0, count = 0;
+   ScanTopEntry_s entries[SCAN_TOP_MAX_ENTRIES];
+   static const char* kindName[ScanTopKind_LastEntry] = { "largest file:", "largest folder:" };
+
+   if(app->largest == NULL || app->largest->valid == 0)
    {
-      checkDiskFreeSpace(gPersistencePath, 0);
+      return;
+   }
 
-      sleep(4);
+   for(kind = 0; kind < ScanTopKind_LastEntry; kind++)
+   {
+      count = scanTopGetSorted(app->largest, (ScanTopKind_e)kind, entries, SCAN_TOP_MAX_ENTRIES);
+      for(i = 0; i < count; i++)
+      {
+         DLT_LOG(phmContext, DLT_LOG_WARN, DLT_STRING("checkAppUsage - AppID:"), DLT_STRING(app->appId),
+                                           DLT_STRING(kindName[kind]), DLT_STRING(entries[i].path), DLT_UINT64(entries[i].size));
+      }
    }
+}
 
-   return NULL;
+
+
+static long long earliestTime(long long t1, long long t2)
+{
+   if(t1 < 0)
+   {
+      return t2;
+   }
+   return (t2 >= 0 && t2 < t1) ? t2 : t1;
 }
 
 
-int startMonitorThread()
+
+static void checkAppUsage(MonitorRoot_s* root, AppUsage_s* app, long long now)
 {
-   int rval = -1;
+   unsigned long long size = app->size;
+   unsigned long long maxSize = findMaxSize(root->limits, app->appId, app->hash);
+   unsigned long long maxInodes = findMaxInodes(root->limits, app->appId, app->hash);
 
-   if(getConfiguration() != -1)   // read configuration file
+   app->timeToLimitMs = (maxSize != 0) ? forecastTimeToLimit(&app->history, now, maxSize) : -1;
+   if(maxInodes != 0)
    {
-      rval = pthread_create(&gMonitorThread, NULL, runMonitorThread, NULL);
-      if(rval)
+      app->timeToLimitMs = earliestTime(app->timeToLimitMs, forecastTimeToLimit(&app->inodeHistory, now, maxInodes));
+   }
+
+   //size = (size/1024);
+   if(size != 0)
+   {
+      printf("       AppID: \"%s\" => Current: %llu - Max: %llu\n", app->appId, size, maxSize);
+      printf("        Size: %llu -> Size + 10 Prozent : %llu\n", size, size + size / 10);
+      if( (size + size / 10) >= maxSize)
       {
-        DLT_LOG(phmContext, DLT_LOG_ERROR, DLT_STRING("pthread_create( runMonitorThread ) ret err:"), DLT_INT(rval) );
-        return -1;
+         printf("Disk space  A L M O S T  empty\n");
+      }
+      else if(size >= maxSize)
+      {
+         printf("Disk space E M P T Y\n");
+      }
+      else
+      {
+         printf("Disk space O K\n");
       }
 
-      (void)pthread_setname_np(gMonitorThread, "phmMonitorThread");
+      printf("\n");
+   }
+
+   // the inodes count whatever the size is, a folder full of empty files has size 0
+   if(maxInodes != 0)
+   {
+      printf("      Inodes: %llu - Max: %llu\n", app->inodes, maxInodes);
+      if(app->inodes + app->inodes / 10 >= maxInodes)
+      {
+         printf("Inodes  A L M O S T  used up\n");
+      }
+   }
+
+   // the same thresholds as the snapshot and the D-Bus answers
+   if(limitsGetHealth(size, maxSize, app->inodes, maxInodes) == PhmHealth_Full)
+   {
+      if(app->overLimit == 0)
+      {
+         app->overLimit = 1;
+         DLT_LOG(phmContext, DLT_LOG_WARN, DLT_STRING("checkAppUsage - AppID:"), DLT_STRING(app->appId),
+                                           DLT_STRING("limit reached, size:"), DLT_UINT64(size), DLT_UINT64(maxSize),
+                                           DLT_STRING("inodes:"), DLT_UINT64(app->inodes), DLT_UINT64(maxInodes));
+         logTopConsumers(app);     // once per crossing, the lists are available via D-Bus anyway
+      }
    }
    else
    {
-      DLT_LOG(phmContext, DLT_LOG_ERROR, DLT_STRING("Failed to read size configuration"));
+      app->overLimit = 0;
    }
 
-   return rval;
+   if(app->timeToLimitMs >= 0)
+   {
+      printf("        Limit reached in: %lld s\n", app->timeToLimitMs / 1000);
+      if(app->timeToLimitMs < root->options.forecastWarnMs)
+      {
+         DLT_LOG(phmContext, DLT_LOG_WARN, DLT_STRING("checkAppUsage - AppID:"), DLT_STRING(app->appId),
+                                           DLT_STRING("limit reached in [s]:"), DLT_INT64(app->timeToLimitMs / 1000));
+      }
+   }
 }
 
 
-static int getConfiguration(void)
+
+static void applyAppLimit(MonitorRoot_s* root, int rootFd, AppUsage_s* app)
 {
-   int rval = 0;
-   const char *filename = getenv("PERS_PHM_CFG");
+   unsigned long long maxSize = findMaxSize(root->limits, app->appId, app->hash);
+   unsigned long long maxInodes = findMaxInodes(root->limits, app->appId, app->hash);
 
-   if(filename == NULL)
+   app->limitApplied = 1;
+
+   if(maxSize != 0 || maxInodes != 0)
    {
-      filename = gDefaultConfig;    // use default filename
-      DLT_LOG(phmContext, DLT_LOG_INFO, DLT_STRING("configReader::getConfiguration ==> using DEFAULT conf file:"), DLT_STRING(filename));
+      // the soft limits are the "almost empty" thresholds of checkAppUsage, the kernel warns when they are crossed
+      QuotaLimits_s limits = { maxSize - maxSize / 11, maxSize, maxInodes - maxInodes / 11, maxInodes };
+      unsigned int defaultProjectId = (app->key != 0) ? app->key : 1;
+
+      if(usageQuotaSetLimit(root->quota, rootFd, app->appId, defaultProjectId, &limits, &app->projectId) == 0)
+      {
+         DLT_LOG(phmContext, DLT_LOG_INFO, DLT_STRING("applyAppLimit - limit enforced:"), DLT_STRING(app->appId),
+                                           DLT_STRING("project:"), DLT_UINT(app->projectId));
+      }
+      else
+      {
+         app->projectId = 0;
+      }
    }
-   else
+   else if(app->projectId != 0)
    {
-      DLT_LOG(phmContext, DLT_LOG_INFO, DLT_STRING("configReader::getConfiguration ==> using environment PERS_FILE_CACHE_CFG conf file:"), DLT_STRING(filename));
+      // the size is not configured any more (reloaded configuration), lift the kernel limit;
+      // the project ID stays, so the usage is still counted
+      QuotaLimits_s limits = { 0, 0, 0, 0 };
+
+      if(usageQuotaSetLimit(root->quota, rootFd, app->appId, app->projectId, &limits, &app->projectId) == 0)
+      {
+         DLT_LOG(phmContext, DLT_LOG_INFO, DLT_STRING("applyAppLimit - limit lifted:"), DLT_STRING(app->appId));
+      }
    }
+}
 
-   if(readConfigFile(filename) != -1)
-   {
-      int i = 0;
-      // create new tree
-      gRb_tree_bl = jsw_rbnew(key_val_cmp, key_val_dup, key_val_rel);
 
-      while( i < TOKENARRAYSIZE-1 )
-      {
-         if(gpTokenArray[i] != NULL)
-         {
-            key_value_s* item;
 
-            item = malloc(sizeof(key_value_s));
-            if(item != NULL)
-            {
-               unsigned int key   = pclCrc32(0, (unsigned char*)gpTokenArray[i], strlen(gpTokenArray[i]));
-               unsigned int value = atoi(gpTokenArray[i+1]);
-               //printf("   config Data: %s - %d - %u -> %u\n", gpTokenArray[i], atoi(gpTokenArray[i+1]), key, value);
+static int scanApps(MonitorRoot_s* root, int rootFd, ScanSelection_e selection)
+{
+   int i = 0, jobCount = 0;
+   unsigned long long maxInodes = 0;
+   long long now = scanScheduleNow();
+   ScanJob_s* jobs = malloc((root->appCount + 1) * sizeof(ScanJob_s));
+   int* appIndex   = malloc((root->appCount + 1) * sizeof(int));
 
-               item->key   = key;
-               item->value = value;
+   if(jobs == NULL || appIndex == NULL)
+   {
+      DLT_LOG(phmContext, DLT_LOG_ERROR, DLT_STRING("scanApps - out of memory"));
+      free(jobs);
+      free(appIndex);
+      return 0;
+   }
 
-               jsw_rbinsert(gRb_tree_bl, item);
+   for(i = 0; i < root->appCount; i++)
+   {
+      if(   root->apps[i].fresh == 1
+         || (   (selection == ScanSelection_Due || (selection == ScanSelection_DirtyDue && root->apps[i].dirty))
+             && scanScheduleIsDue(&root->apps[i].schedule, now)))
+      {
+         AppUsage_s* app = &root->apps[i];
 
-               free(item);
-            }
-            i+=2;       // move to the next configuration file entry
+         if(root->quota != NULL && app->limitApplied == 0)
+         {
+            applyAppLimit(root, rootFd, app);
          }
-         else
+
+         // the cache misses files written in place without a change event (polling mode),
+         // so check every file from time to time
+         if(app->cache != NULL && --app->cachedScans < 0)
          {
-            break;
+            diskScanCacheClear(app->cache);
+            app->cachedScans = root->options.scanCache - 1;
          }
+
+         jobs[jobCount].appId = app->appId;
+         jobs[jobCount].cache = app->cache;
+         jobs[jobCount].top   = app->largestNext;
+         jobs[jobCount].unlimited = (selection == ScanSelection_Client) ? 1 : 0;
+         if(app->largestNext != NULL)
+         {
+            app->largestNext->previous = app->largest;
+         }
+         appIndex[jobCount] = i;
+         jobCount++;
       }
-      releaseConfigFile();
    }
-   else
+
+   if(jobCount > 0)
    {
-      DLT_LOG(phmContext, DLT_LOG_ERROR, DLT_STRING("configReader::getConfiguration ==> error reading config file:"), DLT_STRING(filename));
-      rval = -1;
+      (void)usageProviderQuery(root->provider, rootFd, jobs, jobCount);
+      now = scanScheduleNow();
    }
 
-   return rval;
-}
+   for(i = 0; i < jobCount; i++)
+   {
+      AppUsage_s* app = &root->apps[appIndex[i]];
 
+      // a folder that is gone or not readable counts as empty
+      app->size   = (jobs[i].result == 0) ? jobs[i].usage.size : 0;
+      app->inodes = (jobs[i].result == 0) ? (unsigned long long)jobs[i].usage.files + jobs[i].usage.folders : 0;
+      app->dirty  = 0;
+      app->fresh  = 0;
 
+      // only a completed walk replaces the lists, e.g. a quota provider does not fill them
+      if(app->largestNext != NULL && jobs[i].result == 0 && app->largestNext->valid == 1)
+      {
+         ScanTop_s* largest = app->largestNext;
 
-static int readConfigFile(const char* filename)
-{
-   int fd = 0;
-   struct stat buffer;
+         largest->previous = NULL;
+         pthread_mutex_lock(&gAppsMtx);
+         app->largestNext = app->largest;
+         app->largest     = largest;
+         pthread_mutex_unlock(&gAppsMtx);
+      }
 
-   memset(&buffer, 0, sizeof(buffer));
+      scanScheduleUpdate(&app->schedule, now, app->size, findMaxSize(root->limits, app->appId, app->hash), &root->options.schedule);
+      forecastAddSample(&app->history, now, app->size);
 
-   if(stat(filename, &buffer) != -1)
-   {
-      if(buffer.st_size > 0)  // check for empty file
+      // an application close to its inode limit is scanned as often as one close to its size
+      maxInodes = findMaxInodes(root->limits, app->appId, app->hash);
+      if(maxInodes != 0)
       {
-         gConfigFileSize = buffer.st_size;
-
-         fd = open(filename, O_RDONLY);
-         if(fd == -1)
+         scanScheduleUpdate(&app->inodeSchedule, now, app->inodes, maxInodes, &root->options.schedule);
+         if(app->inodeSchedule.nextScanMs < app->schedule.nextScanMs)
          {
-            DLT_LOG(phmContext, DLT_LOG_ERROR, DLT_STRING("configReader::readConfigFile ==> Error file open: "),
-                    DLT_STRING(filename), DLT_STRING("err msg: "), DLT_STRING(strerror(errno)) );
-            return -1;
+            app->schedule.nextScanMs = app->inodeSchedule.nextScanMs;
          }
+         forecastAddSample(&app->inodeHistory, now, app->inodes);
+      }
+      checkAppUsage(root, app, now);
+   }
+
+   free(jobs);
+   free(appIndex);
+
+   return jobCount;
+}
 
-         // map the config file into memory
-         gpConfigFileMap = (char*)mmap(0, gConfigFileSize, PROT_WRITE, MAP_PRIVATE, fd, 0);
 
-         if(gpConfigFileMap == MAP_FAILED)
+
+static int checkDiskFreeSpace(MonitorRoot_s* root, int scanAll)
+{
+   struct dirent *dirent = NULL;
+   long long start = 0, elapsedMs = 0;
+   int i = 0, scanned = 0;
+   const char* provider = NULL;
+   ScanBudgetCounters_s counters = { 0, 0, 0 };
+
+   DIR *dir = opendir(root->path);
+   if(NULL == dir)
+   {
+      DLT_LOG(phmContext, DLT_LOG_ERROR, DLT_STRING("checkDiskFreeSpace - failed to open:"), DLT_STRING(root->path));
+      return -1;
+   }
+
+   for(i = 0; i < root->appCount; i++)
+   {
+      root->apps[i].seen = 0;
+   }
+
+   for(dirent = readdir(dir); NULL != dirent; dirent = readdir(dir))
+   {
+      struct stat buf;
+
+      if(   FILE_DIR_NOT_SELF_OR_PARENT(dirent->d_name)
+         && (   DT_DIR == dirent->d_type
+             || (   DT_UNKNOWN == dirent->d_type
+                 && fstatat(dirfd(dir), dirent->d_name, &buf, AT_SYMLINK_NOFOLLOW) == 0 && S_ISDIR(buf.st_mode))))
+      {
+         AppUsage_s* app = addAppUsage(root, dirent->d_name);
+         if(app != NULL)
          {
-            DLT_LOG(phmContext, DLT_LOG_ERROR, DLT_STRING("configReader::readConfigFile ==> Error mapping the file"));
-            gpConfigFileMap = 0;
-            close(fd);
-            return -1;
+            app->seen = 1;
          }
+      }
+   }
 
-         gTokenCounter = 0;   // reset the token counter
-         fillCharTokenArray();
-         close(fd);
+   // forget about removed applications (the caches of the others are kept)
+   for(i = root->appCount - 1; i >= 0; i--)
+   {
+      if(root->apps[i].seen == 0)
+      {
+         removeAppUsage(root, &root->apps[i]);
       }
-      else
+      else if(scanAll == 1)
       {
-         DLT_LOG(phmContext, DLT_LOG_ERROR, DLT_STRING("configReader::readConfigFile ==> Error file size is 0"));
-         return -1;
+         root->apps[i].schedule.nextScanMs = 0;
       }
    }
-   else
+
+   start = scanScheduleNow();
+   scanned = scanApps(root, dirfd(dir), ScanSelection_Due);
+   elapsedMs = scanScheduleNow() - start;
+
+   closedir(dir);
+
+   if(scanned == 0)
    {
-      DLT_LOG(phmContext, DLT_LOG_ERROR, DLT_STRING("configReader::readConfigFile ==> failed to stat file"));
-      return -1;
+      return 0;      // no application due yet
+   }
+
+   if(root->options.scan.budget != NULL)
+   {
+      scanBudgetGetCounters(root->options.scan.budget, &counters);
    }
 
+   provider = usageProviderGetTypeName(usageProviderGetActiveType(root->provider));
+   printf("Scan of %d of %d applications in %s: %lld ms (provider: %s, backend: %s, metric: %s, budget pauses: %u/%u, %llu ms)\n\n",
+          scanned, root->appCount, root->path, elapsedMs, provider,
+          diskScanGetBackendName(root->options.scan.backend), diskScanGetMetricName(root->options.scan.metric),
+          counters.tokenPauses, counters.dutyPauses, counters.pausedMs);
+   DLT_LOG(phmContext, DLT_LOG_INFO, DLT_STRING("checkDiskFreeSpace - scan [ms]:"), DLT_INT((int)elapsedMs),
+                                     DLT_STRING("root:"), DLT_STRING(root->path),
+                                     DLT_STRING("applications:"), DLT_INT(scanned),
+                                     DLT_STRING("provider:"), DLT_STRING(provider),
+                                     DLT_STRING("backend:"), DLT_STRING(diskScanGetBackendName(root->options.scan.backend)),
+                                     DLT_STRING("metric:"), DLT_STRING(diskScanGetMetricName(root->options.scan.metric)),
+                                     DLT_STRING("budget pauses (ops/duty):"), DLT_UINT(counters.tokenPauses), DLT_UINT(counters.dutyPauses),
+                                     DLT_STRING("paused [ms]:"), DLT_UINT64(counters.pausedMs));
+
    return 0;
 }
 
 
 
-static void fillCharTokenArray()
+static void wakeRootAt(MonitorRoot_s* root, long long timeMs)
 {
-   unsigned int i=0;
-   int blankCount=0;
-
-   if(gpConfigFileMap != 0)
+   if(root->nextRoundMs == -1 || timeMs < root->nextRoundMs)
    {
-      char* tmpPointer = gpConfigFileMap;
+      root->nextRoundMs = timeMs;
+   }
+}
 
-      // set the first pointer to the start of the file
-      gpTokenArray[blankCount] = tmpPointer;
-      blankCount++;
 
-      while(i < gConfigFileSize)
-      {
-         if(1 != gCharLookup[(int)*tmpPointer])
-         {
-            *tmpPointer = 0;
 
-            // check if we are at the end of the token array
-            if(blankCount >= TOKENARRAYSIZE)
-            {
-               break;
-            }
-            gpTokenArray[blankCount] = tmpPointer+1;
-            blankCount++;
-            gTokenCounter++;
+static void onDiskWatchEvent(const char* appId, DiskWatchEvent_e event, void* userData)
+{
+   MonitorRoot_s* root = (MonitorRoot_s*)userData;
+   AppUsage_s* app = NULL;
 
+   switch(event)
+   {
+      case DiskWatch_AppAdded:
+         app = addAppUsage(root, appId);
+         break;
+      case DiskWatch_AppChanged:
+         app = findAppUsage(root, appId);
+         break;
+      case DiskWatch_AppRemoved:
+         app = findAppUsage(root, appId);
+         if(app != NULL)
+         {
+            removeAppUsage(root, app);
+            app = NULL;
          }
-         tmpPointer++;
-         i++;
-      }
+         break;
+      case DiskWatch_AppModified:
+         app = findAppUsage(root, appId);
+         if(app != NULL && app->cache != NULL)
+         {
+            diskScanCacheClear(app->cache);     // a file size changed, the folder times did not
+         }
+         break;
    }
-   else
+
+   if(app != NULL)
    {
-      DLT_LOG(phmContext, DLT_LOG_ERROR, DLT_STRING("configReader::fillCharTokenArray ==> invalid file mapping (mmap failed)"));
+      long long batchEnd = scanScheduleNow() + root->options.schedule.minIntervalMs;
+
+      // give the first change of a burst the shortest interval to collect the rest of the burst
+      if(app->dirty == 0 && app->schedule.nextScanMs < batchEnd)
+      {
+         app->schedule.nextScanMs = batchEnd;
+      }
+      app->dirty = 1;
+      wakeRootAt(root, app->schedule.nextScanMs);
    }
 }
 
 
 
-static void releaseConfigFile(void)
+static void onQuotaEvent(unsigned int projectId, QuotaEvent_e event, void* userData)
 {
-   // unmap the mapped config file if successfully mapped
-   if(gpConfigFileMap != 0)
+   static const char* eventName[] = { "soft limit exceeded", "grace time expired", "hard limit reached",
+                                      "below soft limit", "below hard limit" };
+   MonitorRoot_s* root = (MonitorRoot_s*)userData;
+   int i = 0;
+
+   for(i = 0; i < root->appCount; i++)
    {
-      if(munmap(gpConfigFileMap, gConfigFileSize) == -1)
+      if(root->apps[i].projectId == projectId)
       {
-         DLT_LOG(phmContext, DLT_LOG_ERROR, DLT_STRING("configReader::releaseConfigFile ==> failed to unmap file: "), DLT_STRING(strerror(errno)));
+         printf("Quota warning: \"%s\" %s\n", root->apps[i].appId, eventName[event]);
+         DLT_LOG(phmContext, (event <= QuotaEvent_HardReached) ? DLT_LOG_WARN : DLT_LOG_INFO,
+                 DLT_STRING("onQuotaEvent - AppID:"), DLT_STRING(root->apps[i].appId), DLT_STRING(eventName[event]));
+         root->apps[i].dirty = 1;     // get the exact size with the next scan
+         wakeRootAt(root, root->apps[i].schedule.nextScanMs);
       }
    }
 }
 
 
-/// compare function for tree key_value_s item
-static int key_val_cmp(const void *p1, const void *p2 )
+
+static int checkPartition(MonitorRoot_s* root)
 {
-   int rval = -1;
-   key_value_s* first;
-   key_value_s* second;
+   int healthy = 0;
+   struct statvfs buf;
+   long long now = scanScheduleNow();
+   unsigned long long used = 0, limit = 0;
+   unsigned long long inodesUsed = 0, inodesLimit = 0;
+   const MonitorOptions_s* options = &root->options;
+
+   if(statvfs(root->path, &buf) == -1)
+   {
+      DLT_LOG(phmContext, DLT_LOG_ERROR, DLT_STRING("checkPartition - statvfs failed:"), DLT_STRING(root->path),
+                                         DLT_STRING(strerror(errno)));
+      return 0;
+   }
 
-   first  = (key_value_s*)p1;
-   second = (key_value_s*)p2;
+   // the partition is full for the applications when the blocks not reserved for root are gone
+   used  = (unsigned long long)(buf.f_blocks - buf.f_bfree) * buf.f_frsize;
+   limit = used + (unsigned long long)buf.f_bavail * buf.f_frsize;
 
-   if(second->key == first->key)
+   forecastAddSample(&root->partitionHistory, now, used);
+   root->partitionTimeToFullMs = forecastTimeToLimit(&root->partitionHistory, now, limit);
+
+   // file systems without an inode table (btrfs) report no inodes
+   if(buf.f_files != 0)
    {
-      rval = 0;
+      inodesUsed  = (unsigned long long)(buf.f_files - buf.f_ffree);
+      inodesLimit = inodesUsed + (unsigned long long)buf.f_favail;
+
+      forecastAddSample(&root->partitionInodeHistory, now, inodesUsed);
+      root->partitionTimeToFullMs = earliestTime(root->partitionTimeToFullMs,
+                                                 forecastTimeToLimit(&root->partitionInodeHistory, now, inodesLimit));
    }
-   else if(second->key < first->key)
+
+   if(root->partitionTimeToFullMs >= 0)
    {
-      rval = -1;
+      printf("Partition of %s: used %llu of %llu, inodes %llu of %llu - full in: %lld s\n\n", root->path, used, limit,
+             inodesUsed, inodesLimit, root->partitionTimeToFullMs / 1000);
+      if(root->partitionTimeToFullMs < options->forecastWarnMs)
+      {
+         DLT_LOG(phmContext, DLT_LOG_WARN, DLT_STRING("checkPartition - partition full in [s]:"),
+                                           DLT_INT64(root->partitionTimeToFullMs / 1000), DLT_STRING(root->path));
+      }
+   }
+
+   if(options->lowWatermark > 0 || options->lowInodeWatermark > 0)
+   {
+      unsigned long long watermark = (unsigned long long)buf.f_blocks * buf.f_frsize / 100 * options->lowWatermark;
+
+      healthy =    (unsigned long long)buf.f_bavail * 100 >= (unsigned long long)buf.f_blocks * options->lowWatermark
+                && (   buf.f_files == 0
+                    || (unsigned long long)buf.f_favail * 100 >= (unsigned long long)buf.f_files * options->lowInodeWatermark);
+
+      // check again before the free blocks at the current growth reach the watermark
+      scanScheduleUpdate(&root->partitionSchedule, now, used, (limit > watermark) ? limit - watermark : 1, &options->schedule);
+   }
+
+   root->partitionUsed        = used;
+   root->partitionLimit       = limit;
+   root->partitionInodesUsed  = inodesUsed;
+   root->partitionInodesLimit = inodesLimit;
+   if(buf.f_bavail == 0 || (buf.f_files != 0 && buf.f_favail == 0))
+   {
+      root->partitionHealth = PhmHealth_Full;
+   }
+   else if(   ((options->lowWatermark > 0 || options->lowInodeWatermark > 0) && healthy == 0)
+           || (root->partitionTimeToFullMs >= 0 && root->partitionTimeToFullMs < options->forecastWarnMs))
+   {
+      root->partitionHealth = PhmHealth_Low;
    }
    else
    {
-      rval = 1;
+      root->partitionHealth = PhmHealth_Ok;
    }
 
-   return rval;
- }
+   return healthy;
+}
 
 
 
-/// duplicate function for key_value_s item
-static void* key_val_dup(void *p)
+static long long getNextScanTime(const MonitorRoot_s* root, int dirtyOnly)
 {
-   key_value_s* src = NULL;
-   key_value_s* dst = NULL;
+   long long next = -1;
+   int i = 0;
 
-   src = (key_value_s*)p;
-
-   // allocate memory for node
-   dst = malloc(sizeof(key_value_s));
-   if(dst != NULL)
+   for(i = 0; i < root->appCount; i++)
    {
-      // duplicate hash key
-      dst->key = src->key;
-      // duplicate value
-      dst->value = src->value;
+      if(   (dirtyOnly == 0 || root->apps[i].dirty)
+         && (next == -1 || root->apps[i].schedule.nextScanMs < next))
+      {
+         next = root->apps[i].schedule.nextScanMs;
+      }
    }
-   return dst;
+   return next;
 }
 
 
 
-/// release function for key_value_s item
-static void  key_val_rel(void *p )
+static void armTimer(int timerFd, long long dueMs)
 {
-   key_value_s* rel = NULL;
-   rel = (key_value_s*)p;
+   struct itimerspec spec;
+
+   memset(&spec, 0, sizeof(spec));      // a zero time disarms the timer
+   if(dueMs >= 0)
+   {
+      if(dueMs == 0)
+      {
+         dueMs = 1;                      // due now, any time in the past expires at once
+      }
+      spec.it_value.tv_sec  = dueMs / 1000;
+      spec.it_value.tv_nsec = (dueMs % 1000) * 1000000;
+   }
 
-   if(rel != NULL)
-      free(rel);
+   if(timerfd_settime(timerFd, TFD_TIMER_ABSTIME, &spec, NULL) == -1)
+   {
+      DLT_LOG(phmContext, DLT_LOG_ERROR, DLT_STRING("armTimer - timerfd_settime failed:"), DLT_STRING(strerror(errno)));
+   }
 }
 
 
 
-static unsigned int findMaxSize(unsigned int folderName)
+static int wakeMonitorThread(void)
 {
-   unsigned int rval = 0;
-   key_value_s* item = NULL;
+   struct itimerspec spec;
+   int timerFd = __atomic_load_n(&gTimerFd, __ATOMIC_ACQUIRE);
 
-   item = malloc(sizeof(key_value_s));
-   if(item != NULL && gRb_tree_bl != NULL)
+   if(timerFd == -1)
    {
-      key_value_s* foundItem = NULL;
-      item->key = folderName;
-      foundItem = (key_value_s*)jsw_rbfind(gRb_tree_bl, item);
-      if(foundItem != NULL)
-      {
-         rval = foundItem->value;
-      }
-      free(item);
-   }
-   else
-   {
-      if(item!=NULL)
-        free(item);
+      return -1;     // the monitor thread does not run
    }
 
-   return rval;
+   memset(&spec, 0, sizeof(spec));
+   spec.it_value.tv_nsec = 1;
+
+   return timerfd_settime(timerFd, 0, &spec, NULL);
+}
+
+
+
+int requestDiskCheck(void)
+{
+   __atomic_store_n(&gCheckRequested, 1, __ATOMIC_RELEASE);
+
+   return wakeMonitorThread();
 }
 
 
 
-void freeRbTree()
+int requestAppScan(const char* appId, diskMonScanDone_f done, unsigned int requestId)
 {
-   if(gRb_tree_bl != NULL)
-      jsw_rbdelete (gRb_tree_bl);
+   int rval = 0;
+   size_t length = strlen(appId);
+
+   if(   length == 0 || length > NAME_MAX || strchr(appId, '/') != NULL
+      || 0 == strcmp(appId, ".") || 0 == strcmp(appId, "..")
+      || __atomic_load_n(&gTimerFd, __ATOMIC_ACQUIRE) == -1)
+   {
+      return -1;
+   }
+
+   pthread_mutex_lock(&gFreshMtx);
+   if(gFreshCount < FRESH_REQUESTS_MAX)
+   {
+      FreshRequest_s* request = &gFreshRequests[gFreshCount++];
+      strcpy(request->appId, appId);
+      request->done   = done;
+      request->id     = requestId;
+      request->result = -1;
+   }
+   else
+   {
+      rval = -1;
+   }
+   pthread_mutex_unlock(&gFreshMtx);
+
+   if(rval == 0)
+   {
+      rval = wakeMonitorThread();
+   }
+
+   return rval;
+}
+
+
+
+int getTopConsumers(const char* appId, ScanTopKind_e kind, ScanTopEntry_s* entries, int max)
+{
+   int i = 0, j = 0, rval = -1;
+
+   if(kind >= ScanTopKind_LastEntry)
+   {
+      return -1;
+   }
+
+   pthread_mutex_lock(&gAppsMtx);
+   for(i = 0; i < gRootCount && rval == -1; i++)
+   {
+      for(j = 0; j < gpRoots[i].appCount; j++)
+      {
+         const AppUsage_s* app = &gpRoots[i].apps[j];
+
+         if(0 == strcmp(app->appId, appId))
+         {
+            rval = (app->largest != NULL) ? scanTopGetSorted(app->largest, kind, entries, max) : 0;
+            break;
+         }
+      }
+   }
+   pthread_mutex_unlock(&gAppsMtx);
+
+   return rval;
+}
+
+
+
+int getAppUsage(const char* appId, PhmUsageApp_s* app, PhmUsageRoot_s* root)
+{
+   int i = 0, j = 0, rval = -1;
+
+   pthread_mutex_lock(&gAppsMtx);
+   for(i = 0; i < gRootCount && rval == -1; i++)
+   {
+      for(j = 0; j < gpRoots[i].appCount; j++)
+      {
+         const AppUsage_s* usage = &gpRoots[i].apps[j];
+
+         if(usage->published.appId[0] != '\0' && 0 == strcmp(usage->appId, appId))
+         {
+            *app  = usage->published;
+            *root = gpRoots[i].published;
+            rval  = 0;
+            break;
+         }
+      }
+   }
+   pthread_mutex_unlock(&gAppsMtx);
+
+   return rval;
+}
+
+
+
+void forEachAppUsage(diskMonAppUsage_f callback, void* data)
+{
+   int i = 0, j = 0;
+
+   pthread_mutex_lock(&gAppsMtx);
+   for(i = 0; i < gRootCount; i++)
+   {
+      for(j = 0; j < gpRoots[i].appCount; j++)
+      {
+         if(gpRoots[i].apps[j].published.appId[0] != '\0')
+         {
+            callback(&gpRoots[i].apps[j].published, &gpRoots[i].published, data);
+         }
+      }
+   }
+   pthread_mutex_unlock(&gAppsMtx);
+}
+
+
+
+static int takeFreshRequests(FreshRequest_s* requests)
+{
+   int count = 0;
+
+   pthread_mutex_lock(&gFreshMtx);
+   count = gFreshCount;
+   memcpy(requests, gFreshRequests, count * sizeof(FreshRequest_s));
+   gFreshCount = 0;
+   pthread_mutex_unlock(&gFreshMtx);
+
+   return count;
+}
+
+
+
+static void scanFreshApps(FreshRequest_s* requests, int count)
+{
+   int i = 0, j = 0;
+
+   for(i = 0; i < gRootCount; i++)
+   {
+      MonitorRoot_s* root = &gpRoots[i];
+      int marked = 0;
+      int rootFd = -1;
+
+      if(root->provider == NULL)
+      {
+         continue;
+      }
+
+      rootFd = open(root->path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+      if(rootFd == -1)
+      {
+         DLT_LOG(phmContext, DLT_LOG_ERROR, DLT_STRING("scanFreshApps - failed to open:"), DLT_STRING(root->path));
+         continue;
+      }
+
+      for(j = 0; j < count; j++)
+      {
+         AppUsage_s* app = findAppUsage(root, requests[j].appId);
+         struct stat buf;
+
+         // an application created since the last full scan is picked up here
+         if(   app == NULL
+            && fstatat(rootFd, requests[j].appId, &buf, AT_SYMLINK_NOFOLLOW) == 0 && S_ISDIR(buf.st_mode))
+         {
+            app = addAppUsage(root, requests[j].appId);
+         }
+
+         if(app != NULL)
+         {
+            app->fresh = 1;
+            requests[j].result = 0;
+            marked++;
+         }
+      }
+
+      if(marked > 0)
+      {
+         scanApps(root, rootFd, ScanSelection_Client);
+      }
+      close(rootFd);
+   }
+}
+
+
+
+static void scanDirtyApps(MonitorRoot_s* root)
+{
+   int rootFd = open(root->path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+
+   if(rootFd == -1)
+   {
+      DLT_LOG(phmContext, DLT_LOG_ERROR, DLT_STRING("scanDirtyApps - failed to open:"), DLT_STRING(root->path));
+      return;
+   }
+
+   scanApps(root, rootFd, ScanSelection_DirtyDue);
+
+   close(rootFd);
+}
+
+
+
+static void runRootRound(MonitorRoot_s* root, int requested)
+{
+   int healthy = 0;
+
+   if(root->watch == NULL && root->incremental == 1)
+   {
+      // (re)create the watch before the full scan, so no change gets lost in between
+      root->watch = diskWatchCreate(root->path);
+      if(root->watch == NULL)
+      {
+         DLT_LOG(phmContext, DLT_LOG_WARN, DLT_STRING("runRootRound - incremental tracking not available, polling:"),
+                                           DLT_STRING(root->path));
+         root->incremental = 0;
+      }
+   }
+
+   // one statvfs first: above the watermarks no application is scanned unless requested
+   healthy = checkPartition(root);
+   if(requested == 1)
+   {
+      healthy = 0;
+   }
+
+   if(healthy == 1)
+   {
+      // changes stay marked and a full scan stays pending until the applications are scanned
+      root->nextRoundMs = root->partitionSchedule.nextScanMs;
+   }
+   else
+   {
+      if(root->scanAll == 1 || root->incremental == 0)
+      {
+         checkDiskFreeSpace(root, root->scanAll);
+         root->scanAll = 0;
+      }
+      else
+      {
+         scanDirtyApps(root);
+      }
+
+      // incremental mode only waits for changed applications; polling mode for every
+      // application, and at least once per longest interval to find new ones
+      root->nextRoundMs = getNextScanTime(root, root->incremental);
+      if(root->incremental == 0 || root->options.lowWatermark > 0 || root->options.lowInodeWatermark > 0)
+      {
+         long long latest = scanScheduleNow() + root->options.schedule.maxIntervalMs;
+         if(root->nextRoundMs == -1 || root->nextRoundMs > latest)
+         {
+            root->nextRoundMs = latest;
+         }
+      }
+   }
+}
+
+
+
+static void startRoot(MonitorRoot_s* root)
+{
+   root->provider = usageProviderCreate(root->options.provider, root->path, root->options.scanWorkers, &root->options.scan);
+   if(root->provider == NULL)
+   {
+      DLT_LOG(phmContext, DLT_LOG_ERROR, DLT_STRING("startRoot - failed to create usage provider:"), DLT_STRING(root->path));
+      root->nextRoundMs = -1;     // never served
+      return;
+   }
+
+   if(root->options.enforceLimits == 1)
+   {
+      struct stat buf;
+
+      root->quota = usageQuotaCreate(root->path);
+      if(root->quota == NULL)
+      {
+         DLT_LOG(phmContext, DLT_LOG_WARN, DLT_STRING("startRoot - project quotas not available, limits not enforced:"),
+                                           DLT_STRING(root->path));
+      }
+      else if(stat(root->path, &buf) == 0)
+      {
+         root->quotaEvents = quotaEventsCreate(buf.st_dev);
+      }
+   }
+
+   root->incremental = 1;
+   root->scanAll     = 1;
+   root->nextRoundMs = 0;
+}
+
+
+
+static PhmHealth_e getAppHealth(const MonitorRoot_s* root, const AppUsage_s* app, unsigned long long maxSize,
+                                unsigned long long maxInodes)
+{
+   PhmHealth_e health = PhmHealth_Unknown;
+
+   if(app->schedule.lastScanMs == 0)
+   {
+      return PhmHealth_Unknown;
+   }
+
+   health = limitsGetHealth(app->size, maxSize, app->inodes, maxInodes);
+   if(   health == PhmHealth_Ok && (maxSize != 0 || maxInodes != 0)
+      && app->timeToLimitMs >= 0 && app->timeToLimitMs < root->options.forecastWarnMs)
+   {
+      health = PhmHealth_Low;     // predicted to reach a limit soon
+   }
+   return health;
+}
+
+
+
+static void publishUsage(void)
+{
+   int i = 0, j = 0;
+   unsigned int appCount = 0;
+   static unsigned int reportedMissing = 0;     // only used by the monitor thread
+   PhmUsageSnapshot_s* snapshot = NULL;
+
+   // the copies the other threads answer from (getAppUsage), complete whatever fits into the snapshot
+   pthread_mutex_lock(&gAppsMtx);
+   for(i = 0; i < gRootCount; i++)
+   {
+      MonitorRoot_s* root = &gpRoots[i];
+      PhmUsageRoot_s* rootUsage = &root->published;
+
+      memcpy(rootUsage->path, root->path, strlen(root->path) + 1);      // both PATH_MAX
+      rootUsage->health       = root->partitionHealth;
+      rootUsage->used         = root->partitionUsed;
+      rootUsage->limit        = root->partitionLimit;
+      rootUsage->inodesUsed   = root->partitionInodesUsed;
+      rootUsage->inodesLimit  = root->partitionInodesLimit;
+      rootUsage->timeToFullMs = root->partitionTimeToFullMs;
+      rootUsage->appCount     = (unsigned int)root->appCount;
+
+      for(j = 0; j < root->appCount; j++)
+      {
+         AppUsage_s* app = &root->apps[j];
+         PhmUsageApp_s* appUsage = &app->published;
+
+         memcpy(appUsage->appId, app->appId, strlen(app->appId) + 1);   // both NAME_MAX+1
+         appUsage->root          = (unsigned int)i;
+         appUsage->size          = app->size;
+         appUsage->limit         = findMaxSize(root->limits, app->appId, app->hash);
+         appUsage->inodes        = app->inodes;
+         appUsage->inodeLimit    = findMaxInodes(root->limits, app->appId, app->hash);
+         appUsage->health        = getAppHealth(root, app, appUsage->limit, appUsage->inodeLimit);
+         appUsage->timeToLimitMs = app->timeToLimitMs;
+         appUsage->scanTimeMs    = app->schedule.lastScanMs;
+      }
+   }
+   pthread_mutex_unlock(&gAppsMtx);
+
+   if(gpUsageShm == NULL)
+   {
+      return;
+   }
+
+   snapshot = usageShmBeginUpdate(gpUsageShm);
+   snapshot->version      = PHM_USAGE_VERSION;
+   snapshot->updateMs     = scanScheduleNow();
+   snapshot->rootCount    = 0;
+   snapshot->missingRoots = 0;
+   snapshot->missingApps  = 0;
+
+   for(i = 0; i < gRootCount; i++)
+   {
+      const MonitorRoot_s* root = &gpRoots[i];
+      PhmUsageRoot_s* rootUsage = &snapshot->roots[snapshot->rootCount];
+
+      if(snapshot->rootCount == PHM_USAGE_MAX_ROOTS)
+      {
+         snapshot->missingRoots++;
+         snapshot->missingApps += (unsigned int)root->appCount;
+         continue;
+      }
+
+      *rootUsage = root->published;
+      rootUsage->appCount = 0;
+
+      for(j = 0; j < root->appCount; j++)
+      {
+         if(appCount == PHM_USAGE_MAX_APPS)
+         {
+            snapshot->missingApps++;
+            continue;
+         }
+
+         snapshot->apps[appCount] = root->apps[j].published;
+         snapshot->apps[appCount].root = snapshot->rootCount;
+         appCount++;
+         rootUsage->appCount++;
+      }
+      snapshot->rootCount++;
+   }
+   snapshot->appCount = appCount;
+
+   if(snapshot->missingRoots + snapshot->missingApps != reportedMissing)
+   {
+      reportedMissing = snapshot->missingRoots + snapshot->missingApps;
+      DLT_LOG(phmContext, DLT_LOG_WARN, DLT_STRING("publishUsage - snapshot full, roots missing:"), DLT_UINT(snapshot->missingRoots),
+                                        DLT_STRING("applications missing:"), DLT_UINT(snapshot->missingApps));
+   }
+
+   usageShmEndUpdate(gpUsageShm);
+}
+
+
+
+static int adoptLimitsConfig(void)
+{
+   int i = 0, j = 0, changed = 0;
+   unsigned int generation = 0;
+   LimitsConfig_s* config = (LimitsConfig_s*)handoffGetNewer(&gLimitsHandoff, &generation);
+
+   if(config == NULL)
+   {
+      return 0;
+   }
+
+   for(i = 0; i < gRootCount; i++)
+   {
+      MonitorRoot_s* root = &gpRoots[i];
+      LimitsTable_s* limits = config->limits[i];
+      int marked = 0;
+
+      // only the applications whose sizes differ are scanned again, whatever the watermarks say
+      for(j = 0; j < root->appCount; j++)
+      {
+         AppUsage_s* app = &root->apps[j];
+
+         if(   findMaxSize(root->limits, app->appId, app->hash) != findMaxSize(limits, app->appId, app->hash)
+            || findMaxInodes(root->limits, app->appId, app->hash) != findMaxInodes(limits, app->appId, app->hash))
+         {
+            app->limitApplied = 0;     // set the kernel limit again
+            app->overLimit    = 0;
+            app->fresh        = 1;
+            marked++;
+         }
+      }
+
+      root->limits = limits;
+
+      if(marked > 0 && root->provider != NULL)
+      {
+         int rootFd = open(root->path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+
+         if(rootFd != -1)
+         {
+            changed += scanApps(root, rootFd, ScanSelection_Fresh);
+            close(rootFd);
+         }
+      }
+   }
+
+   DLT_LOG(phmContext, DLT_LOG_INFO, DLT_STRING("adoptLimitsConfig - configuration:"), DLT_UINT(generation),
+                                     DLT_STRING("rescanned applications:"), DLT_INT(changed));
+
+   // the previous version is not referenced any more
+   handoffAdopt(&gLimitsHandoff, generation);
+
+   return (changed > 0) ? 1 : 0;
+}
+
+
+
+static void* runMonitorThread(void* dataPtr)
+{
+   int i = 0;
+   int timerFd = -1;
+   FreshRequest_s fresh[FRESH_REQUESTS_MAX];
+   struct pollfd* pfd = malloc((1 + 2 * gRootCount) * sizeof(struct pollfd));
+
+   // before the first scan, the scan workers inherit the policy of this thread
+   (void)threadPolicyApply(ThreadPolicy_Monitor);
+
+   timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+   if(timerFd == -1 || pfd == NULL)
+   {
+      DLT_LOG(phmContext, DLT_LOG_ERROR, DLT_STRING("runMonitorThread - failed to create timer:"), DLT_STRING(strerror(errno)));
+      if(timerFd != -1)
+         close(timerFd);
+      free(pfd);
+      handoffStop(&gLimitsHandoff);     // nobody takes a reloaded configuration over
+      return NULL;
+   }
+   __atomic_store_n(&gTimerFd, timerFd, __ATOMIC_RELEASE);
+
+   __atomic_store_n(&gpUsageShm, usageShmCreate(), __ATOMIC_RELEASE);
+
+   for(i = 0; i < gRootCount; i++)
+   {
+      startRoot(&gpRoots[i]);
+   }
+
+   while(__atomic_load_n(&gStopRequested, __ATOMIC_SEQ_CST) == 0)
+   {
+      long long now = scanScheduleNow();
+      long long nextRound = -1;
+      uint64_t expirations = 0;
+      int rounds = 0;
+      int requested = __atomic_exchange_n(&gCheckRequested, 0, __ATOMIC_ACQ_REL);
+      int freshCount = takeFreshRequests(fresh);
+
+      // a reloaded configuration is taken over between two rounds, never in the middle of one
+      rounds += adoptLimitsConfig();
+
+      // the clients wait for these, so they come before the regular rounds
+      if(freshCount > 0)
+      {
+         scanFreshApps(fresh, freshCount);
+         rounds++;
+      }
+
+      // only the roots that are due or have changed get a round, the others cost nothing
+      for(i = 0; i < gRootCount; i++)
+      {
+         MonitorRoot_s* root = &gpRoots[i];
+
+         if(root->provider != NULL && (requested == 1 || (root->nextRoundMs != -1 && root->nextRoundMs <= now)))
+         {
+            runRootRound(root, requested);
+            rounds++;
+         }
+         if(root->nextRoundMs != -1 && (nextRound == -1 || root->nextRoundMs < nextRound))
+         {
+            nextRound = root->nextRoundMs;
+         }
+      }
+
+      if(rounds > 0)
+      {
+         publishUsage();
+      }
+
+      for(i = 0; i < freshCount; i++)
+      {
+         if(fresh[i].done != NULL)
+         {
+            fresh[i].done(fresh[i].id, fresh[i].result);
+         }
+      }
+
+      armTimer(timerFd, nextRound);
+      if(__atomic_load_n(&gCheckRequested, __ATOMIC_ACQUIRE) == 1 || __atomic_load_n(&gFreshCount, __ATOMIC_ACQUIRE) > 0)
+      {
+         armTimer(timerFd, 0);     // requested while the timer was armed
+      }
+
+      pfd[0].fd = timerFd;
+      pfd[0].events  = POLLIN;
+      pfd[0].revents = 0;
+      for(i = 0; i < gRootCount; i++)
+      {
+         pfd[1 + 2*i].fd = (gpRoots[i].watch != NULL) ? diskWatchGetFd(gpRoots[i].watch) : -1;
+         pfd[2 + 2*i].fd = (gpRoots[i].quotaEvents != NULL) ? quotaEventsGetFd(gpRoots[i].quotaEvents) : -1;
+         pfd[1 + 2*i].events  = pfd[2 + 2*i].events  = POLLIN;
+         pfd[1 + 2*i].revents = pfd[2 + 2*i].revents = 0;
+      }
+
+      while(-1 == poll(pfd, 1 + 2 * gRootCount, -1) && EINTR == errno);
+
+      if(pfd[0].revents & POLLIN)
+      {
+         (void)read(timerFd, &expirations, sizeof(expirations));
+      }
+
+      for(i = 0; i < gRootCount; i++)
+      {
+         MonitorRoot_s* root = &gpRoots[i];
+
+         if((pfd[2 + 2*i].revents & POLLIN) && quotaEventsProcess(root->quotaEvents, onQuotaEvent, root) != 0)
+         {
+            DLT_LOG(phmContext, DLT_LOG_WARN, DLT_STRING("runMonitorThread - quota warnings lost:"), DLT_STRING(root->path));
+         }
+
+         if((pfd[1 + 2*i].revents & POLLIN) && diskWatchProcessEvents(root->watch, onDiskWatchEvent, root) != 0)
+         {
+            // event queue overflow, changes have been lost => full rescan
+            diskWatchDestroy(root->watch);
+            root->watch   = NULL;
+            root->scanAll = 1;
+            wakeRootAt(root, 0);
+         }
+      }
+   }
+
+   // stopMonitorThread: the configuration thread has ended, nobody wakes the timer any more
+   for(i = 0; i < gRootCount; i++)
+   {
+      usageProviderDestroy(gpRoots[i].provider);    // joins the scan workers
+      gpRoots[i].provider = NULL;
+   }
+   handoffStop(&gLimitsHandoff);
+   __atomic_store_n(&gTimerFd, -1, __ATOMIC_RELEASE);
+   close(timerFd);
+   free(pfd);
+
+   return NULL;
+}
+
+
+
+static MonitorRoot_s* addRoot(const char* path, LimitsTable_s* limits)
+{
+   MonitorRoot_s* root = NULL;
+   MonitorRoot_s* newRoots = NULL;
+
+   if(strlen(path) >= sizeof(root->path))
+   {
+      DLT_LOG(phmContext, DLT_LOG_ERROR, DLT_STRING("addRoot - path too long:"), DLT_STRING(path));
+      return NULL;
+   }
+
+   newRoots = realloc(gpRoots, (gRootCount + 1) * sizeof(MonitorRoot_s));
+   if(newRoots == NULL)
+   {
+      DLT_LOG(phmContext, DLT_LOG_ERROR, DLT_STRING("addRoot - out of memory"));
+      return NULL;
+   }
+   gpRoots = newRoots;
+
+   root = &gpRoots[gRootCount++];
+   memset(root, 0, sizeof(MonitorRoot_s));
+   strcpy(root->path, path);
+   root->options = gOptions;     // the options so far are the defaults of the root
+   root->limits  = (limits != NULL) ? limits : limitsTableCreate();
+   root->partitionTimeToFullMs = -1;
+   root->nextRoundMs = -1;
+
+   return root;
+}
+
+
+
+int startMonitorThread()
+{
+   int rval = -1;
+
+   if(getConfiguration() != -1)   // read configuration file
+   {
+      int i = 0;
+      LimitsConfig_s* first = NULL;
+      const char* backend = getenv("PERS_PHM_SCAN_BACKEND");   // override to compare the backends
+
+      // one budget for the scans of all roots, they share the storage bandwidth
+      if(gOptions.scanOpsPerSec > 0 || gOptions.scanDutyCycle < 100)
+      {
+         gpScanBudget = scanBudgetCreate(gOptions.scanOpsPerSec, gOptions.scanDutyCycle);
+      }
+
+      for(i = 0; i < gRootCount; i++)
+      {
+         MonitorOptions_s* options = &gpRoots[i].options;
+
+         options->scan.budget = gpScanBudget;
+
+         if(backend != NULL)
+         {
+            setOption(options, "scanBackend", backend);
+         }
+
+         if(options->schedule.maxIntervalMs < options->schedule.minIntervalMs)
+         {
+            options->schedule.maxIntervalMs = options->schedule.minIntervalMs;
+         }
+
+         if(options->scanWorkers <= 0)
+         {
+            long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+            options->scanWorkers = (cpus > 0) ? (int)cpus : 1;
+         }
+      }
+
+      // the sizes read now are the first version, later versions replace it as a whole
+      first = calloc(1, sizeof(LimitsConfig_s));
+      if(first != NULL)
+      {
+         first->limits = malloc(gRootCount * sizeof(LimitsTable_s*));
+         if(first->limits == NULL)
+         {
+            free(first);
+            first = NULL;
+         }
+         for(i = 0; first != NULL && i < gRootCount; i++)
+         {
+            first->limits[i] = gpRoots[i].limits;
+         }
+      }
+      handoffInit(&gLimitsHandoff, first);
+
+      rval = pthread_create(&gMonitorThread, NULL, runMonitorThread, NULL);
+      if(rval)
+      {
+        DLT_LOG(phmContext, DLT_LOG_ERROR, DLT_STRING("pthread_create( runMonitorThread ) ret err:"), DLT_INT(rval) );
+        return -1;
+      }
+      gMonitorStarted = 1;
+
+      (void)pthread_setname_np(gMonitorThread, "phmMonitorThread");
+
+      if(first != NULL)
+      {
+         // the sizes are reloaded when the configuration file changes, the options need a restart
+         gConfigStopFd = eventfd(0, EFD_CLOEXEC);
+         if(gConfigStopFd != -1 && pthread_create(&gConfigThread, NULL, runConfigThread, NULL) == 0)
+         {
+            (void)pthread_setname_np(gConfigThread, "phmConfigThread");
+         }
+         else
+         {
+            DLT_LOG(phmContext, DLT_LOG_WARN, DLT_STRING("pthread_create( runConfigThread ) failed, sizes are not reloaded"));
+            if(gConfigStopFd != -1)
+            {
+               close(gConfigStopFd);
+               gConfigStopFd = -1;
+            }
+         }
+      }
+   }
+   else
+   {
+      DLT_LOG(phmContext, DLT_LOG_ERROR, DLT_STRING("Failed to read size configuration"));
+   }
+
+   return rval;
+}
+
+
+static int getConfiguration(void)
+{
+   int rval = 0;
+   const char *filename = getenv("PERS_PHM_CFG");
+   const char* cachePath = NULL;
+   struct stat source;
+   ConfigReader_s* reader = NULL;
+
+   if(filename == NULL)
+   {
+      filename = gDefaultConfig;    // use default filename
+      DLT_LOG(phmContext, DLT_LOG_INFO, DLT_STRING("configReader::getConfiguration ==> using DEFAULT conf file:"), DLT_STRING(filename));
+   }
+   else
+   {
+      DLT_LOG(phmContext, DLT_LOG_INFO, DLT_STRING("configReader::getConfiguration ==> using environment PERS_FILE_CACHE_CFG conf file:"), DLT_STRING(filename));
+   }
+
+   gpConfigFileName = filename;     // watched for changes of the sizes
+
+   // the compiled form is used as long as it belongs to the current file
+   cachePath = getenv("PERS_PHM_CFG_CACHE");
+   if(cachePath == NULL)
+   {
+      cachePath = gDefaultConfigCache;
+   }
+   if(stat(filename, &source) == -1)
+   {
+      cachePath = "";
+   }
+
+   if(cachePath[0] != '\0' && readConfigCache(cachePath, &source) == 0)
+   {
+      DLT_LOG(phmContext, DLT_LOG_INFO, DLT_STRING("configReader::getConfiguration ==> using compiled configuration:"), DLT_STRING(cachePath));
+   }
+   else if((reader = configReaderOpen(filename)) != NULL)
+   {
+      int i = 0;
+      const char* key = NULL;
+      const char* value = NULL;
+      unsigned int line = 0;
+      // entries before the first '@root' belong to the default root
+      MonitorRoot_s* root = NULL;
+      LimitsTable_s* defaultLimits = limitsTableCreate();
+      int defaultEntries = 0, defaultRoot = 0;
+      // the '@' entries in the order of the file, for the configuration cache
+      const char** options = NULL;
+      int optionCount = 0, optionCapacity = 0;
+
+      while(configReaderNext(reader, &key, &value, &line) == 1)
+      {
+         if(key[0] == '@' && cachePath[0] != '\0')
+         {
+            if(optionCount == optionCapacity)
+            {
+               const char** newOptions = realloc(options, (optionCapacity + 32) * sizeof(const char*));
+               if(newOptions == NULL)
+               {
+                  cachePath = "";      // not written without all options
+               }
+               else
+               {
+                  options = newOptions;
+                  optionCapacity += 32;
+               }
+            }
+            if(optionCount < optionCapacity)
+            {
+               options[optionCount++] = key;
+               options[optionCount++] = value;
+            }
+         }
+
+         if(0 == strcmp(key, "@root"))
+         {
+            root = addRoot(value, NULL);
+         }
+         else if(key[0] == '@')
+         {
+            // options before the first '@root' are the defaults of every root
+            setOption((root != NULL) ? &root->options : &gOptions, key + 1, value);
+         }
+         else if(root != NULL)
+         {
+            (void)addLimit(root->limits, key, value);
+         }
+         else if(addLimit(defaultLimits, key, value) == 0)
+         {
+            defaultEntries++;
+         }
+      }
+
+      if(gRootCount == 0 || defaultEntries > 0)
+      {
+         // the default root gets the options of the whole file
+         root = addRoot(gDefaultPersistencePath, defaultLimits);
+         defaultLimits = NULL;
+         defaultRoot = (root != NULL) ? 1 : 0;
+      }
+      if(defaultLimits != NULL)
+      {
+         limitsTableDestroy(defaultLimits);
+      }
+
+      // the tables are complete, from now on they are only read
+      for(i = 0; i < gRootCount; i++)
+      {
+         if(gpRoots[i].limits != NULL)
+         {
+            (void)limitsTableSeal(gpRoots[i].limits);
+         }
+      }
+
+      if(cachePath[0] != '\0' && gRootCount > 0 && configReaderGetErrors(reader) == 0)
+      {
+         writeConfigCache(cachePath, &source, options, optionCount, defaultRoot);
+      }
+      free(options);
+      configReaderClose(reader);
+
+      if(gRootCount == 0)
+      {
+         rval = -1;
+      }
+   }
+   else
+   {
+      DLT_LOG(phmContext, DLT_LOG_ERROR, DLT_STRING("configReader::getConfiguration ==> error reading config file:"), DLT_STRING(filename));
+      rval = -1;
+   }
+
+   return rval;
+}
+
+
+
+static int addLimit(LimitsTable_s* limits, const char* appId, const char* value)
+{
+   int rval = -1;
+
+   if(limits != NULL)
+   {
+      unsigned long long size = 0, inodes = 0;
+
+      limitsParse(value, &size, &inodes);
+      rval = limitsTableAdd(limits, appId, size, inodes);
+   }
+   return rval;
+}
+
+
+
+static void freeLimitsConfig(LimitsConfig_s* config)
+{
+   int i = 0;
+
+   for(i = 0; i < gRootCount; i++)
+   {
+      limitsTableDestroy(config->limits[i]);
+   }
+   free(config->limits);
+   free(config);
+}
+
+
+
+static LimitsConfig_s* readLimitsConfig(const char* filename)
+{
+   int i = 0, rootIndex = -1, ok = 1;
+   const char* key = NULL;
+   const char* value = NULL;
+   unsigned int line = 0;
+   ConfigReader_s* reader = NULL;
+   LimitsConfig_s* config = calloc(1, sizeof(LimitsConfig_s));
+
+   if(config == NULL || (config->limits = calloc(gRootCount, sizeof(LimitsTable_s*))) == NULL)
+   {
+      free(config);
+      return NULL;
+   }
+
+   for(i = 0; i < gRootCount; i++)
+   {
+      config->limits[i] = limitsTableCreate();
+      if(config->limits[i] == NULL)
+      {
+         ok = 0;
+      }
+      else if(0 == strcmp(gpRoots[i].path, gDefaultPersistencePath))
+      {
+         rootIndex = i;     // entries before the first '@root' belong to the default root
+      }
+   }
+
+   if(ok == 0 || (reader = configReaderOpen(filename)) == NULL)
+   {
+      freeLimitsConfig(config);
+      return NULL;
+   }
+
+   while(configReaderNext(reader, &key, &value, &line) == 1)
+   {
+      if(0 == strcmp(key, "@root"))
+      {
+         int j = 0;
+
+         for(rootIndex = -1, j = 0; j < gRootCount && rootIndex == -1; j++)
+         {
+            if(0 == strcmp(gpRoots[j].path, value))
+            {
+               rootIndex = j;
+            }
+         }
+         if(rootIndex == -1)
+         {
+            DLT_LOG(phmContext, DLT_LOG_WARN, DLT_STRING("configReader::readLimitsConfig ==> new root needs a restart:"),
+                                              DLT_STRING(value), DLT_STRING("line:"), DLT_UINT(line));
+         }
+      }
+      else if(key[0] != '@' && rootIndex != -1)
+      {
+         // options are only read at startup
+         (void)addLimit(config->limits[rootIndex], key, value);
+      }
+   }
+   configReaderClose(reader);
+
+   for(i = 0; i < gRootCount; i++)
+   {
+      (void)limitsTableSeal(config->limits[i]);
+   }
+
+   return config;
+}
+
+
+
+static void reloadLimitsConfig(void)
+{
+   unsigned int generation = 0;
+   LimitsConfig_s* previous = NULL;
+
+   // parsed here, the monitor thread only swaps a pointer
+   LimitsConfig_s* config = readLimitsConfig(gpConfigFileName);
+   if(config == NULL)
+   {
+      DLT_LOG(phmContext, DLT_LOG_ERROR, DLT_STRING("configReader::reloadLimitsConfig ==> sizes unchanged, failed to read:"),
+                                         DLT_STRING(gpConfigFileName));
+      return;
+   }
+
+   previous = (LimitsConfig_s*)handoffPublish(&gLimitsHandoff, config, &generation);
+   DLT_LOG(phmContext, DLT_LOG_INFO, DLT_STRING("configReader::reloadLimitsConfig ==> new sizes:"), DLT_UINT(generation));
+
+   // the monitor thread may be in the middle of a round with the previous version; it is
+   // released once the monitor thread has taken over the new one between two rounds (or has stopped)
+   (void)wakeMonitorThread();
+   (void)handoffWaitAdopted(&gLimitsHandoff, generation);
+   freeLimitsConfig(previous);
+}
+
+
+
+static void* runConfigThread(void* dataPtr)
+{
+   char folder[PATH_MAX];
+   char events[sizeof(struct inotify_event) + NAME_MAX + 1] __attribute__((aligned(__alignof__(struct inotify_event))));
+   const char* name = strrchr(gpConfigFileName, '/');
+   int fd = inotify_init1(IN_CLOEXEC);
+
+   (void)dataPtr;
+   (void)threadPolicyApply(ThreadPolicy_Monitor);
+
+   // the folder is watched, editors replace the file by renaming a new one onto it
+   if(name == NULL)
+   {
+      strcpy(folder, ".");
+      name = gpConfigFileName;
+   }
+   else
+   {
+      size_t len = (name == gpConfigFileName) ? 1 : (size_t)(name - gpConfigFileName);
+
+      if(len >= sizeof(folder))
+      {
+         len = sizeof(folder) - 1;
+      }
+      memcpy(folder, gpConfigFileName, len);
+      folder[len] = '\0';
+      name++;
+   }
+
+   if(fd == -1 || inotify_add_watch(fd, folder, IN_CLOSE_WRITE | IN_MOVED_TO) == -1)
+   {
+      DLT_LOG(phmContext, DLT_LOG_WARN, DLT_STRING("runConfigThread - sizes are not reloaded, failed to watch:"),
+                                        DLT_STRING(folder), DLT_STRING(strerror(errno)));
+      if(fd != -1)
+         close(fd);
+      return NULL;
+   }
+
+   while(1) // run until stopMonitorThread
+   {
+      int changed = 0;
+      ssize_t len = 0;
+      const char* ptr = events;
+      struct pollfd pfd[2] = { {fd, POLLIN, 0}, {gConfigStopFd, POLLIN, 0} };
+
+      if(poll(pfd, 2, -1) == -1)
+      {
+         if(errno == EINTR)
+         {
+            continue;
+         }
+         DLT_LOG(phmContext, DLT_LOG_ERROR, DLT_STRING("runConfigThread - poll failed:"), DLT_STRING(strerror(errno)));
+         break;
+      }
+      if(pfd[1].revents != 0)
+      {
+         break;
+      }
+
+      len = read(fd, events, sizeof(events));
+      if(len == -1)
+      {
+         if(errno == EINTR)
+         {
+            continue;
+         }
+         DLT_LOG(phmContext, DLT_LOG_ERROR, DLT_STRING("runConfigThread - read failed:"), DLT_STRING(strerror(errno)));
+         break;
+      }
+
+      while(ptr < events + len)
+      {
+         const struct inotify_event* event = (const struct inotify_event*)ptr;
+
+         if(event->len > 0 && 0 == strcmp(event->name, name))
+         {
+            changed = 1;
+         }
+         ptr += sizeof(struct inotify_event) + event->len;
+      }
+
+      if(changed == 1)
+      {
+         reloadLimitsConfig();
+      }
+   }
+
+   close(fd);
+
+   return NULL;
+}
+
+
+
+static int readConfigCache(const char* cachePath, const struct stat* source)
+{
+   int i = 0, tokenCount = 0;
+   const char** tokens = NULL;
+   MonitorRoot_s* root = NULL;
+   ConfigCache_s* cache = configCacheOpen(cachePath, source);
+
+   if(cache == NULL)
+   {
+      return -1;
+   }
+
+   tokens = malloc((configCacheGetTokenCount(cache) + 1) * sizeof(const char*));
+   if(tokens == NULL)
+   {
+      configCacheClose(cache);
+      return -1;
+   }
+
+   // the same sequence as the configuration file, only the sizes are already in their tables
+   tokenCount = configCacheGetTokens(cache, tokens, configCacheGetTokenCount(cache));
+   for(i = 0; i + 1 < tokenCount; i += 2)
+   {
+      if(0 == strcmp(tokens[i], "@root"))
+      {
+         LimitsTable_s* limits = (gRootCount < configCacheGetTableCount(cache)) ? configCacheGetLimits(cache, gRootCount) : NULL;
+
+         root = addRoot(tokens[i+1], limits);
+         if(root == NULL)
+         {
+            limitsTableDestroy(limits);
+         }
+      }
+      else
+      {
+         setOption((root != NULL) ? &root->options : &gOptions, tokens[i] + 1, tokens[i+1]);
+      }
+   }
+
+   free(tokens);
+   gpConfigCache = cache;
+
+   return (gRootCount > 0) ? 0 : -1;
+}
+
+
+
+static void writeConfigCache(const char* cachePath, const struct stat* source, const char** options, int optionCount, int defaultRoot)
+{
+   int i = 0, tokenCount = optionCount;
+   const char** tokens = malloc((optionCount + 2) * sizeof(const char*));
+   LimitsTable_s** tables = malloc(gRootCount * sizeof(LimitsTable_s*));
+
+   if(tokens == NULL || tables == NULL)
+   {
+      free(tokens);
+      free(tables);
+      return;
+   }
+
+   // the '@' entries in the order of the file; the sizes go into the tables
+   if(optionCount > 0)
+   {
+      memcpy(tokens, options, optionCount * sizeof(const char*));
+   }
+   if(defaultRoot == 1)
+   {
+      tokens[tokenCount++] = "@root";     // added after the whole file
+      tokens[tokenCount++] = gDefaultPersistencePath;
+   }
+
+   for(i = 0; i < gRootCount; i++)
+   {
+      tables[i] = gpRoots[i].limits;
+      if(tables[i] == NULL)
+      {
+         free(tokens);
+         free(tables);
+         return;     // out of memory while reading, next time the file is parsed again
+      }
+   }
+
+   if(configCacheWrite(cachePath, source, tokens, tokenCount, tables, gRootCount) == 0)
+   {
+      DLT_LOG(phmContext, DLT_LOG_INFO, DLT_STRING("configReader::writeConfigCache ==> compiled configuration written:"), DLT_STRING(cachePath));
+   }
+
+   free(tokens);
+   free(tables);
+}
+
+
+
+static long long getIntervalOption(const char* value, long long current)
+{
+   long long interval = strtoll(value, NULL, 10) * 1000;    // seconds in the configuration
+
+   if(interval <= 0)
+   {
+      DLT_LOG(phmContext, DLT_LOG_WARN, DLT_STRING("configReader::setOption ==> invalid interval:"), DLT_STRING(value));
+      return current;
+   }
+   return interval;
+}
+
+
+
+static int getPercentOption(const char* value, int current)
+{
+   int percent = atoi(value);
+
+   if(percent < 0 || percent > 100)
+   {
+      DLT_LOG(phmContext, DLT_LOG_WARN, DLT_STRING("configReader::setOption ==> invalid percentage:"), DLT_STRING(value));
+      return current;
+   }
+   return percent;
+}
+
+
+
+static void setOption(MonitorOptions_s* options, const char* name, const char* value)
+{
+   if(0 == strcmp(name, "scanWorkers"))
+   {
+      options->scanWorkers = atoi(value);
+   }
+   else if(0 == strcmp(name, "scanCache"))
+   {
+      options->scanCache = atoi(value);
+   }
+   else if(0 == strcmp(name, "topConsumers"))
+   {
+      int count = atoi(value);
+      if(count >= 0 && count <= SCAN_TOP_MAX_ENTRIES)
+      {
+         options->topConsumers = count;
+      }
+      else
+      {
+         DLT_LOG(phmContext, DLT_LOG_WARN, DLT_STRING("configReader::setOption ==> invalid number of top consumers:"), DLT_STRING(value));
+      }
+   }
+   else if(0 == strcmp(name, "provider"))
+   {
+      UsageProviderType_e provider = usageProviderGetType(value);
+      if(provider != UsageProvider_LastEntry)
+      {
+         options->provider = provider;
+      }
+      else
+      {
+         DLT_LOG(phmContext, DLT_LOG_WARN, DLT_STRING("configReader::setOption ==> unknown provider:"), DLT_STRING(value));
+      }
+   }
+   else if(0 == strcmp(name, "minInterval"))
+   {
+      options->schedule.minIntervalMs = getIntervalOption(value, options->schedule.minIntervalMs);
+   }
+   else if(0 == strcmp(name, "maxInterval"))
+   {
+      options->schedule.maxIntervalMs = getIntervalOption(value, options->schedule.maxIntervalMs);
+   }
+   else if(0 == strcmp(name, "forecastWarn"))
+   {
+      options->forecastWarnMs = getIntervalOption(value, options->forecastWarnMs);
+   }
+   else if(0 == strcmp(name, "lowWatermark"))
+   {
+      options->lowWatermark = getPercentOption(value, options->lowWatermark);
+   }
+   else if(0 == strcmp(name, "lowInodeWatermark"))
+   {
+      options->lowInodeWatermark = getPercentOption(value, options->lowInodeWatermark);
+   }
+   else if(0 == strcmp(name, "scanOpsPerSec"))
+   {
+      options->scanOpsPerSec = (unsigned int)strtoul(value, NULL, 10);
+   }
+   else if(0 == strcmp(name, "scanDutyCycle"))
+   {
+      int dutyCycle = getPercentOption(value, (int)options->scanDutyCycle);
+      options->scanDutyCycle = (dutyCycle > 0) ? (unsigned int)dutyCycle : options->scanDutyCycle;
+   }
+   else if(0 == strcmp(name, "enforceLimits"))
+   {
+      options->enforceLimits = (atoi(value) != 0) ? 1 : 0;
+   }
+   else if(0 == strcmp(name, "metric"))
+   {
+      DiskScanMetric_e metric = diskScanGetMetric(value);
+      if(metric != DiskScanMetric_LastEntry)
+      {
+         options->scan.metric = metric;
+      }
+      else
+      {
+         DLT_LOG(phmContext, DLT_LOG_WARN, DLT_STRING("configReader::setOption ==> unknown metric:"), DLT_STRING(value));
+      }
+   }
+   else if(0 == strcmp(name, "scanBackend"))
+   {
+      DiskScanBackend_e backend = diskScanGetBackend(value);
+      if(backend != DiskScanBackend_LastEntry)
+      {
+         options->scan.backend = backend;
+      }
+      else
+      {
+         DLT_LOG(phmContext, DLT_LOG_WARN, DLT_STRING("configReader::setOption ==> unknown scan backend:"), DLT_STRING(value));
+      }
+   }
+   else if(0 == strncmp(name, "monitor", 7))    // thread policies are process wide, not per root
+   {
+      if(threadPolicySetOption(ThreadPolicy_Monitor, name + 7, value) == -1)
+      {
+         DLT_LOG(phmContext, DLT_LOG_WARN, DLT_STRING("configReader::setOption ==> invalid thread option:"), DLT_STRING(name), DLT_STRING(value));
+      }
+   }
+   else if(0 == strncmp(name, "dbus", 4))
+   {
+      if(threadPolicySetOption(ThreadPolicy_Dbus, name + 4, value) == -1)
+      {
+         DLT_LOG(phmContext, DLT_LOG_WARN, DLT_STRING("configReader::setOption ==> invalid thread option:"), DLT_STRING(name), DLT_STRING(value));
+      }
+   }
+   else
+   {
+      DLT_LOG(phmContext, DLT_LOG_WARN, DLT_STRING("configReader::setOption ==> unknown option:"), DLT_STRING(name));
+   }
+}
+
+
+
+static unsigned long long findMaxSize(const LimitsTable_s* limits, const char* appId, unsigned long long hash)
+{
+   const LimitsEntry_s* entry = (limits != NULL) ? limitsTableFind(limits, appId, hash) : NULL;
+
+   return (entry != NULL) ? entry->size : 0;
+}
+
+
+
+static unsigned long long findMaxInodes(const LimitsTable_s* limits, const char* appId, unsigned long long hash)
+{
+   const LimitsEntry_s* entry = (limits != NULL) ? limitsTableFind(limits, appId, hash) : NULL;
+
+   return (entry != NULL) ? entry->inodes : 0;
+}
+
+
+
+void stopMonitorThread(void)
+{
+   uint64_t stop = 1;
+
+   // the configuration thread first, it may wait for the monitor thread to take over a version
+   if(gConfigStopFd != -1)
+   {
+      if(write(gConfigStopFd, &stop, sizeof(stop)) == sizeof(stop))
+      {
+         pthread_join(gConfigThread, NULL);
+      }
+      close(gConfigStopFd);
+      gConfigStopFd = -1;
+   }
+
+   if(gMonitorStarted == 1)
+   {
+      __atomic_store_n(&gStopRequested, 1, __ATOMIC_SEQ_CST);
+      (void)wakeMonitorThread();
+      pthread_join(gMonitorThread, NULL);
+      gMonitorStarted = 0;
+   }
+}
+
+
+
+void freeLimits()
+{
+   int i = 0;
+   LimitsConfig_s* config = (LimitsConfig_s*)handoffClose(&gLimitsHandoff);
+
+   // the trees of the roots belong to the current version of the configuration
+   if(config != NULL)
+   {
+      freeLimitsConfig(config);
+   }
+
+   for(i = 0; i < gRootCount; i++)
+   {
+      gpRoots[i].limits = NULL;
+   }
 }
 
 
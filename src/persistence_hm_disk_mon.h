@@ -22,9 +22,88 @@
 
 
 
+#include "persistence_hm_usage.h"
+#include "persistence_hm_scan_top.h"
+
+
+/// called by the monitor thread when a requested scan is done (result 0) or the application is unknown (-1);
+/// requestId is the one passed to requestAppScan
+typedef void (*diskMonScanDone_f)(unsigned int requestId, int result);
+
+/// called by forEachAppUsage for every application
+typedef void (*diskMonAppUsage_f)(const PhmUsageApp_s* app, const PhmUsageRoot_s* root, void* data);
+
+
 int startMonitorThread();
 
-void freeRbTree();
+/**
+ * @brief Request a check of every application, even if the partition is above the watermarks.
+ *        May be called from any thread.
+ *
+ * @return 0 on success, -1 if the monitor thread does not run
+ */
+int requestDiskCheck(void);
+
+/**
+ * @brief Request a scan of one application in all roots, whatever is due.
+ *        The usage snapshot is updated before the callback is called.
+ *        May be called from any thread.
+ *
+ * @param appId the AppID
+ * @param done called by the monitor thread when the scan is done, may be NULL
+ * @param requestId passed to done, identifies the request
+ *
+ * @return 0 on success, -1 if the AppID is invalid, too many requests are pending
+ *         or the monitor thread does not run
+ */
+int requestAppScan(const char* appId, diskMonScanDone_f done, unsigned int requestId);
+
+/**
+ * @brief Get the usage of an application published after the last round; unlike the
+ *        snapshot this covers every application and root. May be called from any thread.
+ *
+ * @param appId the AppID; the first root holding the application is used
+ * @param app [out] the usage, root is the index of the root in the configuration
+ * @param root [out] the usage of the root
+ *
+ * @return 0 on success, -1 if the application is unknown or not scanned yet
+ */
+int getAppUsage(const char* appId, PhmUsageApp_s* app, PhmUsageRoot_s* root);
+
+/**
+ * @brief Call a function for the published usage of every application of every root.
+ *        The application tables are locked meanwhile, the function must not call the monitor.
+ *        May be called from any thread.
+ *
+ * @param callback called for every application
+ * @param data passed to callback
+ */
+void forEachAppUsage(diskMonAppUsage_f callback, void* data);
+
+/**
+ * @brief Get the largest files or folders of an application found by the last scan.
+ *        May be called from any thread.
+ *
+ * @param appId the AppID; the first root holding the application is used
+ * @param kind files or folders
+ * @param entries [out] the entries, largest first, paths relative to the application folder
+ * @param max number of entries fitting into entries
+ *
+ * @return number of entries, -1 if the application is unknown
+ */
+int getTopConsumers(const char* appId, ScanTopKind_e kind, ScanTopEntry_s* entries, int max);
+
+
+/**
+ * @brief Stop the monitor thread and the thread reloading the configuration and wait for them
+ */
+void stopMonitorThread(void);
+
+
+/**
+ * @brief Release the configured sizes, after stopMonitorThread
+ */
+void freeLimits();
 
 
 #endif /* PERSISTENCE_HM_DISK_MON_H_ */
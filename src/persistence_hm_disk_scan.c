@@ -0,0 +1,678 @@
+/******************************************************************************
+ * Project         Persistency
+ * (c) copyright   2014
+ * Company         XS Embedded GmbH
+ *****************************************************************************/
+/******************************************************************************
+ * This Source Code Form is subject to the terms of the
+ * Mozilla Public License, v. 2.0. If a  copy of the MPL was not distributed
+ * with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
+******************************************************************************/
+ /**
+ * @file           persistence_hm_disk_scan.c
+ * @ingroup        Persistence Health Monitor
+ * @author         Ingo Huerner
+ * @brief          Implementation of the persistence health monitor folder tree scanner.
+ *                 A folder is read completely with large getdents64 calls before any of
+ *                 its sub folders is entered; the sub folder names are kept on an explicit
+ *                 stack together with the open folder descriptor. So only one directory
+ *                 entry buffer is needed and the number of open descriptors is bounded
+ *                 by the depth of the tree.
+ *                 With a folder size cache, a folder whose times are unchanged is only
+ *                 read for its sub folders, the files are taken from the cache.
+ *                 The size of a folder tree is added to its parent frame when the frame is
+ *                 left; with a top consumer list the path of the current folder is kept
+ *                 in one buffer that every frame knows its length of.
+ * @see
+ */
+
+#include "persistence_hm_definitions.h"
+#include "persistence_hm_disk_scan.h"
+#include "persistence_hm_disk_scan_uring.h"
+#include "persistence_hm_scan_cache.h"
+#include "persistence_hm_inode_set.h"
+
+#include <sys/syscall.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <dirent.h>
+#include <stdint.h>
+
+
+/// size of the buffer for one getdents64 call
+#define DENTS_BUFFER_SIZE (64 * 1024)
+
+#define FILE_DIR_NOT_SELF_OR_PARENT(s) ((s)[0]!='.'&&(((s)[1]!='.'||(s)[2]!='\0')||(s)[1]=='\0'))
+
+
+/// directory entry as returned by the getdents64 system call
+struct linux_dirent64
+{
+   uint64_t       d_ino;
+   int64_t        d_off;
+   unsigned short d_reclen;
+   unsigned char  d_type;
+   char           d_name[];
+};
+
+
+/// one level of the folder stack
+typedef struct ScanFrame_s_
+{
+   /// descriptor of the open folder
+   int fd;
+   /// names of the sub folders still to be scanned, '\0' separated
+   char* subFolders;
+   /// used bytes of subFolders
+   size_t used;
+   /// allocated bytes of subFolders
+   size_t capacity;
+   /// read position inside subFolders
+   size_t pos;
+   /// length of the folder's path relative to the scanned folder
+   size_t pathLen;
+   /// size of the folder tree counted so far
+   unsigned long long total;
+} ScanFrame_s;
+
+
+struct DiskScanner_s_
+{
+   /// the backend in use
+   DiskScanBackend_e backend;
+   /// the io_uring instance if the backend is DiskScanBackend_Uring
+   DiskScanUring_s* uring;
+   /// the size accounted per file
+   DiskScanMetric_e metric;
+   /// files with more than one link seen by the running scan
+   InodeSet_s* links;
+   /// limit of the metadata operations and busy time, NULL = unlimited
+   ScanBudget_s* budget;
+   /// duty cycle state of the thread running the scanner
+   ScanBudgetSlice_s slice;
+   /// the largest files and folders of the running scan or NULL
+   ScanTop_s* largest;
+   /// path of the deepest folder relative to the scanned folder (not 0 terminated)
+   char* path;
+   size_t pathCapacity;
+   /// getdents64 buffer
+   char* dents;
+   /// the folder stack
+   ScanFrame_s* frames;
+   /// number of frames in use
+   int depth;
+   /// number of allocated frames
+   int capacity;
+};
+
+
+/// backend names, same order as DiskScanBackend_e
+static const char* gBackendName[DiskScanBackend_LastEntry] =
+{
+   "sync",
+   "uring"
+};
+
+
+/// metric names, same order as DiskScanMetric_e
+static const char* gMetricName[DiskScanMetric_LastEntry] =
+{
+   "apparent",
+   "allocated"
+};
+
+
+#ifdef HAVE_STATX
+/// cleared if the kernel does not know the statx system call; shared by all scanners,
+/// so it is only accessed atomically
+static int gUseStatx = 1;
+#endif
+
+
+// local function prototypes
+static int scanTree(DiskScanner_s* ctx, int parentFd, const char* name, DiskScanCache_s* cache, ScanTop_s* largest, DiskScanUsage_s* usage);
+static int pushFolder(DiskScanner_s* ctx, int fd);
+static int readFolder(DiskScanner_s* ctx, ScanFrame_s* frame, DiskScanCache_s* cache, DiskScanUsage_s* usage);
+static int addSubFolder(ScanFrame_s* frame, const char* name);
+static int setFramePath(DiskScanner_s* ctx, ScanFrame_s* frame, size_t parentLen, const char* name);
+static int statEntry(int dirFd, const char* name, struct stat* buf);
+//----------------------------------------------------------
+
+
+
+DiskScanBackend_e diskScanGetBackend(const char* name)
+{
+   int i = 0;
+
+   for(i = 0; i < DiskScanBackend_LastEntry; i++)
+   {
+      if(0 == strcmp(name, gBackendName[i]))
+      {
+         break;
+      }
+   }
+   return (DiskScanBackend_e)i;
+}
+
+
+
+const char* diskScanGetBackendName(DiskScanBackend_e backend)
+{
+   return (backend < DiskScanBackend_LastEntry) ? gBackendName[backend] : "unknown";
+}
+
+
+
+DiskScanMetric_e diskScanGetMetric(const char* name)
+{
+   int i = 0;
+
+   for(i = 0; i < DiskScanMetric_LastEntry; i++)
+   {
+      if(0 == strcmp(name, gMetricName[i]))
+      {
+         break;
+      }
+   }
+   return (DiskScanMetric_e)i;
+}
+
+
+
+const char* diskScanGetMetricName(DiskScanMetric_e metric)
+{
+   return (metric < DiskScanMetric_LastEntry) ? gMetricName[metric] : "unknown";
+}
+
+
+
+DiskScanner_s* diskScannerCreate(const DiskScanOptions_s* options)
+{
+   DiskScanner_s* scanner = calloc(1, sizeof(DiskScanner_s));
+
+   if(scanner != NULL)
+   {
+      scanner->backend = DiskScanBackend_Sync;
+      scanner->metric  = options->metric;
+      scanner->budget  = options->budget;
+      scanner->dents = malloc(DENTS_BUFFER_SIZE);
+      scanner->links = inodeSetCreate();
+      if(scanner->dents == NULL || scanner->links == NULL)
+      {
+         inodeSetDestroy(scanner->links);
+         free(scanner->dents);
+         free(scanner);
+         return NULL;
+      }
+
+      if(options->backend == DiskScanBackend_Uring)
+      {
+         scanner->uring = diskScanUringCreate(options);
+         if(scanner->uring != NULL)
+         {
+            scanner->backend = DiskScanBackend_Uring;
+         }
+         // else: kernel lacks support, use the synchronous walk
+      }
+   }
+   return scanner;
+}
+
+
+
+void diskScannerDestroy(DiskScanner_s* scanner)
+{
+   if(scanner != NULL)
+   {
+      int i = 0;
+
+      for(i = 0; i < scanner->capacity; i++)
+      {
+         free(scanner->frames[i].subFolders);
+      }
+      free(scanner->frames);
+      free(scanner->path);
+      free(scanner->dents);
+      inodeSetDestroy(scanner->links);
+      diskScanUringDestroy(scanner->uring);
+      free(scanner);
+   }
+}
+
+
+
+DiskScanBackend_e diskScannerGetBackend(const DiskScanner_s* scanner)
+{
+   return scanner->backend;
+}
+
+
+
+void diskScannerSetBudget(DiskScanner_s* scanner, ScanBudget_s* budget)
+{
+   scanner->budget = budget;
+   if(scanner->uring != NULL)
+   {
+      diskScanUringSetBudget(scanner->uring, budget);
+   }
+}
+
+
+
+int diskScanFolder(int parentFd, const char* name, const DiskScanOptions_s* options, DiskScanUsage_s* usage)
+{
+   int rval = -1;
+   DiskScanner_s* scanner = diskScannerCreate(options);
+
+   if(scanner != NULL)
+   {
+      rval = diskScannerRun(scanner, parentFd, name, NULL, NULL, usage);
+      diskScannerDestroy(scanner);
+   }
+   return rval;
+}
+
+
+
+int diskScannerRun(DiskScanner_s* ctx, int parentFd, const char* name, DiskScanCache_s* cache, ScanTop_s* largest, DiskScanUsage_s* usage)
+{
+   int rval = scanTree(ctx, parentFd, name, cache, largest, usage);
+
+   if(rval == 0 && cache != NULL && diskScanCacheEndScan(cache) == 1)
+   {
+      // hard linked files have appeared, a folder served from the cache may hold another
+      // link of a file counted; scan again, the cache serves no folder now
+      rval = scanTree(ctx, parentFd, name, cache, largest, usage);
+      if(rval == 0)
+      {
+         (void)diskScanCacheEndScan(cache);
+      }
+   }
+
+   return rval;
+}
+
+
+
+static int scanTree(DiskScanner_s* ctx, int parentFd, const char* name, DiskScanCache_s* cache, ScanTop_s* largest, DiskScanUsage_s* usage)
+{
+   int rval = 0;
+   int fd = -1;
+
+   if(cache != NULL)
+   {
+      diskScanCacheBeginScan(cache);
+   }
+   if(largest != NULL)
+   {
+      scanTopBegin(largest);
+   }
+
+   if(ctx->backend == DiskScanBackend_Uring)
+   {
+      rval = diskScanUringRun(ctx->uring, parentFd, name, cache, usage);
+      if(rval != -2)
+      {
+         return rval;
+      }
+
+      // the ring failed, continue with the synchronous walk
+      DLT_LOG(phmContext, DLT_LOG_WARN, DLT_STRING("diskScannerRun - io_uring failed, using synchronous scan"));
+      diskScanUringDestroy(ctx->uring);
+      ctx->uring   = NULL;
+      ctx->backend = DiskScanBackend_Sync;
+   }
+
+   memset(usage, 0, sizeof(DiskScanUsage_s));
+   inodeSetClear(ctx->links);
+   ctx->depth   = 0;
+   ctx->largest = largest;
+   scanBudgetBegin(&ctx->slice);
+
+   fd = openat(parentFd, name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+   if(fd == -1)
+   {
+      return -1;
+   }
+
+   if(pushFolder(ctx, fd) == -1)
+   {
+      close(fd);
+      return -1;
+   }
+   rval = readFolder(ctx, &ctx->frames[0], cache, usage);
+
+   while(ctx->depth > 0 && rval == 0)
+   {
+      ScanFrame_s* top = &ctx->frames[ctx->depth-1];
+
+      if(top->pos < top->used)
+      {
+         const char* subFolder = top->subFolders + top->pos;
+         size_t parentLen = top->pathLen;
+         top->pos += strlen(subFolder) + 1;
+
+         fd = openat(top->fd, subFolder, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+         if(fd != -1)
+         {
+            if(pushFolder(ctx, fd) == 0)
+            {
+               // pushFolder may move the frames, the name is in the parent's own buffer
+               rval = setFramePath(ctx, &ctx->frames[ctx->depth-1], parentLen, subFolder);
+               if(rval == 0)
+               {
+                  rval = readFolder(ctx, &ctx->frames[ctx->depth-1], cache, usage);
+               }
+            }
+            else
+            {
+               close(fd);
+               rval = -1;
+            }
+         }
+         // else: folder has been removed in the meantime or is not accessible
+      }
+      else
+      {
+         if(ctx->depth > 1)
+         {
+            ctx->frames[ctx->depth-2].total += top->total;
+            if(largest != NULL)
+            {
+               scanTopAdd(largest, ScanTopKind_Folder, top->total, 0, 0, ctx->path, (unsigned int)top->pathLen, NULL);
+            }
+         }
+         close(top->fd);
+         ctx->depth--;
+      }
+   }
+
+   // close the remaining folders in case of an error
+   while(ctx->depth > 0)
+   {
+      close(ctx->frames[--ctx->depth].fd);
+   }
+
+   if(rval == 0 && largest != NULL)
+   {
+      largest->valid = 1;
+   }
+   ctx->largest = NULL;
+
+   return rval;
+}
+
+
+
+static int pushFolder(DiskScanner_s* ctx, int fd)
+{
+   ScanFrame_s* frame = NULL;
+
+   if(ctx->depth == ctx->capacity)
+   {
+      int newCapacity = (ctx->capacity == 0) ? 16 : ctx->capacity * 2;
+      ScanFrame_s* frames = realloc(ctx->frames, newCapacity * sizeof(ScanFrame_s));
+      if(frames == NULL)
+      {
+         DLT_LOG(phmContext, DLT_LOG_ERROR, DLT_STRING("diskScannerRun - out of memory"));
+         return -1;
+      }
+      memset(&frames[ctx->capacity], 0, (newCapacity - ctx->capacity) * sizeof(ScanFrame_s));
+      ctx->frames   = frames;
+      ctx->capacity = newCapacity;
+   }
+
+   // the sub folder buffer of a frame is kept for reuse by the next folder on this level
+   frame = &ctx->frames[ctx->depth++];
+   frame->fd      = fd;
+   frame->used    = 0;
+   frame->pos     = 0;
+   frame->pathLen = 0;
+   frame->total   = 0;
+
+   return 0;
+}
+
+
+
+static int readFolder(DiskScanner_s* ctx, ScanFrame_s* frame, DiskScanCache_s* cache, DiskScanUsage_s* usage)
+{
+   long nread = 0;
+   int cached = 0;
+   int linked = 0;
+   unsigned int ops = 2;      // the open and the last getdents64
+   unsigned long long size = 0, dirSize = 0;
+   unsigned long long dirDev = 0, dirIno = 0;
+   unsigned int files = 0;
+   struct stat dirStat;
+
+   usage->folders++;
+
+   // the folder times are taken before reading, so a change while reading is seen by the next scan
+   if(cache != NULL || ctx->metric == DiskScanMetric_Allocated)
+   {
+      ops++;
+      if(fstat(frame->fd, &dirStat) == 0)
+      {
+         dirDev = (unsigned long long)dirStat.st_dev;
+         dirIno = (unsigned long long)dirStat.st_ino;
+         if(ctx->metric == DiskScanMetric_Allocated)
+         {
+            dirSize = (unsigned long long)dirStat.st_blocks * 512;
+         }
+         if(cache != NULL)
+         {
+            cached = diskScanCacheLookup(cache, &dirStat, &size, &files);
+         }
+         if(cached == 1 && ctx->largest != NULL)
+         {
+            scanTopCarry(ctx->largest, dirDev, dirIno, ctx->path, (unsigned int)frame->pathLen);
+         }
+      }
+      else
+      {
+         cache = NULL;
+      }
+   }
+
+   while((nread = syscall(SYS_getdents64, frame->fd, ctx->dents, DENTS_BUFFER_SIZE)) > 0)
+   {
+      long bpos = 0;
+
+      ops++;
+      while(bpos < nread)
+      {
+         const struct linux_dirent64* dent = (const struct linux_dirent64*)(ctx->dents + bpos);
+         bpos += dent->d_reclen;
+
+         if(FILE_DIR_NOT_SELF_OR_PARENT(dent->d_name))
+         {
+            unsigned char type = dent->d_type;
+            struct stat buf;
+
+            if(DT_DIR == type)
+            {
+               if(addSubFolder(frame, dent->d_name) == -1)
+               {
+                  return -1;
+               }
+            }
+            else if((DT_REG == type && cached == 0) || DT_UNKNOWN == type)
+            {
+               // file systems without d_type support report DT_UNKNOWN, the stat tells the type
+               ops++;
+               if(statEntry(frame->fd, dent->d_name, &buf) == 0)
+               {
+                  if(S_ISREG(buf.st_mode))
+                  {
+                     int isNew = 1;
+
+                     if(cached == 0 && buf.st_nlink > 1)
+                     {
+                        linked = 1;    // the total depends on which link is seen first, do not cache it
+                        if(cache != NULL)
+                        {
+                           diskScanCacheNoteLinked(cache);
+                        }
+                        isNew = inodeSetInsert(ctx->links, buf.st_dev, buf.st_ino);
+                        if(isNew == -1)
+                        {
+                           return -1;
+                        }
+                     }
+                     if(cached == 0 && isNew == 1)
+                     {
+                        unsigned long long fileSize = (ctx->metric == DiskScanMetric_Allocated) ? (unsigned long long)buf.st_blocks * 512
+                                                                                                : (unsigned long long)buf.st_size;
+                        size += fileSize;
+                        files++;
+
+                        if(ctx->largest != NULL && scanTopQualifies(ctx->largest, ScanTopKind_File, fileSize) == 1)
+                        {
+                           scanTopAdd(ctx->largest, ScanTopKind_File, fileSize, dirDev, dirIno,
+                                      ctx->path, (unsigned int)frame->pathLen, dent->d_name);
+                        }
+                     }
+                  }
+                  else if(S_ISDIR(buf.st_mode))
+                  {
+                     if(addSubFolder(frame, dent->d_name) == -1)
+                     {
+                        return -1;
+                     }
+                  }
+               }
+            }
+         }
+      }
+   }
+
+   if(nread == -1)
+   {
+      DLT_LOG(phmContext, DLT_LOG_WARN, DLT_STRING("diskScannerRun - getdents64 failed:"), DLT_STRING(strerror(errno)));
+   }
+   else if(cache != NULL && cached == 0 && linked == 0)
+   {
+      diskScanCacheStore(cache, &dirStat, size, files);
+   }
+
+   usage->size  += size + dirSize;
+   usage->files += files;
+   frame->total += size + dirSize;
+
+   // the folder is done, pause here if the budget is exhausted
+   scanBudgetCharge(ctx->budget, &ctx->slice, ops);
+
+   return 0;
+}
+
+
+
+static int addSubFolder(ScanFrame_s* frame, const char* name)
+{
+   size_t len = strlen(name) + 1;
+
+   if(frame->used + len > frame->capacity)
+   {
+      size_t newCapacity = (frame->capacity == 0) ? 1024 : frame->capacity;
+      char* subFolders = NULL;
+
+      while(newCapacity < frame->used + len)
+      {
+         newCapacity *= 2;
+      }
+
+      subFolders = realloc(frame->subFolders, newCapacity);
+      if(subFolders == NULL)
+      {
+         DLT_LOG(phmContext, DLT_LOG_ERROR, DLT_STRING("diskScannerRun - out of memory"));
+         return -1;
+      }
+      frame->subFolders = subFolders;
+      frame->capacity   = newCapacity;
+   }
+
+   memcpy(frame->subFolders + frame->used, name, len);
+   frame->used += len;
+
+   return 0;
+}
+
+
+
+static int setFramePath(DiskScanner_s* ctx, ScanFrame_s* frame, size_t parentLen, const char* name)
+{
+   size_t len = strlen(name);
+   size_t pathLen = (parentLen > 0) ? parentLen + 1 + len : len;
+
+   if(ctx->largest == NULL)
+   {
+      return 0;      // the path is only needed for the top consumer list
+   }
+
+   if(pathLen > ctx->pathCapacity)
+   {
+      size_t newCapacity = (ctx->pathCapacity == 0) ? 256 : ctx->pathCapacity;
+      char* path = NULL;
+
+      while(newCapacity < pathLen)
+      {
+         newCapacity *= 2;
+      }
+
+      path = realloc(ctx->path, newCapacity);
+      if(path == NULL)
+      {
+         DLT_LOG(phmContext, DLT_LOG_ERROR, DLT_STRING("diskScannerRun - out of memory"));
+         return -1;
+      }
+      ctx->path         = path;
+      ctx->pathCapacity = newCapacity;
+   }
+
+   if(parentLen > 0)
+   {
+      ctx->path[parentLen++] = '/';
+   }
+   memcpy(ctx->path + parentLen, name, len);
+   frame->pathLen = pathLen;
+
+   return 0;
+}
+
+
+
+static int statEntry(int dirFd, const char* name, struct stat* buf)
+{
+#ifdef HAVE_STATX
+   if(__atomic_load_n(&gUseStatx, __ATOMIC_RELAXED) == 1)
+   {
+      struct statx stx;
+
+      // only request what is needed, the file system may skip the rest
+      if(statx(dirFd, name, AT_SYMLINK_NOFOLLOW | AT_NO_AUTOMOUNT,
+               STATX_TYPE | STATX_SIZE | STATX_BLOCKS | STATX_NLINK | STATX_INO, &stx) == 0)
+      {
+         buf->st_mode   = stx.stx_mode;
+         buf->st_size   = (off_t)stx.stx_size;
+         buf->st_blocks = (blkcnt_t)stx.stx_blocks;
+         buf->st_nlink  = (nlink_t)stx.stx_nlink;
+         buf->st_ino    = (ino_t)stx.stx_ino;
+         buf->st_dev    = makedev(stx.stx_dev_major, stx.stx_dev_minor);
+         return 0;
+      }
+      else if(errno != ENOSYS)
+      {
+         return -1;
+      }
+      __atomic_store_n(&gUseStatx, 0, __ATOMIC_RELAXED);    // kernel too old, use fstatat from now on
+   }
+#endif
+   return fstatat(dirFd, name, buf, AT_SYMLINK_NOFOLLOW | AT_NO_AUTOMOUNT);
+}
@@ -0,0 +1,201 @@
+#ifndef PERSISTENCE_HM_DISK_SCAN_H_
+#define PERSISTENCE_HM_DISK_SCAN_H_
+
+/******************************************************************************
+ * Project         Persistency
+ * (c) copyright   2014
+ * Company         XS Embedded GmbH
+ *****************************************************************************/
+/******************************************************************************
+ * This Source Code Form is subject to the terms of the
+ * Mozilla Public License, v. 2.0. If a  copy of the MPL was not distributed
+ * with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
+******************************************************************************/
+ /**
+ * @file           persistence_hm_disk_scan.h
+ * @ingroup        Persistence Health Monitor
+ * @author         Ingo Huerner
+ * @brief          Header of the persistence health monitor folder tree scanner.
+ * @see
+ */
+
+#include "persistence_hm_scan_cache.h"
+#include "persistence_hm_scan_budget.h"
+#include "persistence_hm_scan_top.h"
+
+
+/// usage of a folder tree
+typedef struct DiskScanUsage_s_
+{
+   /// sum of the regular file sizes (see DiskScanMetric_e), hard linked files count once
+   unsigned long long size;
+   /// number of regular files
+   unsigned int files;
+   /// number of folders, including the scanned folder itself
+   unsigned int folders;
+
+} DiskScanUsage_s;
+
+
+/// implementations of the folder tree walk
+typedef enum DiskScanBackend_e_
+{
+   /// one blocking stat call per file
+   DiskScanBackend_Sync = 0,
+   /// stat calls and folder opens are submitted in batches through io_uring
+   DiskScanBackend_Uring,
+
+   // insert new entries here ...
+
+   /// last entry
+   DiskScanBackend_LastEntry
+
+} DiskScanBackend_e;
+
+
+/// what the size of a file is
+typedef enum DiskScanMetric_e_
+{
+   /// the file length (st_size), what a reader of the file sees
+   DiskScanMetric_Apparent = 0,
+   /// the allocated blocks (st_blocks), what the file takes from the partition;
+   /// sparse files count less, small files are rounded up and folders are included
+   DiskScanMetric_Allocated,
+
+   // insert new entries here ...
+
+   /// last entry
+   DiskScanMetric_LastEntry
+
+} DiskScanMetric_e;
+
+
+/// options of a scan
+typedef struct DiskScanOptions_s_
+{
+   /// the walk implementation to use
+   DiskScanBackend_e backend;
+   /// the size accounted per file
+   DiskScanMetric_e metric;
+   /// limit of the metadata operations and busy time, NULL = unlimited
+   ScanBudget_s* budget;
+
+} DiskScanOptions_s;
+
+
+/// the scanner (holds buffers and kernel resources, one per thread)
+typedef struct DiskScanner_s_ DiskScanner_s;
+
+
+/**
+ * @brief Get the backend from its name
+ *
+ * @param name "sync" or "uring"
+ *
+ * @return the backend or DiskScanBackend_LastEntry if the name is unknown
+ */
+DiskScanBackend_e diskScanGetBackend(const char* name);
+
+
+/**
+ * @brief Get the name of a backend
+ *
+ * @param backend the backend
+ *
+ * @return the name
+ */
+const char* diskScanGetBackendName(DiskScanBackend_e backend);
+
+
+/**
+ * @brief Get the metric from its name
+ *
+ * @param name "apparent" or "allocated"
+ *
+ * @return the metric or DiskScanMetric_LastEntry if the name is unknown
+ */
+DiskScanMetric_e diskScanGetMetric(const char* name);
+
+
+/**
+ * @brief Get the name of a metric
+ *
+ * @param metric the metric
+ *
+ * @return the name
+ */
+const char* diskScanGetMetricName(DiskScanMetric_e metric);
+
+
+/**
+ * @brief Create a scanner.
+ *        If the requested backend is not supported by the kernel, the scanner
+ *        falls back to the synchronous walk.
+ *
+ * @param options the scan options
+ *
+ * @return the scanner or NULL if memory is exhausted
+ */
+DiskScanner_s* diskScannerCreate(const DiskScanOptions_s* options);
+
+
+/**
+ * @brief Release a scanner
+ *
+ * @param scanner the scanner
+ */
+void diskScannerDestroy(DiskScanner_s* scanner);
+
+
+/**
+ * @brief Get the backend the scanner actually uses
+ *
+ * @param scanner the scanner
+ *
+ * @return the backend
+ */
+DiskScanBackend_e diskScannerGetBackend(const DiskScanner_s* scanner);
+
+
+/**
+ * @brief Set the budget of the next scans
+ *
+ * @param scanner the scanner
+ * @param budget the budget or NULL to scan without limit
+ */
+void diskScannerSetBudget(DiskScanner_s* scanner, ScanBudget_s* budget);
+
+
+/**
+ * @brief Sum up the usage of a folder tree.
+ *        The tree is walked relative to directory file descriptors, so there is no
+ *        limit on the path length and the kernel does not resolve a full path per file.
+ *        Symbolic links are not followed.
+ *
+ * @param scanner the scanner; must not be used by two threads at the same time
+ * @param parentFd file descriptor of the parent folder or AT_FDCWD
+ * @param name name of the folder relative to parentFd
+ * @param cache folder size cache of this tree or NULL to stat every file
+ * @param largest [out] the largest files and folders of the tree or NULL; only the
+ *                synchronous walk fills it, it stays invalid with the io_uring backend
+ * @param usage [out] the usage of the folder tree
+ *
+ * @return 0 on success, -1 if the folder could not be opened or memory is exhausted
+ */
+int diskScannerRun(DiskScanner_s* scanner, int parentFd, const char* name, DiskScanCache_s* cache, ScanTop_s* largest, DiskScanUsage_s* usage);
+
+
+/**
+ * @brief Sum up the usage of a folder tree with a temporary scanner
+ *
+ * @param parentFd file descriptor of the parent folder or AT_FDCWD
+ * @param name name of the folder relative to parentFd
+ * @param options the scan options
+ * @param usage [out] the usage of the folder tree
+ *
+ * @return 0 on success, -1 if the folder could not be opened or memory is exhausted
+ */
+int diskScanFolder(int parentFd, const char* name, const DiskScanOptions_s* options, DiskScanUsage_s* usage);
+
+
+#endif /* PERSISTENCE_HM_DISK_SCAN_H_ */
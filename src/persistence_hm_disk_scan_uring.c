@@ -0,0 +1,914 @@
+/******************************************************************************
+ * Project         Persistency
+ * (c) copyright   2014
+ * Company         XS Embedded GmbH
+ *****************************************************************************/
+/******************************************************************************
+ * This Source Code Form is subject to the terms of the
+ * Mozilla Public License, v. 2.0. If a  copy of the MPL was not distributed
+ * with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
+******************************************************************************/
+ /**
+ * @file           persistence_hm_disk_scan_uring.c
+ * @ingroup        Persistence Health Monitor
+ * @author         Ingo Huerner
+ * @brief          Implementation of the io_uring backend of the folder tree scanner.
+ *                 Folders are still read with getdents64 (there is no io_uring operation
+ *                 for it), but every stat of a file and every open of a sub folder is
+ *                 queued as IORING_OP_STATX / IORING_OP_OPENAT and submitted in batches of
+ *                 up to URING_ENTRIES requests. Completions are handled as they arrive.
+ *                 Sub folders waiting to be opened are kept on a stack, so the walk is
+ *                 depth first and the number of open folder descriptors stays bounded.
+ *                 The file total of each folder is collected in its folder record and
+ *                 handed to the folder size cache when the last reference is released.
+ * @see
+ */
+
+#include "persistence_hm_definitions.h"
+#include "persistence_hm_disk_scan_uring.h"
+#include "persistence_hm_inode_set.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+
+#if defined(HAVE_LINUX_IO_URING_H)
+#include <linux/io_uring.h>
+#endif
+
+// IORING_FEAT_FAST_POLL came with the kernel headers that know STATX, OPENAT and the probe
+#if defined(HAVE_LINUX_IO_URING_H) && defined(IORING_FEAT_FAST_POLL)
+
+#include <sys/syscall.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <limits.h>
+#include <stdint.h>
+#include <dirent.h>
+
+
+/// number of submission queue entries and of requests in flight
+#define URING_ENTRIES 256
+
+/// maximum number of opened folders waiting to be read
+#define URING_MAX_OPEN_DIRS 64
+
+/// size of the buffer for one getdents64 call
+#define URING_DENTS_BUFFER_SIZE (64 * 1024)
+
+#define FILE_DIR_NOT_SELF_OR_PARENT(s) ((s)[0]!='.'&&(((s)[1]!='.'||(s)[2]!='\0')||(s)[1]=='\0'))
+
+
+/// directory entry as returned by the getdents64 system call
+struct linux_dirent64
+{
+   uint64_t       d_ino;
+   int64_t        d_off;
+   unsigned short d_reclen;
+   unsigned char  d_type;
+   char           d_name[];
+};
+
+
+/// type of a request in flight
+typedef enum UringRequest_e_
+{
+   UringRequest_Free = 0,
+   UringRequest_Statx,
+   UringRequest_Open
+} UringRequest_e;
+
+
+/// one request in flight; name and statx buffer must stay valid until the completion
+typedef struct UringSlot_s_
+{
+   UringRequest_e type;
+   /// the folder the name is relative to (index into dirs)
+   int dir;
+   /// next free slot
+   int nextFree;
+   struct statx stx;
+   char name[NAME_MAX+1];
+} UringSlot_s;
+
+
+/// an open folder, closed when nothing refers to it any more
+typedef struct UringDir_s_
+{
+   int fd;
+   /// references: reading, pending sub folders and requests in flight
+   int refs;
+   /// next free record
+   int nextFree;
+   /// the folder's stat before reading, valid if cacheable is set
+   struct stat st;
+   /// 1 if the file total may be stored in the cache when the folder is done
+   int cacheable;
+   /// 1 if the file total has been taken from the cache, the files are not counted
+   int cached;
+   /// sum of the file sizes directly inside the folder
+   unsigned long long size;
+   /// number of files directly inside the folder
+   unsigned int files;
+} UringDir_s;
+
+
+/// a sub folder still to be opened
+typedef struct UringPending_s_
+{
+   /// the parent folder (index into dirs)
+   int dir;
+   /// offset of the name in the name stack
+   size_t nameOffset;
+} UringPending_s;
+
+
+struct DiskScanUring_s_
+{
+   /// the io_uring file descriptor
+   int fd;
+
+   /// submission queue ring
+   void* sqRing;
+   size_t sqRingSize;
+   unsigned int* sqHead;
+   unsigned int* sqTail;
+   unsigned int* sqMask;
+   unsigned int* sqArray;
+   struct io_uring_sqe* sqes;
+   size_t sqesSize;
+   /// tail of the filled SQEs, published to the kernel only by submitAndWait
+   unsigned int sqeTail;
+   /// SQEs filled but not yet submitted
+   unsigned int toSubmit;
+
+   /// completion queue ring
+   void* cqRing;
+   size_t cqRingSize;
+   unsigned int* cqHead;
+   unsigned int* cqTail;
+   unsigned int* cqMask;
+   struct io_uring_cqe* cqes;
+
+   /// requests in flight
+   UringSlot_s slots[URING_ENTRIES];
+   int freeSlot;
+   int inflight;
+   int inflightOpens;
+
+   /// open folders
+   UringDir_s* dirs;
+   int dirCapacity;
+   int freeDir;
+
+   /// opened folders waiting to be read (indices into dirs)
+   int* ready;
+   int readyCount;
+
+   /// sub folders waiting to be opened, names on a stack of '\0' terminated strings
+   UringPending_s* pending;
+   int pendingCount;
+   int pendingCapacity;
+   char* names;
+   size_t namesUsed;
+   size_t namesCapacity;
+
+   /// getdents64 buffer and read position of the folder being read
+   char* dents;
+   long dentsLen;
+   long dentsPos;
+   int current;
+
+   /// the size accounted per file
+   DiskScanMetric_e metric;
+   /// files with more than one link seen by the running scan
+   InodeSet_s* links;
+   /// limit of the metadata operations and busy time, NULL = unlimited
+   ScanBudget_s* budget;
+   /// duty cycle state of the thread running the scan
+   ScanBudgetSlice_s slice;
+   /// operations queued since the budget has been charged last
+   unsigned int ops;
+
+   /// folder size cache and result of the running scan
+   DiskScanCache_s* cache;
+   DiskScanUsage_s* usage;
+};
+
+
+// local function prototypes
+static int setupRing(DiskScanUring_s* uring);
+static int probeOperations(DiskScanUring_s* uring);
+static int newDir(DiskScanUring_s* uring, int fd);
+static void releaseDir(DiskScanUring_s* uring, int dir);
+static int pushPending(DiskScanUring_s* uring, int dir, const char* name);
+static int allocSlot(DiskScanUring_s* uring, UringRequest_e type, int dir, const char* name);
+static struct io_uring_sqe* nextSqe(DiskScanUring_s* uring);
+static void queueStatx(DiskScanUring_s* uring, int slot);
+static void queueOpen(DiskScanUring_s* uring, int slot);
+static int submitAndWait(DiskScanUring_s* uring, unsigned int minComplete);
+static int reapCompletions(DiskScanUring_s* uring);
+static void resetScan(DiskScanUring_s* uring);
+//----------------------------------------------------------
+
+
+
+DiskScanUring_s* diskScanUringCreate(const DiskScanOptions_s* options)
+{
+   DiskScanUring_s* uring = calloc(1, sizeof(DiskScanUring_s));
+
+   if(uring != NULL)
+   {
+      uring->fd = -1;
+      uring->metric = options->metric;
+      uring->budget = options->budget;
+      uring->dents = malloc(URING_DENTS_BUFFER_SIZE);
+      uring->ready = malloc(URING_MAX_OPEN_DIRS * sizeof(int));
+      uring->links = inodeSetCreate();
+
+      if(   uring->dents == NULL || uring->ready == NULL || uring->links == NULL
+         || setupRing(uring) == -1 || probeOperations(uring) == -1)
+      {
+         diskScanUringDestroy(uring);
+         return NULL;
+      }
+      resetScan(uring);
+   }
+
+   return uring;
+}
+
+
+
+void diskScanUringDestroy(DiskScanUring_s* uring)
+{
+   if(uring != NULL)
+   {
+      if(uring->sqes != NULL)
+      {
+         munmap(uring->sqes, uring->sqesSize);
+      }
+      if(uring->cqRing != NULL && uring->cqRing != uring->sqRing)
+      {
+         munmap(uring->cqRing, uring->cqRingSize);
+      }
+      if(uring->sqRing != NULL)
+      {
+         munmap(uring->sqRing, uring->sqRingSize);
+      }
+      if(uring->fd != -1)
+      {
+         close(uring->fd);
+      }
+      free(uring->dirs);
+      free(uring->ready);
+      free(uring->pending);
+      free(uring->names);
+      free(uring->dents);
+      inodeSetDestroy(uring->links);
+      free(uring);
+   }
+}
+
+
+
+void diskScanUringSetBudget(DiskScanUring_s* uring, ScanBudget_s* budget)
+{
+   uring->budget = budget;
+}
+
+
+
+int diskScanUringRun(DiskScanUring_s* uring, int parentFd, const char* name, DiskScanCache_s* cache, DiskScanUsage_s* usage)
+{
+   int rval = 0;
+   int fd = openat(parentFd, name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+
+   memset(usage, 0, sizeof(DiskScanUsage_s));
+
+   if(fd == -1)
+   {
+      return -1;
+   }
+
+   resetScan(uring);
+   inodeSetClear(uring->links);
+   uring->cache = cache;
+   uring->usage = usage;
+   uring->ops   = 0;
+   scanBudgetBegin(&uring->slice);
+   uring->ready[uring->readyCount++] = newDir(uring, fd);
+   if(uring->ready[0] == -1)
+   {
+      close(fd);
+      return -1;
+   }
+
+   while(rval == 0)
+   {
+      int progress = 0;
+
+      // open the sub folders found so far, the deepest first
+      while(   uring->pendingCount > 0 && uring->freeSlot != -1
+            && uring->readyCount + uring->inflightOpens < URING_MAX_OPEN_DIRS)
+      {
+         UringPending_s* pending = &uring->pending[--uring->pendingCount];
+         int slot = allocSlot(uring, UringRequest_Open, pending->dir, uring->names + pending->nameOffset);
+
+         uring->namesUsed = pending->nameOffset;
+         releaseDir(uring, pending->dir);    // the slot holds the reference now
+         queueOpen(uring, slot);
+         progress = 1;
+      }
+
+      // read folders and queue a statx for every file
+      while(uring->freeSlot != -1 && rval == 0)
+      {
+         const struct linux_dirent64* dent = NULL;
+
+         if(uring->current == -1)
+         {
+            if(uring->readyCount == 0)
+            {
+               break;
+            }
+
+            // charge the folders read so far before the next one, pause here if the budget is exhausted
+            scanBudgetCharge(uring->budget, &uring->slice, uring->ops);
+            uring->ops = 0;
+
+            uring->current  = uring->ready[--uring->readyCount];
+            uring->dentsLen = 0;
+            uring->dentsPos = 0;
+            usage->folders++;
+         }
+
+         if(uring->dentsPos >= uring->dentsLen)
+         {
+            uring->dentsLen = syscall(SYS_getdents64, uring->dirs[uring->current].fd, uring->dents, URING_DENTS_BUFFER_SIZE);
+            uring->dentsPos = 0;
+            uring->ops++;
+            progress = 1;
+            if(uring->dentsLen <= 0)
+            {
+               if(uring->dentsLen < 0)
+               {
+                  uring->dirs[uring->current].cacheable = 0;
+               }
+               releaseDir(uring, uring->current);     // folder completely read
+               uring->current = -1;
+               continue;
+            }
+         }
+
+         dent = (const struct linux_dirent64*)(uring->dents + uring->dentsPos);
+         uring->dentsPos += dent->d_reclen;
+         progress = 1;
+
+         if(FILE_DIR_NOT_SELF_OR_PARENT(dent->d_name))
+         {
+            if(DT_DIR == dent->d_type)
+            {
+               rval = pushPending(uring, uring->current, dent->d_name);
+            }
+            else if((DT_REG == dent->d_type && uring->dirs[uring->current].cached == 0) || DT_UNKNOWN == dent->d_type)
+            {
+               queueStatx(uring, allocSlot(uring, UringRequest_Statx, uring->current, dent->d_name));
+            }
+         }
+      }
+
+      if(   uring->inflight == 0 && uring->toSubmit == 0 && uring->current == -1
+         && uring->readyCount == 0 && uring->pendingCount == 0)
+      {
+         break;   // done
+      }
+
+      if(rval == 0)
+      {
+         // only block if there is nothing else to do
+         rval = submitAndWait(uring, (progress == 0 && uring->inflight > 0) ? 1 : 0);
+      }
+      if(rval == 0)
+      {
+         rval = reapCompletions(uring);
+      }
+   }
+
+   if(rval != 0)
+   {
+      // the folders still open are incomplete, keep them out of the cache
+      uring->cache = NULL;
+
+      // wait for the requests in flight, they still refer to the slots
+      while(uring->inflight > 0 && submitAndWait(uring, 1) == 0 && reapCompletions(uring) == 0);
+      if(uring->inflight > 0)
+      {
+         rval = -2;
+      }
+      if(uring->current != -1)
+      {
+         releaseDir(uring, uring->current);
+      }
+      while(uring->readyCount > 0)
+      {
+         releaseDir(uring, uring->ready[--uring->readyCount]);
+      }
+      while(uring->pendingCount > 0)
+      {
+         releaseDir(uring, uring->pending[--uring->pendingCount].dir);
+      }
+      if(rval == -1)
+      {
+         rval = -2;     // ring or memory failure, not a missing folder
+      }
+   }
+
+   return rval;
+}
+
+
+
+static int setupRing(DiskScanUring_s* uring)
+{
+   struct io_uring_params params;
+   unsigned char* cq = NULL;
+
+   memset(&params, 0, sizeof(params));
+
+   uring->fd = (int)syscall(__NR_io_uring_setup, URING_ENTRIES, &params);
+   if(uring->fd == -1)
+   {
+      DLT_LOG(phmContext, DLT_LOG_INFO, DLT_STRING("diskScanUring - io_uring not available:"), DLT_STRING(strerror(errno)));
+      return -1;
+   }
+
+   uring->sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+   uring->cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+   if(params.features & IORING_FEAT_SINGLE_MMAP)
+   {
+      if(uring->cqRingSize > uring->sqRingSize)
+      {
+         uring->sqRingSize = uring->cqRingSize;
+      }
+      uring->cqRingSize = uring->sqRingSize;
+   }
+
+   uring->sqRing = mmap(0, uring->sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, uring->fd, IORING_OFF_SQ_RING);
+   if(uring->sqRing == MAP_FAILED)
+   {
+      uring->sqRing = NULL;
+      return -1;
+   }
+
+   if(params.features & IORING_FEAT_SINGLE_MMAP)
+   {
+      uring->cqRing = uring->sqRing;
+   }
+   else
+   {
+      uring->cqRing = mmap(0, uring->cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, uring->fd, IORING_OFF_CQ_RING);
+      if(uring->cqRing == MAP_FAILED)
+      {
+         uring->cqRing = NULL;
+         return -1;
+      }
+   }
+
+   uring->sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+   uring->sqes = mmap(0, uring->sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, uring->fd, IORING_OFF_SQES);
+   if(uring->sqes == MAP_FAILED)
+   {
+      uring->sqes = NULL;
+      return -1;
+   }
+
+   uring->sqHead  = (unsigned int*)((unsigned char*)uring->sqRing + params.sq_off.head);
+   uring->sqTail  = (unsigned int*)((unsigned char*)uring->sqRing + params.sq_off.tail);
+   uring->sqMask  = (unsigned int*)((unsigned char*)uring->sqRing + params.sq_off.ring_mask);
+   uring->sqArray = (unsigned int*)((unsigned char*)uring->sqRing + params.sq_off.array);
+   uring->sqeTail = *uring->sqTail;
+
+   cq = (unsigned char*)uring->cqRing;
+   uring->cqHead = (unsigned int*)(cq + params.cq_off.head);
+   uring->cqTail = (unsigned int*)(cq + params.cq_off.tail);
+   uring->cqMask = (unsigned int*)(cq + params.cq_off.ring_mask);
+   uring->cqes   = (struct io_uring_cqe*)(cq + params.cq_off.cqes);
+
+   return 0;
+}
+
+
+
+static int probeOperations(DiskScanUring_s* uring)
+{
+   int rval = -1;
+   size_t size = sizeof(struct io_uring_probe) + 256 * sizeof(struct io_uring_probe_op);
+   struct io_uring_probe* probe = calloc(1, size);
+
+   if(probe != NULL)
+   {
+      if(   syscall(__NR_io_uring_register, uring->fd, IORING_REGISTER_PROBE, probe, 256) == 0
+         && probe->last_op >= IORING_OP_STATX && probe->last_op >= IORING_OP_OPENAT
+         && (probe->ops[IORING_OP_STATX].flags & IO_URING_OP_SUPPORTED)
+         && (probe->ops[IORING_OP_OPENAT].flags & IO_URING_OP_SUPPORTED))
+      {
+         rval = 0;
+      }
+      else
+      {
+         DLT_LOG(phmContext, DLT_LOG_INFO, DLT_STRING("diskScanUring - kernel lacks IORING_OP_STATX/OPENAT"));
+      }
+      free(probe);
+   }
+
+   return rval;
+}
+
+
+
+static void resetScan(DiskScanUring_s* uring)
+{
+   int i = 0;
+
+   for(i = 0; i < URING_ENTRIES; i++)
+   {
+      uring->slots[i].type = UringRequest_Free;
+      uring->slots[i].nextFree = (i + 1 < URING_ENTRIES) ? i + 1 : -1;
+   }
+   uring->freeSlot = 0;
+   uring->inflight = 0;
+   uring->inflightOpens = 0;
+
+   for(i = 0; i < uring->dirCapacity; i++)
+   {
+      uring->dirs[i].nextFree = (i + 1 < uring->dirCapacity) ? i + 1 : -1;
+   }
+   uring->freeDir = (uring->dirCapacity > 0) ? 0 : -1;
+
+   uring->readyCount   = 0;
+   uring->pendingCount = 0;
+   uring->namesUsed    = 0;
+   uring->current      = -1;
+}
+
+
+
+static int newDir(DiskScanUring_s* uring, int fd)
+{
+   int dir = -1;
+
+   if(uring->freeDir == -1)
+   {
+      int i = 0;
+      int newCapacity = (uring->dirCapacity == 0) ? 64 : uring->dirCapacity * 2;
+      UringDir_s* dirs = realloc(uring->dirs, newCapacity * sizeof(UringDir_s));
+      if(dirs == NULL)
+      {
+         DLT_LOG(phmContext, DLT_LOG_ERROR, DLT_STRING("diskScanUring - out of memory"));
+         return -1;
+      }
+      for(i = uring->dirCapacity; i < newCapacity; i++)
+      {
+         dirs[i].nextFree = (i + 1 < newCapacity) ? i + 1 : -1;
+      }
+      uring->freeDir = uring->dirCapacity;
+      uring->dirs = dirs;
+      uring->dirCapacity = newCapacity;
+   }
+
+   dir = uring->freeDir;
+   uring->freeDir = uring->dirs[dir].nextFree;
+   uring->dirs[dir].fd        = fd;
+   uring->dirs[dir].refs      = 1;       // the reference of the reader
+   uring->dirs[dir].cacheable = 0;
+   uring->dirs[dir].cached    = 0;
+   uring->dirs[dir].size      = 0;
+   uring->dirs[dir].files     = 0;
+
+   // the folder times are taken before reading, so a change while reading is seen by the next scan
+   if(   (uring->cache != NULL || uring->metric == DiskScanMetric_Allocated)
+      && fstat(fd, &uring->dirs[dir].st) == 0)
+   {
+      if(uring->metric == DiskScanMetric_Allocated)
+      {
+         uring->usage->size += (unsigned long long)uring->dirs[dir].st.st_blocks * 512;
+      }
+      if(uring->cache != NULL)
+      {
+         uring->dirs[dir].cacheable = 1;
+         uring->dirs[dir].cached = diskScanCacheLookup(uring->cache, &uring->dirs[dir].st,
+                                                       &uring->dirs[dir].size, &uring->dirs[dir].files);
+         if(uring->dirs[dir].cached == 1)
+         {
+            uring->usage->size  += uring->dirs[dir].size;
+            uring->usage->files += uring->dirs[dir].files;
+         }
+      }
+   }
+
+   return dir;
+}
+
+
+
+static void releaseDir(DiskScanUring_s* uring, int dir)
+{
+   if(--uring->dirs[dir].refs == 0)
+   {
+      if(uring->cache != NULL && uring->dirs[dir].cacheable == 1 && uring->dirs[dir].cached == 0)
+      {
+         diskScanCacheStore(uring->cache, &uring->dirs[dir].st, uring->dirs[dir].size, uring->dirs[dir].files);
+      }
+      close(uring->dirs[dir].fd);
+      uring->dirs[dir].nextFree = uring->freeDir;
+      uring->freeDir = dir;
+   }
+}
+
+
+
+static int pushPending(DiskScanUring_s* uring, int dir, const char* name)
+{
+   size_t len = strlen(name) + 1;
+
+   if(uring->pendingCount == uring->pendingCapacity)
+   {
+      int newCapacity = (uring->pendingCapacity == 0) ? 256 : uring->pendingCapacity * 2;
+      UringPending_s* pending = realloc(uring->pending, newCapacity * sizeof(UringPending_s));
+      if(pending == NULL)
+      {
+         return -1;
+      }
+      uring->pending = pending;
+      uring->pendingCapacity = newCapacity;
+   }
+
+   if(uring->namesUsed + len > uring->namesCapacity)
+   {
+      size_t newCapacity = (uring->namesCapacity == 0) ? 4096 : uring->namesCapacity;
+      char* names = NULL;
+
+      while(newCapacity < uring->namesUsed + len)
+      {
+         newCapacity *= 2;
+      }
+      names = realloc(uring->names, newCapacity);
+      if(names == NULL)
+      {
+         return -1;
+      }
+      uring->names = names;
+      uring->namesCapacity = newCapacity;
+   }
+
+   memcpy(uring->names + uring->namesUsed, name, len);
+   uring->pending[uring->pendingCount].dir = dir;
+   uring->pending[uring->pendingCount].nameOffset = uring->namesUsed;
+   uring->pendingCount++;
+   uring->namesUsed += len;
+   uring->dirs[dir].refs++;
+
+   return 0;
+}
+
+
+
+static int allocSlot(DiskScanUring_s* uring, UringRequest_e type, int dir, const char* name)
+{
+   int slot = uring->freeSlot;
+   size_t len = strlen(name);
+
+   if(len > NAME_MAX)
+   {
+      len = NAME_MAX;
+   }
+
+   uring->freeSlot = uring->slots[slot].nextFree;
+   uring->slots[slot].type = type;
+   uring->slots[slot].dir  = dir;
+   memcpy(uring->slots[slot].name, name, len);
+   uring->slots[slot].name[len] = '\0';
+   uring->dirs[dir].refs++;
+   uring->inflight++;
+
+   return slot;
+}
+
+
+
+static struct io_uring_sqe* nextSqe(DiskScanUring_s* uring)
+{
+   unsigned int index = uring->sqeTail & *uring->sqMask;
+   struct io_uring_sqe* sqe = &uring->sqes[index];
+
+   // the kernel does not see the SQE before submitAndWait moves the tail, the caller fills it first
+   memset(sqe, 0, sizeof(struct io_uring_sqe));
+   uring->sqArray[index] = index;
+   uring->sqeTail++;
+   uring->toSubmit++;
+
+   return sqe;
+}
+
+
+
+static void queueStatx(DiskScanUring_s* uring, int slot)
+{
+   UringSlot_s* request = &uring->slots[slot];
+   struct io_uring_sqe* sqe = nextSqe(uring);
+
+   uring->ops++;
+
+   sqe->opcode      = IORING_OP_STATX;
+   sqe->fd          = uring->dirs[request->dir].fd;
+   sqe->addr        = (uint64_t)(uintptr_t)request->name;
+   sqe->len         = STATX_TYPE | STATX_SIZE | STATX_BLOCKS | STATX_NLINK | STATX_INO;
+   sqe->off         = (uint64_t)(uintptr_t)&request->stx;
+   sqe->statx_flags = AT_SYMLINK_NOFOLLOW | AT_NO_AUTOMOUNT;
+   sqe->user_data   = (uint64_t)slot;
+}
+
+
+
+static void queueOpen(DiskScanUring_s* uring, int slot)
+{
+   UringSlot_s* request = &uring->slots[slot];
+   struct io_uring_sqe* sqe = nextSqe(uring);
+
+   uring->ops++;
+
+   sqe->opcode     = IORING_OP_OPENAT;
+   sqe->fd         = uring->dirs[request->dir].fd;
+   sqe->addr       = (uint64_t)(uintptr_t)request->name;
+   sqe->open_flags = O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC;
+   sqe->user_data  = (uint64_t)slot;
+   uring->inflightOpens++;
+}
+
+
+
+static int submitAndWait(DiskScanUring_s* uring, unsigned int minComplete)
+{
+   // publish the filled SQEs, the release store orders their fields before the new tail
+   __atomic_store_n(uring->sqTail, uring->sqeTail, __ATOMIC_RELEASE);
+
+   while(uring->toSubmit > 0 || minComplete > 0)
+   {
+      int ret = (int)syscall(__NR_io_uring_enter, uring->fd, uring->toSubmit, minComplete,
+                             (minComplete > 0) ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+      if(ret >= 0)
+      {
+         uring->toSubmit -= (unsigned int)ret;
+         break;
+      }
+      else if(errno == EAGAIN || errno == EBUSY)
+      {
+         if(uring->inflight == (int)uring->toSubmit)
+         {
+            return -1;     // nothing to wait for, the kernel refuses the requests
+         }
+         minComplete = 1;  // resources exhausted, make room by waiting for completions
+      }
+      else if(errno != EINTR)
+      {
+         DLT_LOG(phmContext, DLT_LOG_ERROR, DLT_STRING("diskScanUring - io_uring_enter failed:"), DLT_STRING(strerror(errno)));
+         return -1;
+      }
+   }
+   return 0;
+}
+
+
+
+static int reapCompletions(DiskScanUring_s* uring)
+{
+   int rval = 0;
+   unsigned int head = *uring->cqHead;
+   unsigned int tail = __atomic_load_n(uring->cqTail, __ATOMIC_ACQUIRE);
+
+   while(head != tail)
+   {
+      const struct io_uring_cqe* cqe = &uring->cqes[head & *uring->cqMask];
+      int slot = (int)cqe->user_data;
+      UringSlot_s* request = &uring->slots[slot];
+
+      if(request->type == UringRequest_Statx)
+      {
+         if(cqe->res == 0)
+         {
+            UringDir_s* dir = &uring->dirs[request->dir];
+
+            if(S_ISREG(request->stx.stx_mode) && dir->cached == 0)
+            {
+               int isNew = 1;
+
+               if(request->stx.stx_nlink > 1)
+               {
+                  dir->cacheable = 0;    // the total depends on which link is seen first
+                  if(uring->cache != NULL)
+                  {
+                     diskScanCacheNoteLinked(uring->cache);
+                  }
+                  isNew = inodeSetInsert(uring->links, makedev(request->stx.stx_dev_major, request->stx.stx_dev_minor),
+                                         (ino_t)request->stx.stx_ino);
+               }
+               if(isNew == 1)
+               {
+                  unsigned long long size = (uring->metric == DiskScanMetric_Allocated)
+                                            ? (unsigned long long)request->stx.stx_blocks * 512
+                                            : (unsigned long long)request->stx.stx_size;
+                  dir->size += size;
+                  dir->files++;
+                  uring->usage->size += size;
+                  uring->usage->files++;
+               }
+               else if(isNew == -1)
+               {
+                  rval = -1;
+               }
+            }
+            else if(S_ISDIR(request->stx.stx_mode) && pushPending(uring, request->dir, request->name) == -1)
+            {
+               rval = -1;
+            }
+         }
+         else
+         {
+            uring->dirs[request->dir].cacheable = 0;     // the total of this folder is incomplete
+         }
+      }
+      else if(request->type == UringRequest_Open)
+      {
+         uring->inflightOpens--;
+         if(cqe->res >= 0)
+         {
+            int dir = newDir(uring, cqe->res);
+            if(dir != -1)
+            {
+               uring->ready[uring->readyCount++] = dir;
+            }
+            else
+            {
+               close(cqe->res);
+               rval = -1;
+            }
+         }
+         // else: folder has been removed in the meantime or is not accessible
+      }
+
+      releaseDir(uring, request->dir);
+      request->type = UringRequest_Free;
+      request->nextFree = uring->freeSlot;
+      uring->freeSlot = slot;
+      uring->inflight--;
+
+      head++;
+   }
+   __atomic_store_n(uring->cqHead, head, __ATOMIC_RELEASE);
+
+   return rval;
+}
+
+
+#else
+
+
+DiskScanUring_s* diskScanUringCreate(const DiskScanOptions_s* options)
+{
+   (void)options;
+   DLT_LOG(phmContext, DLT_LOG_INFO, DLT_STRING("diskScanUring - built without io_uring support"));
+   return NULL;
+}
+
+
+void diskScanUringDestroy(DiskScanUring_s* uring)
+{
+   (void)uring;
+}
+
+
+void diskScanUringSetBudget(DiskScanUring_s* uring, ScanBudget_s* budget)
+{
+   (void)uring;
+   (void)budget;
+}
+
+
+int diskScanUringRun(DiskScanUring_s* uring, int parentFd, const char* name, DiskScanCache_s* cache, DiskScanUsage_s* usage)
+{
+   (void)uring;
+   (void)parentFd;
+   (void)name;
+   (void)cache;
+   memset(usage, 0, sizeof(DiskScanUsage_s));
+   return -2;
+}
+
+
+#endif
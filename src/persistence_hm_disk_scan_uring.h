@@ -0,0 +1,71 @@
+#ifndef PERSISTENCE_HM_DISK_SCAN_URING_H_
+#define PERSISTENCE_HM_DISK_SCAN_URING_H_
+
+/******************************************************************************
+ * Project         Persistency
+ * (c) copyright   2014
+ * Company         XS Embedded GmbH
+ *****************************************************************************/
+/******************************************************************************
+ * This Source Code Form is subject to the terms of the
+ * Mozilla Public License, v. 2.0. If a  copy of the MPL was not distributed
+ * with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
+******************************************************************************/
+ /**
+ * @file           persistence_hm_disk_scan_uring.h
+ * @ingroup        Persistence Health Monitor
+ * @author         Ingo Huerner
+ * @brief          Header of the io_uring backend of the folder tree scanner (internal to the scanner).
+ * @see
+ */
+
+#include "persistence_hm_disk_scan.h"
+
+
+/// the io_uring instance of a scanner
+typedef struct DiskScanUring_s_ DiskScanUring_s;
+
+
+/**
+ * @brief Create an io_uring instance for batched stat calls and folder opens
+ *
+ * @param options the scan options
+ *
+ * @return the instance or NULL if the kernel does not support io_uring or the needed operations
+ */
+DiskScanUring_s* diskScanUringCreate(const DiskScanOptions_s* options);
+
+
+/**
+ * @brief Release an io_uring instance
+ *
+ * @param uring the instance
+ */
+void diskScanUringDestroy(DiskScanUring_s* uring);
+
+
+/**
+ * @brief Set the budget of the next scans
+ *
+ * @param uring the instance
+ * @param budget the budget or NULL to scan without limit
+ */
+void diskScanUringSetBudget(DiskScanUring_s* uring, ScanBudget_s* budget);
+
+
+/**
+ * @brief Sum up the usage of a folder tree, see diskScannerRun
+ *
+ * @param uring the instance
+ * @param parentFd file descriptor of the parent folder or AT_FDCWD
+ * @param name name of the folder relative to parentFd
+ * @param cache folder size cache of this tree or NULL
+ * @param usage [out] the usage of the folder tree
+ *
+ * @return 0 on success, -1 if the folder could not be opened, -2 if the ring failed
+ *         (the instance must not be used any more)
+ */
+int diskScanUringRun(DiskScanUring_s* uring, int parentFd, const char* name, DiskScanCache_s* cache, DiskScanUsage_s* usage);
+
+
+#endif /* PERSISTENCE_HM_DISK_SCAN_URING_H_ */
@@ -0,0 +1,343 @@
+/******************************************************************************
+ * Project         Persistency
+ * (c) copyright   2014
+ * Company         XS Embedded GmbH
+ *****************************************************************************/
+/******************************************************************************
+ * This Source Code Form is subject to the terms of the
+ * Mozilla Public License, v. 2.0. If a  copy of the MPL was not distributed
+ * with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
+******************************************************************************/
+ /**
+ * @file           persistence_hm_disk_watch.c
+ * @ingroup        Persistence Health Monitor
+ * @author         Ingo Huerner
+ * @brief          Implementation of the persistence health monitor inotify based change tracking.
+ *                 Every folder below the persistence root gets an inotify watch; events are
+ *                 mapped back to the AppID (the top level folder) they belong to, so only the
+ *                 affected application folders need to be scanned again.
+ * @see
+ */
+
+#include "persistence_hm_definitions.h"
+#include "persistence_hm_disk_watch.h"
+
+#include <sys/inotify.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <errno.h>
+#include <limits.h>
+#include <fcntl.h>
+
+
+/// events that may change the size of an application folder
+#define DISK_WATCH_MASK (IN_CREATE | IN_DELETE | IN_MODIFY | IN_MOVED_FROM | IN_MOVED_TO | IN_ONLYDIR | IN_DONT_FOLLOW)
+
+#define FILE_DIR_NOT_SELF_OR_PARENT(s) ((s)[0]!='.'&&(((s)[1]!='.'||(s)[2]!='\0')||(s)[1]=='\0'))
+
+
+/// one watched folder
+typedef struct WatchEntry_s_
+{
+   /// full path of the folder, NULL if the slot is unused
+   char* path;
+   /// offset of the AppID inside path, 0 for the root folder itself
+   unsigned int appIdOffset;
+} WatchEntry_s;
+
+
+struct DiskWatch_s_
+{
+   /// the inotify instance
+   int fd;
+   /// length of the root path
+   unsigned int rootLen;
+   /// watched folders, indexed by watch descriptor
+   WatchEntry_s* entries;
+   /// number of allocated entries
+   int capacity;
+};
+
+
+// local function prototypes
+static int addWatch(DiskWatch_s* watch, const char* path);
+static int addWatchTree(DiskWatch_s* watch, const char* path);
+static int makeChildPath(char* path, size_t size, const char* parent, const char* name);
+static void removeWatchEntry(DiskWatch_s* watch, int wd);
+static void getAppId(const WatchEntry_s* entry, char* appId, size_t size);
+//----------------------------------------------------------
+
+
+
+DiskWatch_s* diskWatchCreate(const char* rootPath)
+{
+   DiskWatch_s* watch = calloc(1, sizeof(DiskWatch_s));
+
+   if(watch != NULL)
+   {
+      watch->rootLen = strlen(rootPath);
+      watch->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+      if(watch->fd == -1)
+      {
+         DLT_LOG(phmContext, DLT_LOG_WARN, DLT_STRING("diskWatchCreate - inotify_init1 failed:"), DLT_STRING(strerror(errno)));
+         free(watch);
+         return NULL;
+      }
+
+      if(addWatchTree(watch, rootPath) == -1)
+      {
+         diskWatchDestroy(watch);
+         watch = NULL;
+      }
+   }
+
+   return watch;
+}
+
+
+
+void diskWatchDestroy(DiskWatch_s* watch)
+{
+   if(watch != NULL)
+   {
+      int i = 0;
+
+      for(i = 0; i < watch->capacity; i++)
+      {
+         free(watch->entries[i].path);
+      }
+      free(watch->entries);
+
+      close(watch->fd);    // releases all watch descriptors
+      free(watch);
+   }
+}
+
+
+
+int diskWatchGetFd(const DiskWatch_s* watch)
+{
+   return watch->fd;
+}
+
+
+
+int diskWatchProcessEvents(DiskWatch_s* watch, diskWatchCallback_f callback, void* userData)
+{
+   int rval = 0;
+   char buffer[16 * 1024] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+
+   while(rval == 0)
+   {
+      char* ptr = NULL;
+      ssize_t len = read(watch->fd, buffer, sizeof(buffer));
+
+      if(len == -1)
+      {
+         if(errno != EAGAIN && errno != EINTR)
+         {
+            DLT_LOG(phmContext, DLT_LOG_ERROR, DLT_STRING("diskWatchProcessEvents - read failed:"), DLT_STRING(strerror(errno)));
+            rval = -1;
+         }
+         break;   // all events consumed
+      }
+
+      for(ptr = buffer; ptr < buffer + len; ptr += sizeof(struct inotify_event) + ((struct inotify_event*)ptr)->len)
+      {
+         const struct inotify_event* event = (const struct inotify_event*)ptr;
+         WatchEntry_s* entry = NULL;
+         char appId[NAME_MAX+1] = {0};
+
+         if(event->mask & IN_Q_OVERFLOW)
+         {
+            DLT_LOG(phmContext, DLT_LOG_WARN, DLT_STRING("diskWatchProcessEvents - event queue overflow, rescan required"));
+            rval = 1;
+            break;
+         }
+
+         if(event->wd < 0 || event->wd >= watch->capacity || watch->entries[event->wd].path == NULL)
+         {
+            continue;   // event for an already removed watch
+         }
+         entry = &watch->entries[event->wd];
+
+         if(event->mask & IN_IGNORED)
+         {
+            removeWatchEntry(watch, event->wd);
+            continue;
+         }
+
+         if(entry->appIdOffset == 0)
+         {
+            // event in the root folder itself, only folders are applications (not hidden ones, like the full scan)
+            if((event->mask & IN_ISDIR) && event->len > 0 && FILE_DIR_NOT_SELF_OR_PARENT(event->name))
+            {
+               if(event->mask & (IN_CREATE | IN_MOVED_TO))
+               {
+                  char path[PATH_MAX] = {0};
+                  if(   makeChildPath(path, sizeof(path), entry->path, event->name) == -1
+                     || addWatchTree(watch, path) == -1)
+                  {
+                     rval = 1;   // could not watch the new folder, fall back to a rescan
+                  }
+                  callback(event->name, DiskWatch_AppAdded, userData);
+               }
+               else if(event->mask & (IN_DELETE | IN_MOVED_FROM))
+               {
+                  callback(event->name, DiskWatch_AppRemoved, userData);
+               }
+            }
+         }
+         else
+         {
+            if((event->mask & IN_ISDIR) && (event->mask & (IN_CREATE | IN_MOVED_TO)) && event->len > 0)
+            {
+               char path[PATH_MAX] = {0};
+               if(   makeChildPath(path, sizeof(path), entry->path, event->name) == -1
+                  || addWatchTree(watch, path) == -1)
+               {
+                  rval = 1;
+               }
+            }
+
+            // entry may have been moved by the realloc in addWatchTree
+            getAppId(&watch->entries[event->wd], appId, sizeof(appId));
+            callback(appId, ((event->mask & (IN_MODIFY | IN_ISDIR)) == IN_MODIFY) ? DiskWatch_AppModified
+                                                                                : DiskWatch_AppChanged, userData);
+         }
+      }
+   }
+
+   return rval;
+}
+
+
+
+static int addWatch(DiskWatch_s* watch, const char* path)
+{
+   int wd = inotify_add_watch(watch->fd, path, DISK_WATCH_MASK);
+
+   if(wd == -1)
+   {
+      if(errno == ENOENT || errno == ENOTDIR)
+      {
+         return 0;   // folder has already been removed again
+      }
+      DLT_LOG(phmContext, DLT_LOG_WARN, DLT_STRING("diskWatch - inotify_add_watch failed:"), DLT_STRING(path), DLT_STRING(strerror(errno)));
+      return -1;
+   }
+
+   if(wd >= watch->capacity)
+   {
+      int newCapacity = (watch->capacity == 0) ? 256 : watch->capacity;
+      WatchEntry_s* entries = NULL;
+
+      while(newCapacity <= wd)
+      {
+         newCapacity *= 2;
+      }
+
+      entries = realloc(watch->entries, newCapacity * sizeof(WatchEntry_s));
+      if(entries == NULL)
+      {
+         inotify_rm_watch(watch->fd, wd);
+         return -1;
+      }
+      memset(&entries[watch->capacity], 0, (newCapacity - watch->capacity) * sizeof(WatchEntry_s));
+      watch->entries  = entries;
+      watch->capacity = newCapacity;
+   }
+
+   // a folder that has been moved returns its existing watch descriptor, update the path
+   free(watch->entries[wd].path);
+   watch->entries[wd].path = strdup(path);
+   watch->entries[wd].appIdOffset = (strlen(path) > watch->rootLen) ? watch->rootLen + 1 : 0;
+
+   return (watch->entries[wd].path != NULL) ? 0 : -1;
+}
+
+
+
+static int addWatchTree(DiskWatch_s* watch, const char* path)
+{
+   int rval = 0;
+   DIR* dir = NULL;
+
+   if(addWatch(watch, path) == -1)
+   {
+      return -1;
+   }
+
+   dir = opendir(path);
+   if(dir != NULL)
+   {
+      struct dirent* dirent = NULL;
+
+      for(dirent = readdir(dir); NULL != dirent && rval == 0; dirent = readdir(dir))
+      {
+         struct stat buf;
+
+         // some file systems do not fill in d_type
+         if(   FILE_DIR_NOT_SELF_OR_PARENT(dirent->d_name)
+            && (   DT_DIR == dirent->d_type
+                || (   DT_UNKNOWN == dirent->d_type
+                    && fstatat(dirfd(dir), dirent->d_name, &buf, AT_SYMLINK_NOFOLLOW) == 0 && S_ISDIR(buf.st_mode))))
+         {
+            char subPath[PATH_MAX] = {0};
+            rval = makeChildPath(subPath, sizeof(subPath), path, dirent->d_name);
+            if(rval == 0)
+            {
+               rval = addWatchTree(watch, subPath);
+            }
+         }
+      }
+      closedir(dir);
+   }
+
+   return rval;
+}
+
+
+
+static int makeChildPath(char* path, size_t size, const char* parent, const char* name)
+{
+   int len = snprintf(path, size, "%s/%s", parent, name);
+
+   // a truncated path would name another (usually missing) folder, the subtree would not be watched
+   if(len < 0 || (size_t)len >= size)
+   {
+      DLT_LOG(phmContext, DLT_LOG_WARN, DLT_STRING("diskWatch - path too long, not watched:"), DLT_STRING(parent),
+                                        DLT_STRING(name));
+      return -1;
+   }
+   return 0;
+}
+
+
+
+static void removeWatchEntry(DiskWatch_s* watch, int wd)
+{
+   free(watch->entries[wd].path);
+   watch->entries[wd].path = NULL;
+   watch->entries[wd].appIdOffset = 0;
+}
+
+
+
+static void getAppId(const WatchEntry_s* entry, char* appId, size_t size)
+{
+   const char* start = entry->path + entry->appIdOffset;
+   size_t len = strcspn(start, "/");
+
+   if(len >= size)
+   {
+      len = size - 1;
+   }
+   memcpy(appId, start, len);
+   appId[len] = '\0';
+}
@@ -0,0 +1,88 @@
+#ifndef PERSISTENCE_HM_DISK_WATCH_H_
+#define PERSISTENCE_HM_DISK_WATCH_H_
+
+/******************************************************************************
+ * Project         Persistency
+ * (c) copyright   2014
+ * Company         XS Embedded GmbH
+ *****************************************************************************/
+/******************************************************************************
+ * This Source Code Form is subject to the terms of the
+ * Mozilla Public License, v. 2.0. If a  copy of the MPL was not distributed
+ * with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
+******************************************************************************/
+ /**
+ * @file           persistence_hm_disk_watch.h
+ * @ingroup        Persistence Health Monitor
+ * @author         Ingo Huerner
+ * @brief          Header of the persistence health monitor inotify based change tracking.
+ * @see
+ */
+
+
+/// change types reported by the disk watch
+typedef enum DiskWatchEvent_e_
+{
+   /// content of an application folder has changed
+   DiskWatch_AppChanged = 0,
+   /// a new application folder has been created below the root
+   DiskWatch_AppAdded,
+   /// an application folder has been removed from the root
+   DiskWatch_AppRemoved,
+   /// a file of an application folder has been written; unlike the other changes
+   /// this does not update the times of the folder containing the file
+   DiskWatch_AppModified
+
+} DiskWatchEvent_e;
+
+
+/// the disk watch handle (one per watched root folder)
+typedef struct DiskWatch_s_ DiskWatch_s;
+
+
+/// callback to report a change of an application folder
+typedef void (*diskWatchCallback_f)(const char* appId, DiskWatchEvent_e event, void* userData);
+
+
+/**
+ * @brief Create an inotify watch on the root folder and all its sub folders
+ *
+ * @param rootPath the persistence root folder; the top level folders are the AppIDs
+ *
+ * @return the watch handle or NULL if inotify is not available or the watch limit has been reached
+ */
+DiskWatch_s* diskWatchCreate(const char* rootPath);
+
+
+/**
+ * @brief Release the watch and all kernel watch descriptors
+ *
+ * @param watch the watch handle
+ */
+void diskWatchDestroy(DiskWatch_s* watch);
+
+
+/**
+ * @brief Get the file descriptor to be poll()'ed for change events
+ *
+ * @param watch the watch handle
+ *
+ * @return the inotify file descriptor
+ */
+int diskWatchGetFd(const DiskWatch_s* watch);
+
+
+/**
+ * @brief Read all pending change events and report them through the callback.
+ *        New sub folders are added to the watch on the fly.
+ *
+ * @param watch the watch handle
+ * @param callback function called for every changed, added or removed application folder
+ * @param userData passed to the callback
+ *
+ * @return 0 on success, 1 if the kernel event queue overflowed (a full rescan is required), -1 on error
+ */
+int diskWatchProcessEvents(DiskWatch_s* watch, diskWatchCallback_f callback, void* userData);
+
+
+#endif /* PERSISTENCE_HM_DISK_WATCH_H_ */
@@ -0,0 +1,111 @@
+/******************************************************************************
+ * Project         Persistency
+ * (c) copyright   2014
+ * Company         XS Embedded GmbH
+ *****************************************************************************/
+/******************************************************************************
+ * This Source Code Form is subject to the terms of the
+ * Mozilla Public License, v. 2.0. If a  copy of the MPL was not distributed
+ * with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
+******************************************************************************/
+ /**
+ * @file           persistence_hm_forecast.c
+ * @ingroup        Persistence Health Monitor
+ * @author         Ingo Huerner
+ * @brief          Implementation of the persistence health monitor usage forecast.
+ *                 Times and sizes are taken relative to the newest sample before the
+ *                 regression, so the sums stay small enough for a double.
+ * @see
+ */
+
+#include "persistence_hm_forecast.h"
+
+
+
+void forecastAddSample(ForecastHistory_s* history, long long timeMs, unsigned long long size)
+{
+   if(history->count > 0)
+   {
+      int newest = (history->next + FORECAST_HISTORY_SIZE - 1) % FORECAST_HISTORY_SIZE;
+      if(history->samples[newest].timeMs == timeMs)
+      {
+         history->samples[newest].size = size;
+         return;
+      }
+   }
+
+   history->samples[history->next].timeMs = timeMs;
+   history->samples[history->next].size   = size;
+   history->next = (history->next + 1) % FORECAST_HISTORY_SIZE;
+   if(history->count < FORECAST_HISTORY_SIZE)
+   {
+      history->count++;
+   }
+}
+
+
+
+int forecastGetGrowth(const ForecastHistory_s* history, double* rate)
+{
+   int i = 0;
+   int newest = (history->next + FORECAST_HISTORY_SIZE - 1) % FORECAST_HISTORY_SIZE;
+   double sumT = 0.0, sumS = 0.0, sumTT = 0.0, sumTS = 0.0, denominator = 0.0;
+   double n = (double)history->count;
+
+   if(history->count < 2)
+   {
+      return -1;
+   }
+
+   for(i = 0; i < history->count; i++)
+   {
+      const ForecastSample_s* sample = &history->samples[(newest + FORECAST_HISTORY_SIZE - i) % FORECAST_HISTORY_SIZE];
+      double t = (double)(sample->timeMs - history->samples[newest].timeMs) / 1000.0;
+      double s = (double)sample->size - (double)history->samples[newest].size;
+
+      sumT  += t;
+      sumS  += s;
+      sumTT += t * t;
+      sumTS += t * s;
+   }
+
+   denominator = n * sumTT - sumT * sumT;
+   if(denominator <= 0.0)
+   {
+      return -1;     // all samples at the same time
+   }
+
+   *rate = (n * sumTS - sumT * sumS) / denominator;
+
+   return 0;
+}
+
+
+
+long long forecastTimeToLimit(const ForecastHistory_s* history, long long nowMs, unsigned long long limit)
+{
+   int newest = (history->next + FORECAST_HISTORY_SIZE - 1) % FORECAST_HISTORY_SIZE;
+   const ForecastSample_s* last = &history->samples[newest];
+   double rate = 0.0;
+   double remaining = 0.0;
+
+   if(history->count == 0)
+   {
+      return -1;
+   }
+
+   if(last->size >= limit)
+   {
+      return 0;
+   }
+
+   if(forecastGetGrowth(history, &rate) == -1 || rate <= 0.0)
+   {
+      return -1;
+   }
+
+   // extrapolate from the newest sample, the time since then is already gone
+   remaining = (double)(limit - last->size) * 1000.0 / rate - (double)(nowMs - last->timeMs);
+
+   return (remaining > 0.0) ? (long long)remaining : 0;
+}
@@ -0,0 +1,85 @@
+#ifndef PERSISTENCE_HM_FORECAST_H_
+#define PERSISTENCE_HM_FORECAST_H_
+
+/******************************************************************************
+ * Project         Persistency
+ * (c) copyright   2014
+ * Company         XS Embedded GmbH
+ *****************************************************************************/
+/******************************************************************************
+ * This Source Code Form is subject to the terms of the
+ * Mozilla Public License, v. 2.0. If a  copy of the MPL was not distributed
+ * with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
+******************************************************************************/
+ /**
+ * @file           persistence_hm_forecast.h
+ * @ingroup        Persistence Health Monitor
+ * @author         Ingo Huerner
+ * @brief          Header of the persistence health monitor usage forecast.
+ *                 A short history of usage samples is kept per application (and for the
+ *                 partition); the growth is the least squares slope of the history and
+ *                 gives the predicted time until the usage reaches a limit.
+ * @see
+ */
+
+
+/// number of samples kept in a history
+#define FORECAST_HISTORY_SIZE 16
+
+
+/// one usage sample
+typedef struct ForecastSample_s_
+{
+   /// time of the sample [ms, CLOCK_MONOTONIC]
+   long long timeMs;
+   /// the usage in bytes
+   unsigned long long size;
+} ForecastSample_s;
+
+
+/// the usage history (ring buffer, the oldest sample is overwritten)
+typedef struct ForecastHistory_s_
+{
+   ForecastSample_s samples[FORECAST_HISTORY_SIZE];
+   /// index of the next sample to write
+   int next;
+   /// number of valid samples
+   int count;
+} ForecastHistory_s;
+
+
+/**
+ * @brief Add a sample, a sample taken at the same time as the newest one replaces it
+ *
+ * @param history the history
+ * @param timeMs time of the sample
+ * @param size the usage
+ */
+void forecastAddSample(ForecastHistory_s* history, long long timeMs, unsigned long long size);
+
+
+/**
+ * @brief Get the growth of the usage
+ *
+ * @param history the history
+ * @param rate [out] least squares slope of the history [bytes/s], negative if shrinking
+ *
+ * @return 0 on success, -1 if the history has less than two samples at different times
+ */
+int forecastGetGrowth(const ForecastHistory_s* history, double* rate);
+
+
+/**
+ * @brief Predict when the usage reaches a limit
+ *
+ * @param history the history
+ * @param nowMs the current time
+ * @param limit the limit in bytes
+ *
+ * @return time until the limit is reached [ms], 0 if already reached,
+ *         -1 if the usage does not grow (or there is no estimate yet)
+ */
+long long forecastTimeToLimit(const ForecastHistory_s* history, long long nowMs, unsigned long long limit);
+
+
+#endif /* PERSISTENCE_HM_FORECAST_H_ */
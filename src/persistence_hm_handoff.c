@@ -0,0 +1,118 @@
+/******************************************************************************
+ * Project         Persistency
+ * (c) copyright   2014
+ * Company         XS Embedded GmbH
+ *****************************************************************************/
+/******************************************************************************
+ * This Source Code Form is subject to the terms of the
+ * Mozilla Public License, v. 2.0. If a  copy of the MPL was not distributed
+ * with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
+******************************************************************************/
+ /**
+ * @file           persistence_hm_handoff.c
+ * @ingroup        Persistence Health Monitor
+ * @author         Ingo Huerner
+ * @brief          Implementation of the persistence health monitor version handoff.
+ *                 The reader checks for a new version once per loop, so a mutex is
+ *                 cheap enough; the writer sleeps on a condition variable until the
+ *                 reader has taken the version over.
+ * @see
+ */
+
+#include "persistence_hm_handoff.h"
+
+#include <stddef.h>
+
+
+
+void handoffInit(Handoff_s* handoff, void* first)
+{
+   pthread_mutex_lock(&handoff->mutex);
+   handoff->newest    = first;
+   handoff->published = 0;
+   handoff->current   = 0;
+   handoff->stopped   = 0;
+   pthread_mutex_unlock(&handoff->mutex);
+}
+
+
+
+void* handoffPublish(Handoff_s* handoff, void* version, unsigned int* generation)
+{
+   void* previous = NULL;
+
+   pthread_mutex_lock(&handoff->mutex);
+   previous = handoff->newest;
+   handoff->newest = version;
+   *generation = ++handoff->published;
+   pthread_mutex_unlock(&handoff->mutex);
+
+   return previous;
+}
+
+
+
+int handoffWaitAdopted(Handoff_s* handoff, unsigned int generation)
+{
+   int rval = 0;
+
+   pthread_mutex_lock(&handoff->mutex);
+   while(handoff->current != generation && handoff->stopped == 0)
+   {
+      pthread_cond_wait(&handoff->adopted, &handoff->mutex);
+   }
+   rval = (handoff->current == generation) ? 0 : -1;
+   pthread_mutex_unlock(&handoff->mutex);
+
+   return rval;
+}
+
+
+
+void* handoffGetNewer(Handoff_s* handoff, unsigned int* generation)
+{
+   void* version = NULL;
+
+   pthread_mutex_lock(&handoff->mutex);
+   if(handoff->published != handoff->current)
+   {
+      version     = handoff->newest;
+      *generation = handoff->published;
+   }
+   pthread_mutex_unlock(&handoff->mutex);
+
+   return version;
+}
+
+
+
+void handoffAdopt(Handoff_s* handoff, unsigned int generation)
+{
+   pthread_mutex_lock(&handoff->mutex);
+   handoff->current = generation;
+   pthread_cond_broadcast(&handoff->adopted);
+   pthread_mutex_unlock(&handoff->mutex);
+}
+
+
+
+void handoffStop(Handoff_s* handoff)
+{
+   pthread_mutex_lock(&handoff->mutex);
+   handoff->stopped = 1;
+   pthread_cond_broadcast(&handoff->adopted);
+   pthread_mutex_unlock(&handoff->mutex);
+}
+
+
+
+void* handoffClose(Handoff_s* handoff)
+{
+   void* newest = handoff->newest;
+
+   handoff->newest = NULL;
+   pthread_cond_destroy(&handoff->adopted);
+   pthread_mutex_destroy(&handoff->mutex);
+
+   return newest;
+}
@@ -0,0 +1,123 @@
+#ifndef PERSISTENCE_HM_HANDOFF_H_
+#define PERSISTENCE_HM_HANDOFF_H_
+
+/******************************************************************************
+ * Project         Persistency
+ * (c) copyright   2014
+ * Company         XS Embedded GmbH
+ *****************************************************************************/
+/******************************************************************************
+ * This Source Code Form is subject to the terms of the
+ * Mozilla Public License, v. 2.0. If a  copy of the MPL was not distributed
+ * with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
+******************************************************************************/
+ /**
+ * @file           persistence_hm_handoff.h
+ * @ingroup        Persistence Health Monitor
+ * @author         Ingo Huerner
+ * @brief          Header of the persistence health monitor version handoff.
+ *                 A writer thread publishes new versions of read only data (e.g. the
+ *                 configured sizes), a reader thread takes them over at a point of its
+ *                 choice. Every version gets a generation number; the writer waits until
+ *                 the reader has adopted a generation before it releases the older version.
+ * @see
+ */
+
+#include <pthread.h>
+
+
+/// the handoff between one writer and one reader
+typedef struct Handoff_s_
+{
+   /// protects the fields below
+   pthread_mutex_t mutex;
+   /// signalled when the reader adopts a generation or stops
+   pthread_cond_t adopted;
+   /// the newest version
+   void* newest;
+   /// generation of the newest version, 0 = the first one
+   unsigned int published;
+   /// generation the reader uses
+   unsigned int current;
+   /// 1 once the reader has stopped, it does not reference any version then
+   int stopped;
+
+} Handoff_s;
+
+
+/// initializer of a handoff without a version
+#define HANDOFF_INITIALIZER { PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, NULL, 0, 0, 0 }
+
+
+/**
+ * @brief Set the first version (generation 0), before the reader and the writer run
+ *
+ * @param handoff the handoff
+ * @param first the version the reader starts with
+ */
+void handoffInit(Handoff_s* handoff, void* first);
+
+
+/**
+ * @brief Publish a new version (writer)
+ *
+ * @param handoff the handoff
+ * @param version the new version
+ * @param generation [out] the generation of the new version
+ *
+ * @return the previous version; it must not be released before handoffWaitAdopted returns
+ */
+void* handoffPublish(Handoff_s* handoff, void* version, unsigned int* generation);
+
+
+/**
+ * @brief Wait until the reader uses a generation (writer).
+ *        Afterwards the reader does not reference an older version any more.
+ *
+ * @param handoff the handoff
+ * @param generation the generation returned by handoffPublish
+ *
+ * @return 0 if the reader has adopted the generation, -1 if it has stopped
+ */
+int handoffWaitAdopted(Handoff_s* handoff, unsigned int generation);
+
+
+/**
+ * @brief Get a version newer than the one the reader uses (reader)
+ *
+ * @param handoff the handoff
+ * @param generation [out] the generation of the version
+ *
+ * @return the newest version or NULL if the reader uses it already
+ */
+void* handoffGetNewer(Handoff_s* handoff, unsigned int* generation);
+
+
+/**
+ * @brief Tell the writer that the reader uses a generation now (reader)
+ *
+ * @param handoff the handoff
+ * @param generation the generation returned by handoffGetNewer
+ */
+void handoffAdopt(Handoff_s* handoff, unsigned int generation);
+
+
+/**
+ * @brief Tell the writer that the reader has stopped and references no version (reader)
+ *
+ * @param handoff the handoff
+ */
+void handoffStop(Handoff_s* handoff);
+
+
+/**
+ * @brief Release a handoff, after the reader and the writer have ended
+ *
+ * @param handoff the handoff
+ *
+ * @return the newest version, to be released by the caller
+ */
+void* handoffClose(Handoff_s* handoff);
+
+
+#endif /* PERSISTENCE_HM_HANDOFF_H_ */
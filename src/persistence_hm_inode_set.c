@@ -0,0 +1,168 @@
+/******************************************************************************
+ * Project         Persistency
+ * (c) copyright   2014
+ * Company         XS Embedded GmbH
+ *****************************************************************************/
+/******************************************************************************
+ * This Source Code Form is subject to the terms of the
+ * Mozilla Public License, v. 2.0. If a  copy of the MPL was not distributed
+ * with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
+******************************************************************************/
+ /**
+ * @file           persistence_hm_inode_set.c
+ * @ingroup        Persistence Health Monitor
+ * @author         Ingo Huerner
+ * @brief          Implementation of the persistence health monitor inode set.
+ *                 Open addressing with linear probing over a flat array of
+ *                 (inode, device) pairs; inode 0 marks an unused slot.
+ *                 Most trees have no hard links at all, so the table starts small
+ *                 and clearing an empty set costs nothing.
+ * @see
+ */
+
+#include "persistence_hm_definitions.h"
+#include "persistence_hm_inode_set.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/// initial number of slots, must be a power of two
+#define INODE_SET_INITIAL_CAPACITY 64
+
+
+/// one inode, inode number 0 (not used by the file systems) marks a free slot
+typedef struct InodeKey_s_
+{
+   uint64_t ino;
+   uint64_t dev;
+} InodeKey_s;
+
+
+struct InodeSet_s_
+{
+   InodeKey_s* keys;
+   /// number of slots, power of two
+   uint32_t capacity;
+   /// number of used slots
+   uint32_t count;
+};
+
+
+// local function prototypes
+static InodeKey_s* findSlot(InodeKey_s* keys, uint32_t capacity, uint64_t dev, uint64_t ino);
+static int grow(InodeSet_s* set);
+//----------------------------------------------------------
+
+
+
+InodeSet_s* inodeSetCreate(void)
+{
+   InodeSet_s* set = calloc(1, sizeof(InodeSet_s));
+
+   if(set != NULL)
+   {
+      set->keys = calloc(INODE_SET_INITIAL_CAPACITY, sizeof(InodeKey_s));
+      if(set->keys == NULL)
+      {
+         free(set);
+         return NULL;
+      }
+      set->capacity = INODE_SET_INITIAL_CAPACITY;
+   }
+   return set;
+}
+
+
+
+void inodeSetDestroy(InodeSet_s* set)
+{
+   if(set != NULL)
+   {
+      free(set->keys);
+      free(set);
+   }
+}
+
+
+
+void inodeSetClear(InodeSet_s* set)
+{
+   if(set->count > 0)
+   {
+      memset(set->keys, 0, set->capacity * sizeof(InodeKey_s));
+      set->count = 0;
+   }
+}
+
+
+
+int inodeSetInsert(InodeSet_s* set, dev_t dev, ino_t ino)
+{
+   InodeKey_s* key = NULL;
+
+   // keep the load factor below 1/2, the probes stay short
+   if((set->count + 1) * 2 > set->capacity && grow(set) == -1)
+   {
+      return -1;
+   }
+
+   key = findSlot(set->keys, set->capacity, (uint64_t)dev, (uint64_t)ino);
+   if(key->ino != 0)
+   {
+      return 0;
+   }
+
+   key->ino = (uint64_t)ino;
+   key->dev = (uint64_t)dev;
+   set->count++;
+
+   return 1;
+}
+
+
+
+static InodeKey_s* findSlot(InodeKey_s* keys, uint32_t capacity, uint64_t dev, uint64_t ino)
+{
+   uint32_t mask = capacity - 1;
+   uint64_t h = ino ^ (dev * 0x9E3779B97F4A7C15ull);
+   uint32_t i = 0;
+
+   h ^= h >> 33;
+   h *= 0xFF51AFD7ED558CCDull;
+   h ^= h >> 33;
+
+   for(i = (uint32_t)h & mask; keys[i].ino != 0 && (keys[i].ino != ino || keys[i].dev != dev); i = (i + 1) & mask);
+
+   return &keys[i];
+}
+
+
+
+static int grow(InodeSet_s* set)
+{
+   uint32_t i = 0;
+   uint32_t capacity = set->capacity * 2;
+   InodeKey_s* keys = calloc(capacity, sizeof(InodeKey_s));
+
+   if(keys == NULL)
+   {
+      DLT_LOG(phmContext, DLT_LOG_ERROR, DLT_STRING("inodeSet - out of memory"));
+      return -1;
+   }
+
+   for(i = 0; i < set->capacity; i++)
+   {
+      if(set->keys[i].ino != 0)
+      {
+         *findSlot(keys, capacity, set->keys[i].dev, set->keys[i].ino) = set->keys[i];
+      }
+   }
+
+   free(set->keys);
+   set->keys     = keys;
+   set->capacity = capacity;
+
+   return 0;
+}
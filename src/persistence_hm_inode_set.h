@@ -0,0 +1,68 @@
+#ifndef PERSISTENCE_HM_INODE_SET_H_
+#define PERSISTENCE_HM_INODE_SET_H_
+
+/******************************************************************************
+ * Project         Persistency
+ * (c) copyright   2014
+ * Company         XS Embedded GmbH
+ *****************************************************************************/
+/******************************************************************************
+ * This Source Code Form is subject to the terms of the
+ * Mozilla Public License, v. 2.0. If a  copy of the MPL was not distributed
+ * with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
+******************************************************************************/
+ /**
+ * @file           persistence_hm_inode_set.h
+ * @ingroup        Persistence Health Monitor
+ * @author         Ingo Huerner
+ * @brief          Header of the persistence health monitor inode set.
+ *                 Remembers the files with more than one hard link seen by a scan,
+ *                 so every inode is counted only once.
+ * @see
+ */
+
+#include <sys/types.h>
+
+
+/// the inode set (not thread safe)
+typedef struct InodeSet_s_ InodeSet_s;
+
+
+/**
+ * @brief Create an empty set
+ *
+ * @return the set or NULL if memory is exhausted
+ */
+InodeSet_s* inodeSetCreate(void);
+
+
+/**
+ * @brief Release a set
+ *
+ * @param set the set
+ */
+void inodeSetDestroy(InodeSet_s* set);
+
+
+/**
+ * @brief Remove all inodes, the memory is kept for the next scan
+ *
+ * @param set the set
+ */
+void inodeSetClear(InodeSet_s* set);
+
+
+/**
+ * @brief Add an inode
+ *
+ * @param set the set
+ * @param dev the device of the inode
+ * @param ino the inode number
+ *
+ * @return 1 if the inode has been added, 0 if it has already been in the set,
+ *         -1 if memory is exhausted
+ */
+int inodeSetInsert(InodeSet_s* set, dev_t dev, ino_t ino);
+
+
+#endif /* PERSISTENCE_HM_INODE_SET_H_ */
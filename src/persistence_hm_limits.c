@@ -0,0 +1,407 @@
+/******************************************************************************
+ * Project         Persistency
+ * (c) copyright   2014
+ * Company         XS Embedded GmbH
+ *****************************************************************************/
+/******************************************************************************
+ * This Source Code Form is subject to the terms of the
+ * Mozilla Public License, v. 2.0. If a  copy of the MPL was not distributed
+ * with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
+******************************************************************************/
+ /**
+ * @file           persistence_hm_limits.c
+ * @ingroup        Persistence Health Monitor
+ * @author         Ingo Huerner
+ * @brief          Implementation of the persistence health monitor limits table.
+ *                 The entries are kept in one array in the order of the configuration
+ *                 file, their AppIDs one after the other in one name arena. Sealing
+ *                 builds an open addressing index (linear probing, load factor below
+ *                 1/2) of (upper half of the hash, entry number) pairs, 8 of them per
+ *                 cache line. A lookup reads one or two lines of the index, the entry
+ *                 and, to rule out a hash collision, the AppID in the arena.
+ *                 The image of a table is a header followed by the three arrays, so a
+ *                 table taken from an image only points into it.
+ * @see
+ */
+
+#include "persistence_hm_definitions.h"
+#include "persistence_hm_limits.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/// initial number of entries, the array grows while the configuration file is read
+#define LIMITS_INITIAL_ENTRIES 16
+/// initial size of the name arena
+#define LIMITS_INITIAL_NAMES 512
+
+
+/// start of the image of a table, followed by the entries, the slots and the names
+typedef struct LimitsImage_s_
+{
+   uint32_t count;
+   uint32_t slotCount;
+   uint32_t namesSize;
+   uint32_t reserved;
+} LimitsImage_s;
+
+
+/// size rounded up to a multiple of 8
+#define LIMITS_ALIGN(size) (((size) + 7) & ~(size_t)7)
+
+
+/// one slot of the index
+typedef struct LimitsSlot_s_
+{
+   /// upper 32 bits of the hash, the lower ones select the slot
+   uint32_t tag;
+   /// entry number + 1, 0 = unused slot
+   uint32_t entry;
+} LimitsSlot_s;
+
+
+struct LimitsTable_s_
+{
+   /// the entries in the order they have been added
+   LimitsEntry_s* entries;
+   uint32_t count;
+   uint32_t capacity;
+   /// the AppIDs of the entries, each 0 terminated
+   char* names;
+   uint32_t namesSize;
+   uint32_t namesCapacity;
+   /// the index, NULL until the table is sealed
+   LimitsSlot_s* slots;
+   /// number of slots - 1, the number of slots is a power of two
+   uint32_t mask;
+   /// 1 if the arrays point into an image and are not owned by the table
+   int fromImage;
+};
+
+
+// local function prototypes
+static uint32_t getSlot(const LimitsTable_s* table, const char* appId, size_t len, uint64_t hash);
+static int reserve(void** buffer, uint32_t* capacity, uint32_t needed, uint32_t initial, size_t itemSize);
+static int checkImage(const LimitsImage_s* header, const LimitsEntry_s* entries, const LimitsSlot_s* slots, const char* names);
+//----------------------------------------------------------
+
+
+
+unsigned long long limitsHash(const char* appId)
+{
+   // FNV-1a over the bytes, then the finalizer of MurmurHash3 so every input bit reaches the upper half
+   uint64_t h = 0xCBF29CE484222325ull;
+
+   while(*appId != '\0')
+   {
+      h ^= (unsigned char)*appId++;
+      h *= 0x100000001B3ull;
+   }
+
+   h ^= h >> 33;
+   h *= 0xFF51AFD7ED558CCDull;
+   h ^= h >> 33;
+   h *= 0xC4CEB9FE1A85EC53ull;
+   h ^= h >> 33;
+
+   return h;
+}
+
+
+
+LimitsTable_s* limitsTableCreate(void)
+{
+   return calloc(1, sizeof(LimitsTable_s));
+}
+
+
+
+void limitsTableDestroy(LimitsTable_s* table)
+{
+   if(table != NULL)
+   {
+      if(table->fromImage == 0)
+      {
+         free(table->entries);
+         free(table->names);
+         free(table->slots);
+      }
+      free(table);
+   }
+}
+
+
+
+int limitsTableAdd(LimitsTable_s* table, const char* appId, unsigned long long size, unsigned long long inodes)
+{
+   LimitsEntry_s* entry = NULL;
+   size_t len = strlen(appId);
+
+   if(table->slots != NULL)
+   {
+      return -1;     // sealed
+   }
+
+   if(   len >= UINT32_MAX - table->namesSize
+      || reserve((void**)&table->entries, &table->capacity, table->count + 1, LIMITS_INITIAL_ENTRIES, sizeof(LimitsEntry_s)) == -1
+      || reserve((void**)&table->names, &table->namesCapacity, table->namesSize + (uint32_t)len + 1, LIMITS_INITIAL_NAMES, 1) == -1)
+   {
+      DLT_LOG(phmContext, DLT_LOG_ERROR, DLT_STRING("limitsTable - out of memory"));
+      return -1;
+   }
+
+   entry = &table->entries[table->count++];
+   entry->hash       = limitsHash(appId);
+   entry->nameOffset = table->namesSize;
+   entry->nameLength = (unsigned int)len;
+   entry->size       = size;
+   entry->inodes     = inodes;
+
+   memcpy(table->names + table->namesSize, appId, len + 1);
+   table->namesSize += (uint32_t)len + 1;
+
+   return 0;
+}
+
+
+
+int limitsTableSeal(LimitsTable_s* table)
+{
+   uint32_t i = 0, slotCount = 8;
+
+   if(table->slots != NULL)
+   {
+      return 0;
+   }
+
+   while(slotCount < table->count * 2)
+   {
+      slotCount *= 2;
+   }
+
+   table->slots = calloc(slotCount, sizeof(LimitsSlot_s));
+   if(table->slots == NULL)
+   {
+      DLT_LOG(phmContext, DLT_LOG_ERROR, DLT_STRING("limitsTable - out of memory"));
+      return -1;
+   }
+   table->mask = slotCount - 1;
+
+   for(i = 0; i < table->count; i++)
+   {
+      const LimitsEntry_s* entry = &table->entries[i];
+      LimitsSlot_s* slot = &table->slots[getSlot(table, table->names + entry->nameOffset, entry->nameLength, entry->hash)];
+
+      if(slot->entry == 0)      // a later entry of the same application is ignored
+      {
+         slot->tag   = (uint32_t)(entry->hash >> 32);
+         slot->entry = i + 1;
+      }
+   }
+
+   return 0;
+}
+
+
+
+const LimitsEntry_s* limitsTableFind(const LimitsTable_s* table, const char* appId, unsigned long long hash)
+{
+   const LimitsSlot_s* slot = NULL;
+
+   if(table->slots == NULL)
+   {
+      return NULL;
+   }
+
+   slot = &table->slots[getSlot(table, appId, strlen(appId), hash)];
+
+   return (slot->entry != 0) ? &table->entries[slot->entry - 1] : NULL;
+}
+
+
+
+void limitsParse(const char* value, unsigned long long* size, unsigned long long* inodes)
+{
+   char* end = NULL;
+
+   *size   = strtoull(value, &end, 10);
+   *inodes = (*end == ':') ? strtoull(end + 1, NULL, 10) : 0;
+}
+
+
+
+PhmHealth_e limitsGetHealth(unsigned long long size, unsigned long long maxSize,
+                            unsigned long long inodes, unsigned long long maxInodes)
+{
+   if((maxSize != 0 && size >= maxSize) || (maxInodes != 0 && inodes >= maxInodes))
+   {
+      return PhmHealth_Full;
+   }
+   if((maxSize != 0 && size + size / 10 >= maxSize) || (maxInodes != 0 && inodes + inodes / 10 >= maxInodes))
+   {
+      return PhmHealth_Low;
+   }
+   return PhmHealth_Ok;
+}
+
+
+
+size_t limitsTableGetImageSize(const LimitsTable_s* table)
+{
+   if(table->slots == NULL)
+   {
+      return 0;      // not sealed
+   }
+
+   return   sizeof(LimitsImage_s)
+          + table->count * sizeof(LimitsEntry_s)
+          + (table->mask + 1) * sizeof(LimitsSlot_s)
+          + LIMITS_ALIGN(table->namesSize);
+}
+
+
+
+void limitsTableWriteImage(const LimitsTable_s* table, void* image)
+{
+   LimitsImage_s* header = (LimitsImage_s*)image;
+   char* ptr = (char*)image + sizeof(LimitsImage_s);
+
+   memset(header, 0, sizeof(LimitsImage_s));
+   header->count     = table->count;
+   header->slotCount = table->mask + 1;
+   header->namesSize = table->namesSize;
+
+   memcpy(ptr, table->entries, table->count * sizeof(LimitsEntry_s));
+   ptr += table->count * sizeof(LimitsEntry_s);
+   memcpy(ptr, table->slots, (table->mask + 1) * sizeof(LimitsSlot_s));
+   ptr += (table->mask + 1) * sizeof(LimitsSlot_s);
+   memset(ptr, 0, LIMITS_ALIGN(table->namesSize));
+   memcpy(ptr, table->names, table->namesSize);
+}
+
+
+
+LimitsTable_s* limitsTableFromImage(const void* image, size_t size)
+{
+   const LimitsImage_s* header = (const LimitsImage_s*)image;
+   const char* ptr = (const char*)image + sizeof(LimitsImage_s);
+   LimitsTable_s* table = NULL;
+
+   if(   size < sizeof(LimitsImage_s)
+      || header->slotCount == 0 || (header->slotCount & (header->slotCount - 1)) != 0
+      || (uint64_t)header->count * 2 > header->slotCount
+      || size !=   sizeof(LimitsImage_s) + (size_t)header->count * sizeof(LimitsEntry_s)
+                 + (size_t)header->slotCount * sizeof(LimitsSlot_s) + LIMITS_ALIGN((size_t)header->namesSize))
+   {
+      return NULL;
+   }
+
+   if(checkImage(header, (const LimitsEntry_s*)ptr,
+                 (const LimitsSlot_s*)(ptr + header->count * sizeof(LimitsEntry_s)),
+                 ptr + header->count * sizeof(LimitsEntry_s) + header->slotCount * sizeof(LimitsSlot_s)) == -1)
+   {
+      DLT_LOG(phmContext, DLT_LOG_WARN, DLT_STRING("limitsTable - damaged image"));
+      return NULL;
+   }
+
+   table = calloc(1, sizeof(LimitsTable_s));
+   if(table != NULL)
+   {
+      // the arrays are only read once the table is sealed, so the casts are safe
+      table->fromImage = 1;
+      table->count     = table->capacity = header->count;
+      table->entries   = (LimitsEntry_s*)ptr;
+      ptr += header->count * sizeof(LimitsEntry_s);
+      table->slots     = (LimitsSlot_s*)ptr;
+      table->mask      = header->slotCount - 1;
+      ptr += header->slotCount * sizeof(LimitsSlot_s);
+      table->names     = (char*)ptr;
+      table->namesSize = table->namesCapacity = header->namesSize;
+   }
+   return table;
+}
+
+
+
+static uint32_t getSlot(const LimitsTable_s* table, const char* appId, size_t len, uint64_t hash)
+{
+   uint32_t tag = (uint32_t)(hash >> 32);
+   uint32_t i = (uint32_t)hash & table->mask;
+
+   // the name is only compared when the whole hash matches
+   while(table->slots[i].entry != 0)
+   {
+      const LimitsEntry_s* entry = &table->entries[table->slots[i].entry - 1];
+
+      if(   table->slots[i].tag == tag && entry->hash == hash && entry->nameLength == len
+         && 0 == memcmp(table->names + entry->nameOffset, appId, len))
+      {
+         break;
+      }
+      i = (i + 1) & table->mask;
+   }
+
+   return i;
+}
+
+
+
+static int reserve(void** buffer, uint32_t* capacity, uint32_t needed, uint32_t initial, size_t itemSize)
+{
+   uint32_t newCapacity = (*capacity == 0) ? initial : *capacity;
+   void* newBuffer = NULL;
+
+   if(needed <= *capacity)
+   {
+      return 0;
+   }
+
+   while(newCapacity < needed)
+   {
+      newCapacity *= 2;
+   }
+
+   newBuffer = realloc(*buffer, newCapacity * itemSize);
+   if(newBuffer == NULL)
+   {
+      return -1;
+   }
+   *buffer   = newBuffer;
+   *capacity = newCapacity;
+
+   return 0;
+}
+
+
+
+static int checkImage(const LimitsImage_s* header, const LimitsEntry_s* entries, const LimitsSlot_s* slots, const char* names)
+{
+   uint32_t i = 0, used = 0;
+
+   // every name has to end inside the arena, lookups compare them and the monitor logs them
+   for(i = 0; i < header->count; i++)
+   {
+      if(   (uint64_t)entries[i].nameOffset + entries[i].nameLength >= header->namesSize
+         || names[entries[i].nameOffset + entries[i].nameLength] != '\0')
+      {
+         return -1;
+      }
+   }
+
+   // every slot points to an entry, and a lookup of an unknown AppID needs an empty slot to end
+   for(i = 0; i < header->slotCount; i++)
+   {
+      if(slots[i].entry > header->count)
+      {
+         return -1;
+      }
+      if(slots[i].entry != 0)
+      {
+         used++;
+      }
+   }
+
+   return (used < header->slotCount) ? 0 : -1;
+}
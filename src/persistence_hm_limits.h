@@ -0,0 +1,172 @@
+#ifndef PERSISTENCE_HM_LIMITS_H_
+#define PERSISTENCE_HM_LIMITS_H_
+
+/******************************************************************************
+ * Project         Persistency
+ * (c) copyright   2014
+ * Company         XS Embedded GmbH
+ *****************************************************************************/
+/******************************************************************************
+ * This Source Code Form is subject to the terms of the
+ * Mozilla Public License, v. 2.0. If a  copy of the MPL was not distributed
+ * with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
+******************************************************************************/
+ /**
+ * @file           persistence_hm_limits.h
+ * @ingroup        Persistence Health Monitor
+ * @author         Ingo Huerner
+ * @brief          Header of the persistence health monitor limits table.
+ *                 Holds the configured sizes of the applications of a root. The table
+ *                 is filled while the configuration file is read and sealed afterwards;
+ *                 a sealed table is never changed, a new configuration gets a new table.
+ *                 The AppIDs are kept in the table, so applications whose names share a
+ *                 hash value never share a limit. A sealed table can be stored as an image
+ *                 that is used in place, e.g. mapped from the configuration cache.
+ * @see
+ */
+
+
+#include <stddef.h>
+
+#include "persistence_hm_usage.h"
+
+
+/// the configured limits of one application
+typedef struct LimitsEntry_s_
+{
+   /// 64 bit hash of the AppID (limitsHash)
+   unsigned long long hash;
+   /// position and length of the AppID in the name arena of the table
+   unsigned int nameOffset;
+   unsigned int nameLength;
+   /// maximum size in bytes, 0 = no size limit
+   unsigned long long size;
+   /// maximum number of inodes (files and folders), 0 = no inode limit
+   unsigned long long inodes;
+
+} LimitsEntry_s;
+
+
+/// the limits table (not thread safe while filled, a sealed table may be read by any thread)
+typedef struct LimitsTable_s_ LimitsTable_s;
+
+
+/**
+ * @brief Get the hash of an AppID, computed once per application and passed to limitsTableFind
+ *
+ * @param appId the AppID
+ *
+ * @return the 64 bit hash
+ */
+unsigned long long limitsHash(const char* appId);
+
+
+/**
+ * @brief Create an empty table
+ *
+ * @return the table or NULL if memory is exhausted
+ */
+LimitsTable_s* limitsTableCreate(void);
+
+
+/**
+ * @brief Release a table
+ *
+ * @param table the table
+ */
+void limitsTableDestroy(LimitsTable_s* table);
+
+
+/**
+ * @brief Add the limits of an application, only before the table is sealed.
+ *        If an application is added twice, the first entry is kept.
+ *
+ * @param table the table
+ * @param appId the AppID, copied into the table
+ * @param size maximum size in bytes, 0 = none
+ * @param inodes maximum number of inodes, 0 = none
+ *
+ * @return 0 on success, -1 if memory is exhausted or the table is sealed
+ */
+int limitsTableAdd(LimitsTable_s* table, const char* appId, unsigned long long size, unsigned long long inodes);
+
+
+/**
+ * @brief Build the lookup index, afterwards the table can not be changed
+ *
+ * @param table the table
+ *
+ * @return 0 on success, -1 if memory is exhausted (every lookup fails then)
+ */
+int limitsTableSeal(LimitsTable_s* table);
+
+
+/**
+ * @brief Find the limits of an application, does not allocate memory
+ *
+ * @param table the sealed table
+ * @param appId the AppID
+ * @param hash limitsHash of the AppID
+ *
+ * @return the limits or NULL if the application has none (or the table is not sealed)
+ */
+const LimitsEntry_s* limitsTableFind(const LimitsTable_s* table, const char* appId, unsigned long long hash);
+
+
+/**
+ * @brief Parse the limits of a configuration entry, "<size>" or "<size>:<inodes>"
+ *
+ * @param value the value of the entry
+ * @param size [out] maximum size in bytes
+ * @param inodes [out] maximum number of inodes, 0 if the value has none
+ */
+void limitsParse(const char* value, unsigned long long* size, unsigned long long* inodes);
+
+
+/**
+ * @brief Rate the usage of an application against its limits
+ *
+ * @param size the size in bytes
+ * @param maxSize maximum size, 0 = none
+ * @param inodes the number of inodes
+ * @param maxInodes maximum number of inodes, 0 = none
+ *
+ * @return PhmHealth_Full if a limit is reached, PhmHealth_Low if the size or the inodes are
+ *         within 10 percent of their limit, PhmHealth_Ok otherwise
+ */
+PhmHealth_e limitsGetHealth(unsigned long long size, unsigned long long maxSize,
+                            unsigned long long inodes, unsigned long long maxInodes);
+
+
+/**
+ * @brief Get the size of the image of a table
+ *
+ * @param table the sealed table
+ *
+ * @return the size in bytes, a multiple of 8; 0 if the table is not sealed
+ */
+size_t limitsTableGetImageSize(const LimitsTable_s* table);
+
+
+/**
+ * @brief Store a table as an image
+ *
+ * @param table the sealed table
+ * @param image [out] the image, limitsTableGetImageSize bytes aligned to 8 bytes
+ */
+void limitsTableWriteImage(const LimitsTable_s* table, void* image);
+
+
+/**
+ * @brief Use an image as a sealed table without copying it.
+ *        The image is not checked beyond its layout, it must come from a checksummed file.
+ *
+ * @param image the image aligned to 8 bytes; must stay valid until the table is destroyed
+ * @param size size of the image in bytes
+ *
+ * @return the table or NULL if the layout is invalid or memory is exhausted
+ */
+LimitsTable_s* limitsTableFromImage(const void* image, size_t size);
+
+
+#endif /* PERSISTENCE_HM_LIMITS_H_ */
@@ -0,0 +1,341 @@
+/******************************************************************************
+ * Project         Persistency
+ * (c) copyright   2014
+ * Company         XS Embedded GmbH
+ *****************************************************************************/
+/******************************************************************************
+ * This Source Code Form is subject to the terms of the
+ * Mozilla Public License, v. 2.0. If a  copy of the MPL was not distributed
+ * with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
+******************************************************************************/
+ /**
+ * @file           persistence_hm_quota_events.c
+ * @ingroup        Persistence Health Monitor
+ * @author         Ingo Huerner
+ * @brief          Implementation of the persistence health monitor quota warnings.
+ *                 The id of the "VFS_DQUOT" family and of its "events" multicast group
+ *                 are asked from the generic netlink controller once, afterwards the
+ *                 socket only receives QUOTA_NL_C_WARNING messages.
+ * @see
+ */
+
+#include "persistence_hm_definitions.h"
+#include "persistence_hm_quota_events.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#if defined(HAVE_LINUX_GENETLINK_H)
+#include <linux/quota.h>
+#endif
+
+#if defined(HAVE_LINUX_GENETLINK_H) && defined(QUOTA_NL_BSOFTWARN)
+
+#include <sys/socket.h>
+#include <sys/sysmacros.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <linux/netlink.h>
+#include <linux/genetlink.h>
+
+
+/// receive buffer size, a warning message is about 100 bytes
+#define QUOTA_EVENTS_BUFFER_SIZE 8192
+
+/// name of the generic netlink family of the quota subsystem
+#define QUOTA_NL_FAMILY_NAME "VFS_DQUOT"
+
+/// pointer to the payload of an attribute
+#define QUOTA_NLA_DATA(a) ((const char*)(a) + NLA_HDRLEN)
+
+
+struct QuotaEvents_s_
+{
+   /// the netlink socket
+   int fd;
+   /// the id of the VFS_DQUOT family
+   unsigned short familyId;
+   /// the subscribed file system
+   dev_t device;
+};
+
+
+// local function prototypes
+static int resolveFamily(QuotaEvents_s* events, unsigned int* groupId);
+static void parseAttrs(const void* start, int len, const struct nlattr** table, int max);
+static uint32_t getU32(const struct nlattr* attr);
+//----------------------------------------------------------
+
+
+
+QuotaEvents_s* quotaEventsCreate(dev_t device)
+{
+   unsigned int groupId = 0;
+   struct sockaddr_nl addr;
+   QuotaEvents_s* events = calloc(1, sizeof(QuotaEvents_s));
+
+   if(events == NULL)
+   {
+      return NULL;
+   }
+
+   events->device = device;
+   events->fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_GENERIC);
+
+   memset(&addr, 0, sizeof(addr));
+   addr.nl_family = AF_NETLINK;
+
+   if(   events->fd != -1
+      && bind(events->fd, (struct sockaddr*)&addr, sizeof(addr)) == 0
+      && resolveFamily(events, &groupId) == 0
+      && setsockopt(events->fd, SOL_NETLINK, NETLINK_ADD_MEMBERSHIP, &groupId, sizeof(groupId)) == 0
+      && fcntl(events->fd, F_SETFL, O_NONBLOCK) == 0)
+   {
+      return events;
+   }
+
+   DLT_LOG(phmContext, DLT_LOG_INFO, DLT_STRING("quotaEvents - quota warnings not available:"), DLT_STRING(strerror(errno)));
+   quotaEventsDestroy(events);
+
+   return NULL;
+}
+
+
+
+void quotaEventsDestroy(QuotaEvents_s* events)
+{
+   if(events != NULL)
+   {
+      if(events->fd != -1)
+      {
+         close(events->fd);
+      }
+      free(events);
+   }
+}
+
+
+
+int quotaEventsGetFd(const QuotaEvents_s* events)
+{
+   return events->fd;
+}
+
+
+
+int quotaEventsProcess(QuotaEvents_s* events, quotaEventCallback_f callback, void* userData)
+{
+   char buffer[QUOTA_EVENTS_BUFFER_SIZE] __attribute__ ((aligned(NLMSG_ALIGNTO)));
+   ssize_t len = 0;
+
+   while((len = recv(events->fd, buffer, sizeof(buffer), 0)) > 0)
+   {
+      const struct nlmsghdr* msg = NULL;
+      int remaining = (int)len;
+
+      for(msg = (const struct nlmsghdr*)buffer; NLMSG_OK(msg, remaining); msg = NLMSG_NEXT(msg, remaining))
+      {
+         const struct genlmsghdr* genl = (const struct genlmsghdr*)NLMSG_DATA(msg);
+         const struct nlattr* attrs[QUOTA_NL_A_MAX + 1];
+
+         if(   msg->nlmsg_type != events->familyId || genl->cmd != QUOTA_NL_C_WARNING
+            || msg->nlmsg_len < NLMSG_LENGTH(GENL_HDRLEN))
+         {
+            continue;
+         }
+
+         parseAttrs((const char*)genl + GENL_HDRLEN, (int)(msg->nlmsg_len - NLMSG_LENGTH(GENL_HDRLEN)), attrs, QUOTA_NL_A_MAX);
+
+         if(   attrs[QUOTA_NL_A_QTYPE] != NULL && attrs[QUOTA_NL_A_EXCESS_ID] != NULL && attrs[QUOTA_NL_A_WARNING] != NULL
+            && attrs[QUOTA_NL_A_DEV_MAJOR] != NULL && attrs[QUOTA_NL_A_DEV_MINOR] != NULL
+            && getU32(attrs[QUOTA_NL_A_QTYPE]) == PRJQUOTA
+            && makedev(getU32(attrs[QUOTA_NL_A_DEV_MAJOR]), getU32(attrs[QUOTA_NL_A_DEV_MINOR])) == events->device)
+         {
+            uint64_t projectId = 0;
+            memcpy(&projectId, QUOTA_NLA_DATA(attrs[QUOTA_NL_A_EXCESS_ID]), sizeof(projectId));
+
+            // the inode warnings are reported like the block warnings, the next scan tells which limit
+            switch(getU32(attrs[QUOTA_NL_A_WARNING]))
+            {
+               case QUOTA_NL_BSOFTWARN:
+               case QUOTA_NL_ISOFTWARN:
+                  callback((unsigned int)projectId, QuotaEvent_SoftExceeded, userData);
+                  break;
+               case QUOTA_NL_BSOFTLONGWARN:
+               case QUOTA_NL_ISOFTLONGWARN:
+                  callback((unsigned int)projectId, QuotaEvent_GraceExpired, userData);
+                  break;
+               case QUOTA_NL_BHARDWARN:
+               case QUOTA_NL_IHARDWARN:
+                  callback((unsigned int)projectId, QuotaEvent_HardReached, userData);
+                  break;
+               case QUOTA_NL_BSOFTBELOW:
+               case QUOTA_NL_ISOFTBELOW:
+                  callback((unsigned int)projectId, QuotaEvent_BelowSoft, userData);
+                  break;
+               case QUOTA_NL_BHARDBELOW:
+               case QUOTA_NL_IHARDBELOW:
+                  callback((unsigned int)projectId, QuotaEvent_BelowHard, userData);
+                  break;
+               default:
+                  break;
+            }
+         }
+      }
+   }
+
+   if(len == -1 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+   {
+      if(errno == ENOBUFS)
+      {
+         return 1;   // the socket overflowed, warnings are lost
+      }
+      DLT_LOG(phmContext, DLT_LOG_ERROR, DLT_STRING("quotaEvents - recv failed:"), DLT_STRING(strerror(errno)));
+      return -1;
+   }
+
+   return 0;
+}
+
+
+
+static int resolveFamily(QuotaEvents_s* events, unsigned int* groupId)
+{
+   struct
+   {
+      struct nlmsghdr msg;
+      struct genlmsghdr genl;
+      char attrs[NLA_HDRLEN + NLA_ALIGN(sizeof(QUOTA_NL_FAMILY_NAME))];
+   } request;
+   char buffer[QUOTA_EVENTS_BUFFER_SIZE] __attribute__ ((aligned(NLMSG_ALIGNTO)));
+   struct nlattr* name = (struct nlattr*)request.attrs;
+   const struct nlmsghdr* reply = (const struct nlmsghdr*)buffer;
+   const struct nlattr* attrs[CTRL_ATTR_MAX + 1];
+   const struct nlattr* group = NULL;
+   ssize_t len = 0;
+   int remaining = 0;
+
+   memset(&request, 0, sizeof(request));
+   request.msg.nlmsg_type  = GENL_ID_CTRL;
+   request.msg.nlmsg_flags = NLM_F_REQUEST;
+   request.msg.nlmsg_seq   = 1;
+   request.genl.cmd        = CTRL_CMD_GETFAMILY;
+   request.genl.version    = 1;
+   name->nla_type = CTRL_ATTR_FAMILY_NAME;
+   name->nla_len  = NLA_HDRLEN + sizeof(QUOTA_NL_FAMILY_NAME);
+   memcpy(request.attrs + NLA_HDRLEN, QUOTA_NL_FAMILY_NAME, sizeof(QUOTA_NL_FAMILY_NAME));
+   request.msg.nlmsg_len = sizeof(request);
+
+   if(send(events->fd, &request, sizeof(request), 0) == -1)
+   {
+      return -1;
+   }
+
+   len = recv(events->fd, buffer, sizeof(buffer), 0);
+   if(len < (ssize_t)NLMSG_LENGTH(GENL_HDRLEN) || !NLMSG_OK(reply, (int)len) || reply->nlmsg_type != GENL_ID_CTRL)
+   {
+      errno = (len > 0 && reply->nlmsg_type == NLMSG_ERROR) ? ENOENT : errno;     // family unknown
+      return -1;
+   }
+
+   parseAttrs((const char*)NLMSG_DATA(reply) + GENL_HDRLEN, (int)(reply->nlmsg_len - NLMSG_LENGTH(GENL_HDRLEN)), attrs, CTRL_ATTR_MAX);
+   if(attrs[CTRL_ATTR_FAMILY_ID] == NULL || attrs[CTRL_ATTR_MCAST_GROUPS] == NULL)
+   {
+      errno = ENOENT;
+      return -1;
+   }
+   memcpy(&events->familyId, QUOTA_NLA_DATA(attrs[CTRL_ATTR_FAMILY_ID]), sizeof(events->familyId));
+
+   // the groups are a list of nested attributes, one per group
+   group = (const struct nlattr*)QUOTA_NLA_DATA(attrs[CTRL_ATTR_MCAST_GROUPS]);
+   remaining = attrs[CTRL_ATTR_MCAST_GROUPS]->nla_len - NLA_HDRLEN;
+   while(remaining >= NLA_HDRLEN && group->nla_len >= NLA_HDRLEN && group->nla_len <= remaining)
+   {
+      const struct nlattr* groupAttrs[CTRL_ATTR_MCAST_GRP_MAX + 1];
+
+      parseAttrs(QUOTA_NLA_DATA(group), group->nla_len - NLA_HDRLEN, groupAttrs, CTRL_ATTR_MCAST_GRP_MAX);
+      if(   groupAttrs[CTRL_ATTR_MCAST_GRP_NAME] != NULL && groupAttrs[CTRL_ATTR_MCAST_GRP_ID] != NULL
+         && 0 == strcmp(QUOTA_NLA_DATA(groupAttrs[CTRL_ATTR_MCAST_GRP_NAME]), "events"))
+      {
+         *groupId = getU32(groupAttrs[CTRL_ATTR_MCAST_GRP_ID]);
+         return 0;
+      }
+
+      remaining -= NLA_ALIGN(group->nla_len);
+      group = (const struct nlattr*)((const char*)group + NLA_ALIGN(group->nla_len));
+   }
+
+   errno = ENOENT;
+   return -1;
+}
+
+
+
+static void parseAttrs(const void* start, int len, const struct nlattr** table, int max)
+{
+   const struct nlattr* attr = (const struct nlattr*)start;
+
+   memset(table, 0, (max + 1) * sizeof(const struct nlattr*));
+
+   while(len >= NLA_HDRLEN && attr->nla_len >= NLA_HDRLEN && attr->nla_len <= len)
+   {
+      int type = attr->nla_type & NLA_TYPE_MASK;
+      if(type <= max)
+      {
+         table[type] = attr;
+      }
+      len -= NLA_ALIGN(attr->nla_len);
+      attr = (const struct nlattr*)((const char*)attr + NLA_ALIGN(attr->nla_len));
+   }
+}
+
+
+
+static uint32_t getU32(const struct nlattr* attr)
+{
+   uint32_t value = 0;
+
+   if(attr->nla_len >= NLA_HDRLEN + sizeof(value))
+   {
+      memcpy(&value, QUOTA_NLA_DATA(attr), sizeof(value));
+   }
+   return value;
+}
+
+
+#else
+
+
+QuotaEvents_s* quotaEventsCreate(dev_t device)
+{
+   (void)device;
+   DLT_LOG(phmContext, DLT_LOG_INFO, DLT_STRING("quotaEvents - built without quota warning support"));
+   return NULL;
+}
+
+
+void quotaEventsDestroy(QuotaEvents_s* events)
+{
+   (void)events;
+}
+
+
+int quotaEventsGetFd(const QuotaEvents_s* events)
+{
+   (void)events;
+   return -1;
+}
+
+
+int quotaEventsProcess(QuotaEvents_s* events, quotaEventCallback_f callback, void* userData)
+{
+   (void)events;
+   (void)callback;
+   (void)userData;
+   return -1;
+}
+
+
+#endif
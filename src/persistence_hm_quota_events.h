@@ -0,0 +1,93 @@
+#ifndef PERSISTENCE_HM_QUOTA_EVENTS_H_
+#define PERSISTENCE_HM_QUOTA_EVENTS_H_
+
+/******************************************************************************
+ * Project         Persistency
+ * (c) copyright   2014
+ * Company         XS Embedded GmbH
+ *****************************************************************************/
+/******************************************************************************
+ * This Source Code Form is subject to the terms of the
+ * Mozilla Public License, v. 2.0. If a  copy of the MPL was not distributed
+ * with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
+******************************************************************************/
+ /**
+ * @file           persistence_hm_quota_events.h
+ * @ingroup        Persistence Health Monitor
+ * @author         Ingo Huerner
+ * @brief          Header of the persistence health monitor quota warnings.
+ *                 The kernel reports crossed project quota block limits through the
+ *                 generic netlink family "VFS_DQUOT" (CONFIG_QUOTA_NETLINK_INTERFACE).
+ * @see
+ */
+
+#include <sys/types.h>
+
+
+/// quota warnings reported for a project
+typedef enum QuotaEvent_e_
+{
+   /// usage went above the soft limit
+   QuotaEvent_SoftExceeded = 0,
+   /// usage stayed above the soft limit longer than the grace time, writes fail now
+   QuotaEvent_GraceExpired,
+   /// a write failed because of the hard limit
+   QuotaEvent_HardReached,
+   /// usage went below the soft limit again
+   QuotaEvent_BelowSoft,
+   /// usage went below the hard limit again
+   QuotaEvent_BelowHard
+
+} QuotaEvent_e;
+
+
+/// the quota warning listener
+typedef struct QuotaEvents_s_ QuotaEvents_s;
+
+
+/// callback to report a quota warning of a project
+typedef void (*quotaEventCallback_f)(unsigned int projectId, QuotaEvent_e event, void* userData);
+
+
+/**
+ * @brief Subscribe to the quota warnings of a file system
+ *
+ * @param device the device of the file system (st_dev)
+ *
+ * @return the listener or NULL if the kernel does not provide quota warnings
+ */
+QuotaEvents_s* quotaEventsCreate(dev_t device);
+
+
+/**
+ * @brief Unsubscribe and release the listener
+ *
+ * @param events the listener
+ */
+void quotaEventsDestroy(QuotaEvents_s* events);
+
+
+/**
+ * @brief Get the file descriptor to poll for warnings
+ *
+ * @param events the listener
+ *
+ * @return the file descriptor
+ */
+int quotaEventsGetFd(const QuotaEvents_s* events);
+
+
+/**
+ * @brief Read the pending warnings (non blocking) and report the block warnings
+ *        of projects on the subscribed file system
+ *
+ * @param events the listener
+ * @param callback the function to call per warning
+ * @param userData passed to the callback
+ *
+ * @return 0 on success, 1 if warnings have been lost (socket overflow), -1 on error
+ */
+int quotaEventsProcess(QuotaEvents_s* events, quotaEventCallback_f callback, void* userData);
+
+
+#endif /* PERSISTENCE_HM_QUOTA_EVENTS_H_ */
@@ -0,0 +1,175 @@
+/******************************************************************************
+ * Project         Persistency
+ * (c) copyright   2014
+ * Company         XS Embedded GmbH
+ *****************************************************************************/
+/******************************************************************************
+ * This Source Code Form is subject to the terms of the
+ * Mozilla Public License, v. 2.0. If a  copy of the MPL was not distributed
+ * with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
+******************************************************************************/
+ /**
+ * @file           persistence_hm_scan_budget.c
+ * @ingroup        Persistence Health Monitor
+ * @author         Ingo Huerner
+ * @brief          Implementation of the persistence health monitor scan budget.
+ *                 The token bucket holds at most one second of operations. A charge may
+ *                 drive it below zero; the caller then sleeps until the debt is refilled,
+ *                 so later callers queue up behind it.
+ * @see
+ */
+
+#include "persistence_hm_scan_budget.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <time.h>
+
+
+/// length of the busy period before the duty cycle is checked [ns]
+#define SCAN_BUDGET_PERIOD_NS (100LL * 1000000LL)
+
+
+struct ScanBudget_s_
+{
+   /// protects the bucket and the counters
+   pthread_mutex_t mutex;
+   /// refill rate, 0 = unlimited
+   double opsPerSecond;
+   /// available operations, negative while in debt
+   double tokens;
+   /// time of the last refill [ns, CLOCK_MONOTONIC]
+   long long refillNs;
+   /// percentage of time a thread may be busy
+   unsigned int dutyCycle;
+   /// how often the budget kicked in
+   ScanBudgetCounters_s counters;
+};
+
+
+// local function prototypes
+static long long nowNs(void);
+static void sleepFor(ScanBudget_s* budget, long long durationNs, unsigned int* counter);
+//----------------------------------------------------------
+
+
+
+ScanBudget_s* scanBudgetCreate(unsigned int opsPerSecond, unsigned int dutyCycle)
+{
+   ScanBudget_s* budget = calloc(1, sizeof(ScanBudget_s));
+
+   if(budget != NULL)
+   {
+      pthread_mutex_init(&budget->mutex, NULL);
+      budget->opsPerSecond = (double)opsPerSecond;
+      budget->tokens       = (double)opsPerSecond;
+      budget->refillNs     = nowNs();
+      budget->dutyCycle    = (dutyCycle == 0 || dutyCycle > 100) ? 100 : dutyCycle;
+   }
+   return budget;
+}
+
+
+
+void scanBudgetDestroy(ScanBudget_s* budget)
+{
+   if(budget != NULL)
+   {
+      pthread_mutex_destroy(&budget->mutex);
+      free(budget);
+   }
+}
+
+
+
+void scanBudgetBegin(ScanBudgetSlice_s* slice)
+{
+   slice->startNs = nowNs();
+}
+
+
+
+void scanBudgetCharge(ScanBudget_s* budget, ScanBudgetSlice_s* slice, unsigned int ops)
+{
+   long long now = 0;
+   long long waitNs = 0;
+
+   if(budget == NULL)
+   {
+      return;
+   }
+
+   now = nowNs();
+
+   if(budget->opsPerSecond > 0.0)
+   {
+      pthread_mutex_lock(&budget->mutex);
+
+      budget->tokens += (double)(now - budget->refillNs) * budget->opsPerSecond / 1e9;
+      if(budget->tokens > budget->opsPerSecond)
+      {
+         budget->tokens = budget->opsPerSecond;
+      }
+      budget->refillNs = now;
+      budget->tokens  -= (double)ops;
+
+      if(budget->tokens < 0.0)
+      {
+         waitNs = (long long)(-budget->tokens * 1e9 / budget->opsPerSecond);
+      }
+
+      pthread_mutex_unlock(&budget->mutex);
+
+      if(waitNs > 0)
+      {
+         sleepFor(budget, waitNs, &budget->counters.tokenPauses);
+         now = nowNs();
+      }
+   }
+
+   if(budget->dutyCycle < 100 && now - slice->startNs >= SCAN_BUDGET_PERIOD_NS)
+   {
+      // idle long enough that the busy period is dutyCycle percent of busy and idle together
+      long long busyNs = now - slice->startNs;
+
+      sleepFor(budget, busyNs * (100 - budget->dutyCycle) / budget->dutyCycle, &budget->counters.dutyPauses);
+      slice->startNs = nowNs();
+   }
+}
+
+
+
+void scanBudgetGetCounters(ScanBudget_s* budget, ScanBudgetCounters_s* counters)
+{
+   pthread_mutex_lock(&budget->mutex);
+   *counters = budget->counters;
+   pthread_mutex_unlock(&budget->mutex);
+}
+
+
+
+static long long nowNs(void)
+{
+   struct timespec now;
+
+   clock_gettime(CLOCK_MONOTONIC, &now);
+
+   return (long long)now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+
+
+static void sleepFor(ScanBudget_s* budget, long long durationNs, unsigned int* counter)
+{
+   struct timespec duration;
+
+   pthread_mutex_lock(&budget->mutex);
+   (*counter)++;
+   budget->counters.pausedMs += (unsigned long long)(durationNs / 1000000);
+   pthread_mutex_unlock(&budget->mutex);
+
+   duration.tv_sec  = durationNs / 1000000000LL;
+   duration.tv_nsec = durationNs % 1000000000LL;
+   while(nanosleep(&duration, &duration) == -1 && errno == EINTR);     // interrupted by a signal, sleep the rest
+}
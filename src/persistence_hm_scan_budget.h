@@ -0,0 +1,98 @@
+#ifndef PERSISTENCE_HM_SCAN_BUDGET_H_
+#define PERSISTENCE_HM_SCAN_BUDGET_H_
+
+/******************************************************************************
+ * Project         Persistency
+ * (c) copyright   2014
+ * Company         XS Embedded GmbH
+ *****************************************************************************/
+/******************************************************************************
+ * This Source Code Form is subject to the terms of the
+ * Mozilla Public License, v. 2.0. If a  copy of the MPL was not distributed
+ * with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
+******************************************************************************/
+ /**
+ * @file           persistence_hm_scan_budget.h
+ * @ingroup        Persistence Health Monitor
+ * @author         Ingo Huerner
+ * @brief          Header of the persistence health monitor scan budget.
+ *                 Limits the metadata operations (open, getdents, stat) of all scanning
+ *                 threads together with a token bucket, and the share of time each
+ *                 scanning thread may be busy (duty cycle). Scanners charge the budget
+ *                 after every folder and pause there when it is exhausted.
+ * @see
+ */
+
+
+/// the budget, shared by all scanning threads
+typedef struct ScanBudget_s_ ScanBudget_s;
+
+
+/// duty cycle state of one scanning thread
+typedef struct ScanBudgetSlice_s_
+{
+   /// start of the current busy period [ns, CLOCK_MONOTONIC]
+   long long startNs;
+} ScanBudgetSlice_s;
+
+
+/// how often the budget made scanners pause
+typedef struct ScanBudgetCounters_s_
+{
+   /// pauses because the token bucket was empty
+   unsigned int tokenPauses;
+   /// pauses because a thread was busy longer than its duty cycle allows
+   unsigned int dutyPauses;
+   /// sum of all pauses [ms]
+   unsigned long long pausedMs;
+} ScanBudgetCounters_s;
+
+
+/**
+ * @brief Create a budget
+ *
+ * @param opsPerSecond metadata operations per second of all scanners together, 0 = unlimited
+ * @param dutyCycle percentage of time a scanning thread may be busy, 100 = unlimited
+ *
+ * @return the budget or NULL if memory is exhausted
+ */
+ScanBudget_s* scanBudgetCreate(unsigned int opsPerSecond, unsigned int dutyCycle);
+
+
+/**
+ * @brief Release a budget
+ *
+ * @param budget the budget
+ */
+void scanBudgetDestroy(ScanBudget_s* budget);
+
+
+/**
+ * @brief Start the busy period of a scanning thread, called when a scan starts
+ *
+ * @param slice the duty cycle state of the thread
+ */
+void scanBudgetBegin(ScanBudgetSlice_s* slice);
+
+
+/**
+ * @brief Charge the operations spent on a folder, pauses the calling thread if the
+ *        budget is exhausted; does nothing if budget is NULL
+ *
+ * @param budget the budget
+ * @param slice the duty cycle state of the calling thread
+ * @param ops number of metadata operations
+ */
+void scanBudgetCharge(ScanBudget_s* budget, ScanBudgetSlice_s* slice, unsigned int ops);
+
+
+/**
+ * @brief Get the counters of a budget
+ *
+ * @param budget the budget
+ * @param counters [out] the counters since the budget has been created
+ */
+void scanBudgetGetCounters(ScanBudget_s* budget, ScanBudgetCounters_s* counters);
+
+
+#endif /* PERSISTENCE_HM_SCAN_BUDGET_H_ */
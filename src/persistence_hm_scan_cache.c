@@ -0,0 +1,284 @@
+/******************************************************************************
+ * Project         Persistency
+ * (c) copyright   2014
+ * Company         XS Embedded GmbH
+ *****************************************************************************/
+/******************************************************************************
+ * This Source Code Form is subject to the terms of the
+ * Mozilla Public License, v. 2.0. If a  copy of the MPL was not distributed
+ * with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
+******************************************************************************/
+ /**
+ * @file           persistence_hm_scan_cache.c
+ * @ingroup        Persistence Health Monitor
+ * @author         Ingo Huerner
+ * @brief          Implementation of the persistence health monitor folder size cache.
+ *                 The entries live in one flat array, an open addressing hash table
+ *                 with linear probing keyed by (device, inode), so a lookup touches
+ *                 one or two cache lines and there is no allocation per folder.
+ * @see
+ */
+
+#include "persistence_hm_definitions.h"
+#include "persistence_hm_scan_cache.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+
+/// initial number of slots, must be a power of two
+#define CACHE_INITIAL_CAPACITY 256
+
+
+/// one cached folder
+typedef struct CacheEntry_s_
+{
+   uint64_t ino;
+   uint64_t dev;
+   int64_t  mtimeSec;
+   int64_t  ctimeSec;
+   /// sum of the file sizes directly inside the folder
+   uint64_t size;
+   uint32_t mtimeNsec;
+   uint32_t ctimeNsec;
+   /// number of files directly inside the folder
+   uint32_t files;
+   /// scan generation the entry has been used last, 0 = slot unused
+   uint32_t generation;
+} CacheEntry_s;
+
+
+struct DiskScanCache_s_
+{
+   CacheEntry_s* entries;
+   /// number of slots, power of two
+   uint32_t capacity;
+   /// number of used slots
+   uint32_t count;
+   /// number of entries used by the current scan
+   uint32_t touched;
+   /// the current scan generation
+   uint32_t generation;
+   /// number of folders served by the current scan
+   uint32_t hits;
+   /// 1 if the current scan has seen hard linked files
+   int linkedNow;
+   /// 1 if the last scan has seen hard linked files, no folder is served then
+   int linked;
+};
+
+
+// local function prototypes
+static uint32_t hashKey(uint64_t dev, uint64_t ino);
+static CacheEntry_s* findSlot(CacheEntry_s* entries, uint32_t capacity, uint64_t dev, uint64_t ino);
+static int rebuild(DiskScanCache_s* cache, uint32_t capacity, int keepAll);
+//----------------------------------------------------------
+
+
+
+DiskScanCache_s* diskScanCacheCreate(void)
+{
+   DiskScanCache_s* cache = calloc(1, sizeof(DiskScanCache_s));
+
+   if(cache != NULL)
+   {
+      cache->entries = calloc(CACHE_INITIAL_CAPACITY, sizeof(CacheEntry_s));
+      if(cache->entries == NULL)
+      {
+         free(cache);
+         return NULL;
+      }
+      cache->capacity   = CACHE_INITIAL_CAPACITY;
+      cache->generation = 1;
+   }
+   return cache;
+}
+
+
+
+void diskScanCacheDestroy(DiskScanCache_s* cache)
+{
+   if(cache != NULL)
+   {
+      free(cache->entries);
+      free(cache);
+   }
+}
+
+
+
+void diskScanCacheClear(DiskScanCache_s* cache)
+{
+   memset(cache->entries, 0, cache->capacity * sizeof(CacheEntry_s));
+   cache->count   = 0;
+   cache->touched = 0;
+}
+
+
+
+void diskScanCacheBeginScan(DiskScanCache_s* cache)
+{
+   cache->generation++;
+   if(cache->generation == 0)
+   {
+      diskScanCacheClear(cache);    // wrap around, start over
+      cache->generation = 1;
+   }
+   cache->touched   = 0;
+   cache->hits      = 0;
+   cache->linkedNow = 0;
+}
+
+
+
+int diskScanCacheEndScan(DiskScanCache_s* cache)
+{
+   if(cache->touched < cache->count)
+   {
+      // folders have been removed; drop their entries (open addressing has no cheap delete)
+      (void)rebuild(cache, cache->capacity, 0);
+   }
+
+   cache->linked = cache->linkedNow;
+
+   // a file in a served folder has not been seen, a new link to it has been counted as a new file
+   return (cache->linkedNow == 1 && cache->hits > 0) ? 1 : 0;
+}
+
+
+
+void diskScanCacheNoteLinked(DiskScanCache_s* cache)
+{
+   cache->linkedNow = 1;
+}
+
+
+
+int diskScanCacheLookup(DiskScanCache_s* cache, const struct stat* dirStat, unsigned long long* size, unsigned int* files)
+{
+   CacheEntry_s* entry = NULL;
+
+   if(cache->linked == 1)
+   {
+      return 0;      // see header
+   }
+
+   entry = findSlot(cache->entries, cache->capacity, (uint64_t)dirStat->st_dev, (uint64_t)dirStat->st_ino);
+   if(   entry->generation != 0
+      && entry->mtimeSec  == (int64_t)dirStat->st_mtim.tv_sec  && entry->mtimeNsec == (uint32_t)dirStat->st_mtim.tv_nsec
+      && entry->ctimeSec  == (int64_t)dirStat->st_ctim.tv_sec  && entry->ctimeNsec == (uint32_t)dirStat->st_ctim.tv_nsec)
+   {
+      if(entry->generation != cache->generation)
+      {
+         entry->generation = cache->generation;
+         cache->touched++;
+      }
+      cache->hits++;
+      *size  = entry->size;
+      *files = entry->files;
+      return 1;
+   }
+   return 0;
+}
+
+
+
+void diskScanCacheStore(DiskScanCache_s* cache, const struct stat* dirStat, unsigned long long size, unsigned int files)
+{
+   CacheEntry_s* entry = NULL;
+   struct timespec now;
+
+   clock_gettime(CLOCK_REALTIME, &now);
+   if(dirStat->st_mtim.tv_sec >= now.tv_sec - 1 || dirStat->st_ctim.tv_sec >= now.tv_sec - 1)
+   {
+      return;     // too recent, see header
+   }
+
+   // keep the load factor below 3/4
+   if((cache->count + 1) * 4 > cache->capacity * 3 && rebuild(cache, cache->capacity * 2, 1) == -1)
+   {
+      return;
+   }
+
+   entry = findSlot(cache->entries, cache->capacity, (uint64_t)dirStat->st_dev, (uint64_t)dirStat->st_ino);
+   if(entry->generation == 0)
+   {
+      cache->count++;
+   }
+   if(entry->generation != cache->generation)
+   {
+      cache->touched++;
+   }
+
+   entry->dev        = (uint64_t)dirStat->st_dev;
+   entry->ino        = (uint64_t)dirStat->st_ino;
+   entry->mtimeSec   = (int64_t)dirStat->st_mtim.tv_sec;
+   entry->mtimeNsec  = (uint32_t)dirStat->st_mtim.tv_nsec;
+   entry->ctimeSec   = (int64_t)dirStat->st_ctim.tv_sec;
+   entry->ctimeNsec  = (uint32_t)dirStat->st_ctim.tv_nsec;
+   entry->size       = size;
+   entry->files      = files;
+   entry->generation = cache->generation;
+}
+
+
+
+static uint32_t hashKey(uint64_t dev, uint64_t ino)
+{
+   uint64_t h = ino ^ (dev * 0x9E3779B97F4A7C15ull);
+
+   h ^= h >> 33;
+   h *= 0xFF51AFD7ED558CCDull;
+   h ^= h >> 33;
+
+   return (uint32_t)h;
+}
+
+
+
+static CacheEntry_s* findSlot(CacheEntry_s* entries, uint32_t capacity, uint64_t dev, uint64_t ino)
+{
+   uint32_t mask = capacity - 1;
+   uint32_t i = hashKey(dev, ino) & mask;
+
+   // the table is never full, so an unused slot terminates the probe
+   while(entries[i].generation != 0 && (entries[i].ino != ino || entries[i].dev != dev))
+   {
+      i = (i + 1) & mask;
+   }
+   return &entries[i];
+}
+
+
+
+static int rebuild(DiskScanCache_s* cache, uint32_t capacity, int keepAll)
+{
+   uint32_t i = 0;
+   CacheEntry_s* entries = calloc(capacity, sizeof(CacheEntry_s));
+
+   if(entries == NULL)
+   {
+      DLT_LOG(phmContext, DLT_LOG_WARN, DLT_STRING("diskScanCache - out of memory"));
+      return -1;
+   }
+
+   cache->count = 0;
+   for(i = 0; i < cache->capacity; i++)
+   {
+      const CacheEntry_s* old = &cache->entries[i];
+
+      if(old->generation != 0 && (keepAll || old->generation == cache->generation))
+      {
+         *findSlot(entries, capacity, old->dev, old->ino) = *old;
+         cache->count++;
+      }
+   }
+
+   free(cache->entries);
+   cache->entries  = entries;
+   cache->capacity = capacity;
+
+   return 0;
+}
@@ -0,0 +1,118 @@
+#ifndef PERSISTENCE_HM_SCAN_CACHE_H_
+#define PERSISTENCE_HM_SCAN_CACHE_H_
+
+/******************************************************************************
+ * Project         Persistency
+ * (c) copyright   2014
+ * Company         XS Embedded GmbH
+ *****************************************************************************/
+/******************************************************************************
+ * This Source Code Form is subject to the terms of the
+ * Mozilla Public License, v. 2.0. If a  copy of the MPL was not distributed
+ * with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
+******************************************************************************/
+ /**
+ * @file           persistence_hm_scan_cache.h
+ * @ingroup        Persistence Health Monitor
+ * @author         Ingo Huerner
+ * @brief          Header of the persistence health monitor folder size cache.
+ *                 The cache remembers the sum of the files directly inside a folder
+ *                 together with the folder's mtime and ctime. As long as both are
+ *                 unchanged, no file has been added, removed or renamed in the folder
+ *                 and the scanner can skip the stat of every file.
+ *                 Note: writing to an existing file does not change the folder times;
+ *                 the cache must be cleared when such a modification is known.
+ *                 While the application has hard linked files no folder is served
+ *                 from the cache: a file in a cached folder is not stat'ed, so a
+ *                 further link to it elsewhere would be counted as a new file.
+ * @see
+ */
+
+#include <sys/stat.h>
+
+
+/// the cache (one per application folder; not thread safe)
+typedef struct DiskScanCache_s_ DiskScanCache_s;
+
+
+/**
+ * @brief Create an empty cache
+ *
+ * @return the cache or NULL if memory is exhausted
+ */
+DiskScanCache_s* diskScanCacheCreate(void);
+
+
+/**
+ * @brief Release a cache
+ *
+ * @param cache the cache
+ */
+void diskScanCacheDestroy(DiskScanCache_s* cache);
+
+
+/**
+ * @brief Remove all entries, the next scan stats every file again
+ *
+ * @param cache the cache
+ */
+void diskScanCacheClear(DiskScanCache_s* cache);
+
+
+/**
+ * @brief Start a scan; entries not used until diskScanCacheEndScan are dropped then
+ *
+ * @param cache the cache
+ */
+void diskScanCacheBeginScan(DiskScanCache_s* cache);
+
+
+/**
+ * @brief End a scan and drop the entries of folders that have not been visited
+ *
+ * @param cache the cache
+ *
+ * @return 1 if the scan has served folders from the cache and has seen hard linked
+ *         files, the result may count a file twice and the caller has to scan again;
+ *         0 otherwise
+ */
+int diskScanCacheEndScan(DiskScanCache_s* cache);
+
+
+/**
+ * @brief Report a file with more than one link seen by the running scan;
+ *        until a scan sees no such file, no folder is served from the cache
+ *
+ * @param cache the cache
+ */
+void diskScanCacheNoteLinked(DiskScanCache_s* cache);
+
+
+/**
+ * @brief Look up the file total of a folder
+ *
+ * @param cache the cache
+ * @param dirStat the current stat of the folder
+ * @param size [out] sum of the sizes of the files directly inside the folder
+ * @param files [out] number of files directly inside the folder
+ *
+ * @return 1 if the entry is valid (folder times unchanged), 0 otherwise or while
+ *         the application has hard linked files
+ */
+int diskScanCacheLookup(DiskScanCache_s* cache, const struct stat* dirStat, unsigned long long* size, unsigned int* files);
+
+
+/**
+ * @brief Store the file total of a folder.
+ *        Folders modified within the last second are not stored, because a further
+ *        change inside the same timestamp granularity would go unnoticed.
+ *
+ * @param cache the cache
+ * @param dirStat the stat of the folder taken before it has been read
+ * @param size sum of the sizes of the files directly inside the folder
+ * @param files number of files directly inside the folder
+ */
+void diskScanCacheStore(DiskScanCache_s* cache, const struct stat* dirStat, unsigned long long size, unsigned int files);
+
+
+#endif /* PERSISTENCE_HM_SCAN_CACHE_H_ */
@@ -0,0 +1,445 @@
+/******************************************************************************
+ * Project         Persistency
+ * (c) copyright   2014
+ * Company         XS Embedded GmbH
+ *****************************************************************************/
+/******************************************************************************
+ * This Source Code Form is subject to the terms of the
+ * Mozilla Public License, v. 2.0. If a  copy of the MPL was not distributed
+ * with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
+******************************************************************************/
+ /**
+ * @file           persistence_hm_scan_pool.c
+ * @ingroup        Persistence Health Monitor
+ * @author         Ingo Huerner
+ * @brief          Implementation of the persistence health monitor parallel application folder scan.
+ *                 The jobs are split into one contiguous range per worker. A range is a
+ *                 deque packed into a single 64 bit word (head in the upper, tail in the
+ *                 lower half): the owner takes jobs from the head, thieves from the tail,
+ *                 both with a compare and swap, so no worker ever blocks another.
+ *                 The worker threads and their scanners live as long as the pool; they
+ *                 sleep on a condition variable between two runs.
+ * @see
+ */
+
+#include "persistence_hm_definitions.h"
+#include "persistence_hm_scan_pool.h"
+
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+
+#define FILE_DIR_NOT_SELF_OR_PARENT(s) ((s)[0]!='.'&&(((s)[1]!='.'||(s)[2]!='\0')||(s)[1]=='\0'))
+
+#define RANGE_HEAD(r) ((uint32_t)((r) >> 32))
+#define RANGE_TAIL(r) ((uint32_t)((r) & 0xFFFFFFFFu))
+#define RANGE_MAKE(h, t) (((uint64_t)(h) << 32) | (uint64_t)(t))
+
+
+/// start parameter of a worker thread
+typedef struct ScanWorker_s_
+{
+   ScanPool_s* pool;
+   int index;
+} ScanWorker_s;
+
+
+struct ScanPool_s_
+{
+   /// job range per worker, cache line aligned to avoid false sharing
+   struct
+   {
+      uint64_t range;
+   } __attribute__ ((aligned(64))) deque[SCAN_POOL_MAX_WORKERS];
+
+   /// protects the fields below, the jobs are handed over with it
+   pthread_mutex_t mutex;
+   /// signalled when a run starts or the pool is destroyed
+   pthread_cond_t start;
+   /// signalled when the last worker thread has finished its part of a run
+   pthread_cond_t done;
+   /// number of the current run, the worker threads wait for the next one
+   unsigned int run;
+   /// worker threads still busy with the current run
+   int busy;
+   /// 1 = the worker threads end
+   int stop;
+
+   /// descriptor of the root folder of the current run
+   int rootFd;
+   /// the jobs of the current run
+   ScanJob_s* jobs;
+   /// the scan options
+   DiskScanOptions_s options;
+   /// number of workers, the calling thread of scanPoolRunJobs is worker 0
+   int workers;
+   /// number of worker threads that have been started (worker 1 to started)
+   int started;
+   pthread_t threads[SCAN_POOL_MAX_WORKERS];
+   ScanWorker_s params[SCAN_POOL_MAX_WORKERS];
+   /// scanner of the calling thread, the worker threads keep their own
+   DiskScanner_s* scanner;
+};
+
+
+// local function prototypes
+static void* runScanWorker(void* dataPtr);
+static void processJobs(ScanPool_s* pool, int index, DiskScanner_s* scanner);
+static int takeOwnJob(ScanPool_s* pool, int index);
+static int stealJob(ScanPool_s* pool, int index);
+static int addRootJob(ScanRootResult_s* result, int* capacity, const char* appId);
+//----------------------------------------------------------
+
+
+
+ScanPool_s* scanPoolCreate(int workers, const DiskScanOptions_s* options)
+{
+   int i = 0;
+   ScanPool_s* pool = NULL;
+
+   if(workers > SCAN_POOL_MAX_WORKERS)
+   {
+      workers = SCAN_POOL_MAX_WORKERS;
+   }
+   if(workers < 1)
+   {
+      workers = 1;
+   }
+
+   if(posix_memalign((void**)&pool, 64, sizeof(ScanPool_s)) != 0)
+   {
+      DLT_LOG(phmContext, DLT_LOG_ERROR, DLT_STRING("scanPoolCreate - out of memory"));
+      return NULL;
+   }
+   memset(pool, 0, sizeof(ScanPool_s));
+   pthread_mutex_init(&pool->mutex, NULL);
+   pthread_cond_init(&pool->start, NULL);
+   pthread_cond_init(&pool->done, NULL);
+   pool->options = *options;
+   pool->workers = workers;
+   pool->scanner = diskScannerCreate(&pool->options);
+
+   for(i = 1; i < workers; i++)
+   {
+      pool->params[i].pool  = pool;
+      pool->params[i].index = i;
+      if(pthread_create(&pool->threads[i], NULL, runScanWorker, &pool->params[i]) != 0)
+      {
+         DLT_LOG(phmContext, DLT_LOG_WARN, DLT_STRING("scanPoolCreate - could not start worker"), DLT_INT(i));
+         break;   // jobs of missing workers get stolen by the running ones
+      }
+      (void)pthread_setname_np(pool->threads[i], "phmScanWorker");
+      pool->started++;
+   }
+
+   return pool;
+}
+
+
+
+void scanPoolDestroy(ScanPool_s* pool)
+{
+   int i = 0;
+
+   if(pool == NULL)
+   {
+      return;
+   }
+
+   pthread_mutex_lock(&pool->mutex);
+   pool->stop = 1;
+   pthread_cond_broadcast(&pool->start);
+   pthread_mutex_unlock(&pool->mutex);
+
+   for(i = 1; i <= pool->started; i++)
+   {
+      pthread_join(pool->threads[i], NULL);
+   }
+
+   if(pool->scanner != NULL)
+   {
+      diskScannerDestroy(pool->scanner);
+   }
+   pthread_cond_destroy(&pool->done);
+   pthread_cond_destroy(&pool->start);
+   pthread_mutex_destroy(&pool->mutex);
+   free(pool);
+}
+
+
+
+int scanPoolRunJobs(ScanPool_s* pool, int rootFd, ScanJob_s* jobs, int jobCount)
+{
+   int i = 0;
+
+   for(i = 0; i < jobCount; i++)
+   {
+      jobs[i].result = -1;
+   }
+
+   if(jobCount == 0)
+   {
+      return 0;
+   }
+
+   // the ranges of the workers without threads are stolen by the others
+   pthread_mutex_lock(&pool->mutex);
+   pool->rootFd = rootFd;
+   pool->jobs   = jobs;
+   for(i = 0; i < pool->workers; i++)
+   {
+      pool->deque[i].range = RANGE_MAKE((uint32_t)((long)jobCount * i / pool->workers),
+                                        (uint32_t)((long)jobCount * (i+1) / pool->workers));
+   }
+   pool->busy = pool->started;
+   pool->run++;
+   pthread_cond_broadcast(&pool->start);
+   pthread_mutex_unlock(&pool->mutex);
+
+   if(pool->scanner != NULL)
+   {
+      processJobs(pool, 0, pool->scanner);
+   }
+
+   // the results are written by the worker threads before they leave the run
+   pthread_mutex_lock(&pool->mutex);
+   while(pool->busy > 0)
+   {
+      pthread_cond_wait(&pool->done, &pool->mutex);
+   }
+   pool->jobs = NULL;
+   pthread_mutex_unlock(&pool->mutex);
+
+   return 0;
+}
+
+
+
+int scanPoolRun(int rootFd, ScanJob_s* jobs, int jobCount, int workers, const DiskScanOptions_s* options)
+{
+   int rval = 0;
+   ScanPool_s* pool = NULL;
+
+   if(workers > jobCount)
+   {
+      workers = jobCount;
+   }
+
+   pool = scanPoolCreate(workers, options);
+   if(pool == NULL)
+   {
+      return -1;
+   }
+   rval = scanPoolRunJobs(pool, rootFd, jobs, jobCount);
+   scanPoolDestroy(pool);
+
+   return rval;
+}
+
+
+
+int scanPoolRunRoot(const char* rootPath, int workers, const DiskScanOptions_s* options, ScanRootResult_s* result)
+{
+   int i = 0, rval = 0, capacity = 0;
+   struct dirent* dirent = NULL;
+   DIR* dir = opendir(rootPath);
+
+   memset(result, 0, sizeof(ScanRootResult_s));
+
+   if(dir == NULL)
+   {
+      DLT_LOG(phmContext, DLT_LOG_ERROR, DLT_STRING("scanPoolRunRoot - failed to open:"), DLT_STRING(rootPath));
+      return -1;
+   }
+
+   for(dirent = readdir(dir); NULL != dirent && rval == 0; dirent = readdir(dir))
+   {
+      struct stat buf;
+
+      if(   FILE_DIR_NOT_SELF_OR_PARENT(dirent->d_name)
+         && (   DT_DIR == dirent->d_type
+             || (   DT_UNKNOWN == dirent->d_type
+                 && fstatat(dirfd(dir), dirent->d_name, &buf, AT_SYMLINK_NOFOLLOW) == 0 && S_ISDIR(buf.st_mode))))
+      {
+         rval = addRootJob(result, &capacity, dirent->d_name);
+      }
+   }
+
+   if(rval == 0 && result->appCount > 0)
+   {
+      rval = scanPoolRun(dirfd(dir), result->apps, result->appCount, workers, options);
+   }
+   closedir(dir);
+
+   if(rval == -1)
+   {
+      scanPoolFreeResult(result);
+      return -1;
+   }
+
+   for(i = 0; i < result->appCount; i++)
+   {
+      if(result->apps[i].result == 0)
+      {
+         result->total.size    += result->apps[i].usage.size;
+         result->total.files   += result->apps[i].usage.files;
+         result->total.folders += result->apps[i].usage.folders;
+      }
+   }
+
+   return 0;
+}
+
+
+
+void scanPoolFreeResult(ScanRootResult_s* result)
+{
+   int i = 0;
+
+   for(i = 0; i < result->appCount; i++)
+   {
+      free((char*)result->apps[i].appId);
+   }
+   free(result->apps);
+   memset(result, 0, sizeof(ScanRootResult_s));
+}
+
+
+
+static int addRootJob(ScanRootResult_s* result, int* capacity, const char* appId)
+{
+   ScanJob_s* job = NULL;
+
+   if(result->appCount == *capacity)
+   {
+      int newCapacity = (*capacity == 0) ? 16 : *capacity * 2;
+      ScanJob_s* apps = realloc(result->apps, newCapacity * sizeof(ScanJob_s));
+      if(apps == NULL)
+      {
+         DLT_LOG(phmContext, DLT_LOG_ERROR, DLT_STRING("scanPoolRunRoot - out of memory"));
+         return -1;
+      }
+      result->apps = apps;
+      *capacity    = newCapacity;
+   }
+
+   job = &result->apps[result->appCount];
+   memset(job, 0, sizeof(ScanJob_s));
+   job->appId = strdup(appId);
+   if(job->appId == NULL)
+   {
+      DLT_LOG(phmContext, DLT_LOG_ERROR, DLT_STRING("scanPoolRunRoot - out of memory"));
+      return -1;
+   }
+   result->appCount++;
+
+   return 0;
+}
+
+
+
+static void* runScanWorker(void* dataPtr)
+{
+   ScanWorker_s* worker = (ScanWorker_s*)dataPtr;
+   ScanPool_s* pool = worker->pool;
+   int index = worker->index;
+   unsigned int run = 0;
+   // kept for the lifetime of the pool, its buffers are reused by every run
+   DiskScanner_s* scanner = diskScannerCreate(&pool->options);
+
+   pthread_mutex_lock(&pool->mutex);
+   while(1)
+   {
+      while(pool->run == run && pool->stop == 0)
+      {
+         pthread_cond_wait(&pool->start, &pool->mutex);
+      }
+      if(pool->stop == 1)
+      {
+         break;
+      }
+      run = pool->run;
+      pthread_mutex_unlock(&pool->mutex);
+
+      if(scanner != NULL)
+      {
+         processJobs(pool, index, scanner);   // otherwise the jobs of this worker get stolen by the others
+      }
+
+      pthread_mutex_lock(&pool->mutex);
+      if(--pool->busy == 0)
+      {
+         pthread_cond_signal(&pool->done);
+      }
+   }
+   pthread_mutex_unlock(&pool->mutex);
+
+   if(scanner != NULL)
+   {
+      diskScannerDestroy(scanner);
+   }
+
+   return NULL;
+}
+
+
+
+static void processJobs(ScanPool_s* pool, int index, DiskScanner_s* scanner)
+{
+   int job = -1;
+
+   while((job = takeOwnJob(pool, index)) != -1 || (job = stealJob(pool, index)) != -1)
+   {
+      ScanJob_s* scanJob = &pool->jobs[job];
+
+      diskScannerSetBudget(scanner, (scanJob->unlimited == 1) ? NULL : pool->options.budget);
+      scanJob->result = diskScannerRun(scanner, pool->rootFd, scanJob->appId, scanJob->cache, scanJob->top, &scanJob->usage);
+   }
+}
+
+
+
+static int takeOwnJob(ScanPool_s* pool, int index)
+{
+   uint64_t* range = &pool->deque[index].range;
+   uint64_t current = __atomic_load_n(range, __ATOMIC_ACQUIRE);
+
+   while(RANGE_HEAD(current) < RANGE_TAIL(current))
+   {
+      uint64_t next = RANGE_MAKE(RANGE_HEAD(current) + 1, RANGE_TAIL(current));
+      if(__atomic_compare_exchange_n(range, &current, next, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+      {
+         return (int)RANGE_HEAD(current);
+      }
+   }
+   return -1;
+}
+
+
+
+static int stealJob(ScanPool_s* pool, int index)
+{
+   int i = 0;
+
+   for(i = 1; i < pool->workers; i++)
+   {
+      uint64_t* range = &pool->deque[(index + i) % pool->workers].range;
+      uint64_t current = __atomic_load_n(range, __ATOMIC_ACQUIRE);
+
+      while(RANGE_HEAD(current) < RANGE_TAIL(current))
+      {
+         uint64_t next = RANGE_MAKE(RANGE_HEAD(current), RANGE_TAIL(current) - 1);
+         if(__atomic_compare_exchange_n(range, &current, next, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+         {
+            return (int)RANGE_TAIL(current) - 1;
+         }
+      }
+   }
+   return -1;
+}
@@ -0,0 +1,140 @@
+#ifndef PERSISTENCE_HM_SCAN_POOL_H_
+#define PERSISTENCE_HM_SCAN_POOL_H_
+
+/******************************************************************************
+ * Project         Persistency
+ * (c) copyright   2014
+ * Company         XS Embedded GmbH
+ *****************************************************************************/
+/******************************************************************************
+ * This Source Code Form is subject to the terms of the
+ * Mozilla Public License, v. 2.0. If a  copy of the MPL was not distributed
+ * with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
+******************************************************************************/
+ /**
+ * @file           persistence_hm_scan_pool.h
+ * @ingroup        Persistence Health Monitor
+ * @author         Ingo Huerner
+ * @brief          Header of the persistence health monitor parallel application folder scan.
+ * @see
+ */
+
+#include "persistence_hm_disk_scan.h"
+
+
+/// maximum number of scan worker threads
+#define SCAN_POOL_MAX_WORKERS 16
+
+
+/// scan of one application folder
+typedef struct ScanJob_s_
+{
+   /// name of the application folder below the root folder
+   const char* appId;
+   /// folder size cache of the application folder or NULL
+   DiskScanCache_s* cache;
+   /// [out] the largest files and folders of the application folder or NULL
+   ScanTop_s* top;
+   /// 1 if a client waits for the result, the scan is not limited by the budget of the options
+   int unlimited;
+   /// [out] the usage of the application folder
+   DiskScanUsage_s usage;
+   /// [out] result of diskScanFolder
+   int result;
+
+} ScanJob_s;
+
+
+/// usage of all application folders below a root, owned by the caller
+typedef struct ScanRootResult_s_
+{
+   /// one finished job per application folder
+   ScanJob_s* apps;
+   /// number of application folders
+   int appCount;
+   /// sum of all application folders that could be scanned
+   DiskScanUsage_s total;
+
+} ScanRootResult_s;
+
+
+/// a bounded pool of worker threads, each with its own scanner
+typedef struct ScanPool_s_ ScanPool_s;
+
+
+/**
+ * @brief Start the worker threads of a pool, they wait for jobs until scanPoolDestroy
+ *
+ * @param workers number of workers (the thread calling scanPoolRunJobs is one of them)
+ * @param options the scan options, every worker creates its own scanner from them
+ *
+ * @return the pool or NULL if memory is exhausted
+ */
+ScanPool_s* scanPoolCreate(int workers, const DiskScanOptions_s* options);
+
+
+/**
+ * @brief Stop the worker threads and release the pool
+ *
+ * @param pool the pool, may be NULL
+ */
+void scanPoolDestroy(ScanPool_s* pool);
+
+
+/**
+ * @brief Scan the application folders of all jobs on the workers of a pool.
+ *        Every worker starts on its own share of the jobs and steals from the other
+ *        workers when it runs out of work. Each job is written by exactly one worker,
+ *        so the results need no locking; they are complete when the function returns.
+ *        Only one thread may use a pool at a time.
+ *
+ * @param pool the pool
+ * @param rootFd descriptor of the root folder the application folders are relative to
+ * @param jobs the jobs to process
+ * @param jobCount number of jobs
+ *
+ * @return 0
+ */
+int scanPoolRunJobs(ScanPool_s* pool, int rootFd, ScanJob_s* jobs, int jobCount);
+
+
+/**
+ * @brief Scan the application folders of all jobs on a pool that exists only for this call
+ *        (scanPoolCreate, scanPoolRunJobs, scanPoolDestroy); for one-off scans.
+ *
+ * @param rootFd descriptor of the root folder the application folders are relative to
+ * @param jobs the jobs to process
+ * @param jobCount number of jobs
+ * @param workers number of workers (the calling thread is one of them)
+ * @param options the scan options
+ *
+ * @return 0 on success, -1 if memory is exhausted
+ */
+int scanPoolRun(int rootFd, ScanJob_s* jobs, int jobCount, int workers, const DiskScanOptions_s* options);
+
+
+/**
+ * @brief Scan every application folder below a root into a result owned by the caller.
+ *        Uses no state besides the result, so several scans of the same or different
+ *        roots may run at the same time (e.g. the disk monitor and an on-demand request).
+ *        The depth of the folder trees is not limited.
+ *
+ * @param rootPath the persistence root folder; its top level folders are the AppIDs
+ * @param workers number of worker threads (the calling thread is one of them)
+ * @param options the scan options
+ * @param result [out] the per application and total usage, release with scanPoolFreeResult
+ *
+ * @return 0 on success, -1 if the root could not be opened or memory is exhausted
+ */
+int scanPoolRunRoot(const char* rootPath, int workers, const DiskScanOptions_s* options, ScanRootResult_s* result);
+
+
+/**
+ * @brief Release the content of a result filled by scanPoolRunRoot
+ *
+ * @param result the result
+ */
+void scanPoolFreeResult(ScanRootResult_s* result);
+
+
+#endif /* PERSISTENCE_HM_SCAN_POOL_H_ */
@@ -0,0 +1,100 @@
+/******************************************************************************
+ * Project         Persistency
+ * (c) copyright   2014
+ * Company         XS Embedded GmbH
+ *****************************************************************************/
+/******************************************************************************
+ * This Source Code Form is subject to the terms of the
+ * Mozilla Public License, v. 2.0. If a  copy of the MPL was not distributed
+ * with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
+******************************************************************************/
+ /**
+ * @file           persistence_hm_scan_schedule.c
+ * @ingroup        Persistence Health Monitor
+ * @author         Ingo Huerner
+ * @brief          Implementation of the persistence health monitor scan scheduler.
+ *                 The interval shrinks linearly with the headroom left to the limit and
+ *                 is cut further so that an application growing at its current rate gets
+ *                 scanned at least SCHEDULE_SCANS_TO_LIMIT times before it reaches the limit.
+ * @see
+ */
+
+#include "persistence_hm_scan_schedule.h"
+
+#include <time.h>
+
+
+/// number of scans wanted before a growing application reaches its limit
+#define SCHEDULE_SCANS_TO_LIMIT 4
+
+/// weight of the newest measurement in the smoothed growth rate
+#define SCHEDULE_GROWTH_WEIGHT 0.5
+
+
+
+long long scanScheduleNow(void)
+{
+   struct timespec now;
+
+   clock_gettime(CLOCK_MONOTONIC, &now);
+
+   return (long long)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+
+
+void scanScheduleUpdate(ScanSchedule_s* schedule, long long nowMs, unsigned long long size,
+                        unsigned long long maxSize, const ScanScheduleLimits_s* limits)
+{
+   long long interval = limits->maxIntervalMs;
+
+   if(schedule->lastScanMs != 0 && nowMs > schedule->lastScanMs)
+   {
+      double rate = ((double)size - (double)schedule->lastSize) * 1000.0 / (double)(nowMs - schedule->lastScanMs);
+      schedule->growthRate = SCHEDULE_GROWTH_WEIGHT * rate + (1.0 - SCHEDULE_GROWTH_WEIGHT) * schedule->growthRate;
+   }
+   schedule->lastScanMs = nowMs;
+   schedule->lastSize   = size;
+
+   if(maxSize != 0)
+   {
+      if(size >= maxSize)
+      {
+         interval = limits->minIntervalMs;
+      }
+      else
+      {
+         double headroom = (double)(maxSize - size);
+
+         interval = limits->minIntervalMs
+                  + (long long)((double)(limits->maxIntervalMs - limits->minIntervalMs) * headroom / (double)maxSize);
+
+         if(schedule->growthRate > 0.0)
+         {
+            double untilLimit = headroom * 1000.0 / schedule->growthRate / SCHEDULE_SCANS_TO_LIMIT;
+            if(untilLimit < (double)interval)
+            {
+               interval = (long long)untilLimit;
+            }
+         }
+      }
+   }
+
+   if(interval < limits->minIntervalMs)
+   {
+      interval = limits->minIntervalMs;
+   }
+   else if(interval > limits->maxIntervalMs)
+   {
+      interval = limits->maxIntervalMs;
+   }
+
+   schedule->nextScanMs = nowMs + interval;
+}
+
+
+
+int scanScheduleIsDue(const ScanSchedule_s* schedule, long long nowMs)
+{
+   return (schedule->nextScanMs <= nowMs) ? 1 : 0;
+}
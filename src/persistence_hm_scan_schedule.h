@@ -0,0 +1,83 @@
+#ifndef PERSISTENCE_HM_SCAN_SCHEDULE_H_
+#define PERSISTENCE_HM_SCAN_SCHEDULE_H_
+
+/******************************************************************************
+ * Project         Persistency
+ * (c) copyright   2014
+ * Company         XS Embedded GmbH
+ *****************************************************************************/
+/******************************************************************************
+ * This Source Code Form is subject to the terms of the
+ * Mozilla Public License, v. 2.0. If a  copy of the MPL was not distributed
+ * with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
+******************************************************************************/
+ /**
+ * @file           persistence_hm_scan_schedule.h
+ * @ingroup        Persistence Health Monitor
+ * @author         Ingo Huerner
+ * @brief          Header of the persistence health monitor scan scheduler.
+ *                 The time of the next scan of an application is derived from the
+ *                 headroom to its limit and from the growth measured by its recent scans:
+ *                 an application close to its limit or growing fast is scanned often,
+ *                 an idle one with plenty of headroom rarely.
+ * @see
+ */
+
+
+/// bounds of the time between two scans of an application
+typedef struct ScanScheduleLimits_s_
+{
+   /// shortest time between two scans [ms]
+   long long minIntervalMs;
+   /// longest time between two scans [ms]
+   long long maxIntervalMs;
+} ScanScheduleLimits_s;
+
+
+/// schedule of one application
+typedef struct ScanSchedule_s_
+{
+   /// time of the last scan [ms, CLOCK_MONOTONIC], 0 = never scanned
+   long long lastScanMs;
+   /// time the next scan is due [ms, CLOCK_MONOTONIC], 0 = due now
+   long long nextScanMs;
+   /// size measured by the last scan
+   unsigned long long lastSize;
+   /// smoothed growth of the size [bytes/s], negative if the application shrinks
+   double growthRate;
+} ScanSchedule_s;
+
+
+/**
+ * @brief Get the current time of the scheduler
+ *
+ * @return CLOCK_MONOTONIC in ms
+ */
+long long scanScheduleNow(void);
+
+
+/**
+ * @brief Record a scan and plan the next one
+ *
+ * @param schedule the schedule of the application
+ * @param nowMs time of the scan
+ * @param size the size measured by the scan
+ * @param maxSize the limit of the application, 0 if it has none
+ * @param limits bounds of the interval
+ */
+void scanScheduleUpdate(ScanSchedule_s* schedule, long long nowMs, unsigned long long size,
+                        unsigned long long maxSize, const ScanScheduleLimits_s* limits);
+
+
+/**
+ * @brief Check if a scan is due
+ *
+ * @param schedule the schedule of the application
+ * @param nowMs the current time
+ *
+ * @return 1 if due, 0 otherwise
+ */
+int scanScheduleIsDue(const ScanSchedule_s* schedule, long long nowMs);
+
+
+#endif /* PERSISTENCE_HM_SCAN_SCHEDULE_H_ */
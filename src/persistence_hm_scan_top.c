@@ -0,0 +1,246 @@
+/******************************************************************************
+ * Project         Persistency
+ * (c) copyright   2014
+ * Company         XS Embedded GmbH
+ *****************************************************************************/
+/******************************************************************************
+ * This Source Code Form is subject to the terms of the
+ * Mozilla Public License, v. 2.0. If a  copy of the MPL was not distributed
+ * with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
+******************************************************************************/
+ /**
+ * @file           persistence_hm_scan_top.c
+ * @ingroup        Persistence Health Monitor
+ * @author         Ingo Huerner
+ * @brief          Implementation of the persistence health monitor top consumer lists.
+ *                 Each list is a binary min-heap in a fixed array: the smallest kept entry
+ *                 is the root, a larger entry replaces it and sinks to its place, so an
+ *                 insert costs O(log n) and nothing is allocated during a walk.
+ * @see
+ */
+
+#include "persistence_hm_definitions.h"
+#include "persistence_hm_scan_top.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+
+// local function prototypes
+static void siftUp(ScanTopEntry_s* heap, unsigned int index);
+static void siftDown(ScanTopEntry_s* heap, unsigned int count, unsigned int index);
+static void setPath(ScanTopEntry_s* entry, const char* folder, unsigned int folderLen, const char* name);
+static int compareSizeDesc(const void* p1, const void* p2);
+//----------------------------------------------------------
+
+
+
+ScanTop_s* scanTopCreate(unsigned int capacity)
+{
+   ScanTop_s* top = NULL;
+
+   if(capacity == 0 || capacity > SCAN_TOP_MAX_ENTRIES)
+   {
+      return NULL;
+   }
+
+   top = calloc(1, sizeof(ScanTop_s));
+   if(top != NULL)
+   {
+      int i = 0;
+
+      top->capacity = capacity;
+      for(i = 0; i < ScanTopKind_LastEntry; i++)
+      {
+         top->entries[i] = calloc(capacity, sizeof(ScanTopEntry_s));
+         if(top->entries[i] == NULL)
+         {
+            scanTopDestroy(top);
+            return NULL;
+         }
+      }
+   }
+   return top;
+}
+
+
+
+void scanTopDestroy(ScanTop_s* top)
+{
+   if(top != NULL)
+   {
+      int i = 0;
+
+      for(i = 0; i < ScanTopKind_LastEntry; i++)
+      {
+         free(top->entries[i]);
+      }
+      free(top);
+   }
+}
+
+
+
+void scanTopBegin(ScanTop_s* top)
+{
+   memset(top->count, 0, sizeof(top->count));
+   top->valid = 0;
+}
+
+
+
+void scanTopAdd(ScanTop_s* top, ScanTopKind_e kind, unsigned long long size, unsigned long long dirDev,
+                unsigned long long dirIno, const char* folder, unsigned int folderLen, const char* name)
+{
+   ScanTopEntry_s* heap = top->entries[kind];
+   ScanTopEntry_s* entry = NULL;
+
+   if(scanTopQualifies(top, kind, size) == 0)
+   {
+      return;
+   }
+
+   // a free slot at the end rises, a replaced root sinks
+   entry = (top->count[kind] < top->capacity) ? &heap[top->count[kind]] : &heap[0];
+   entry->size   = size;
+   entry->dirDev = dirDev;
+   entry->dirIno = dirIno;
+   setPath(entry, folder, folderLen, name);
+
+   if(top->count[kind] < top->capacity)
+   {
+      siftUp(heap, top->count[kind]++);
+   }
+   else
+   {
+      siftDown(heap, top->count[kind], 0);
+   }
+}
+
+
+
+void scanTopCarry(ScanTop_s* top, unsigned long long dirDev, unsigned long long dirIno, const char* folder, unsigned int folderLen)
+{
+   unsigned int i = 0;
+   const ScanTop_s* previous = top->previous;
+
+   if(previous == NULL || previous->valid == 0 || dirIno == 0)
+   {
+      return;
+   }
+
+   for(i = 0; i < previous->count[ScanTopKind_File]; i++)
+   {
+      const ScanTopEntry_s* old = &previous->entries[ScanTopKind_File][i];
+
+      // the folder may have been moved, so the path is rebuilt from its current one
+      if(old->dirDev == dirDev && old->dirIno == dirIno)
+      {
+         scanTopAdd(top, ScanTopKind_File, old->size, dirDev, dirIno, folder, folderLen, old->path + old->nameOffset);
+      }
+   }
+}
+
+
+
+int scanTopGetSorted(const ScanTop_s* top, ScanTopKind_e kind, ScanTopEntry_s* entries, int max)
+{
+   int count = (int)top->count[kind];
+   ScanTopEntry_s sorted[SCAN_TOP_MAX_ENTRIES];
+
+   memcpy(sorted, top->entries[kind], count * sizeof(ScanTopEntry_s));
+   qsort(sorted, count, sizeof(ScanTopEntry_s), compareSizeDesc);
+
+   if(count > max)
+   {
+      count = max;      // the smallest entries are dropped
+   }
+   memcpy(entries, sorted, count * sizeof(ScanTopEntry_s));
+
+   return count;
+}
+
+
+
+static void siftUp(ScanTopEntry_s* heap, unsigned int index)
+{
+   ScanTopEntry_s entry = heap[index];
+
+   while(index > 0 && heap[(index - 1) / 2].size > entry.size)
+   {
+      heap[index] = heap[(index - 1) / 2];
+      index = (index - 1) / 2;
+   }
+   heap[index] = entry;
+}
+
+
+
+static void siftDown(ScanTopEntry_s* heap, unsigned int count, unsigned int index)
+{
+   ScanTopEntry_s entry = heap[index];
+
+   for(;;)
+   {
+      unsigned int child = 2 * index + 1;
+
+      if(child >= count)
+      {
+         break;
+      }
+      if(child + 1 < count && heap[child + 1].size < heap[child].size)
+      {
+         child++;
+      }
+      if(heap[child].size >= entry.size)
+      {
+         break;
+      }
+      heap[index] = heap[child];
+      index = child;
+   }
+   heap[index] = entry;
+}
+
+
+
+static void setPath(ScanTopEntry_s* entry, const char* folder, unsigned int folderLen, const char* name)
+{
+   unsigned int len = (folderLen < SCAN_TOP_PATH_SIZE - 1) ? folderLen : SCAN_TOP_PATH_SIZE - 1;
+
+   memcpy(entry->path, folder, len);
+
+   if(name != NULL)
+   {
+      size_t nameLen = strlen(name);
+
+      if(len > 0 && len < SCAN_TOP_PATH_SIZE - 1)
+      {
+         entry->path[len++] = '/';
+      }
+      entry->nameOffset = len;
+      if(nameLen > SCAN_TOP_PATH_SIZE - 1 - len)
+      {
+         nameLen = SCAN_TOP_PATH_SIZE - 1 - len;
+      }
+      memcpy(entry->path + len, name, nameLen);
+      len += (unsigned int)nameLen;
+   }
+   else
+   {
+      const char* slash = memrchr(entry->path, '/', len);
+      entry->nameOffset = (slash != NULL) ? (unsigned int)(slash - entry->path) + 1 : 0;
+   }
+
+   entry->path[len] = '\0';
+}
+
+
+
+static int compareSizeDesc(const void* p1, const void* p2)
+{
+   const ScanTopEntry_s* e1 = (const ScanTopEntry_s*)p1;
+   const ScanTopEntry_s* e2 = (const ScanTopEntry_s*)p2;
+
+   return (e1->size < e2->size) ? 1 : ((e1->size > e2->size) ? -1 : 0);
+}
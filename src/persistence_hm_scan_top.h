@@ -0,0 +1,167 @@
+#ifndef PERSISTENCE_HM_SCAN_TOP_H_
+#define PERSISTENCE_HM_SCAN_TOP_H_
+
+/******************************************************************************
+ * Project         Persistency
+ * (c) copyright   2014
+ * Company         XS Embedded GmbH
+ *****************************************************************************/
+/******************************************************************************
+ * This Source Code Form is subject to the terms of the
+ * Mozilla Public License, v. 2.0. If a  copy of the MPL was not distributed
+ * with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
+******************************************************************************/
+ /**
+ * @file           persistence_hm_scan_top.h
+ * @ingroup        Persistence Health Monitor
+ * @author         Ingo Huerner
+ * @brief          Header of the persistence health monitor top consumer lists.
+ *                 While walking an application folder the scanner offers every file and
+ *                 every sub folder (with the total of its tree) to a bounded list that
+ *                 keeps the largest ones. An entry below the smallest kept one costs a
+ *                 single compare, so the list is collected with every regular scan.
+ * @see
+ */
+
+
+/// maximum number of entries per list
+#define SCAN_TOP_MAX_ENTRIES 32
+/// maximum length of a path in a list, including the terminating 0; longer paths are cut
+#define SCAN_TOP_PATH_SIZE 256
+
+
+/// what a list holds
+typedef enum ScanTopKind_e_
+{
+   /// regular files
+   ScanTopKind_File = 0,
+   /// sub folders of the application folder, with the total of their tree
+   ScanTopKind_Folder,
+
+   // insert new entries here ...
+
+   /// last entry
+   ScanTopKind_LastEntry
+
+} ScanTopKind_e;
+
+
+/// one file or folder of a list
+typedef struct ScanTopEntry_s_
+{
+   /// size of the file or of the folder tree (see DiskScanMetric_e)
+   unsigned long long size;
+   /// device and inode of the folder holding a file, 0 if unknown
+   unsigned long long dirDev;
+   unsigned long long dirIno;
+   /// offset of the last path component in path
+   unsigned int nameOffset;
+   /// path relative to the application folder
+   char path[SCAN_TOP_PATH_SIZE];
+
+} ScanTopEntry_s;
+
+
+/// the largest files and folders of one application folder
+typedef struct ScanTop_s_ ScanTop_s;
+
+struct ScanTop_s_
+{
+   /// maximum number of entries per list
+   unsigned int capacity;
+   /// number of entries per list
+   unsigned int count[ScanTopKind_LastEntry];
+   /// the lists, min-heaps ordered by size (the smallest kept entry first)
+   ScanTopEntry_s* entries[ScanTopKind_LastEntry];
+   /// 1 if a walk has filled the lists completely
+   int valid;
+   /// the lists of the previous scan of the same folder or NULL; the files of folders
+   /// served from the folder size cache are taken over from it
+   const ScanTop_s* previous;
+};
+
+
+/**
+ * @brief Create empty lists
+ *
+ * @param capacity maximum number of entries per list, 1 ... SCAN_TOP_MAX_ENTRIES
+ *
+ * @return the lists or NULL if memory is exhausted or the capacity is invalid
+ */
+ScanTop_s* scanTopCreate(unsigned int capacity);
+
+
+/**
+ * @brief Release lists
+ *
+ * @param top the lists
+ */
+void scanTopDestroy(ScanTop_s* top);
+
+
+/**
+ * @brief Empty the lists at the start of a walk, they are invalid until the walk completes
+ *
+ * @param top the lists
+ */
+void scanTopBegin(ScanTop_s* top);
+
+
+/**
+ * @brief Check if an entry would be kept, so the caller builds the path only then
+ *
+ * @param top the lists
+ * @param kind the list
+ * @param size size of the entry
+ *
+ * @return 1 if the entry would be kept, 0 otherwise
+ */
+static inline int scanTopQualifies(const ScanTop_s* top, ScanTopKind_e kind, unsigned long long size)
+{
+   return (top->count[kind] < top->capacity || size > top->entries[kind][0].size) ? 1 : 0;
+}
+
+
+/**
+ * @brief Offer an entry to a list
+ *
+ * @param top the lists
+ * @param kind the list
+ * @param size size of the entry
+ * @param dirDev device of the folder holding a file, 0 if unknown
+ * @param dirIno inode of the folder holding a file, 0 if unknown
+ * @param folder path of the folder holding the entry (not 0 terminated), or of the folder itself
+ * @param folderLen length of folder
+ * @param name name of the entry inside folder or NULL if folder is the entry
+ */
+void scanTopAdd(ScanTop_s* top, ScanTopKind_e kind, unsigned long long size, unsigned long long dirDev,
+                unsigned long long dirIno, const char* folder, unsigned int folderLen, const char* name);
+
+
+/**
+ * @brief Take over the files of a folder from the previous lists.
+ *        Used for a folder served from the folder size cache, whose files are not looked at.
+ *
+ * @param top the lists
+ * @param dirDev device of the folder
+ * @param dirIno inode of the folder
+ * @param folder path of the folder now (not 0 terminated)
+ * @param folderLen length of folder
+ */
+void scanTopCarry(ScanTop_s* top, unsigned long long dirDev, unsigned long long dirIno, const char* folder, unsigned int folderLen);
+
+
+/**
+ * @brief Get a list ordered by size, the largest entry first
+ *
+ * @param top the lists
+ * @param kind the list
+ * @param entries [out] the entries
+ * @param max number of entries fitting into entries
+ *
+ * @return number of entries
+ */
+int scanTopGetSorted(const ScanTop_s* top, ScanTopKind_e kind, ScanTopEntry_s* entries, int max);
+
+
+#endif /* PERSISTENCE_HM_SCAN_TOP_H_ */
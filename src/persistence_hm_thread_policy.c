@@ -0,0 +1,272 @@
+/******************************************************************************
+ * Project         Persistency
+ * (c) copyright   2014
+ * Company         XS Embedded GmbH
+ *****************************************************************************/
+/******************************************************************************
+ * This Source Code Form is subject to the terms of the
+ * Mozilla Public License, v. 2.0. If a  copy of the MPL was not distributed
+ * with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
+******************************************************************************/
+ /**
+ * @file           persistence_hm_thread_policy.c
+ * @ingroup        Persistence Health Monitor
+ * @author         Ingo Huerner
+ * @brief          Implementation of the persistence health monitor thread policies.
+ *                 On Linux the scheduling class, nice value, I/O priority and affinity
+ *                 are attributes of a thread (task), so all of them are set for the
+ *                 thread ID of the caller and not for the process.
+ * @see
+ */
+
+#include "persistence_hm_definitions.h"
+#include "persistence_hm_thread_policy.h"
+
+#include <sched.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+
+
+// the kernel headers only export these since linux 5.13 (linux/ioprio.h), glibc has no wrapper
+#ifndef IOPRIO_CLASS_SHIFT
+#define IOPRIO_CLASS_SHIFT 13
+#endif
+#ifndef IOPRIO_PRIO_VALUE
+#define IOPRIO_PRIO_VALUE(class, data) (((class) << IOPRIO_CLASS_SHIFT) | (data))
+#endif
+#ifndef IOPRIO_WHO_PROCESS
+#define IOPRIO_WHO_PROCESS 1
+#endif
+
+/// I/O scheduling classes
+enum ioprioClass
+{
+   IOPRIO_NONE = 0,
+   IOPRIO_RT,
+   IOPRIO_BE,
+   IOPRIO_IDLE
+};
+
+
+/// scheduling of one thread
+typedef struct ThreadPolicy_s_
+{
+   /// SCHED_OTHER, SCHED_BATCH or SCHED_IDLE, -1 = unchanged
+   int sched;
+   /// the nice value, only applied if niceSet is 1
+   int nice;
+   int niceSet;
+   /// I/O scheduling class (ioprioClass), -1 = unchanged
+   int ioClass;
+   /// level within the I/O class, 0 = highest
+   int ioLevel;
+   /// the allowed CPUs, only applied if cpusSet is 1
+   cpu_set_t cpus;
+   int cpusSet;
+} ThreadPolicy_s;
+
+
+static ThreadPolicy_s gPolicies[ThreadPolicy_LastEntry] =
+{
+   { -1, 0, 0, -1, 0, { { 0 } }, 0 },
+   { -1, 0, 0, -1, 0, { { 0 } }, 0 }
+};
+
+static const char* gPolicyNames[ThreadPolicy_LastEntry] = { "monitor", "dbus" };
+
+
+// local function prototypes
+static int parseCpuList(const char* value, cpu_set_t* cpus);
+//----------------------------------------------------------
+
+
+
+const char* threadPolicyGetName(ThreadPolicyId_e id)
+{
+   return (id < ThreadPolicy_LastEntry) ? gPolicyNames[id] : "unknown";
+}
+
+
+
+int threadPolicySetOption(ThreadPolicyId_e id, const char* name, const char* value)
+{
+   ThreadPolicy_s* policy = NULL;
+
+   if(id >= ThreadPolicy_LastEntry)
+   {
+      return -1;
+   }
+   policy = &gPolicies[id];
+
+   if(0 == strcmp(name, "Sched"))
+   {
+      if(0 == strcmp(value, "other"))
+      {
+         policy->sched = SCHED_OTHER;
+      }
+      else if(0 == strcmp(value, "batch"))
+      {
+         policy->sched = SCHED_BATCH;
+      }
+      else if(0 == strcmp(value, "idle"))
+      {
+         policy->sched = SCHED_IDLE;
+      }
+      else
+      {
+         return -1;
+      }
+   }
+   else if(0 == strcmp(name, "Nice"))
+   {
+      int nice = atoi(value);
+      if(nice < -20 || nice > 19)
+      {
+         return -1;
+      }
+      policy->nice    = nice;
+      policy->niceSet = 1;
+   }
+   else if(0 == strcmp(name, "IoPrio"))
+   {
+      int level = 0;
+
+      if(0 == strcmp(value, "none"))
+      {
+         policy->ioClass = IOPRIO_NONE;
+      }
+      else if(0 == strcmp(value, "idle"))
+      {
+         policy->ioClass = IOPRIO_IDLE;
+      }
+      else if(   (0 == strncmp(value, "be:", 3) || 0 == strncmp(value, "rt:", 3))
+              && value[3] >= '0' && value[3] <= '7' && value[4] == '\0')
+      {
+         level = value[3] - '0';
+         policy->ioClass = (value[0] == 'b') ? IOPRIO_BE : IOPRIO_RT;
+      }
+      else
+      {
+         return -1;
+      }
+      policy->ioLevel = level;
+   }
+   else if(0 == strcmp(name, "Cpus"))
+   {
+      if(parseCpuList(value, &policy->cpus) == -1)
+      {
+         return -1;
+      }
+      policy->cpusSet = 1;
+   }
+   else
+   {
+      return -1;
+   }
+
+   return 0;
+}
+
+
+
+int threadPolicyApply(ThreadPolicyId_e id)
+{
+   int rval = 0;
+   const ThreadPolicy_s* policy = NULL;
+   pid_t tid = (pid_t)syscall(SYS_gettid);
+
+   if(id >= ThreadPolicy_LastEntry)
+   {
+      return -1;
+   }
+   policy = &gPolicies[id];
+
+   if(policy->sched != -1)
+   {
+      struct sched_param param;
+
+      memset(&param, 0, sizeof(param));
+      if(sched_setscheduler(tid, policy->sched, &param) == -1)
+      {
+         DLT_LOG(phmContext, DLT_LOG_WARN, DLT_STRING("threadPolicyApply - failed to set scheduling class:"), DLT_STRING(gPolicyNames[id]),
+                                           DLT_STRING(strerror(errno)));
+         rval = -1;
+      }
+   }
+
+   if(policy->niceSet == 1 && setpriority(PRIO_PROCESS, (id_t)tid, policy->nice) == -1)
+   {
+      DLT_LOG(phmContext, DLT_LOG_WARN, DLT_STRING("threadPolicyApply - failed to set nice value:"), DLT_STRING(gPolicyNames[id]),
+                                        DLT_INT(policy->nice), DLT_STRING(strerror(errno)));
+      rval = -1;
+   }
+
+   if(   policy->ioClass != -1
+      && syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, (int)tid, IOPRIO_PRIO_VALUE(policy->ioClass, policy->ioLevel)) == -1)
+   {
+      DLT_LOG(phmContext, DLT_LOG_WARN, DLT_STRING("threadPolicyApply - failed to set I/O priority:"), DLT_STRING(gPolicyNames[id]),
+                                        DLT_STRING(strerror(errno)));
+      rval = -1;
+   }
+
+   if(policy->cpusSet == 1 && sched_setaffinity(tid, sizeof(cpu_set_t), &policy->cpus) == -1)
+   {
+      DLT_LOG(phmContext, DLT_LOG_WARN, DLT_STRING("threadPolicyApply - failed to set CPU affinity:"), DLT_STRING(gPolicyNames[id]),
+                                        DLT_STRING(strerror(errno)));
+      rval = -1;
+   }
+
+   return rval;
+}
+
+
+
+static int parseCpuList(const char* value, cpu_set_t* cpus)
+{
+   const char* pos = value;
+
+   CPU_ZERO(cpus);
+
+   while(*pos != '\0')
+   {
+      char* end = NULL;
+      long first = strtol(pos, &end, 10);
+      long last = first;
+
+      if(end == pos || first < 0 || first >= CPU_SETSIZE)
+      {
+         return -1;
+      }
+      pos = end;
+
+      if(*pos == '-')
+      {
+         last = strtol(pos + 1, &end, 10);
+         if(end == pos + 1 || last < first || last >= CPU_SETSIZE)
+         {
+            return -1;
+         }
+         pos = end;
+      }
+
+      for(; first <= last; first++)
+      {
+         CPU_SET((int)first, cpus);
+      }
+
+      if(*pos == ',')
+      {
+         pos++;
+      }
+      else if(*pos != '\0')
+      {
+         return -1;
+      }
+   }
+
+   return (CPU_COUNT(cpus) > 0) ? 0 : -1;
+}
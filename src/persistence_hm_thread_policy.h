@@ -0,0 +1,80 @@
+#ifndef PERSISTENCE_HM_THREAD_POLICY_H_
+#define PERSISTENCE_HM_THREAD_POLICY_H_
+
+/******************************************************************************
+ * Project         Persistency
+ * (c) copyright   2014
+ * Company         XS Embedded GmbH
+ *****************************************************************************/
+/******************************************************************************
+ * This Source Code Form is subject to the terms of the
+ * Mozilla Public License, v. 2.0. If a  copy of the MPL was not distributed
+ * with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
+******************************************************************************/
+ /**
+ * @file           persistence_hm_thread_policy.h
+ * @ingroup        Persistence Health Monitor
+ * @author         Ingo Huerner
+ * @brief          Header of the persistence health monitor thread policies.
+ *                 A policy holds the scheduling class, nice value, I/O priority and
+ *                 CPU affinity of one PHM thread. It is applied by the thread itself,
+ *                 threads it creates afterwards inherit it.
+ * @see
+ */
+
+
+/// the PHM threads with a configurable policy
+typedef enum ThreadPolicyId_e_
+{
+   /// the disk monitor thread and its scan workers
+   ThreadPolicy_Monitor = 0,
+   /// the thread running the D-Bus mainloop
+   ThreadPolicy_Dbus,
+
+   // insert new entries here ...
+
+   /// last entry
+   ThreadPolicy_LastEntry
+
+} ThreadPolicyId_e;
+
+
+/**
+ * @brief Get the prefix of the configuration options of a thread
+ *
+ * @param id the thread
+ *
+ * @return the prefix ("monitor" or "dbus")
+ */
+const char* threadPolicyGetName(ThreadPolicyId_e id);
+
+
+/**
+ * @brief Set one option of a thread policy
+ *
+ * @param id the thread
+ * @param name the option without the thread prefix:
+ *             "Sched"  "other", "batch" or "idle"
+ *             "Nice"   -20 ... 19 (not used with "idle")
+ *             "IoPrio" "none", "idle" or "be:<0-7>"/"rt:<0-7>" (class and level)
+ *             "Cpus"   list of CPUs, e.g. "0,2-3"
+ * @param value the value of the option
+ *
+ * @return 0 on success, -1 if the option is unknown or the value is invalid
+ */
+int threadPolicySetOption(ThreadPolicyId_e id, const char* name, const char* value);
+
+
+/**
+ * @brief Apply the policy of a thread to the calling thread.
+ *        Settings that fail (e.g. a negative nice value without CAP_SYS_NICE) are
+ *        logged and skipped, the others are applied anyway.
+ *
+ * @param id the thread
+ *
+ * @return 0 if everything has been applied, -1 if at least one setting failed
+ */
+int threadPolicyApply(ThreadPolicyId_e id);
+
+
+#endif /* PERSISTENCE_HM_THREAD_POLICY_H_ */
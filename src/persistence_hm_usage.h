@@ -0,0 +1,308 @@
+#ifndef PERSISTENCE_HM_USAGE_H_
+#define PERSISTENCE_HM_USAGE_H_
+
+/******************************************************************************
+ * Project         Persistency
+ * (c) copyright   2014
+ * Company         XS Embedded GmbH
+ *****************************************************************************/
+/******************************************************************************
+ * This Source Code Form is subject to the terms of the
+ * Mozilla Public License, v. 2.0. If a  copy of the MPL was not distributed
+ * with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
+******************************************************************************/
+ /**
+ * @file           persistence_hm_usage.h
+ * @ingroup        Persistence Health Monitor
+ * @author         Ingo Huerner
+ * @brief          Reader of the usage snapshot published by the persistence health monitor.
+ *                 The disk monitor publishes the usage, limit and health of every
+ *                 application and persistence root after each round in a read-only
+ *                 shared memory segment. The segment is protected by a sequence lock:
+ *                 the monitor makes the sequence odd while it writes, readers copy the
+ *                 data and retry if the sequence was odd or has changed meanwhile.
+ *                 A read needs no system call unless the monitor is writing, and it
+ *                 never blocks the monitor.
+ *                 This header is self-contained (static inline functions), clients only
+ *                 need to link librt for shm_open on older C libraries.
+ * @see
+ */
+
+#include <fcntl.h>
+#include <limits.h>
+#include <stddef.h>
+#include <string.h>
+#include <time.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+
+/// name of the shared memory segment
+#define PHM_USAGE_SHM_NAME "/persistence_phm_usage"
+/// layout version, changed with every incompatible change of the structures below
+#define PHM_USAGE_VERSION 3
+/// maximum number of persistence roots in the snapshot
+#define PHM_USAGE_MAX_ROOTS 8
+/// maximum number of applications of all roots together in the snapshot
+#define PHM_USAGE_MAX_APPS 512
+/// maximum length of an AppID in the snapshot, including the terminating 0 (any folder name fits)
+#define PHM_USAGE_APPID_SIZE (NAME_MAX + 1)
+/// maximum length of a root path in the snapshot, including the terminating 0
+#define PHM_USAGE_PATH_SIZE PATH_MAX
+/// time a reader waits for the monitor to finish an update before it gives up [ms]
+#define PHM_USAGE_READ_TIMEOUT_MS 200
+
+
+/// health of an application or a persistence root
+typedef enum PhmHealth_e_
+{
+   /// not yet measured
+   PhmHealth_Unknown = 0,
+   /// enough space left
+   PhmHealth_Ok,
+   /// application: within 10 percent of its size or inode limit or predicted to reach one soon;
+   /// root: below a watermark or predicted to be full soon
+   PhmHealth_Low,
+   /// application: size or inode limit reached; root: no blocks or inodes left for applications
+   PhmHealth_Full,
+
+   // insert new entries here ...
+
+   /// last entry
+   PhmHealth_LastEntry
+
+} PhmHealth_e;
+
+
+/// usage of one application
+typedef struct PhmUsageApp_s_
+{
+   /// the AppID (name of the application folder)
+   char appId[PHM_USAGE_APPID_SIZE];
+   /// index of the root in PhmUsageSnapshot_s::roots
+   unsigned int root;
+   /// PhmHealth_e
+   unsigned int health;
+   /// size measured by the last scan [bytes]
+   unsigned long long size;
+   /// configured size, 0 = no limit
+   unsigned long long limit;
+   /// inodes (files and folders) measured by the last scan, 0 = not counted (btrfs quota groups)
+   unsigned long long inodes;
+   /// configured number of inodes, 0 = no limit
+   unsigned long long inodeLimit;
+   /// predicted time until a limit is reached [ms], -1 = not growing or no limit
+   long long timeToLimitMs;
+   /// time of the last scan [ms, CLOCK_MONOTONIC], 0 = not scanned yet
+   long long scanTimeMs;
+
+} PhmUsageApp_s;
+
+
+/// usage of one persistence root (partition)
+typedef struct PhmUsageRoot_s_
+{
+   /// the root folder
+   char path[PHM_USAGE_PATH_SIZE];
+   /// PhmHealth_e
+   unsigned int health;
+   /// number of applications of the root in the snapshot
+   unsigned int appCount;
+   /// used bytes of the partition
+   unsigned long long used;
+   /// bytes applications may use in total (used + available to non-root users)
+   unsigned long long limit;
+   /// used inodes of the partition, 0 = the file system has no inode table
+   unsigned long long inodesUsed;
+   /// inodes applications may use in total (used + available to non-root users)
+   unsigned long long inodesLimit;
+   /// predicted time until the blocks or inodes of the partition are gone [ms], -1 = not growing
+   long long timeToFullMs;
+
+} PhmUsageRoot_s;
+
+
+/// the snapshot
+typedef struct PhmUsageSnapshot_s_
+{
+   /// PHM_USAGE_VERSION of the monitor
+   unsigned int version;
+   /// number of valid entries in roots
+   unsigned int rootCount;
+   /// number of valid entries in apps
+   unsigned int appCount;
+   /// number of roots and applications known to the monitor but not in the snapshot (it is
+   /// full); an application not found while missingApps > 0 may exist nevertheless
+   unsigned int missingRoots;
+   unsigned int missingApps;
+   /// time of the last update [ms, CLOCK_MONOTONIC]
+   long long updateMs;
+   PhmUsageRoot_s roots[PHM_USAGE_MAX_ROOTS];
+   PhmUsageApp_s apps[PHM_USAGE_MAX_APPS];
+
+} PhmUsageSnapshot_s;
+
+
+/// the shared memory segment
+typedef struct PhmUsageShm_s_
+{
+   /// sequence lock: odd while the monitor writes
+   unsigned int sequence;
+   /// the data protected by the sequence lock
+   PhmUsageSnapshot_s snapshot;
+
+} PhmUsageShm_s;
+
+
+/**
+ * @brief Map the snapshot of the monitor
+ *
+ * @return the mapping or NULL if the monitor does not publish a snapshot (yet)
+ */
+static inline const PhmUsageShm_s* phmUsageOpen(void)
+{
+   void* map = MAP_FAILED;
+   int fd = shm_open(PHM_USAGE_SHM_NAME, O_RDONLY | O_CLOEXEC, 0);
+
+   if(fd == -1)
+   {
+      return NULL;
+   }
+   map = mmap(0, sizeof(PhmUsageShm_s), PROT_READ, MAP_SHARED, fd, 0);
+   close(fd);
+
+   return (map != MAP_FAILED) ? (const PhmUsageShm_s*)map : NULL;
+}
+
+
+/**
+ * @brief Unmap the snapshot
+ *
+ * @param shm the mapping returned by phmUsageOpen
+ */
+static inline void phmUsageClose(const PhmUsageShm_s* shm)
+{
+   if(shm != NULL)
+   {
+      munmap((void*)shm, sizeof(PhmUsageShm_s));
+   }
+}
+
+
+/**
+ * @brief Copy a consistent part of the snapshot
+ *
+ * @param shm the mapping
+ * @param offset offset of the part in PhmUsageSnapshot_s
+ * @param size size of the part
+ * @param data [out] the copy
+ *
+ * @return 0 on success, -1 if the layout version of the monitor differs or the monitor has not
+ *         finished an update within PHM_USAGE_READ_TIMEOUT_MS (e.g. it has died while writing)
+ */
+static inline int phmUsageRead(const PhmUsageShm_s* shm, size_t offset, size_t size, void* data)
+{
+   unsigned int before = 0;
+   long long waitedNs = -1;
+   struct timespec start, now;
+
+   for(;;)
+   {
+      before = __atomic_load_n(&shm->sequence, __ATOMIC_ACQUIRE);
+      if((before & 1) == 0)
+      {
+         if(shm->snapshot.version != PHM_USAGE_VERSION)
+         {
+            return -1;
+         }
+         memcpy(data, (const char*)&shm->snapshot + offset, size);
+         __atomic_thread_fence(__ATOMIC_ACQUIRE);
+         if(__atomic_load_n(&shm->sequence, __ATOMIC_RELAXED) == before)
+         {
+            return 0;
+         }
+      }
+
+      // the monitor is writing: let it run, the clock is only read once a retry is needed
+      if(waitedNs == -1)
+      {
+         clock_gettime(CLOCK_MONOTONIC, &start);
+         waitedNs = 0;
+      }
+      else
+      {
+         clock_gettime(CLOCK_MONOTONIC, &now);
+         waitedNs = (now.tv_sec - start.tv_sec) * 1000000000LL + (now.tv_nsec - start.tv_nsec);
+         if(waitedNs > PHM_USAGE_READ_TIMEOUT_MS * 1000000LL)
+         {
+            return -1;
+         }
+      }
+      (void)sched_yield();
+   }
+}
+
+
+/**
+ * @brief Get the usage of an application
+ *
+ * @param shm the mapping
+ * @param appId the AppID
+ * @param app [out] the usage; the first match of all roots
+ *
+ * @return 0 on success, -1 if the snapshot can not be read (see phmUsageRead: the monitor
+ *         does not publish), -2 if the application is not in the snapshot (see missingApps)
+ */
+static inline int phmUsageGetApp(const PhmUsageShm_s* shm, const char* appId, PhmUsageApp_s* app)
+{
+   unsigned int i = 0, count = 0;
+
+   if(phmUsageRead(shm, offsetof(PhmUsageSnapshot_s, appCount), sizeof(count), &count) == -1)
+   {
+      return -1;
+   }
+
+   // the entry is copied first and compared afterwards, so the name and the values belong together
+   for(i = 0; i < count && i < PHM_USAGE_MAX_APPS; i++)
+   {
+      if(phmUsageRead(shm, offsetof(PhmUsageSnapshot_s, apps) + i * sizeof(PhmUsageApp_s), sizeof(PhmUsageApp_s), app) == -1)
+      {
+         return -1;
+      }
+      if(strncmp(app->appId, appId, PHM_USAGE_APPID_SIZE) == 0)
+      {
+         return 0;
+      }
+   }
+   return -2;
+}
+
+
+/**
+ * @brief Get the usage of a persistence root
+ *
+ * @param shm the mapping
+ * @param index index of the root, 0 ... rootCount-1
+ * @param root [out] the usage
+ *
+ * @return 0 on success, -1 if the snapshot can not be read (see phmUsageRead: the monitor
+ *         does not publish), -2 if there is no such root
+ */
+static inline int phmUsageGetRoot(const PhmUsageShm_s* shm, unsigned int index, PhmUsageRoot_s* root)
+{
+   unsigned int count = 0;
+
+   if(phmUsageRead(shm, offsetof(PhmUsageSnapshot_s, rootCount), sizeof(count), &count) == -1)
+   {
+      return -1;
+   }
+   if(index >= count || index >= PHM_USAGE_MAX_ROOTS)
+   {
+      return -2;
+   }
+   return phmUsageRead(shm, offsetof(PhmUsageSnapshot_s, roots) + index * sizeof(PhmUsageRoot_s), sizeof(PhmUsageRoot_s), root);
+}
+
+
+#endif /* PERSISTENCE_HM_USAGE_H_ */
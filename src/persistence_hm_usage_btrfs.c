@@ -0,0 +1,199 @@
+/******************************************************************************
+ * Project         Persistency
+ * (c) copyright   2014
+ * Company         XS Embedded GmbH
+ *****************************************************************************/
+/******************************************************************************
+ * This Source Code Form is subject to the terms of the
+ * Mozilla Public License, v. 2.0. If a  copy of the MPL was not distributed
+ * with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
+******************************************************************************/
+ /**
+ * @file           persistence_hm_usage_btrfs.c
+ * @ingroup        Persistence Health Monitor
+ * @author         Ingo Huerner
+ * @brief          Implementation of the btrfs quota group usage provider.
+ *                 Every application folder is a subvolume; its level 0 quota group
+ *                 (0/<subvolume id>) is looked up in the quota tree with a tree search.
+ *                 The referenced bytes are reported, extents shared with snapshots
+ *                 count for every subvolume referring to them.
+ * @see
+ */
+
+#include "persistence_hm_definitions.h"
+#include "persistence_hm_usage_quota.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#if defined(HAVE_LINUX_BTRFS_H) && defined(HAVE_LINUX_BTRFS_TREE_H)
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/ioctl.h>
+#include <sys/vfs.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <endian.h>
+#include <linux/magic.h>
+#include <linux/btrfs.h>
+#include <linux/btrfs_tree.h>
+
+
+/// state of the btrfs provider
+typedef struct UsageBtrfs_s_
+{
+   /// descriptor of the root folder, the tree search runs on it
+   int rootFd;
+} UsageBtrfs_s;
+
+
+// local function prototypes
+static int searchQuotaTree(int fd, unsigned int type, unsigned long long offset, void* item, size_t size);
+//----------------------------------------------------------
+
+
+
+void* usageBtrfsCreate(const char* rootPath)
+{
+   struct statfs fsBuf;
+   struct btrfs_qgroup_status_item status;
+   UsageBtrfs_s* btrfs = calloc(1, sizeof(UsageBtrfs_s));
+
+   if(btrfs == NULL)
+   {
+      return NULL;
+   }
+
+   btrfs->rootFd = open(rootPath, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+   if(   btrfs->rootFd != -1
+      && fstatfs(btrfs->rootFd, &fsBuf) == 0 && fsBuf.f_type == BTRFS_SUPER_MAGIC
+      && searchQuotaTree(btrfs->rootFd, BTRFS_QGROUP_STATUS_KEY, 0, &status, sizeof(status)) == 0)
+   {
+      if((le64toh(status.flags) & BTRFS_QGROUP_STATUS_FLAG_INCONSISTENT) != 0)
+      {
+         DLT_LOG(phmContext, DLT_LOG_WARN, DLT_STRING("usageBtrfs - quota groups inconsistent, rescan needed:"), DLT_STRING(rootPath));
+      }
+      return btrfs;
+   }
+
+   DLT_LOG(phmContext, DLT_LOG_INFO, DLT_STRING("usageBtrfs - no btrfs or quota disabled:"), DLT_STRING(rootPath));
+   usageBtrfsDestroy(btrfs);
+
+   return NULL;
+}
+
+
+
+void usageBtrfsDestroy(void* state)
+{
+   UsageBtrfs_s* btrfs = (UsageBtrfs_s*)state;
+
+   if(btrfs != NULL)
+   {
+      if(btrfs->rootFd != -1)
+      {
+         close(btrfs->rootFd);
+      }
+      free(btrfs);
+   }
+}
+
+
+
+int usageBtrfsQuery(void* state, int rootFd, const char* appId, DiskScanUsage_s* usage)
+{
+   int rval = -1;
+   struct stat buf;
+   struct btrfs_ioctl_ino_lookup_args lookup;
+   struct btrfs_qgroup_info_item info;
+   int fd = openat(rootFd, appId, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+
+   memset(usage, 0, sizeof(DiskScanUsage_s));
+
+   if(fd == -1)
+   {
+      return -1;
+   }
+
+   memset(&lookup, 0, sizeof(lookup));
+   lookup.objectid = BTRFS_FIRST_FREE_OBJECTID;
+
+   // the top folder of a subvolume always has the first free object id as inode number
+   if(   fstat(fd, &buf) == 0 && buf.st_ino == BTRFS_FIRST_FREE_OBJECTID
+      && ioctl(fd, BTRFS_IOC_INO_LOOKUP, &lookup) == 0
+      && searchQuotaTree(((UsageBtrfs_s*)state)->rootFd, BTRFS_QGROUP_INFO_KEY, lookup.treeid, &info, sizeof(info)) == 0)
+   {
+      usage->size = (unsigned long long)le64toh(info.rfer);
+      rval = 0;
+   }
+
+   close(fd);
+
+   return rval;
+}
+
+
+
+static int searchQuotaTree(int fd, unsigned int type, unsigned long long offset, void* item, size_t size)
+{
+   struct btrfs_ioctl_search_args args;
+   const struct btrfs_ioctl_search_header* header = (const struct btrfs_ioctl_search_header*)args.buf;
+
+   memset(&args, 0, sizeof(args));
+   args.key.tree_id      = BTRFS_QUOTA_TREE_OBJECTID;
+   args.key.min_objectid = 0;
+   args.key.max_objectid = 0;
+   args.key.min_type     = type;
+   args.key.max_type     = type;
+   args.key.min_offset   = offset;
+   args.key.max_offset   = offset;
+   args.key.min_transid  = 0;
+   args.key.max_transid  = (__u64)-1;
+   args.key.nr_items     = 1;
+
+   if(ioctl(fd, BTRFS_IOC_TREE_SEARCH, &args) == -1)
+   {
+      return -1;     // ENOENT: quota disabled, EPERM: needs CAP_SYS_ADMIN
+   }
+
+   if(args.key.nr_items < 1 || header->type != type || header->offset != offset || header->len < size)
+   {
+      return -1;
+   }
+
+   memcpy(item, header + 1, size);
+
+   return 0;
+}
+
+
+#else
+
+
+void* usageBtrfsCreate(const char* rootPath)
+{
+   (void)rootPath;
+   DLT_LOG(phmContext, DLT_LOG_INFO, DLT_STRING("usageBtrfs - built without btrfs support"));
+   return NULL;
+}
+
+
+void usageBtrfsDestroy(void* state)
+{
+   (void)state;
+}
+
+
+int usageBtrfsQuery(void* state, int rootFd, const char* appId, DiskScanUsage_s* usage)
+{
+   (void)state;
+   (void)rootFd;
+   (void)appId;
+   memset(usage, 0, sizeof(DiskScanUsage_s));
+   return -1;
+}
+
+
+#endif
@@ -0,0 +1,340 @@
+/******************************************************************************
+ * Project         Persistency
+ * (c) copyright   2014
+ * Company         XS Embedded GmbH
+ *****************************************************************************/
+/******************************************************************************
+ * This Source Code Form is subject to the terms of the
+ * Mozilla Public License, v. 2.0. If a  copy of the MPL was not distributed
+ * with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
+******************************************************************************/
+ /**
+ * @file           persistence_hm_usage_provider.c
+ * @ingroup        Persistence Health Monitor
+ * @author         Ingo Huerner
+ * @brief          Implementation of the persistence health monitor usage providers.
+ *                 Every provider other than the walk answers one application at a time
+ *                 through its entry in gProviderOps; whatever it can not answer is
+ *                 collected and walked on the scan pool afterwards.
+ * @see
+ */
+
+#include "persistence_hm_definitions.h"
+#include "persistence_hm_usage_provider.h"
+#include "persistence_hm_usage_quota.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+
+/// operations of a provider answering per application
+typedef struct UsageProviderOps_s_
+{
+   /// prepare the provider for a root folder, NULL if not supported
+   void* (*create)(const char* rootPath);
+   /// release the provider
+   void (*destroy)(void* state);
+   /// get the usage of one application folder, -1 if not known
+   int (*query)(void* state, int rootFd, const char* appId, DiskScanUsage_s* usage);
+} UsageProviderOps_s;
+
+
+/// usage of one application reported by the fake provider
+typedef struct FakeUsage_s_
+{
+   char appId[NAME_MAX+1];
+   unsigned long long size;
+   unsigned int files;
+} FakeUsage_s;
+
+
+/// state of the fake provider
+typedef struct UsageFake_s_
+{
+   FakeUsage_s* apps;
+   int count;
+   int capacity;
+} UsageFake_s;
+
+
+struct UsageProvider_s_
+{
+   /// the type in use
+   UsageProviderType_e type;
+   /// the state of the provider, NULL for the walk
+   void* state;
+   /// number of threads walking folder trees
+   int workers;
+   /// the options of the walk
+   DiskScanOptions_s options;
+   /// the threads walking folder trees, started with the first walk
+   ScanPool_s* pool;
+};
+
+
+// local function prototypes
+static void* fakeCreate(const char* rootPath);
+static void fakeDestroy(void* state);
+static int fakeQuery(void* state, int rootFd, const char* appId, DiskScanUsage_s* usage);
+static int walkFolders(UsageProvider_s* provider, int rootFd, ScanJob_s* jobs, int jobCount);
+//----------------------------------------------------------
+
+
+/// provider names, same order as UsageProviderType_e
+static const char* gProviderName[UsageProvider_LastEntry] =
+{
+   "walk",
+   "prjquota",
+   "btrfs",
+   "fake"
+};
+
+
+/// provider operations, same order as UsageProviderType_e
+static const UsageProviderOps_s gProviderOps[UsageProvider_LastEntry] =
+{
+   { NULL, NULL, NULL },
+   { usageQuotaCreate, usageQuotaDestroy, usageQuotaQuery },
+   { usageBtrfsCreate, usageBtrfsDestroy, usageBtrfsQuery },
+   { fakeCreate, fakeDestroy, fakeQuery }
+};
+
+
+
+UsageProviderType_e usageProviderGetType(const char* name)
+{
+   int i = 0;
+
+   // the fake provider can only be created directly
+   for(i = 0; i < UsageProvider_Fake; i++)
+   {
+      if(0 == strcmp(name, gProviderName[i]))
+      {
+         return (UsageProviderType_e)i;
+      }
+   }
+   return UsageProvider_LastEntry;
+}
+
+
+
+const char* usageProviderGetTypeName(UsageProviderType_e type)
+{
+   return (type < UsageProvider_LastEntry) ? gProviderName[type] : "unknown";
+}
+
+
+
+UsageProvider_s* usageProviderCreate(UsageProviderType_e type, const char* rootPath, int workers, const DiskScanOptions_s* options)
+{
+   UsageProvider_s* provider = calloc(1, sizeof(UsageProvider_s));
+
+   if(provider != NULL)
+   {
+      provider->type    = UsageProvider_Walk;
+      provider->workers = workers;
+      provider->options = *options;
+
+      if(type != UsageProvider_Walk && type < UsageProvider_LastEntry)
+      {
+         provider->state = gProviderOps[type].create(rootPath);
+         if(provider->state != NULL)
+         {
+            provider->type = type;
+         }
+         else
+         {
+            DLT_LOG(phmContext, DLT_LOG_WARN, DLT_STRING("usageProviderCreate - not supported, walking folders:"),
+                                              DLT_STRING(gProviderName[type]), DLT_STRING(rootPath));
+         }
+      }
+   }
+   return provider;
+}
+
+
+
+void usageProviderDestroy(UsageProvider_s* provider)
+{
+   if(provider != NULL)
+   {
+      if(provider->state != NULL)
+      {
+         gProviderOps[provider->type].destroy(provider->state);
+      }
+      scanPoolDestroy(provider->pool);
+      free(provider);
+   }
+}
+
+
+
+UsageProviderType_e usageProviderGetActiveType(const UsageProvider_s* provider)
+{
+   return provider->type;
+}
+
+
+
+int usageProviderQuery(UsageProvider_s* provider, int rootFd, ScanJob_s* jobs, int jobCount)
+{
+   int rval = 0;
+   int i = 0, walkCount = 0;
+   ScanJob_s* walkJobs = NULL;
+   int* walkIndex = NULL;
+
+   if(provider->type == UsageProvider_Walk)
+   {
+      return walkFolders(provider, rootFd, jobs, jobCount);
+   }
+
+   for(i = 0; i < jobCount; i++)
+   {
+      jobs[i].result = gProviderOps[provider->type].query(provider->state, rootFd, jobs[i].appId, &jobs[i].usage);
+      if(jobs[i].result != 0)
+      {
+         walkCount++;
+      }
+   }
+
+   if(walkCount == 0)
+   {
+      return 0;
+   }
+
+   // walk the folders the provider does not know
+   walkJobs  = malloc(walkCount * sizeof(ScanJob_s));
+   walkIndex = malloc(walkCount * sizeof(int));
+   if(walkJobs != NULL && walkIndex != NULL)
+   {
+      walkCount = 0;
+      for(i = 0; i < jobCount; i++)
+      {
+         if(jobs[i].result != 0)
+         {
+            walkJobs[walkCount]  = jobs[i];
+            walkIndex[walkCount] = i;
+            walkCount++;
+         }
+      }
+
+      rval = walkFolders(provider, rootFd, walkJobs, walkCount);
+
+      for(i = 0; i < walkCount; i++)
+      {
+         jobs[walkIndex[i]].usage  = walkJobs[i].usage;
+         jobs[walkIndex[i]].result = walkJobs[i].result;
+      }
+   }
+   else
+   {
+      DLT_LOG(phmContext, DLT_LOG_ERROR, DLT_STRING("usageProviderQuery - out of memory"));
+   }
+
+   free(walkJobs);
+   free(walkIndex);
+
+   return rval;
+}
+
+
+
+int usageProviderFakeSet(UsageProvider_s* provider, const char* appId, unsigned long long size, unsigned int files)
+{
+   int i = 0;
+   UsageFake_s* fake = (UsageFake_s*)provider->state;
+
+   if(provider->type != UsageProvider_Fake)
+   {
+      return -1;
+   }
+
+   for(i = 0; i < fake->count; i++)
+   {
+      if(0 == strcmp(fake->apps[i].appId, appId))
+      {
+         break;
+      }
+   }
+
+   if(i == fake->count)
+   {
+      if(fake->count == fake->capacity)
+      {
+         int newCapacity = (fake->capacity == 0) ? 16 : fake->capacity * 2;
+         FakeUsage_s* apps = realloc(fake->apps, newCapacity * sizeof(FakeUsage_s));
+         if(apps == NULL)
+         {
+            return -1;
+         }
+         fake->apps = apps;
+         fake->capacity = newCapacity;
+      }
+      memset(&fake->apps[i], 0, sizeof(FakeUsage_s));
+      strncpy(fake->apps[i].appId, appId, sizeof(fake->apps[i].appId)-1);
+      fake->count++;
+   }
+
+   fake->apps[i].size  = size;
+   fake->apps[i].files = files;
+
+   return 0;
+}
+
+
+
+static int walkFolders(UsageProvider_s* provider, int rootFd, ScanJob_s* jobs, int jobCount)
+{
+   // the workers are kept for the next walks, creating threads and scanners each round is not for free
+   if(provider->pool == NULL)
+   {
+      provider->pool = scanPoolCreate(provider->workers, &provider->options);
+      if(provider->pool == NULL)
+      {
+         return -1;
+      }
+   }
+
+   return scanPoolRunJobs(provider->pool, rootFd, jobs, jobCount);
+}
+
+
+
+static void* fakeCreate(const char* rootPath)
+{
+   (void)rootPath;
+   return calloc(1, sizeof(UsageFake_s));
+}
+
+
+
+static void fakeDestroy(void* state)
+{
+   UsageFake_s* fake = (UsageFake_s*)state;
+
+   free(fake->apps);
+   free(fake);
+}
+
+
+
+static int fakeQuery(void* state, int rootFd, const char* appId, DiskScanUsage_s* usage)
+{
+   int i = 0;
+   UsageFake_s* fake = (UsageFake_s*)state;
+   (void)rootFd;
+
+   memset(usage, 0, sizeof(DiskScanUsage_s));
+
+   for(i = 0; i < fake->count; i++)
+   {
+      if(0 == strcmp(fake->apps[i].appId, appId))
+      {
+         usage->size  = fake->apps[i].size;
+         usage->files = fake->apps[i].files;
+         return 0;
+      }
+   }
+   return -1;
+}
@@ -0,0 +1,134 @@
+#ifndef PERSISTENCE_HM_USAGE_PROVIDER_H_
+#define PERSISTENCE_HM_USAGE_PROVIDER_H_
+
+/******************************************************************************
+ * Project         Persistency
+ * (c) copyright   2014
+ * Company         XS Embedded GmbH
+ *****************************************************************************/
+/******************************************************************************
+ * This Source Code Form is subject to the terms of the
+ * Mozilla Public License, v. 2.0. If a  copy of the MPL was not distributed
+ * with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
+******************************************************************************/
+ /**
+ * @file           persistence_hm_usage_provider.h
+ * @ingroup        Persistence Health Monitor
+ * @author         Ingo Huerner
+ * @brief          Header of the persistence health monitor usage providers.
+ *                 A provider tells the usage of the application folders below a root.
+ *                 Walking the folder tree is always available; file systems that account
+ *                 the usage themselves answer in constant time per application.
+ * @see
+ */
+
+#include "persistence_hm_scan_pool.h"
+
+
+/// the usage providers
+typedef enum UsageProviderType_e_
+{
+   /// walk the folder tree of every application (scan pool)
+   UsageProvider_Walk = 0,
+   /// project quota (ext4, xfs), the application folder carries the project ID
+   UsageProvider_ProjectQuota,
+   /// btrfs quota groups, the application folder is a subvolume
+   UsageProvider_BtrfsQgroup,
+   /// usage set with usageProviderFakeSet, for tests
+   UsageProvider_Fake,
+
+   // insert new entries here ...
+
+   /// last entry
+   UsageProvider_LastEntry
+
+} UsageProviderType_e;
+
+
+/// a provider for one root folder
+typedef struct UsageProvider_s_ UsageProvider_s;
+
+
+/**
+ * @brief Get the provider type from its name
+ *
+ * @param name "walk", "prjquota" or "btrfs"
+ *
+ * @return the type or UsageProvider_LastEntry if the name is unknown
+ */
+UsageProviderType_e usageProviderGetType(const char* name);
+
+
+/**
+ * @brief Get the name of a provider type
+ *
+ * @param type the type
+ *
+ * @return the name
+ */
+const char* usageProviderGetTypeName(UsageProviderType_e type);
+
+
+/**
+ * @brief Create a provider for a root folder.
+ *        If the file system does not support the requested type, the provider
+ *        walks the folder trees.
+ *
+ * @param type the requested type
+ * @param rootPath the root folder containing the application folders
+ * @param workers number of threads walking folder trees in parallel
+ * @param options the scan options of the walk
+ *
+ * @return the provider or NULL if memory is exhausted
+ */
+UsageProvider_s* usageProviderCreate(UsageProviderType_e type, const char* rootPath, int workers, const DiskScanOptions_s* options);
+
+
+/**
+ * @brief Release a provider and stop the threads of its walk
+ *
+ * @param provider the provider
+ */
+void usageProviderDestroy(UsageProvider_s* provider);
+
+
+/**
+ * @brief Get the type the provider actually uses
+ *
+ * @param provider the provider
+ *
+ * @return the type
+ */
+UsageProviderType_e usageProviderGetActiveType(const UsageProvider_s* provider);
+
+
+/**
+ * @brief Get the usage of application folders.
+ *        Jobs the provider can not answer (e.g. a folder without project ID) are
+ *        handed to the folder tree walk. Its threads are started by the first walk and
+ *        kept until usageProviderDestroy, so only one thread may query a provider.
+ *
+ * @param provider the provider
+ * @param rootFd descriptor of the root folder
+ * @param jobs the jobs, see scanPoolRunJobs
+ * @param jobCount number of jobs
+ *
+ * @return 0 on success, -1 if no job could be processed
+ */
+int usageProviderQuery(UsageProvider_s* provider, int rootFd, ScanJob_s* jobs, int jobCount);
+
+
+/**
+ * @brief Set the usage the fake provider reports for an application
+ *
+ * @param provider a provider of type UsageProvider_Fake
+ * @param appId the application
+ * @param size the size to report
+ * @param files the number of files to report
+ *
+ * @return 0 on success, -1 if the provider is no fake or memory is exhausted
+ */
+int usageProviderFakeSet(UsageProvider_s* provider, const char* appId, unsigned long long size, unsigned int files);
+
+
+#endif /* PERSISTENCE_HM_USAGE_PROVIDER_H_ */
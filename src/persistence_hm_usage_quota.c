@@ -0,0 +1,428 @@
+/******************************************************************************
+ * Project         Persistency
+ * (c) copyright   2014
+ * Company         XS Embedded GmbH
+ *****************************************************************************/
+/******************************************************************************
+ * This Source Code Form is subject to the terms of the
+ * Mozilla Public License, v. 2.0. If a  copy of the MPL was not distributed
+ * with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
+******************************************************************************/
+ /**
+ * @file           persistence_hm_usage_quota.c
+ * @ingroup        Persistence Health Monitor
+ * @author         Ingo Huerner
+ * @brief          Implementation of the project quota usage provider.
+ *                 The project ID is read from the application folder (FS_IOC_FSGETXATTR),
+ *                 the usage of the project from the quota subsystem (Q_GETQUOTA).
+ *                 quotactl_fd is used where the kernel has it, otherwise quotactl with
+ *                 the block device of the root folder taken from /proc/self/mountinfo.
+ *                 Limits are enforced by labelling the application folder with a project
+ *                 ID (FS_IOC_FSSETXATTR with FS_XFLAG_PROJINHERIT) and Q_SETQUOTA.
+ * @see
+ */
+
+#include "persistence_hm_definitions.h"
+#include "persistence_hm_usage_quota.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#if defined(HAVE_SYS_QUOTA_H)
+#include <sys/quota.h>
+#include <linux/fs.h>
+#endif
+
+// FS_IOC_FSGETXATTR came with the kernel headers that know project quotas
+#if defined(HAVE_SYS_QUOTA_H) && defined(FS_IOC_FSGETXATTR)
+
+#include <sys/syscall.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/ioctl.h>
+#include <sys/sysmacros.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <limits.h>
+#include <stdio.h>
+#include <dirent.h>
+
+
+#ifndef PRJQUOTA
+#define PRJQUOTA 2
+#endif
+
+#define FILE_DIR_NOT_SELF_OR_PARENT(s) ((s)[0]!='.'&&(((s)[1]!='.'||(s)[2]!='\0')||(s)[1]=='\0'))
+
+/// number of project IDs tried after the default one of an application is used by another folder
+#define QUOTA_PROJECT_PROBES 64
+
+
+/// state of the project quota provider
+typedef struct UsageQuota_s_
+{
+   /// descriptor of the root folder, used by quotactl_fd
+   int rootFd;
+   /// 1 if quotactl_fd is available, 0 if the block device must be used
+   int useFd;
+   /// the block device of the root folder
+   char device[PATH_MAX];
+} UsageQuota_s;
+
+
+// local function prototypes
+static int quotaCommand(UsageQuota_s* quota, int cmd, unsigned int id, void* data);
+static int findDevice(int rootFd, char* device, size_t size);
+static int setProjectId(int fd, unsigned int projectId, int isDir);
+static int setProjectIdTree(int dirFd, unsigned int projectId);
+static unsigned int findFreeProjectId(UsageQuota_s* quota, unsigned int projectId);
+//----------------------------------------------------------
+
+
+
+void* usageQuotaCreate(const char* rootPath)
+{
+   struct if_dqinfo info;
+   UsageQuota_s* quota = calloc(1, sizeof(UsageQuota_s));
+
+   if(quota == NULL)
+   {
+      return NULL;
+   }
+
+   quota->rootFd = open(rootPath, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+   if(quota->rootFd == -1)
+   {
+      free(quota);
+      return NULL;
+   }
+
+#ifdef __NR_quotactl_fd
+   quota->useFd = 1;
+   if(quotaCommand(quota, Q_GETINFO, 0, &info) == 0)
+   {
+      return quota;
+   }
+   quota->useFd = 0;       // kernel older than 5.14, try with the device
+#endif
+
+   if(   findDevice(quota->rootFd, quota->device, sizeof(quota->device)) == 0
+      && quotaCommand(quota, Q_GETINFO, 0, &info) == 0)
+   {
+      return quota;
+   }
+
+   DLT_LOG(phmContext, DLT_LOG_INFO, DLT_STRING("usageQuota - project quota not enabled for:"), DLT_STRING(rootPath),
+                                     DLT_STRING(strerror(errno)));
+   usageQuotaDestroy(quota);
+
+   return NULL;
+}
+
+
+
+void usageQuotaDestroy(void* state)
+{
+   UsageQuota_s* quota = (UsageQuota_s*)state;
+
+   if(quota != NULL)
+   {
+      close(quota->rootFd);
+      free(quota);
+   }
+}
+
+
+
+int usageQuotaQuery(void* state, int rootFd, const char* appId, DiskScanUsage_s* usage)
+{
+   int rval = -1;
+   struct fsxattr fsx;
+   struct dqblk dq;
+   int fd = openat(rootFd, appId, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+
+   memset(usage, 0, sizeof(DiskScanUsage_s));
+
+   if(fd == -1)
+   {
+      return -1;
+   }
+
+   memset(&fsx, 0, sizeof(fsx));
+   memset(&dq, 0, sizeof(dq));
+
+   // project 0 is the default of every file, it is never a per application project
+   if(   ioctl(fd, FS_IOC_FSGETXATTR, &fsx) == 0 && fsx.fsx_projid != 0
+      && quotaCommand((UsageQuota_s*)state, Q_GETQUOTA, fsx.fsx_projid, &dq) == 0
+      && (dq.dqb_valid & QIF_USAGE) == QIF_USAGE)
+   {
+      usage->size  = (unsigned long long)dq.dqb_curspace;
+      usage->files = (unsigned int)dq.dqb_curinodes;
+      rval = 0;
+   }
+
+   close(fd);
+
+   return rval;
+}
+
+
+
+int usageQuotaSetLimit(void* state, int rootFd, const char* appId, unsigned int defaultProjectId,
+                       const QuotaLimits_s* limits, unsigned int* projectId)
+{
+   int rval = -1;
+   struct fsxattr fsx;
+   struct dqblk dq;
+   int fd = openat(rootFd, appId, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+
+   if(fd == -1)
+   {
+      return -1;
+   }
+
+   memset(&fsx, 0, sizeof(fsx));
+   if(ioctl(fd, FS_IOC_FSGETXATTR, &fsx) == 0)
+   {
+      // keep a project ID assigned by the system integrator
+      *projectId = fsx.fsx_projid;
+      if(*projectId == 0)
+      {
+         *projectId = findFreeProjectId((UsageQuota_s*)state, defaultProjectId);
+         rval = (*projectId != 0) ? setProjectIdTree(fd, *projectId) : -1;
+      }
+      else
+      {
+         rval = 0;
+      }
+   }
+
+   if(rval == 0)
+   {
+      // the quota subsystem counts in blocks of 1 KiB
+      memset(&dq, 0, sizeof(dq));
+      dq.dqb_bsoftlimit = limits->softBytes / 1024;
+      dq.dqb_bhardlimit = (limits->hardBytes + 1023) / 1024;
+      dq.dqb_isoftlimit = limits->softInodes;
+      dq.dqb_ihardlimit = limits->hardInodes;
+      dq.dqb_valid      = QIF_BLIMITS | QIF_ILIMITS;
+
+      rval = quotaCommand((UsageQuota_s*)state, Q_SETQUOTA, *projectId, &dq);
+   }
+
+   if(rval == -1)
+   {
+      DLT_LOG(phmContext, DLT_LOG_ERROR, DLT_STRING("usageQuota - failed to set limit for:"), DLT_STRING(appId),
+                                         DLT_STRING(strerror(errno)));
+   }
+
+   close(fd);
+
+   return rval;
+}
+
+
+
+static int setProjectId(int fd, unsigned int projectId, int isDir)
+{
+   struct fsxattr fsx;
+
+   memset(&fsx, 0, sizeof(fsx));
+   if(ioctl(fd, FS_IOC_FSGETXATTR, &fsx) == -1)
+   {
+      return -1;
+   }
+
+   fsx.fsx_projid = projectId;
+   if(isDir)
+   {
+      fsx.fsx_xflags |= FS_XFLAG_PROJINHERIT;   // new files and folders get the project ID
+   }
+
+   return ioctl(fd, FS_IOC_FSSETXATTR, &fsx);
+}
+
+
+
+static int setProjectIdTree(int dirFd, unsigned int projectId)
+{
+   int rval = setProjectId(dirFd, projectId, 1);
+   int fd = dup(dirFd);
+   DIR* dir = (fd != -1) ? fdopendir(fd) : NULL;
+   struct dirent* dirent = NULL;
+
+   if(dir == NULL)
+   {
+      if(fd != -1)
+      {
+         close(fd);
+      }
+      return -1;
+   }
+
+   // the existing content keeps its old project ID, label it like "chattr -R -p"
+   while(rval == 0 && (dirent = readdir(dir)) != NULL)
+   {
+      int entryFd = -1;
+
+      if(   FILE_DIR_NOT_SELF_OR_PARENT(dirent->d_name)
+         && (DT_DIR == dirent->d_type || DT_REG == dirent->d_type || DT_UNKNOWN == dirent->d_type))
+      {
+         // O_NONBLOCK: never block on a fifo reported as DT_UNKNOWN
+         entryFd = openat(dirfd(dir), dirent->d_name, O_RDONLY | O_NOFOLLOW | O_NONBLOCK | O_CLOEXEC);
+      }
+
+      if(entryFd != -1)
+      {
+         struct stat buf;
+
+         if(fstat(entryFd, &buf) == 0)
+         {
+            if(S_ISDIR(buf.st_mode))
+            {
+               rval = setProjectIdTree(entryFd, projectId);
+            }
+            else if(S_ISREG(buf.st_mode))
+            {
+               rval = setProjectId(entryFd, projectId, 0);
+            }
+         }
+         close(entryFd);
+      }
+   }
+
+   closedir(dir);
+
+   return rval;
+}
+
+
+
+static unsigned int findFreeProjectId(UsageQuota_s* quota, unsigned int projectId)
+{
+   int i = 0;
+
+   // the default ID is a hash of the AppID and may collide with the project of another folder;
+   // a project that counts files or has limits is in use (also by a folder of another root)
+   for(i = 0; i < QUOTA_PROJECT_PROBES; i++, projectId++)
+   {
+      struct dqblk dq;
+
+      if(projectId == 0)
+      {
+         projectId = 1;    // project 0 is the default of every file
+      }
+
+      memset(&dq, 0, sizeof(dq));
+      if(   quotaCommand(quota, Q_GETQUOTA, projectId, &dq) == -1
+         || (   dq.dqb_curspace == 0 && dq.dqb_curinodes == 0
+             && dq.dqb_bhardlimit == 0 && dq.dqb_bsoftlimit == 0 && dq.dqb_ihardlimit == 0 && dq.dqb_isoftlimit == 0))
+      {
+         return projectId;
+      }
+      DLT_LOG(phmContext, DLT_LOG_INFO, DLT_STRING("usageQuota - project ID in use:"), DLT_UINT(projectId));
+   }
+
+   errno = EEXIST;
+   return 0;
+}
+
+
+
+static int quotaCommand(UsageQuota_s* quota, int cmd, unsigned int id, void* data)
+{
+#ifdef __NR_quotactl_fd
+   if(quota->useFd == 1)
+   {
+      return (int)syscall(__NR_quotactl_fd, quota->rootFd, QCMD(cmd, PRJQUOTA), id, data);
+   }
+#endif
+   return quotactl(QCMD(cmd, PRJQUOTA), quota->device, (int)id, (caddr_t)data);
+}
+
+
+
+static int findDevice(int rootFd, char* device, size_t size)
+{
+   int rval = -1;
+   char line[PATH_MAX * 2];
+   struct stat buf;
+   FILE* mountInfo = NULL;
+
+   if(fstat(rootFd, &buf) == -1)
+   {
+      return -1;
+   }
+
+   mountInfo = fopen("/proc/self/mountinfo", "re");
+   if(mountInfo == NULL)
+   {
+      return -1;
+   }
+
+   // "36 35 98:0 /mnt1 /mnt2 rw,noatime master:1 - ext4 /dev/sda1 rw,errors=continue"
+   while(rval == -1 && fgets(line, sizeof(line), mountInfo) != NULL)
+   {
+      unsigned int major = 0, minor = 0;
+      const char* separator = strstr(line, " - ");
+      char source[PATH_MAX];
+
+      if(   separator != NULL
+         && sscanf(line, "%*s %*s %u:%u", &major, &minor) == 2
+         && makedev(major, minor) == buf.st_dev
+         && sscanf(separator, " - %*s %4095s", source) == 1
+         && strlen(source) < size)
+      {
+         strcpy(device, source);
+         rval = 0;
+      }
+   }
+
+   fclose(mountInfo);
+
+   return rval;
+}
+
+
+#else
+
+
+void* usageQuotaCreate(const char* rootPath)
+{
+   (void)rootPath;
+   DLT_LOG(phmContext, DLT_LOG_INFO, DLT_STRING("usageQuota - built without project quota support"));
+   return NULL;
+}
+
+
+void usageQuotaDestroy(void* state)
+{
+   (void)state;
+}
+
+
+int usageQuotaQuery(void* state, int rootFd, const char* appId, DiskScanUsage_s* usage)
+{
+   (void)state;
+   (void)rootFd;
+   (void)appId;
+   memset(usage, 0, sizeof(DiskScanUsage_s));
+   return -1;
+}
+
+
+int usageQuotaSetLimit(void* state, int rootFd, const char* appId, unsigned int defaultProjectId,
+                       const QuotaLimits_s* limits, unsigned int* projectId)
+{
+   (void)state;
+   (void)rootFd;
+   (void)appId;
+   (void)defaultProjectId;
+   (void)limits;
+   *projectId = 0;
+   return -1;
+}
+
+
+#endif
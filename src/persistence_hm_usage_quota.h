@@ -0,0 +1,122 @@
+#ifndef PERSISTENCE_HM_USAGE_QUOTA_H_
+#define PERSISTENCE_HM_USAGE_QUOTA_H_
+
+/******************************************************************************
+ * Project         Persistency
+ * (c) copyright   2014
+ * Company         XS Embedded GmbH
+ *****************************************************************************/
+/******************************************************************************
+ * This Source Code Form is subject to the terms of the
+ * Mozilla Public License, v. 2.0. If a  copy of the MPL was not distributed
+ * with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
+******************************************************************************/
+ /**
+ * @file           persistence_hm_usage_quota.h
+ * @ingroup        Persistence Health Monitor
+ * @author         Ingo Huerner
+ * @brief          Header of the usage providers backed by file system quotas
+ *                 and of the project quota limits.
+ * @see
+ */
+
+#include "persistence_hm_disk_scan.h"
+
+
+/**
+ * @brief Prepare the project quota provider for a root folder
+ *
+ * @param rootPath the root folder
+ *
+ * @return the provider state or NULL if project quotas are not enabled on the file system
+ */
+void* usageQuotaCreate(const char* rootPath);
+
+
+/**
+ * @brief Release the project quota provider
+ *
+ * @param state the provider state
+ */
+void usageQuotaDestroy(void* state);
+
+
+/**
+ * @brief Get the usage of an application folder from its project quota
+ *
+ * @param state the provider state
+ * @param rootFd descriptor of the root folder
+ * @param appId name of the application folder
+ * @param usage [out] the usage (allocated bytes and inodes of the project)
+ *
+ * @return 0 on success, -1 if the folder has no project ID or the quota can not be read
+ */
+int usageQuotaQuery(void* state, int rootFd, const char* appId, DiskScanUsage_s* usage);
+
+
+/// the limits of a project, 0 = no limit
+typedef struct QuotaLimits_s_
+{
+   /// the kernel warns when the soft limits are crossed
+   unsigned long long softBytes;
+   /// writes beyond the hard limits fail with EDQUOT
+   unsigned long long hardBytes;
+   /// creating files and folders beyond the hard inode limit fails with EDQUOT
+   unsigned long long softInodes;
+   unsigned long long hardInodes;
+
+} QuotaLimits_s;
+
+
+/**
+ * @brief Let the kernel enforce the limits of an application folder.
+ *        A folder without project ID gets defaultProjectId, recursively for its content
+ *        and inherited by everything created later; if the project of defaultProjectId is
+ *        used already, one of the following IDs that is not used. Then the block and inode
+ *        limits of the project are set.
+ *
+ * @param state the project quota provider state
+ * @param rootFd descriptor of the root folder
+ * @param appId name of the application folder
+ * @param defaultProjectId project ID for a folder without one, must not be 0
+ * @param limits the limits
+ * @param projectId [out] the project ID of the folder
+ *
+ * @return 0 on success, -1 otherwise
+ */
+int usageQuotaSetLimit(void* state, int rootFd, const char* appId, unsigned int defaultProjectId,
+                       const QuotaLimits_s* limits, unsigned int* projectId);
+
+
+/**
+ * @brief Prepare the btrfs quota group provider for a root folder
+ *
+ * @param rootPath the root folder
+ *
+ * @return the provider state or NULL if the root is no btrfs or quotas are disabled
+ */
+void* usageBtrfsCreate(const char* rootPath);
+
+
+/**
+ * @brief Release the btrfs quota group provider
+ *
+ * @param state the provider state
+ */
+void usageBtrfsDestroy(void* state);
+
+
+/**
+ * @brief Get the usage of an application subvolume from its quota group
+ *
+ * @param state the provider state
+ * @param rootFd descriptor of the root folder
+ * @param appId name of the application subvolume
+ * @param usage [out] the usage (referenced bytes, files and folders are not counted)
+ *
+ * @return 0 on success, -1 if the folder is no subvolume or has no quota group
+ */
+int usageBtrfsQuery(void* state, int rootFd, const char* appId, DiskScanUsage_s* usage);
+
+
+#endif /* PERSISTENCE_HM_USAGE_QUOTA_H_ */
@@ -0,0 +1,90 @@
+/******************************************************************************
+ * Project         Persistency
+ * (c) copyright   2014
+ * Company         XS Embedded GmbH
+ *****************************************************************************/
+/******************************************************************************
+ * This Source Code Form is subject to the terms of the
+ * Mozilla Public License, v. 2.0. If a  copy of the MPL was not distributed
+ * with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
+******************************************************************************/
+ /**
+ * @file           persistence_hm_usage_shm.c
+ * @ingroup        Persistence Health Monitor
+ * @author         Ingo Huerner
+ * @brief          Implementation of the persistence health monitor usage snapshot publisher.
+ *                 Write side of the sequence lock: the odd sequence is stored before the
+ *                 data (release fence), the even one after it (release store), so a
+ *                 reader that sees the same even sequence before and after its copy has
+ *                 seen no write.
+ * @see
+ */
+
+#include "persistence_hm_definitions.h"
+#include "persistence_hm_usage_shm.h"
+
+#include <errno.h>
+#include <sys/stat.h>
+
+
+
+PhmUsageShm_s* usageShmCreate(void)
+{
+   void* map = MAP_FAILED;
+   int fd = shm_open(PHM_USAGE_SHM_NAME, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+
+   if(fd == -1)
+   {
+      DLT_LOG(phmContext, DLT_LOG_ERROR, DLT_STRING("usageShmCreate - shm_open failed:"), DLT_STRING(strerror(errno)));
+      return NULL;
+   }
+
+   (void)fchmod(fd, 0644);     // the umask must not hide the snapshot from the clients
+   if(ftruncate(fd, sizeof(PhmUsageShm_s)) == 0)
+   {
+      map = mmap(0, sizeof(PhmUsageShm_s), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+   }
+   if(map == MAP_FAILED)
+   {
+      DLT_LOG(phmContext, DLT_LOG_ERROR, DLT_STRING("usageShmCreate - failed to map:"), DLT_STRING(strerror(errno)));
+      close(fd);
+      shm_unlink(PHM_USAGE_SHM_NAME);
+      return NULL;
+   }
+   close(fd);
+
+   return (PhmUsageShm_s*)map;
+}
+
+
+
+void usageShmDestroy(PhmUsageShm_s* shm)
+{
+   if(shm != NULL)
+   {
+      munmap(shm, sizeof(PhmUsageShm_s));
+      shm_unlink(PHM_USAGE_SHM_NAME);
+   }
+}
+
+
+
+PhmUsageSnapshot_s* usageShmBeginUpdate(PhmUsageShm_s* shm)
+{
+   unsigned int sequence = __atomic_load_n(&shm->sequence, __ATOMIC_RELAXED);
+
+   // a segment left by a crashed writer may still be odd
+   __atomic_store_n(&shm->sequence, (sequence | 1) + ((sequence & 1) ? 2 : 0), __ATOMIC_RELAXED);
+   __atomic_thread_fence(__ATOMIC_RELEASE);
+
+   return &shm->snapshot;
+}
+
+
+
+void usageShmEndUpdate(PhmUsageShm_s* shm)
+{
+   unsigned int sequence = __atomic_load_n(&shm->sequence, __ATOMIC_RELAXED);
+
+   __atomic_store_n(&shm->sequence, sequence + 1, __ATOMIC_RELEASE);
+}
@@ -0,0 +1,62 @@
+#ifndef PERSISTENCE_HM_USAGE_SHM_H_
+#define PERSISTENCE_HM_USAGE_SHM_H_
+
+/******************************************************************************
+ * Project         Persistency
+ * (c) copyright   2014
+ * Company         XS Embedded GmbH
+ *****************************************************************************/
+/******************************************************************************
+ * This Source Code Form is subject to the terms of the
+ * Mozilla Public License, v. 2.0. If a  copy of the MPL was not distributed
+ * with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
+******************************************************************************/
+ /**
+ * @file           persistence_hm_usage_shm.h
+ * @ingroup        Persistence Health Monitor
+ * @author         Ingo Huerner
+ * @brief          Header of the persistence health monitor usage snapshot publisher.
+ *                 The layout and the reader are in persistence_hm_usage.h.
+ * @see
+ */
+
+#include "persistence_hm_usage.h"
+
+
+/**
+ * @brief Create the shared memory segment of the snapshot, readable by everyone.
+ *        A segment left over by a previous run is reused.
+ *
+ * @return the writable mapping or NULL on error
+ */
+PhmUsageShm_s* usageShmCreate(void);
+
+
+/**
+ * @brief Unmap and remove the segment
+ *
+ * @param shm the mapping
+ */
+void usageShmDestroy(PhmUsageShm_s* shm);
+
+
+/**
+ * @brief Start an update of the snapshot; readers retry until usageShmEndUpdate.
+ *        Only one thread may update the snapshot.
+ *
+ * @param shm the mapping
+ *
+ * @return the snapshot to write
+ */
+PhmUsageSnapshot_s* usageShmBeginUpdate(PhmUsageShm_s* shm);
+
+
+/**
+ * @brief Finish an update, the new snapshot becomes visible to the readers
+ *
+ * @param shm the mapping
+ */
+void usageShmEndUpdate(PhmUsageShm_s* shm);
+
+
+#endif /* PERSISTENCE_HM_USAGE_SHM_H_ */
@@ -24,29 +24,1635 @@
 #include <fcntl.h>
 #include <sys/mman.h>
 #include <sys/stat.h>
+#include <pthread.h>
 
 #include <dlt/dlt.h>
 #include <dlt/dlt_common.h>
 
 #include "persCheck.h"
 
+#include "persistence_hm_usage_provider.h"
+#include "persistence_hm_limits.h"
+#include "persistence_hm_config_cache.h"
+#include "persistence_hm_config_reader.h"
+#include "persistence_hm_usage_shm.h"
+#include "persistence_hm_inode_set.h"
+#include "persistence_hm_scan_schedule.h"
+#include "persistence_hm_forecast.h"
+#include "persistence_hm_handoff.h"
+#include "crc32.h"
+
+
+/// root folder of the usage provider test
+#define TEST_PROVIDER_ROOT "/tmp/phmProviderTest"
+
+/// root folder of the root scan test
+#define TEST_SCAN_ROOT "/tmp/phmScanRootTest"
+/// depth of the deep application folder of the root scan test
+#define TEST_SCAN_DEPTH 40
+/// number of root scans running at the same time
+#define TEST_SCAN_THREADS 4
+
+/// application folder of the top consumer test
+#define TEST_TOP_APP "/tmp/phmTopTest"
+
+/// number of applications of the limits table test
+#define TEST_LIMITS_COUNT 1000
+
+/// configuration file and cache of the configuration cache test
+#define TEST_CACHE_CONFIG "/tmp/phmConfigCacheTest.conf"
+#define TEST_CACHE_FILE   "/tmp/phmConfigCacheTest.cache"
+
+/// configuration file of the configuration reader test
+#define TEST_READER_CONFIG "/tmp/phmConfigReaderTest.conf"
+/// number of size entries of the configuration reader test, more than the old token array held
+#define TEST_READER_COUNT 600
+
+/// data of the crc32 self test, every length up to it is checked at every start offset up to 16
+#define TEST_CRC_SIZE 1024
+/// buffer and rounds of the crc32 benchmark
+#define TEST_CRC_BENCH_SIZE (1024 * 1024)
+#define TEST_CRC_BENCH_ROUNDS 32
+
+/// AppID of the usage snapshot test, the longest a folder can have
+#define TEST_SNAPSHOT_APPID_LEN NAME_MAX
+
+/// root folder of the descriptor relative scan test
+#define TEST_RELATIVE_ROOT "/tmp/phmRelativeTest"
+/// folder levels and name length of the descriptor relative scan test, the path exceeds PATH_MAX
+#define TEST_RELATIVE_DEPTH 24
+#define TEST_RELATIVE_NAME_LEN 200
+
+/// application folder of the backend parity test
+#define TEST_PARITY_APP "/tmp/phmParityTest"
+/// folders and files per folder of the backend parity test, more than the io_uring ring and open folder limit
+#define TEST_PARITY_FOLDERS 100
+#define TEST_PARITY_FILES 5
+
+/// application folder of the folder cache test
+#define TEST_CACHE_APP "/tmp/phmScanCacheTest"
+
+/// application folder of the hard link test
+#define TEST_LINK_APP "/tmp/phmLinkTest"
+/// inodes added to the set of the hard link test, enough to grow it several times
+#define TEST_LINK_INODES 10000
+
+/// samples of the linear series of the forecast test, more than the history holds
+#define TEST_FORECAST_SAMPLES 20
+
+/// application folder and number of files of the scan budget test
+#define TEST_BUDGET_APP "/tmp/phmBudgetTest"
+#define TEST_BUDGET_FILES 150
+
+/// time the reader of the handoff test lets the writer wait [us]
+#define TEST_HANDOFF_DELAY_US 50000
+
+/// layout of the limits image of a sealed table with 2 entries
+#define TEST_IMAGE_HEADER_SIZE 16
+#define TEST_IMAGE_SLOTS 8
+
+/// root, number of applications and workers of the scan pool test
+#define TEST_POOL_ROOT "/tmp/phmScanPoolTest"
+#define TEST_POOL_APPS 10
+#define TEST_POOL_WORKERS 4
+
+/// application folder and number of empty files of the inode limit test
+#define TEST_EMPTY_APP "/tmp/phmEmptyFilesTest"
+#define TEST_EMPTY_FILES 150
+
 
 void data_teardown(void)
 {
-   printf("* * * tear down * * *\n");	// nothing
+   printf("* * * tear down * * *\n");	// nothing
+}
+
+
+START_TEST(test_SendNotification)
+{
+   X_TEST_REPORT_TEST_NAME("persistence_health_monitor_test");
+   X_TEST_REPORT_COMP_NAME("libpersistence_health_monitor");
+   X_TEST_REPORT_REFERENCE("NONE");
+   X_TEST_REPORT_DESCRIPTION("Send notification to healt monitor");
+   X_TEST_REPORT_TYPE(GOOD);
+
+
+
+}
+END_TEST
+
+
+
+START_TEST(test_UsageProviderFake)
+{
+   int fd = -1, ret = 0;
+   char buffer[100];
+   ScanJob_s jobs[3];
+   DiskScanOptions_s options = { DiskScanBackend_Sync, DiskScanMetric_Apparent };
+   UsageProvider_s* provider = NULL;
+
+   X_TEST_REPORT_TEST_NAME("persistence_health_monitor_test");
+   X_TEST_REPORT_COMP_NAME("libpersistence_health_monitor");
+   X_TEST_REPORT_REFERENCE("NONE");
+   X_TEST_REPORT_DESCRIPTION("Usage provider answers known applications, walks the others");
+   X_TEST_REPORT_TYPE(GOOD);
+
+   // App1 is answered by the provider, App2 is walked, App3 does not exist
+   (void)system("rm -rf " TEST_PROVIDER_ROOT);
+   mkdir(TEST_PROVIDER_ROOT, 0755);
+   mkdir(TEST_PROVIDER_ROOT "/App1", 0755);
+   mkdir(TEST_PROVIDER_ROOT "/App2", 0755);
+   memset(buffer, 'x', sizeof(buffer));
+   fd = open(TEST_PROVIDER_ROOT "/App2/data", O_CREAT | O_WRONLY | O_TRUNC, 0644);
+   x_fail_unless(fd != -1, "Failed to create test file");
+   ret = write(fd, buffer, sizeof(buffer));
+   x_fail_unless(ret == sizeof(buffer), "Failed to write test file");
+   close(fd);
+
+   x_fail_unless(usageProviderGetType("prjquota") == UsageProvider_ProjectQuota, "Wrong provider type");
+   x_fail_unless(usageProviderGetType("fake") == UsageProvider_LastEntry, "Fake provider must not be configurable");
+
+   provider = usageProviderCreate(UsageProvider_Fake, TEST_PROVIDER_ROOT, 2, &options);
+   x_fail_unless(provider != NULL, "Failed to create provider");
+   x_fail_unless(usageProviderGetActiveType(provider) == UsageProvider_Fake, "Wrong active provider");
+   ret = usageProviderFakeSet(provider, "App1", 5000000000ULL, 7);
+   x_fail_unless(ret == 0, "Failed to set fake usage");
+
+   memset(jobs, 0, sizeof(jobs));
+   jobs[0].appId = "App1";
+   jobs[1].appId = "App2";
+   jobs[2].appId = "App3";
+
+   fd = open(TEST_PROVIDER_ROOT, O_RDONLY | O_DIRECTORY);
+   ret = usageProviderQuery(provider, fd, jobs, 3);
+   x_fail_unless(ret == 0, "Query failed");
+   close(fd);
+
+   x_fail_unless(jobs[0].result == 0 && jobs[0].usage.size == 5000000000ULL && jobs[0].usage.files == 7, "Wrong fake usage");
+   x_fail_unless(jobs[1].result == 0 && jobs[1].usage.size == sizeof(buffer) && jobs[1].usage.files == 1, "Wrong walked usage");
+   x_fail_unless(jobs[2].result == -1, "Missing folder must fail");
+
+   usageProviderDestroy(provider);
+
+   // only the fake provider takes usage values
+   provider = usageProviderCreate(UsageProvider_Walk, TEST_PROVIDER_ROOT, 1, &options);
+   x_fail_unless(provider != NULL, "Failed to create provider");
+   ret = usageProviderFakeSet(provider, "App1", 1, 1);
+   x_fail_unless(ret == -1, "Only the fake provider can be set");
+   usageProviderDestroy(provider);
+
+   (void)system("rm -rf " TEST_PROVIDER_ROOT);
+}
+END_TEST
+
+
+
+
+static void* runRootScan(void* dataPtr)
+{
+   DiskScanOptions_s options = { DiskScanBackend_Sync, DiskScanMetric_Apparent };
+
+   return (void*)(long)scanPoolRunRoot(TEST_SCAN_ROOT, 2, &options, (ScanRootResult_s*)dataPtr);
+}
+
+
+START_TEST(test_ScanRootConcurrent)
+{
+   int i = 0, j = 0, fd = -1, ret = 0;
+   char path[1024];
+   pthread_t threads[TEST_SCAN_THREADS];
+   ScanRootResult_s results[TEST_SCAN_THREADS];
+
+   X_TEST_REPORT_TEST_NAME("persistence_health_monitor_test");
+   X_TEST_REPORT_COMP_NAME("libpersistence_health_monitor");
+   X_TEST_REPORT_REFERENCE("NONE");
+   X_TEST_REPORT_DESCRIPTION("Concurrent root scans of deep trees return separate, complete results");
+   X_TEST_REPORT_TYPE(GOOD);
+
+   // Deep: one 10 byte file on each of TEST_SCAN_DEPTH levels
+   // Flat: two sibling folders with one 1 byte file each
+   (void)system("rm -rf " TEST_SCAN_ROOT);
+   mkdir(TEST_SCAN_ROOT, 0755);
+   strcpy(path, TEST_SCAN_ROOT "/Deep");
+   for(i = 0; i < TEST_SCAN_DEPTH; i++)
+   {
+      ret = mkdir(path, 0755);
+      x_fail_unless(ret == 0, "Failed to create test folder");
+      j = strlen(path);
+      strcpy(path + j, "/f");
+      fd = open(path, O_CREAT | O_WRONLY | O_TRUNC, 0644);
+      x_fail_unless(fd != -1, "Failed to create test file");
+      ret = write(fd, "0123456789", 10);
+      x_fail_unless(ret == 10, "Failed to write test file");
+      close(fd);
+      strcpy(path + j, "/d");
+   }
+   mkdir(TEST_SCAN_ROOT "/Flat", 0755);
+   mkdir(TEST_SCAN_ROOT "/Flat/a", 0755);
+   mkdir(TEST_SCAN_ROOT "/Flat/b", 0755);
+   fd = open(TEST_SCAN_ROOT "/Flat/a/f", O_CREAT | O_WRONLY | O_TRUNC, 0644);
+   ret = write(fd, "x", 1);
+   close(fd);
+   fd = open(TEST_SCAN_ROOT "/Flat/b/f", O_CREAT | O_WRONLY | O_TRUNC, 0644);
+   ret = write(fd, "x", 1);
+   close(fd);
+
+   for(i = 0; i < TEST_SCAN_THREADS; i++)
+   {
+      ret = pthread_create(&threads[i], NULL, runRootScan, &results[i]);
+      x_fail_unless(ret == 0, "Failed to start scan thread");
+   }
+
+   for(i = 0; i < TEST_SCAN_THREADS; i++)
+   {
+      void* scanResult = NULL;
+
+      pthread_join(threads[i], &scanResult);
+      x_fail_unless(scanResult == NULL, "Root scan failed");
+      x_fail_unless(results[i].appCount == 2, "Wrong number of applications");
+
+      for(j = 0; j < results[i].appCount; j++)
+      {
+         ScanJob_s* app = &results[i].apps[j];
+
+         x_fail_unless(app->result == 0, "Application scan failed");
+         if(0 == strcmp(app->appId, "Deep"))
+         {
+            x_fail_unless(   app->usage.size == 10 * TEST_SCAN_DEPTH && app->usage.files == TEST_SCAN_DEPTH
+                          && app->usage.folders == TEST_SCAN_DEPTH, "Wrong usage of the deep tree");
+         }
+         else
+         {
+            x_fail_unless(app->usage.size == 2 && app->usage.files == 2 && app->usage.folders == 3, "Wrong usage of the flat tree");
+         }
+      }
+      x_fail_unless(results[i].total.size == 10 * TEST_SCAN_DEPTH + 2, "Wrong total usage");
+
+      scanPoolFreeResult(&results[i]);
+   }
+
+   (void)system("rm -rf " TEST_SCAN_ROOT);
+}
+END_TEST
+
+
+
+
+static int createTestFile(const char* path, int size)
+{
+   int ret = -1;
+   char buffer[1000];
+   int fd = open(path, O_CREAT | O_WRONLY | O_TRUNC, 0644);
+
+   if(fd != -1)
+   {
+      memset(buffer, 'x', sizeof(buffer));
+      ret = 0;
+      while(size > 0 && ret == 0)
+      {
+         int len = (size < (int)sizeof(buffer)) ? size : (int)sizeof(buffer);
+         ret = (write(fd, buffer, len) == len) ? 0 : -1;
+         size -= len;
+      }
+      close(fd);
+   }
+   return ret;
+}
+
+
+START_TEST(test_ScanTopConsumers)
+{
+   int ret = 0, count = 0;
+   DiskScanOptions_s options = { DiskScanBackend_Sync, DiskScanMetric_Apparent };
+   DiskScanUsage_s usage;
+   ScanTopEntry_s entries[SCAN_TOP_MAX_ENTRIES];
+   DiskScanner_s* scanner = NULL;
+   DiskScanCache_s* cache = NULL;
+   ScanTop_s* first = NULL;
+   ScanTop_s* second = NULL;
+
+   X_TEST_REPORT_TEST_NAME("persistence_health_monitor_test");
+   X_TEST_REPORT_COMP_NAME("libpersistence_health_monitor");
+   X_TEST_REPORT_REFERENCE("NONE");
+   X_TEST_REPORT_DESCRIPTION("Scan keeps the largest files and folders, also for folders served from the cache");
+   X_TEST_REPORT_TYPE(GOOD);
+
+   // small 100, big 5000, sub/mid 3000, sub/deep/low 2000, other/tiny 10
+   (void)system("rm -rf " TEST_TOP_APP);
+   mkdir(TEST_TOP_APP, 0755);
+   mkdir(TEST_TOP_APP "/sub", 0755);
+   mkdir(TEST_TOP_APP "/sub/deep", 0755);
+   mkdir(TEST_TOP_APP "/other", 0755);
+   ret  = createTestFile(TEST_TOP_APP "/small", 100);
+   ret |= createTestFile(TEST_TOP_APP "/big", 5000);
+   ret |= createTestFile(TEST_TOP_APP "/sub/mid", 3000);
+   ret |= createTestFile(TEST_TOP_APP "/sub/deep/low", 2000);
+   ret |= createTestFile(TEST_TOP_APP "/other/tiny", 10);
+   x_fail_unless(ret == 0, "Failed to create test files");
+
+   x_fail_unless(scanTopCreate(0) == NULL && scanTopCreate(SCAN_TOP_MAX_ENTRIES + 1) == NULL, "Invalid capacity accepted");
+   first   = scanTopCreate(2);
+   second  = scanTopCreate(2);
+   scanner = diskScannerCreate(&options);
+   cache   = diskScanCacheCreate();
+   x_fail_unless(first != NULL && second != NULL && scanner != NULL && cache != NULL, "Failed to create scanner");
+
+   // the folder size cache only takes folders unchanged for a second
+   sleep(2);
+
+   ret = diskScannerRun(scanner, AT_FDCWD, TEST_TOP_APP, cache, first, &usage);
+   x_fail_unless(ret == 0 && usage.size == 10110, "Scan failed");
+   x_fail_unless(first->valid == 1, "List not valid after the scan");
+
+   count = scanTopGetSorted(first, ScanTopKind_File, entries, SCAN_TOP_MAX_ENTRIES);
+   x_fail_unless(count == 2, "Wrong number of files");
+   x_fail_unless(0 == strcmp(entries[0].path, "big") && entries[0].size == 5000, "Wrong largest file");
+   x_fail_unless(0 == strcmp(entries[1].path, "sub/mid") && entries[1].size == 3000, "Wrong second file");
+
+   count = scanTopGetSorted(first, ScanTopKind_Folder, entries, SCAN_TOP_MAX_ENTRIES);
+   x_fail_unless(count == 2, "Wrong number of folders");
+   x_fail_unless(0 == strcmp(entries[0].path, "sub") && entries[0].size == 5000, "Wrong largest folder");
+   x_fail_unless(0 == strcmp(entries[1].path, "sub/deep") && entries[1].size == 2000, "Wrong second folder");
+
+   count = scanTopGetSorted(first, ScanTopKind_File, entries, 1);
+   x_fail_unless(count == 1 && entries[0].size == 5000, "Wrong truncated list");
+
+   // every folder is cached now, the files come from the first list
+   second->previous = first;
+   ret = diskScannerRun(scanner, AT_FDCWD, TEST_TOP_APP, cache, second, &usage);
+   x_fail_unless(ret == 0 && usage.size == 10110, "Cached scan failed");
+
+   count = scanTopGetSorted(second, ScanTopKind_File, entries, SCAN_TOP_MAX_ENTRIES);
+   x_fail_unless(count == 2, "Wrong number of files of the cached scan");
+   x_fail_unless(0 == strcmp(entries[0].path, "big") && 0 == strcmp(entries[1].path, "sub/mid"), "Files not taken over");
+
+   count = scanTopGetSorted(second, ScanTopKind_Folder, entries, SCAN_TOP_MAX_ENTRIES);
+   x_fail_unless(count == 2 && entries[0].size == 5000 && entries[1].size == 2000, "Wrong folders of the cached scan");
+
+   diskScanCacheDestroy(cache);
+   diskScannerDestroy(scanner);
+   scanTopDestroy(first);
+   scanTopDestroy(second);
+
+   (void)system("rm -rf " TEST_TOP_APP);
+}
+END_TEST
+
+
+
+START_TEST(test_LimitsTable)
+{
+   unsigned int i = 0;
+   int ret = 0, found = 0;
+   char appId[32];
+   const LimitsEntry_s* entry = NULL;
+   const LimitsEntry_s* other = NULL;
+   LimitsTable_s* table = limitsTableCreate();
+
+   X_TEST_REPORT_TEST_NAME("persistence_health_monitor_test");
+   X_TEST_REPORT_COMP_NAME("libpersistence_health_monitor");
+   X_TEST_REPORT_REFERENCE("NONE");
+   X_TEST_REPORT_DESCRIPTION("Limits table finds every configured application and only those");
+   X_TEST_REPORT_TYPE(GOOD);
+
+   x_fail_unless(table != NULL, "Failed to create table");
+
+   for(i = 0; i < TEST_LIMITS_COUNT && ret == 0; i++)
+   {
+      snprintf(appId, sizeof(appId), "app%u", i * 2);
+      ret = limitsTableAdd(table, appId, 1000 + i, i);
+   }
+   x_fail_unless(ret == 0, "Failed to add limits");
+   ret  = limitsTableAdd(table, "app4", 7, 7);       // the first entry of an application is kept
+   // the two names have the same crc32
+   ret |= limitsTableAdd(table, "plumless", 1, 0);
+   ret |= limitsTableAdd(table, "buckeroo", 2, 0);
+   x_fail_unless(ret == 0, "Failed to add duplicates");
+
+   entry = limitsTableFind(table, "app0", limitsHash("app0"));
+   x_fail_unless(entry == NULL, "Found entry before the table is sealed");
+
+   ret = limitsTableSeal(table);
+   x_fail_unless(ret == 0, "Failed to seal table");
+   ret = limitsTableAdd(table, "late", 1, 1);
+   x_fail_unless(ret == -1, "Added to sealed table");
+
+   for(i = 0; i < TEST_LIMITS_COUNT * 2; i++)
+   {
+      snprintf(appId, sizeof(appId), "app%u", i);
+      entry = limitsTableFind(table, appId, limitsHash(appId));
+      if((i % 2) == 0 && entry != NULL && entry->size == 1000 + i / 2 && entry->inodes == i / 2)
+      {
+         found++;
+      }
+      else if((i % 2) == 1 && entry == NULL)
+      {
+         found++;
+      }
+   }
+   x_fail_unless(found == TEST_LIMITS_COUNT * 2, "Wrong lookup results");
+
+   entry = limitsTableFind(table, "plumless", limitsHash("plumless"));
+   other = limitsTableFind(table, "buckeroo", limitsHash("buckeroo"));
+   x_fail_unless(entry != NULL && other != NULL && entry->size == 1 && other->size == 2, "Colliding names share a limit");
+
+   entry = limitsTableFind(table, "app", limitsHash("app"));
+   x_fail_unless(entry == NULL, "Found unknown application");
+
+   limitsTableDestroy(table);
+}
+END_TEST
+
+
+
+START_TEST(test_ConfigCache)
+{
+   int ret = 0, fd = -1;
+   struct stat source;
+   const char* tokens[4];
+   const char* written[] = { "@scanCache", "4", "@root", "/tmp" };
+   const LimitsEntry_s* entry = NULL;
+   LimitsTable_s* limits[2] = { limitsTableCreate(), limitsTableCreate() };
+   LimitsTable_s* mapped = NULL;
+   ConfigCache_s* cache = NULL;
+
+   X_TEST_REPORT_TEST_NAME("persistence_health_monitor_test");
+   X_TEST_REPORT_COMP_NAME("libpersistence_health_monitor");
+   X_TEST_REPORT_REFERENCE("NONE");
+   X_TEST_REPORT_DESCRIPTION("Compiled configuration is used in place and only for the file it belongs to");
+   X_TEST_REPORT_TYPE(GOOD);
+
+   unlink(TEST_CACHE_FILE);
+   ret = createTestFile(TEST_CACHE_CONFIG, 100);
+   ret |= stat(TEST_CACHE_CONFIG, &source);
+   x_fail_unless(ret == 0 && limits[0] != NULL && limits[1] != NULL, "Failed to prepare test");
+
+   ret  = limitsTableAdd(limits[0], "firstApp", 1000, 10);
+   ret |= limitsTableAdd(limits[1], "secondApp", 2000, 0);
+   x_fail_unless(ret == 0, "Failed to add limits");
+
+   ret = configCacheWrite(TEST_CACHE_FILE, &source, written, 4, limits, 2);
+   x_fail_unless(ret == -1, "Unsealed table written");
+
+   ret  = limitsTableSeal(limits[0]);
+   ret |= limitsTableSeal(limits[1]);
+   ret |= configCacheWrite(TEST_CACHE_FILE, &source, written, 4, limits, 2);
+   x_fail_unless(ret == 0, "Failed to write cache");
+
+   cache = configCacheOpen(TEST_CACHE_FILE, &source);
+   x_fail_unless(cache != NULL, "Failed to open cache");
+   ret = configCacheGetTokens(cache, tokens, 4);
+   x_fail_unless(ret == 4 && 0 == strcmp(tokens[1], "4") && 0 == strcmp(tokens[3], "/tmp"), "Wrong tokens");
+   x_fail_unless(configCacheGetTableCount(cache) == 2, "Wrong number of tables");
+
+   mapped = configCacheGetLimits(cache, 1);
+   x_fail_unless(mapped != NULL, "Failed to map table");
+   entry = limitsTableFind(mapped, "secondApp", limitsHash("secondApp"));
+   x_fail_unless(entry != NULL && entry->size == 2000, "Wrong mapped limits");
+   entry = limitsTableFind(mapped, "firstApp", limitsHash("firstApp"));
+   x_fail_unless(entry == NULL, "Limits of another root found");
+   limitsTableDestroy(mapped);
+   configCacheClose(cache);
+
+   // another version of the configuration file
+   source.st_size++;
+   cache = configCacheOpen(TEST_CACHE_FILE, &source);
+   x_fail_unless(cache == NULL, "Outdated cache used");
+   source.st_size--;
+
+   // damaged cache
+   fd = open(TEST_CACHE_FILE, O_WRONLY);
+   x_fail_unless(fd != -1, "Failed to open cache file");
+   ret = (pwrite(fd, "X", 1, 100) == 1) ? 0 : -1;
+   close(fd);
+   x_fail_unless(ret == 0, "Failed to damage cache");
+   cache = configCacheOpen(TEST_CACHE_FILE, &source);
+   x_fail_unless(cache == NULL, "Damaged cache used");
+
+   limitsTableDestroy(limits[0]);
+   limitsTableDestroy(limits[1]);
+   unlink(TEST_CACHE_FILE);
+   unlink(TEST_CACHE_CONFIG);
+}
+END_TEST
+
+
+
+
+START_TEST(test_ConfigReader)
+{
+   int ret = 0, fd = -1, i = 0, count = 0, len = 0;
+   unsigned int line = 0;
+   const char* key = NULL;
+   const char* value = NULL;
+   char longKey[101];
+   char buffer[200];
+   ConfigReader_s* reader = NULL;
+   // comment, CRLF line end, comment after an entry, two malformed lines, empty line
+   const char* head = "# size limits\n@root /tmp\r\n  appA\t100  # comment\nmalformed\na b c\n\n";
+
+   X_TEST_REPORT_TEST_NAME("persistence_health_monitor_test");
+   X_TEST_REPORT_COMP_NAME("libpersistence_health_monitor");
+   X_TEST_REPORT_REFERENCE("NONE");
+   X_TEST_REPORT_DESCRIPTION("Configuration file entries are read without a limit and malformed lines are skipped");
+   X_TEST_REPORT_TYPE(GOOD);
+
+   // longer than a block, so it spans at least one block boundary
+   memset(longKey, 'k', sizeof(longKey) - 1);
+   longKey[sizeof(longKey) - 1] = '\0';
+
+   fd = open(TEST_READER_CONFIG, O_CREAT | O_WRONLY | O_TRUNC, 0644);
+   x_fail_unless(fd != -1, "Failed to create config file");
+   ret = (write(fd, head, strlen(head)) == (ssize_t)strlen(head)) ? 0 : -1;
+   len = snprintf(buffer, sizeof(buffer), "%s 7\n", longKey);
+   ret |= (write(fd, buffer, len) == len) ? 0 : -1;
+   for(i = 0; i < TEST_READER_COUNT; i++)
+   {
+      // the last line has no line feed
+      len = snprintf(buffer, sizeof(buffer), (i < TEST_READER_COUNT - 1) ? "app%d %d\n" : "app%d %d", i, i);
+      ret |= (write(fd, buffer, len) == len) ? 0 : -1;
+   }
+   close(fd);
+   x_fail_unless(ret == 0, "Failed to write config file");
+
+   reader = configReaderOpen(TEST_READER_CONFIG);
+   x_fail_unless(reader != NULL, "Failed to open config file");
+
+   ret = configReaderNext(reader, &key, &value, &line);
+   x_fail_unless(ret == 1 && 0 == strcmp(key, "@root") && 0 == strcmp(value, "/tmp") && line == 2, "Wrong entry after comment");
+   ret = configReaderNext(reader, &key, &value, &line);
+   x_fail_unless(ret == 1 && 0 == strcmp(key, "appA") && 0 == strcmp(value, "100") && line == 3, "Wrong entry with comment");
+   ret = configReaderNext(reader, &key, &value, &line);
+   x_fail_unless(ret == 1 && 0 == strcmp(key, longKey) && 0 == strcmp(value, "7") && line == 7, "Wrong long entry");
+   x_fail_unless(configReaderGetErrors(reader) == 2, "Malformed lines not reported");
+
+   while(configReaderNext(reader, &key, &value, &line) == 1)
+   {
+      snprintf(buffer, sizeof(buffer), "app%d", count);
+      if(0 == strcmp(key, buffer) && atoi(value) == count && line == (unsigned int)(8 + count))
+      {
+         count++;
+      }
+   }
+   x_fail_unless(count == TEST_READER_COUNT, "Wrong number of entries");
+   ret = configReaderNext(reader, &key, &value, &line);
+   x_fail_unless(ret == 0, "Entry after the end of the file");
+
+   configReaderClose(reader);
+   unlink(TEST_READER_CONFIG);
+}
+END_TEST
+
+
+
+
+START_TEST(test_Crc32)
+{
+   int ret = 0, impl = 0, offset = 0, len = 0;
+   unsigned int seed = 1, expected = 0, crc = 0;
+   static unsigned char data[TEST_CRC_SIZE + 16];
+
+   X_TEST_REPORT_TEST_NAME("persistence_health_monitor_test");
+   X_TEST_REPORT_COMP_NAME("libpersistence_health_monitor");
+   X_TEST_REPORT_REFERENCE("NONE");
+   X_TEST_REPORT_DESCRIPTION("All crc32 implementations give the same result, pclCrc32 keeps its values");
+   X_TEST_REPORT_TYPE(GOOD);
+
+   // the values of pclCrc32 are stored, "app102" is one where it is not the standard CRC-32
+   x_fail_unless(pclCrc32(0, (const unsigned char*)"123456789", 9) == 0xCBF43926, "Wrong pclCrc32");
+   x_fail_unless(pclCrc32(0, (const unsigned char*)"app102", 6) == 0xBD3A5632, "pclCrc32 changed");
+   x_fail_unless(pclCrc32Ieee(0, (const unsigned char*)"app102", 6) == 0xD2BFD5DB, "Wrong pclCrc32Ieee");
+   x_fail_unless(pclCrc32Ieee(0, NULL, 6) == 0, "NULL buffer not handled");
+   x_fail_unless(pclCrc32IeeeSupported(PCL_CRC32_BYTEWISE) == 1 && pclCrc32IeeeSupported(PCL_CRC32_SLICE8) == 1,
+                 "Portable implementation not supported");
+
+   for(len = 0; len < (int)sizeof(data); len++)
+   {
+      seed = seed * 1103515245 + 12345;
+      data[len] = (unsigned char)(seed >> 16);
+   }
+
+   for(impl = 0; impl < PCL_CRC32_IMPL_COUNT; impl++)
+   {
+      if(pclCrc32IeeeSupported((pclCrc32Impl_e)impl) == 0)
+      {
+         continue;
+      }
+
+      ret = (pclCrc32IeeeUsing((pclCrc32Impl_e)impl, 0, (const unsigned char*)"123456789", 9) == 0xCBF43926) ? 0 : -1;
+      for(offset = 0; offset < 16 && ret == 0; offset++)
+      {
+         for(len = 0; len <= TEST_CRC_SIZE && ret == 0; len++)
+         {
+            expected = pclCrc32IeeeUsing(PCL_CRC32_BYTEWISE, 0, data + offset, len);
+            crc = pclCrc32IeeeUsing((pclCrc32Impl_e)impl, 0, data + offset, len);
+            // and in two parts
+            ret = (crc == expected) ? 0 : -1;
+            crc = pclCrc32IeeeUsing((pclCrc32Impl_e)impl, 0, data + offset, len / 3);
+            crc = pclCrc32IeeeUsing((pclCrc32Impl_e)impl, crc, data + offset + len / 3, len - len / 3);
+            ret |= (crc == expected) ? 0 : -1;
+         }
+      }
+      x_fail_unless(ret == 0, "Implementations differ");
+   }
+}
+END_TEST
+
+
+
+
+START_TEST(test_Crc32Benchmark)
+{
+   int impl = 0, round = 0;
+   unsigned int crc = 0, expected = 0;
+   unsigned char* data = malloc(TEST_CRC_BENCH_SIZE);
+   struct timespec start, end;
+
+   X_TEST_REPORT_TEST_NAME("persistence_health_monitor_test");
+   X_TEST_REPORT_COMP_NAME("libpersistence_health_monitor");
+   X_TEST_REPORT_REFERENCE("NONE");
+   X_TEST_REPORT_DESCRIPTION("Throughput of the crc32 implementations");
+   X_TEST_REPORT_TYPE(GOOD);
+
+   x_fail_unless(data != NULL, "Failed to allocate buffer");
+   for(round = 0; round < TEST_CRC_BENCH_SIZE; round++)
+   {
+      data[round] = (unsigned char)(round * 131 + (round >> 9));
+   }
+   expected = pclCrc32IeeeUsing(PCL_CRC32_BYTEWISE, 0, data, TEST_CRC_BENCH_SIZE);
+
+   for(impl = 0; impl < PCL_CRC32_IMPL_COUNT; impl++)
+   {
+      long long ns = 0;
+
+      if(pclCrc32IeeeSupported((pclCrc32Impl_e)impl) == 0)
+      {
+         printf("crc32 implementation %d: not supported\n", impl);
+         continue;
+      }
+
+      clock_gettime(CLOCK_MONOTONIC, &start);
+      for(round = 0; round < TEST_CRC_BENCH_ROUNDS; round++)
+      {
+         crc = pclCrc32IeeeUsing((pclCrc32Impl_e)impl, 0, data, TEST_CRC_BENCH_SIZE);
+      }
+      clock_gettime(CLOCK_MONOTONIC, &end);
+      x_fail_unless(crc == expected, "Implementations differ");
+
+      ns = (end.tv_sec - start.tv_sec) * 1000000000LL + (end.tv_nsec - start.tv_nsec);
+      printf("crc32 implementation %d: %lld MiB/s\n", impl,
+             (ns > 0) ? (long long)TEST_CRC_BENCH_ROUNDS * 1000000000LL / ns : 0);
+   }
+
+   // the legacy function for comparison
+   clock_gettime(CLOCK_MONOTONIC, &start);
+   for(round = 0; round < TEST_CRC_BENCH_ROUNDS; round++)
+   {
+      crc = pclCrc32(0, data, TEST_CRC_BENCH_SIZE);
+   }
+   clock_gettime(CLOCK_MONOTONIC, &end);
+   printf("pclCrc32: %lld MiB/s\n",
+          (long long)TEST_CRC_BENCH_ROUNDS * 1000000000LL / ((end.tv_sec - start.tv_sec) * 1000000000LL + (end.tv_nsec - start.tv_nsec) + 1));
+
+   free(data);
+}
+END_TEST
+
+
+
+
+/// reader of the usage snapshot test, started while the snapshot is written
+static void* runSnapshotRead(void* dataPtr)
+{
+   PhmUsageApp_s* app = (PhmUsageApp_s*)dataPtr;
+   const PhmUsageShm_s* shm = phmUsageOpen();
+   int ret = -1;
+
+   if(shm != NULL)
+   {
+      ret = phmUsageGetApp(shm, app->appId, app);
+      phmUsageClose(shm);
+   }
+   return (ret == 0) ? dataPtr : NULL;
+}
+
+
+
+START_TEST(test_UsageSnapshot)
+{
+   int ret = 0;
+   void* threadRet = NULL;
+   pthread_t thread;
+   char appId[TEST_SNAPSHOT_APPID_LEN + 1];
+   PhmUsageApp_s app, readerApp;
+   PhmUsageRoot_s root;
+   PhmUsageSnapshot_s* snapshot = NULL;
+   const PhmUsageShm_s* reader = NULL;
+   PhmUsageShm_s* shm = usageShmCreate();
+
+   X_TEST_REPORT_TEST_NAME("persistence_health_monitor_test");
+   X_TEST_REPORT_COMP_NAME("libpersistence_health_monitor");
+   X_TEST_REPORT_REFERENCE("NONE");
+   X_TEST_REPORT_DESCRIPTION("Usage snapshot is read consistently, long AppIDs are found");
+   X_TEST_REPORT_TYPE(GOOD);
+
+   x_fail_unless(shm != NULL, "Failed to create snapshot");
+   memset(appId, 'a', TEST_SNAPSHOT_APPID_LEN);
+   appId[TEST_SNAPSHOT_APPID_LEN] = '\0';
+
+   snapshot = usageShmBeginUpdate(shm);
+   memset(snapshot, 0, sizeof(PhmUsageSnapshot_s));
+   snapshot->version   = PHM_USAGE_VERSION;
+   snapshot->rootCount = 1;
+   snapshot->appCount  = 1;
+   snapshot->missingApps = 3;
+   strcpy(snapshot->roots[0].path, "/tmp");
+   snapshot->roots[0].appCount = 1;
+   strcpy(snapshot->apps[0].appId, appId);
+   snapshot->apps[0].size = 1000;
+   usageShmEndUpdate(shm);
+
+   reader = phmUsageOpen();
+   x_fail_unless(reader != NULL, "Failed to open snapshot");
+   ret = phmUsageGetApp(reader, appId, &app);
+   x_fail_unless(ret == 0 && app.size == 1000, "Long AppID not found");
+   ret = phmUsageGetRoot(reader, app.root, &root);
+   x_fail_unless(ret == 0 && 0 == strcmp(root.path, "/tmp"), "Wrong root");
+   x_fail_unless(reader->snapshot.missingApps == 3, "Missing applications not published");
+   appId[TEST_SNAPSHOT_APPID_LEN - 1] = 'b';
+   ret = phmUsageGetApp(reader, appId, &app);
+   x_fail_unless(ret == -2, "AppID matched by prefix");
+   appId[TEST_SNAPSHOT_APPID_LEN - 1] = 'a';
+
+   // a reader started during an update waits for its end and gets the new values
+   snapshot = usageShmBeginUpdate(shm);
+   snapshot->apps[0].size = 2000;
+   memset(&readerApp, 0, sizeof(readerApp));
+   strcpy(readerApp.appId, appId);
+   ret = pthread_create(&thread, NULL, runSnapshotRead, &readerApp);
+   x_fail_unless(ret == 0, "Failed to start reader");
+   usleep(50000);
+   snapshot->apps[0].inodes = 20;
+   usageShmEndUpdate(shm);
+   pthread_join(thread, &threadRet);
+   x_fail_unless(threadRet != NULL && readerApp.size == 2000 && readerApp.inodes == 20, "Reader saw a partial update");
+
+   // a monitor with another layout
+   snapshot = usageShmBeginUpdate(shm);
+   snapshot->version = PHM_USAGE_VERSION + 1;
+   usageShmEndUpdate(shm);
+   ret = phmUsageGetApp(reader, appId, &app);
+   x_fail_unless(ret == -1, "Snapshot of another version read");
+   ret = phmUsageGetRoot(reader, 0, &root);
+   x_fail_unless(ret == -1, "Root of another version read");
+
+   // a monitor that died while writing, the reader gives up instead of spinning forever
+   snapshot = usageShmBeginUpdate(shm);
+   snapshot->version = PHM_USAGE_VERSION;
+   ret = phmUsageGetApp(reader, appId, &app);
+   x_fail_unless(ret == -1, "Snapshot read during an update that never ends");
+   ret = phmUsageGetRoot(reader, 0, &root);
+   x_fail_unless(ret == -1, "Root read during an update that never ends");
+   usageShmEndUpdate(shm);
+   ret = phmUsageGetRoot(reader, 1, &root);
+   x_fail_unless(ret == -2, "Root behind the last one found");
+
+   phmUsageClose(reader);
+   usageShmDestroy(shm);
+}
+END_TEST
+
+
+
+
+START_TEST(test_ScanFolderRelative)
+{
+   int i = 0, ret = 0, fd = -1, rootFd = -1, fileFd = -1;
+   char name[TEST_RELATIVE_NAME_LEN + 1];
+   DiskScanOptions_s options = { DiskScanBackend_Sync, DiskScanMetric_Apparent, NULL };
+   DiskScanUsage_s usage;
+
+   X_TEST_REPORT_TEST_NAME("persistence_health_monitor_test");
+   X_TEST_REPORT_COMP_NAME("libpersistence_health_monitor");
+   X_TEST_REPORT_REFERENCE("NONE");
+   X_TEST_REPORT_DESCRIPTION("Scan relative to a folder descriptor, also below a path longer than PATH_MAX");
+   X_TEST_REPORT_TYPE(GOOD);
+
+   x_fail_unless(TEST_RELATIVE_DEPTH * (TEST_RELATIVE_NAME_LEN + 1) > PATH_MAX, "Test tree not deep enough");
+
+   // App holds one 10 byte file on each level, the levels are created relative to the parent
+   memset(name, 'd', TEST_RELATIVE_NAME_LEN);
+   name[TEST_RELATIVE_NAME_LEN] = '\0';
+   (void)system("rm -rf " TEST_RELATIVE_ROOT);
+   mkdir(TEST_RELATIVE_ROOT, 0755);
+   mkdir(TEST_RELATIVE_ROOT "/App", 0755);
+   rootFd = open(TEST_RELATIVE_ROOT, O_RDONLY | O_DIRECTORY);
+   x_fail_unless(rootFd != -1, "Failed to open test root");
+   fd = openat(rootFd, "App", O_RDONLY | O_DIRECTORY);
+   for(i = 0; i < TEST_RELATIVE_DEPTH && fd != -1; i++)
+   {
+      int next = -1;
+
+      fileFd = openat(fd, "f", O_CREAT | O_WRONLY | O_TRUNC, 0644);
+      x_fail_unless(fileFd != -1, "Failed to create test file");
+      ret = write(fileFd, "0123456789", 10);
+      x_fail_unless(ret == 10, "Failed to write test file");
+      close(fileFd);
+
+      if(mkdirat(fd, name, 0755) == 0)
+      {
+         next = openat(fd, name, O_RDONLY | O_DIRECTORY);
+      }
+      close(fd);
+      fd = next;
+   }
+   x_fail_unless(fd != -1, "Failed to create test folders");
+   close(fd);
+
+   ret = diskScanFolder(rootFd, "App", &options, &usage);
+   x_fail_unless(ret == 0, "Scan relative to the root descriptor failed");
+   x_fail_unless(usage.size == 10 * TEST_RELATIVE_DEPTH && usage.files == TEST_RELATIVE_DEPTH, "Wrong file usage");
+   x_fail_unless(usage.folders == TEST_RELATIVE_DEPTH + 1, "Wrong number of folders");
+
+   // the name is resolved against the descriptor, not the working directory
+   ret = diskScanFolder(AT_FDCWD, "App", &options, &usage);
+   x_fail_unless(ret == -1, "Name resolved against the working directory");
+   ret = diskScanFolder(rootFd, "Missing", &options, &usage);
+   x_fail_unless(ret == -1, "Missing folder scanned");
+
+   close(rootFd);
+   (void)system("rm -rf " TEST_RELATIVE_ROOT);
+}
+END_TEST
+
+
+
+
+START_TEST(test_ScanBackendParity)
+{
+   int i = 0, j = 0, m = 0, ret = 0;
+   char path[256];
+   DiskScanUsage_s usage[DiskScanBackend_LastEntry];
+
+   X_TEST_REPORT_TEST_NAME("persistence_health_monitor_test");
+   X_TEST_REPORT_COMP_NAME("libpersistence_health_monitor");
+   X_TEST_REPORT_REFERENCE("NONE");
+   X_TEST_REPORT_DESCRIPTION("The io_uring and the synchronous walk return the same usage of a tree");
+   X_TEST_REPORT_TYPE(GOOD);
+
+   // TEST_PARITY_FOLDERS folders in two levels with files of different sizes, a sparse file and a symbolic link
+   (void)system("rm -rf " TEST_PARITY_APP);
+   mkdir(TEST_PARITY_APP, 0755);
+   for(i = 0; i < TEST_PARITY_FOLDERS; i++)
+   {
+      snprintf(path, sizeof(path), TEST_PARITY_APP "/%d", i / 10);
+      mkdir(path, 0755);
+      snprintf(path, sizeof(path), TEST_PARITY_APP "/%d/%d", i / 10, i);
+      ret = mkdir(path, 0755);
+      x_fail_unless(ret == 0, "Failed to create test folder");
+      for(j = 0; j < TEST_PARITY_FILES; j++)
+      {
+         snprintf(path, sizeof(path), TEST_PARITY_APP "/%d/%d/f%d", i / 10, i, j);
+         ret = createTestFile(path, (i * TEST_PARITY_FILES + j) * 37);
+         x_fail_unless(ret == 0, "Failed to create test file");
+      }
+   }
+   ret = truncate(TEST_PARITY_APP "/0/0/f1", 1024 * 1024);
+   x_fail_unless(ret == 0, "Failed to create sparse file");
+   ret = symlink("0/0/f1", TEST_PARITY_APP "/link");
+   x_fail_unless(ret == 0, "Failed to create symbolic link");
+
+   for(m = 0; m < DiskScanMetric_LastEntry; m++)
+   {
+      for(i = 0; i < DiskScanBackend_LastEntry; i++)
+      {
+         DiskScanOptions_s options = { (DiskScanBackend_e)i, (DiskScanMetric_e)m, NULL };
+         DiskScanner_s* scanner = diskScannerCreate(&options);
+
+         x_fail_unless(scanner != NULL, "Failed to create scanner");
+         if(diskScannerGetBackend(scanner) != (DiskScanBackend_e)i)
+         {
+            printf("Backend %s not supported, parity test runs the fallback\n", diskScanGetBackendName((DiskScanBackend_e)i));
+         }
+
+         // the second run of the same scanner must not see anything left from the first
+         ret  = diskScannerRun(scanner, AT_FDCWD, TEST_PARITY_APP, NULL, NULL, &usage[i]);
+         ret |= diskScannerRun(scanner, AT_FDCWD, TEST_PARITY_APP, NULL, NULL, &usage[i]);
+         x_fail_unless(ret == 0, "Scan failed");
+         diskScannerDestroy(scanner);
+      }
+
+      x_fail_unless(   usage[DiskScanBackend_Sync].files   == TEST_PARITY_FOLDERS * TEST_PARITY_FILES
+                    && usage[DiskScanBackend_Sync].folders == 1 + TEST_PARITY_FOLDERS / 10 + TEST_PARITY_FOLDERS, "Wrong count");
+      x_fail_unless(   usage[DiskScanBackend_Uring].size    == usage[DiskScanBackend_Sync].size
+                    && usage[DiskScanBackend_Uring].files   == usage[DiskScanBackend_Sync].files
+                    && usage[DiskScanBackend_Uring].folders == usage[DiskScanBackend_Sync].folders, "Backends differ");
+   }
+
+   (void)system("rm -rf " TEST_PARITY_APP);
 }
+END_TEST
 
 
-START_TEST(test_SendNotification)
+
+
+START_TEST(test_ScanCacheTimes)
 {
+   int ret = 0, fd = -1;
+   unsigned int files = 0;
+   unsigned long long size = 0;
+   struct stat dirStat;
+   DiskScanOptions_s options = { DiskScanBackend_Sync, DiskScanMetric_Apparent, NULL };
+   DiskScanUsage_s usage;
+   DiskScanner_s* scanner = NULL;
+   DiskScanCache_s* cache = NULL;
+
    X_TEST_REPORT_TEST_NAME("persistence_health_monitor_test");
    X_TEST_REPORT_COMP_NAME("libpersistence_health_monitor");
    X_TEST_REPORT_REFERENCE("NONE");
-   X_TEST_REPORT_DESCRIPTION("Send notification to healt monitor");
+   X_TEST_REPORT_DESCRIPTION("Folder cache entries are used while mtime and ctime are unchanged and dropped after a change");
+   X_TEST_REPORT_TYPE(GOOD);
+
+   // a 100, sub/b 200
+   (void)system("rm -rf " TEST_CACHE_APP);
+   mkdir(TEST_CACHE_APP, 0755);
+   mkdir(TEST_CACHE_APP "/sub", 0755);
+   ret  = createTestFile(TEST_CACHE_APP "/a", 100);
+   ret |= createTestFile(TEST_CACHE_APP "/sub/b", 200);
+   x_fail_unless(ret == 0, "Failed to create test files");
+
+   scanner = diskScannerCreate(&options);
+   cache   = diskScanCacheCreate();
+   x_fail_unless(scanner != NULL && cache != NULL, "Failed to create scanner");
+
+   // a folder changed within the last second is not stored
+   ret = stat(TEST_CACHE_APP, &dirStat);
+   x_fail_unless(ret == 0, "Failed to stat test folder");
+   diskScanCacheStore(cache, &dirStat, 999, 7);
+   x_fail_unless(diskScanCacheLookup(cache, &dirStat, &size, &files) == 0, "Recently changed folder stored");
+
+   sleep(2);
+
+   ret = stat(TEST_CACHE_APP, &dirStat);
+   diskScanCacheStore(cache, &dirStat, 999, 7);
+   x_fail_unless(diskScanCacheLookup(cache, &dirStat, &size, &files) == 1 && size == 999 && files == 7, "Cache miss");
+   diskScanCacheClear(cache);
+   x_fail_unless(diskScanCacheLookup(cache, &dirStat, &size, &files) == 0, "Entry left after clear");
+
+   ret = diskScannerRun(scanner, AT_FDCWD, TEST_CACHE_APP, cache, NULL, &usage);
+   x_fail_unless(ret == 0 && usage.size == 300 && usage.files == 2, "First scan failed");
+
+   // hit: appending to a file leaves the folder times alone, the cached total is reported (see header)
+   fd = open(TEST_CACHE_APP "/a", O_WRONLY | O_APPEND);
+   ret = write(fd, "0123456789", 10);
+   close(fd);
+   x_fail_unless(ret == 10, "Failed to append to test file");
+   ret = diskScannerRun(scanner, AT_FDCWD, TEST_CACHE_APP, cache, NULL, &usage);
+   x_fail_unless(ret == 0 && usage.size == 300, "Cached total not used");
+
+   // mtime miss: a new file in the application folder, sub is still served from the cache
+   fd = open(TEST_CACHE_APP "/sub/b", O_WRONLY | O_APPEND);
+   ret = write(fd, "0123456789", 10);
+   close(fd);
+   x_fail_unless(ret == 10, "Failed to append to test file");
+   ret = createTestFile(TEST_CACHE_APP "/c", 50);
+   x_fail_unless(ret == 0, "Failed to create test file");
+   ret = diskScannerRun(scanner, AT_FDCWD, TEST_CACHE_APP, cache, NULL, &usage);
+   x_fail_unless(ret == 0 && usage.size == 110 + 50 + 200 && usage.files == 3, "Folder mtime change not seen");
+
+   // ctime miss: a mode change only updates the ctime of sub
+   ret = chmod(TEST_CACHE_APP "/sub", 0700);
+   x_fail_unless(ret == 0, "Failed to change mode of test folder");
+   ret = diskScannerRun(scanner, AT_FDCWD, TEST_CACHE_APP, cache, NULL, &usage);
+   x_fail_unless(ret == 0 && usage.size == 110 + 50 + 210, "Folder ctime change not seen");
+
+   diskScanCacheDestroy(cache);
+   diskScannerDestroy(scanner);
+
+   (void)system("rm -rf " TEST_CACHE_APP);
+}
+END_TEST
+
+
+
+
+START_TEST(test_ScanHardLinks)
+{
+   int i = 0, ret = 0, found = 0;
+   DiskScanUsage_s usage;
+   DiskScanCache_s* cache = NULL;
+   InodeSet_s* set = NULL;
+
+   X_TEST_REPORT_TEST_NAME("persistence_health_monitor_test");
+   X_TEST_REPORT_COMP_NAME("libpersistence_health_monitor");
+   X_TEST_REPORT_REFERENCE("NONE");
+   X_TEST_REPORT_DESCRIPTION("A file with several hard links counts once");
+   X_TEST_REPORT_TYPE(GOOD);
+
+   set = inodeSetCreate();
+   x_fail_unless(set != NULL, "Failed to create inode set");
+   for(i = 0; i < TEST_LINK_INODES; i++)
+   {
+      ret = inodeSetInsert(set, 1, (ino_t)(i + 1) * 7919);
+      x_fail_unless(ret == 1, "New inode not added");
+   }
+   for(i = 0; i < TEST_LINK_INODES; i++)
+   {
+      found += (inodeSetInsert(set, 1, (ino_t)(i + 1) * 7919) == 0) ? 1 : 0;
+   }
+   x_fail_unless(found == TEST_LINK_INODES, "Inode added twice");
+   ret = inodeSetInsert(set, 2, 7919);
+   x_fail_unless(ret == 1, "Same inode of another device not added");
+   inodeSetClear(set);
+   ret = inodeSetInsert(set, 1, 7919);
+   x_fail_unless(ret == 1, "Inode left after clear");
+   inodeSetDestroy(set);
+
+   // a 1000 with links b and sub/c, single 10
+   (void)system("rm -rf " TEST_LINK_APP);
+   mkdir(TEST_LINK_APP, 0755);
+   mkdir(TEST_LINK_APP "/sub", 0755);
+   ret  = createTestFile(TEST_LINK_APP "/a", 1000);
+   ret |= createTestFile(TEST_LINK_APP "/single", 10);
+   ret |= link(TEST_LINK_APP "/a", TEST_LINK_APP "/b");
+   ret |= link(TEST_LINK_APP "/a", TEST_LINK_APP "/sub/c");
+   x_fail_unless(ret == 0, "Failed to create test files");
+
+   // the folders may be cached, the links keep them out of it
+   cache = diskScanCacheCreate();
+   x_fail_unless(cache != NULL, "Failed to create cache");
+   sleep(2);
+
+   for(i = 0; i < DiskScanBackend_LastEntry; i++)
+   {
+      DiskScanOptions_s options = { (DiskScanBackend_e)i, DiskScanMetric_Apparent, NULL };
+      DiskScanner_s* scanner = diskScannerCreate(&options);
+
+      x_fail_unless(scanner != NULL, "Failed to create scanner");
+      ret = diskScannerRun(scanner, AT_FDCWD, TEST_LINK_APP, cache, NULL, &usage);
+      x_fail_unless(ret == 0 && usage.size == 1010 && usage.files == 2, "Linked file counted more than once");
+      ret = diskScannerRun(scanner, AT_FDCWD, TEST_LINK_APP, cache, NULL, &usage);
+      x_fail_unless(ret == 0 && usage.size == 1010 && usage.files == 2, "Wrong usage of the second scan");
+      diskScannerDestroy(scanner);
+      diskScanCacheClear(cache);
+   }
+
+   // a link to a file of a folder served from the cache appears in another folder
+   (void)system("rm -rf " TEST_LINK_APP);
+   mkdir(TEST_LINK_APP, 0755);
+   mkdir(TEST_LINK_APP "/a", 0755);
+   ret = createTestFile(TEST_LINK_APP "/a/x", 1000);
+   x_fail_unless(ret == 0, "Failed to create test files");
+   sleep(2);
+
+   for(i = 0; i < DiskScanBackend_LastEntry; i++)
+   {
+      DiskScanOptions_s options = { (DiskScanBackend_e)i, DiskScanMetric_Apparent, NULL };
+      DiskScanner_s* scanner = diskScannerCreate(&options);
+      unsigned long long size = 0;
+      unsigned int files = 0;
+      struct stat dirStat;
+
+      x_fail_unless(scanner != NULL, "Failed to create scanner");
+      ret = diskScannerRun(scanner, AT_FDCWD, TEST_LINK_APP, cache, NULL, &usage);
+      x_fail_unless(ret == 0 && usage.size == 1000 && usage.files == 1, "Wrong usage of the first scan");
+      ret = stat(TEST_LINK_APP "/a", &dirStat);
+      x_fail_unless(ret == 0, "Failed to stat folder");
+      ret = diskScanCacheLookup(cache, &dirStat, &size, &files);
+      x_fail_unless(ret == 1 && size == 1000 && files == 1, "Folder not cached");
+
+      mkdir(TEST_LINK_APP "/b", 0755);
+      ret = link(TEST_LINK_APP "/a/x", TEST_LINK_APP "/b/y");
+      x_fail_unless(ret == 0, "Failed to create link");
+      ret = diskScannerRun(scanner, AT_FDCWD, TEST_LINK_APP, cache, NULL, &usage);
+      x_fail_unless(ret == 0 && usage.size == 1000 && usage.files == 1, "Link of a cached file counted again");
+      ret = diskScannerRun(scanner, AT_FDCWD, TEST_LINK_APP, cache, NULL, &usage);
+      x_fail_unless(ret == 0 && usage.size == 1000 && usage.files == 1, "Link counted again by the next scan");
+      ret = diskScanCacheLookup(cache, &dirStat, &size, &files);
+      x_fail_unless(ret == 0, "Folder served while the application has linked files");
+
+      // without the link the folder is served again
+      unlink(TEST_LINK_APP "/b/y");
+      rmdir(TEST_LINK_APP "/b");
+      ret = diskScannerRun(scanner, AT_FDCWD, TEST_LINK_APP, cache, NULL, &usage);
+      x_fail_unless(ret == 0 && usage.size == 1000 && usage.files == 1, "Wrong usage after the link is gone");
+      ret = diskScanCacheLookup(cache, &dirStat, &size, &files);
+      x_fail_unless(ret == 1 && size == 1000 && files == 1, "Folder not served after the link is gone");
+
+      diskScannerDestroy(scanner);
+      diskScanCacheClear(cache);
+   }
+
+   diskScanCacheDestroy(cache);
+   (void)system("rm -rf " TEST_LINK_APP);
+}
+END_TEST
+
+
+
+
+START_TEST(test_ScanSchedule)
+{
+   const ScanScheduleLimits_s limits = { 1000, 61000 };
+   const long long start = 1000000;
+   ScanSchedule_s schedule;
+
+   X_TEST_REPORT_TEST_NAME("persistence_health_monitor_test");
+   X_TEST_REPORT_COMP_NAME("libpersistence_health_monitor");
+   X_TEST_REPORT_REFERENCE("NONE");
+   X_TEST_REPORT_DESCRIPTION("Scan intervals follow the headroom and the growth and stay within the bounds");
+   X_TEST_REPORT_TYPE(GOOD);
+
+   // no limit: longest interval
+   memset(&schedule, 0, sizeof(schedule));
+   x_fail_unless(scanScheduleIsDue(&schedule, start) == 1, "Unscanned application not due");
+   scanScheduleUpdate(&schedule, start, 500, 0, &limits);
+   x_fail_unless(schedule.nextScanMs == start + 61000, "Wrong interval without limit");
+   x_fail_unless(scanScheduleIsDue(&schedule, start + 60999) == 0, "Due too early");
+   x_fail_unless(scanScheduleIsDue(&schedule, start + 61000) == 1, "Not due in time");
+
+   // half the limit used, no growth yet: half way between the bounds
+   memset(&schedule, 0, sizeof(schedule));
+   scanScheduleUpdate(&schedule, start, 500, 1000, &limits);
+   x_fail_unless(schedule.nextScanMs == start + 31000, "Wrong interval from headroom");
+
+   // 500 bytes in 10 s: smoothed growth 25 bytes/s, 500 bytes headroom reached in 20 s, four scans until then
+   memset(&schedule, 0, sizeof(schedule));
+   scanScheduleUpdate(&schedule, start, 0, 1000, &limits);
+   scanScheduleUpdate(&schedule, start + 10000, 500, 1000, &limits);
+   x_fail_unless(schedule.growthRate > 24.999 && schedule.growthRate < 25.001, "Wrong growth rate");
+   x_fail_unless(schedule.nextScanMs == start + 10000 + 5000, "Wrong interval from growth");
+
+   // shrinking does not shorten the interval
+   scanScheduleUpdate(&schedule, start + 20000, 0, 1000, &limits);
+   x_fail_unless(schedule.growthRate < 0.0, "Shrinking not measured");
+   x_fail_unless(schedule.nextScanMs == start + 20000 + 61000, "Wrong interval while shrinking");
+
+   // fast growth and a full application: shortest interval
+   scanScheduleUpdate(&schedule, start + 21000, 900, 1000, &limits);
+   x_fail_unless(schedule.nextScanMs == start + 21000 + 1000, "Interval below the lower bound");
+   scanScheduleUpdate(&schedule, start + 22000, 1000, 1000, &limits);
+   x_fail_unless(schedule.nextScanMs == start + 22000 + 1000, "Wrong interval at the limit");
+}
+END_TEST
+
+
+
+
+START_TEST(test_Forecast)
+{
+   int i = 0;
+   double rate = 0.0;
+   const long long start = 1000000;
+   ForecastHistory_s history;
+
+   X_TEST_REPORT_TEST_NAME("persistence_health_monitor_test");
+   X_TEST_REPORT_COMP_NAME("libpersistence_health_monitor");
+   X_TEST_REPORT_REFERENCE("NONE");
+   X_TEST_REPORT_DESCRIPTION("Least squares growth and time to limit of known series");
+   X_TEST_REPORT_TYPE(GOOD);
+
+   memset(&history, 0, sizeof(history));
+   x_fail_unless(forecastTimeToLimit(&history, start, 1000) == -1, "Estimate without samples");
+   forecastAddSample(&history, start, 100);
+   x_fail_unless(forecastGetGrowth(&history, &rate) == -1, "Growth from one sample");
+   forecastAddSample(&history, start, 200);
+   x_fail_unless(history.count == 1 && forecastGetGrowth(&history, &rate) == -1, "Sample at the same time not replaced");
+
+   // linear: 1000 bytes + 200 bytes/s, the oldest samples are overwritten
+   memset(&history, 0, sizeof(history));
+   for(i = 0; i < TEST_FORECAST_SAMPLES; i++)
+   {
+      forecastAddSample(&history, start + i * 1000, 1000 + 200 * (unsigned long long)i);
+   }
+   x_fail_unless(history.count == FORECAST_HISTORY_SIZE, "Wrong history size");
+   x_fail_unless(forecastGetGrowth(&history, &rate) == 0 && rate > 199.999 && rate < 200.001, "Wrong linear growth");
+
+   // newest sample 4800 bytes at start + 19 s, 6000 bytes left at 200 bytes/s, 5 s of it already gone
+   x_fail_unless(forecastTimeToLimit(&history, start + 24000, 10800) == 25000, "Wrong time to limit");
+   x_fail_unless(forecastTimeToLimit(&history, start + 60000, 10800) == 0, "Passed limit not reported as reached");
+   x_fail_unless(forecastTimeToLimit(&history, start + 19000, 4800) == 0, "Reached limit not reported");
+
+   // (0 s, 0) (1 s, 1) (2 s, 3): slope (3 * 7 - 3 * 4) / (3 * 5 - 3 * 3) = 1.5 bytes/s
+   memset(&history, 0, sizeof(history));
+   forecastAddSample(&history, start, 0);
+   forecastAddSample(&history, start + 1000, 1);
+   forecastAddSample(&history, start + 2000, 3);
+   x_fail_unless(forecastGetGrowth(&history, &rate) == 0 && rate > 1.4999 && rate < 1.5001, "Wrong least squares slope");
+
+   // shrinking: no estimate
+   forecastAddSample(&history, start + 3000, 0);
+   forecastAddSample(&history, start + 4000, 0);
+   x_fail_unless(forecastGetGrowth(&history, &rate) == 0 && rate < 0.0, "Shrinking not measured");
+   x_fail_unless(forecastTimeToLimit(&history, start + 4000, 1000) == -1, "Estimate while shrinking");
+}
+END_TEST
+
+
+
+
+START_TEST(test_ScanBudget)
+{
+   int i = 0, ret = 0;
+   char path[256];
+   long long start = 0, elapsed = 0;
+   ScanJob_s job;
+   ScanBudgetSlice_s slice;
+   ScanBudgetCounters_s counters;
+   ScanBudget_s* budget = NULL;
+   DiskScanOptions_s options = { DiskScanBackend_Sync, DiskScanMetric_Apparent, NULL };
+
+   X_TEST_REPORT_TEST_NAME("persistence_health_monitor_test");
+   X_TEST_REPORT_COMP_NAME("libpersistence_health_monitor");
+   X_TEST_REPORT_REFERENCE("NONE");
+   X_TEST_REPORT_DESCRIPTION("The scan budget pauses after its operations are used up and keeps the duty cycle");
+   X_TEST_REPORT_TYPE(GOOD);
+
+   scanBudgetCharge(NULL, &slice, 1000000);     // no budget, no pause
+
+   // token bucket: 1000 operations are available at once, 200 more take 200 ms
+   budget = scanBudgetCreate(1000, 100);
+   x_fail_unless(budget != NULL, "Failed to create budget");
+   scanBudgetBegin(&slice);
+   start = scanScheduleNow();
+   scanBudgetCharge(budget, &slice, 1000);
+   scanBudgetGetCounters(budget, &counters);
+   x_fail_unless(counters.tokenPauses == 0 && scanScheduleNow() - start < 100, "Paused within the budget");
+   scanBudgetCharge(budget, &slice, 200);
+   elapsed = scanScheduleNow() - start;
+   scanBudgetGetCounters(budget, &counters);
+   x_fail_unless(counters.tokenPauses == 1 && counters.dutyPauses == 0, "No pause after the budget is used up");
+   x_fail_unless(elapsed >= 150 && elapsed < 400 && counters.pausedMs >= 150 && counters.pausedMs < 250, "Wrong pause");
+   scanBudgetDestroy(budget);
+
+   // duty cycle 50 %: 120 ms busy are followed by 120 ms idle, the next period starts after it
+   budget = scanBudgetCreate(0, 50);
+   x_fail_unless(budget != NULL, "Failed to create budget");
+   scanBudgetBegin(&slice);
+   start = scanScheduleNow();
+   while(scanScheduleNow() - start < 120);
+   scanBudgetCharge(budget, &slice, 1);
+   elapsed = scanScheduleNow() - start;
+   scanBudgetGetCounters(budget, &counters);
+   x_fail_unless(counters.dutyPauses == 1 && counters.tokenPauses == 0, "No duty cycle pause");
+   x_fail_unless(elapsed >= 230 && elapsed < 500 && counters.pausedMs >= 115, "Wrong duty cycle");
+   scanBudgetCharge(budget, &slice, 1);
+   scanBudgetGetCounters(budget, &counters);
+   x_fail_unless(counters.dutyPauses == 1, "Paused again without being busy");
+   scanBudgetDestroy(budget);
+
+   // a scan a client waits for ignores the budget, a background scan of the same folder pauses
+   (void)system("rm -rf " TEST_BUDGET_APP);
+   mkdir(TEST_BUDGET_APP, 0755);
+   for(i = 0; i < TEST_BUDGET_FILES; i++)
+   {
+      snprintf(path, sizeof(path), TEST_BUDGET_APP "/f%d", i);
+      ret = createTestFile(path, 1);
+      x_fail_unless(ret == 0, "Failed to create test file");
+   }
+
+   budget = scanBudgetCreate(100, 100);
+   x_fail_unless(budget != NULL, "Failed to create budget");
+   options.budget = budget;
+   memset(&job, 0, sizeof(job));
+   job.appId     = TEST_BUDGET_APP;
+   job.unlimited = 1;
+   ret = scanPoolRun(AT_FDCWD, &job, 1, 1, &options);
+   scanBudgetGetCounters(budget, &counters);
+   x_fail_unless(ret == 0 && job.result == 0 && job.usage.files == TEST_BUDGET_FILES, "Unlimited scan failed");
+   x_fail_unless(counters.tokenPauses == 0, "Unlimited scan paused");
+
+   job.unlimited = 0;
+   ret = scanPoolRun(AT_FDCWD, &job, 1, 1, &options);
+   scanBudgetGetCounters(budget, &counters);
+   x_fail_unless(ret == 0 && job.result == 0 && job.usage.files == TEST_BUDGET_FILES, "Budgeted scan failed");
+   x_fail_unless(counters.tokenPauses > 0, "Budgeted scan did not pause");
+   scanBudgetDestroy(budget);
+
+   (void)system("rm -rf " TEST_BUDGET_APP);
+}
+END_TEST
+
+
+
+
+START_TEST(test_InodeLimits)
+{
+   unsigned long long size = 0, inodes = 0;
+   const LimitsEntry_s* entry = NULL;
+   LimitsTable_s* table = NULL;
+   LimitsTable_s* mapped = NULL;
+   void* image = NULL;
+
+   X_TEST_REPORT_TEST_NAME("persistence_health_monitor_test");
+   X_TEST_REPORT_COMP_NAME("libpersistence_health_monitor");
+   X_TEST_REPORT_REFERENCE("NONE");
+   X_TEST_REPORT_DESCRIPTION("Inode limits are parsed, kept by the limits table and rate the health like the size");
+   X_TEST_REPORT_TYPE(GOOD);
+
+   limitsParse("4096", &size, &inodes);
+   x_fail_unless(size == 4096 && inodes == 0, "Size without inodes parsed wrong");
+   limitsParse("4096:100", &size, &inodes);
+   x_fail_unless(size == 4096 && inodes == 100, "Size with inodes parsed wrong");
+   limitsParse("0:50", &size, &inodes);
+   x_fail_unless(size == 0 && inodes == 50, "Inodes without size parsed wrong");
+
+   // 10 percent below an inode limit is low, whatever the size says
+   x_fail_unless(limitsGetHealth(10, 4096, 89, 100) == PhmHealth_Ok, "Inodes rated low too early");
+   x_fail_unless(limitsGetHealth(10, 4096, 91, 100) == PhmHealth_Low, "Inodes close to the limit not rated low");
+   x_fail_unless(limitsGetHealth(10, 4096, 100, 100) == PhmHealth_Full, "Inode limit reached not rated full");
+   x_fail_unless(limitsGetHealth(10, 0, 100, 100) == PhmHealth_Full, "Inode limit without size limit ignored");
+   x_fail_unless(limitsGetHealth(4096, 4096, 1, 100) == PhmHealth_Full, "Size limit ignored next to an inode limit");
+   x_fail_unless(limitsGetHealth(10, 4096, 1000000, 0) == PhmHealth_Ok, "Inodes rated without inode limit");
+
+   table = limitsTableCreate();
+   x_fail_unless(table != NULL, "Failed to create table");
+   x_fail_unless(limitsTableAdd(table, "Files", 4096, 100) == 0 && limitsTableAdd(table, "Bytes", 4096, 0) == 0, "Failed to add");
+   x_fail_unless(limitsTableSeal(table) == 0, "Failed to seal table");
+   entry = limitsTableFind(table, "Files", limitsHash("Files"));
+   x_fail_unless(entry != NULL && entry->size == 4096 && entry->inodes == 100, "Inode limit not kept");
+
+   // the image of the configuration cache carries the inode limits
+   image = aligned_alloc(8, limitsTableGetImageSize(table));
+   x_fail_unless(image != NULL, "Out of memory");
+   limitsTableWriteImage(table, image);
+   mapped = limitsTableFromImage(image, limitsTableGetImageSize(table));
+   x_fail_unless(mapped != NULL, "Failed to use image");
+   entry = limitsTableFind(mapped, "Files", limitsHash("Files"));
+   x_fail_unless(entry != NULL && entry->inodes == 100, "Inode limit lost in the image");
+   entry = limitsTableFind(mapped, "Bytes", limitsHash("Bytes"));
+   x_fail_unless(entry != NULL && entry->inodes == 0, "Inode limit added in the image");
+
+   limitsTableDestroy(mapped);
+   limitsTableDestroy(table);
+   free(image);
+}
+END_TEST
+
+
+
+
+/// reader of the handoff test, takes the newest version over after a delay
+static void* runHandoffReader(void* dataPtr)
+{
+   Handoff_s* handoff = (Handoff_s*)dataPtr;
+   unsigned int generation = 0;
+   void* version = NULL;
+
+   usleep(TEST_HANDOFF_DELAY_US);
+   version = handoffGetNewer(handoff, &generation);
+   if(version != NULL)
+   {
+      handoffAdopt(handoff, generation);
+   }
+   return version;
+}
+
+
+
+/// reader of the handoff test that stops without taking a version over
+static void* runHandoffStop(void* dataPtr)
+{
+   usleep(TEST_HANDOFF_DELAY_US);
+   handoffStop((Handoff_s*)dataPtr);
+   return NULL;
+}
+
+
+
+START_TEST(test_LimitsHandoff)
+{
+   int first = 1, second = 2, third = 3, ret = 0;
+   unsigned int generation = 0, readerGeneration = 0;
+   void* previous = NULL;
+   void* threadRet = NULL;
+   pthread_t thread;
+   Handoff_s handoff = HANDOFF_INITIALIZER;
+
+   X_TEST_REPORT_TEST_NAME("persistence_health_monitor_test");
+   X_TEST_REPORT_COMP_NAME("libpersistence_health_monitor");
+   X_TEST_REPORT_REFERENCE("NONE");
+   X_TEST_REPORT_DESCRIPTION("A reloaded version is released only after the reader has taken the new one over or has stopped");
+   X_TEST_REPORT_TYPE(GOOD);
+
+   handoffInit(&handoff, &first);
+   previous = handoffGetNewer(&handoff, &readerGeneration);
+   x_fail_unless(previous == NULL, "First version reported as newer");
+
+   // the writer sleeps until the reader adopts the new generation
+   previous = handoffPublish(&handoff, &second, &generation);
+   x_fail_unless(previous == &first && generation == 1, "Wrong previous version or generation");
+   ret = pthread_create(&thread, NULL, runHandoffReader, &handoff);
+   x_fail_unless(ret == 0, "Failed to start reader");
+   ret = handoffWaitAdopted(&handoff, generation);
+   x_fail_unless(ret == 0, "Writer woken before the reader adopted the version");
+   pthread_join(thread, &threadRet);
+   x_fail_unless(threadRet == &second, "Reader got the wrong version");
+   previous = handoffGetNewer(&handoff, &readerGeneration);
+   x_fail_unless(previous == NULL, "Adopted version reported as newer");
+
+   // a stopped reader wakes the writer as well
+   previous = handoffPublish(&handoff, &third, &generation);
+   x_fail_unless(previous == &second && generation == 2, "Wrong previous version or generation");
+   ret = pthread_create(&thread, NULL, runHandoffStop, &handoff);
+   x_fail_unless(ret == 0, "Failed to start reader");
+   ret = handoffWaitAdopted(&handoff, generation);
+   x_fail_unless(ret == -1, "Stopped reader reported as adopted");
+   pthread_join(thread, NULL);
+
+   previous = handoffClose(&handoff);
+   x_fail_unless(previous == &third, "Newest version lost");
+}
+END_TEST
+
+
+
+
+START_TEST(test_LimitsImageDamaged)
+{
+   int i = 0, ret = 0;
+   size_t size = 0;
+   unsigned int* slots = NULL;
+   LimitsEntry_s* entries = NULL;
+   LimitsTable_s* table = NULL;
+   LimitsTable_s* mapped = NULL;
+   char* image = NULL;
+   char* copy = NULL;
+
+   X_TEST_REPORT_TEST_NAME("persistence_health_monitor_test");
+   X_TEST_REPORT_COMP_NAME("libpersistence_health_monitor");
+   X_TEST_REPORT_REFERENCE("NONE");
+   X_TEST_REPORT_DESCRIPTION("A damaged limits image is refused instead of read out of bounds");
+   X_TEST_REPORT_TYPE(GOOD);
+
+   table = limitsTableCreate();
+   x_fail_unless(table != NULL, "Failed to create table");
+   ret = limitsTableAdd(table, "App1", 100, 0);
+   x_fail_unless(ret == 0, "Failed to add");
+   ret = limitsTableAdd(table, "App2", 200, 0);
+   x_fail_unless(ret == 0, "Failed to add");
+   ret = limitsTableSeal(table);
+   x_fail_unless(ret == 0, "Failed to seal table");
+   size  = limitsTableGetImageSize(table);
+   image = aligned_alloc(8, size);
+   copy  = aligned_alloc(8, size);
+   x_fail_unless(image != NULL && copy != NULL, "Out of memory");
+   limitsTableWriteImage(table, image);
+   limitsTableDestroy(table);
+
+   // image: header, 2 entries, TEST_IMAGE_SLOTS slots (tag, entry), names
+   entries = (LimitsEntry_s*)(copy + TEST_IMAGE_HEADER_SIZE);
+   slots   = (unsigned int*)(copy + TEST_IMAGE_HEADER_SIZE + 2 * sizeof(LimitsEntry_s));
+
+   memcpy(copy, image, size);
+   mapped = limitsTableFromImage(copy, size);
+   x_fail_unless(mapped != NULL, "Intact image refused");
+   limitsTableDestroy(mapped);
+
+   // a slot pointing behind the entries
+   memcpy(copy, image, size);
+   slots[1] = 3;
+   mapped = limitsTableFromImage(copy, size);
+   x_fail_unless(mapped == NULL, "Slot behind the entries accepted");
+
+   // a name outside of the arena
+   memcpy(copy, image, size);
+   entries[1].nameOffset = 0xFFFFFFF0u;
+   mapped = limitsTableFromImage(copy, size);
+   x_fail_unless(mapped == NULL, "Name outside of the arena accepted");
+
+   // a name without terminator
+   memcpy(copy, image, size);
+   copy[TEST_IMAGE_HEADER_SIZE + 2 * sizeof(LimitsEntry_s) + TEST_IMAGE_SLOTS * 8 + entries[0].nameLength] = 'x';
+   mapped = limitsTableFromImage(copy, size);
+   x_fail_unless(mapped == NULL, "Name without terminator accepted");
+
+   // no empty slot, a lookup of an unknown AppID would never end
+   memcpy(copy, image, size);
+   for(i = 0; i < TEST_IMAGE_SLOTS; i++)
+   {
+      slots[2 * i + 1] = 1;
+   }
+   mapped = limitsTableFromImage(copy, size);
+   x_fail_unless(mapped == NULL, "Index without empty slot accepted");
+
+   free(copy);
+   free(image);
+}
+END_TEST
+
+
+
+
+START_TEST(test_ScanPoolReuse)
+{
+   int i = 0, run = 0, ret = 0, fd = -1;
+   char path[1024];
+   const char* appIds[TEST_POOL_APPS];
+   char names[TEST_POOL_APPS][8];
+   ScanJob_s jobs[TEST_POOL_APPS];
+   ScanPool_s* pool = NULL;
+   DiskScanOptions_s options = { DiskScanBackend_Sync, DiskScanMetric_Apparent };
+   // number of jobs per run: more jobs than workers, fewer, none and all again
+   const int jobCounts[] = { TEST_POOL_APPS, 2, 0, TEST_POOL_APPS };
+
+   X_TEST_REPORT_TEST_NAME("persistence_health_monitor_test");
+   X_TEST_REPORT_COMP_NAME("libpersistence_health_monitor");
+   X_TEST_REPORT_REFERENCE("NONE");
+   X_TEST_REPORT_DESCRIPTION("The workers of a scan pool are kept and process the jobs of several runs");
+   X_TEST_REPORT_TYPE(GOOD);
+
+   // application i holds one file of i+1 bytes
+   (void)system("rm -rf " TEST_POOL_ROOT);
+   mkdir(TEST_POOL_ROOT, 0755);
+   for(i = 0; i < TEST_POOL_APPS; i++)
+   {
+      snprintf(names[i], sizeof(names[i]), "App%d", i);
+      appIds[i] = names[i];
+      snprintf(path, sizeof(path), TEST_POOL_ROOT "/%s", names[i]);
+      ret = mkdir(path, 0755);
+      x_fail_unless(ret == 0, "Failed to create test folder");
+      snprintf(path, sizeof(path), TEST_POOL_ROOT "/%s/f", names[i]);
+      fd = open(path, O_CREAT | O_WRONLY | O_TRUNC, 0644);
+      x_fail_unless(fd != -1, "Failed to create test file");
+      ret = write(fd, "0123456789abcdef", i + 1);
+      x_fail_unless(ret == i + 1, "Failed to write test file");
+      close(fd);
+   }
+
+   fd = open(TEST_POOL_ROOT, O_RDONLY | O_DIRECTORY);
+   x_fail_unless(fd != -1, "Failed to open test root");
+   pool = scanPoolCreate(TEST_POOL_WORKERS, &options);
+   x_fail_unless(pool != NULL, "Failed to create pool");
+
+   for(run = 0; run < (int)(sizeof(jobCounts) / sizeof(jobCounts[0])); run++)
+   {
+      memset(jobs, 0, sizeof(jobs));
+      for(i = 0; i < jobCounts[run]; i++)
+      {
+         jobs[i].appId = appIds[i];
+      }
+
+      ret = scanPoolRunJobs(pool, fd, jobs, jobCounts[run]);
+      x_fail_unless(ret == 0, "Pool run failed");
+
+      for(i = 0; i < jobCounts[run]; i++)
+      {
+         x_fail_unless(jobs[i].result == 0, "Application scan failed");
+         x_fail_unless(jobs[i].usage.size == (unsigned long long)(i + 1) && jobs[i].usage.files == 1, "Wrong usage");
+      }
+   }
+
+   scanPoolDestroy(pool);
+   close(fd);
+
+   (void)system("rm -rf " TEST_POOL_ROOT);
+}
+END_TEST
+
+
+
+
+START_TEST(test_InodeLimitsEmptyFiles)
+{
+   int i = 0, ret = 0, fd = -1;
+   char path[1024];
+   unsigned long long inodes = 0;
+   DiskScanUsage_s usage;
+   DiskScanner_s* scanner = NULL;
+   DiskScanOptions_s options = { DiskScanBackend_Sync, DiskScanMetric_Apparent };
+
+   X_TEST_REPORT_TEST_NAME("persistence_health_monitor_test");
+   X_TEST_REPORT_COMP_NAME("libpersistence_health_monitor");
+   X_TEST_REPORT_REFERENCE("NONE");
+   X_TEST_REPORT_DESCRIPTION("An application of empty files beyond its inode limit is full although its size is 0");
    X_TEST_REPORT_TYPE(GOOD);
 
+   (void)system("rm -rf " TEST_EMPTY_APP);
+   ret = mkdir(TEST_EMPTY_APP, 0755);
+   x_fail_unless(ret == 0, "Failed to create test folder");
+   for(i = 0; i < TEST_EMPTY_FILES; i++)
+   {
+      snprintf(path, sizeof(path), TEST_EMPTY_APP "/f%d", i);
+      fd = open(path, O_CREAT | O_WRONLY | O_TRUNC, 0644);
+      x_fail_unless(fd != -1, "Failed to create test file");
+      close(fd);
+   }
 
+   // the inodes as the monitor counts them: files and folders
+   scanner = diskScannerCreate(&options);
+   x_fail_unless(scanner != NULL, "Failed to create scanner");
+   ret = diskScannerRun(scanner, AT_FDCWD, TEST_EMPTY_APP, NULL, NULL, &usage);
+   x_fail_unless(ret == 0, "Scan failed");
+   inodes = (unsigned long long)usage.files + usage.folders;
+   x_fail_unless(usage.size == 0 && inodes == TEST_EMPTY_FILES + 1, "Wrong usage of the empty files");
 
+   // with and without a size limit, the size of 0 must not hide the inodes
+   x_fail_unless(limitsGetHealth(usage.size, 4096, inodes, TEST_EMPTY_FILES / 2) == PhmHealth_Full, "Inode limit hidden by the size limit");
+   x_fail_unless(limitsGetHealth(usage.size, 0, inodes, TEST_EMPTY_FILES / 2) == PhmHealth_Full, "Inode limit without size limit ignored");
+   x_fail_unless(limitsGetHealth(usage.size, 4096, inodes, TEST_EMPTY_FILES * 2) == PhmHealth_Ok, "Empty files below the limits not ok");
+
+   diskScannerDestroy(scanner);
+   (void)system("rm -rf " TEST_EMPTY_APP);
 }
 END_TEST
 
@@ -62,6 +1668,111 @@ static Suite * persistencyClientLib_suite()
    tcase_set_timeout(tc_SendNotification, 1);
    suite_add_tcase(s, tc_SendNotification);
 
+   TCase * tc_UsageProviderFake = tcase_create("UsageProviderFake");
+   tcase_add_test(tc_UsageProviderFake, test_UsageProviderFake);
+   tcase_set_timeout(tc_UsageProviderFake, 5);
+   suite_add_tcase(s, tc_UsageProviderFake);
+
+   TCase * tc_ScanRootConcurrent = tcase_create("ScanRootConcurrent");
+   tcase_add_test(tc_ScanRootConcurrent, test_ScanRootConcurrent);
+   tcase_set_timeout(tc_ScanRootConcurrent, 5);
+   suite_add_tcase(s, tc_ScanRootConcurrent);
+
+   TCase * tc_ScanTopConsumers = tcase_create("ScanTopConsumers");
+   tcase_add_test(tc_ScanTopConsumers, test_ScanTopConsumers);
+   tcase_set_timeout(tc_ScanTopConsumers, 10);
+   suite_add_tcase(s, tc_ScanTopConsumers);
+
+   TCase * tc_LimitsTable = tcase_create("LimitsTable");
+   tcase_add_test(tc_LimitsTable, test_LimitsTable);
+   tcase_set_timeout(tc_LimitsTable, 1);
+   suite_add_tcase(s, tc_LimitsTable);
+
+   TCase * tc_ConfigCache = tcase_create("ConfigCache");
+   tcase_add_test(tc_ConfigCache, test_ConfigCache);
+   tcase_set_timeout(tc_ConfigCache, 1);
+   suite_add_tcase(s, tc_ConfigCache);
+
+   TCase * tc_ConfigReader = tcase_create("ConfigReader");
+   tcase_add_test(tc_ConfigReader, test_ConfigReader);
+   tcase_set_timeout(tc_ConfigReader, 1);
+   suite_add_tcase(s, tc_ConfigReader);
+
+   TCase * tc_Crc32 = tcase_create("Crc32");
+   tcase_add_test(tc_Crc32, test_Crc32);
+   tcase_set_timeout(tc_Crc32, 5);
+   suite_add_tcase(s, tc_Crc32);
+
+   TCase * tc_Crc32Benchmark = tcase_create("Crc32Benchmark");
+   tcase_add_test(tc_Crc32Benchmark, test_Crc32Benchmark);
+   tcase_set_timeout(tc_Crc32Benchmark, 10);
+   suite_add_tcase(s, tc_Crc32Benchmark);
+
+   TCase * tc_UsageSnapshot = tcase_create("UsageSnapshot");
+   tcase_add_test(tc_UsageSnapshot, test_UsageSnapshot);
+   tcase_set_timeout(tc_UsageSnapshot, 2);
+   suite_add_tcase(s, tc_UsageSnapshot);
+
+   TCase * tc_ScanFolderRelative = tcase_create("ScanFolderRelative");
+   tcase_add_test(tc_ScanFolderRelative, test_ScanFolderRelative);
+   tcase_set_timeout(tc_ScanFolderRelative, 5);
+   suite_add_tcase(s, tc_ScanFolderRelative);
+
+   TCase * tc_ScanBackendParity = tcase_create("ScanBackendParity");
+   tcase_add_test(tc_ScanBackendParity, test_ScanBackendParity);
+   tcase_set_timeout(tc_ScanBackendParity, 10);
+   suite_add_tcase(s, tc_ScanBackendParity);
+
+   TCase * tc_ScanCacheTimes = tcase_create("ScanCacheTimes");
+   tcase_add_test(tc_ScanCacheTimes, test_ScanCacheTimes);
+   tcase_set_timeout(tc_ScanCacheTimes, 10);
+   suite_add_tcase(s, tc_ScanCacheTimes);
+
+   TCase * tc_ScanHardLinks = tcase_create("ScanHardLinks");
+   tcase_add_test(tc_ScanHardLinks, test_ScanHardLinks);
+   tcase_set_timeout(tc_ScanHardLinks, 20);
+   suite_add_tcase(s, tc_ScanHardLinks);
+
+   TCase * tc_ScanSchedule = tcase_create("ScanSchedule");
+   tcase_add_test(tc_ScanSchedule, test_ScanSchedule);
+   tcase_set_timeout(tc_ScanSchedule, 1);
+   suite_add_tcase(s, tc_ScanSchedule);
+
+   TCase * tc_Forecast = tcase_create("Forecast");
+   tcase_add_test(tc_Forecast, test_Forecast);
+   tcase_set_timeout(tc_Forecast, 1);
+   suite_add_tcase(s, tc_Forecast);
+
+   TCase * tc_ScanBudget = tcase_create("ScanBudget");
+   tcase_add_test(tc_ScanBudget, test_ScanBudget);
+   tcase_set_timeout(tc_ScanBudget, 10);
+   suite_add_tcase(s, tc_ScanBudget);
+
+   TCase * tc_InodeLimits = tcase_create("InodeLimits");
+   tcase_add_test(tc_InodeLimits, test_InodeLimits);
+   tcase_set_timeout(tc_InodeLimits, 1);
+   suite_add_tcase(s, tc_InodeLimits);
+
+   TCase * tc_LimitsHandoff = tcase_create("LimitsHandoff");
+   tcase_add_test(tc_LimitsHandoff, test_LimitsHandoff);
+   tcase_set_timeout(tc_LimitsHandoff, 5);
+   suite_add_tcase(s, tc_LimitsHandoff);
+
+   TCase * tc_LimitsImageDamaged = tcase_create("LimitsImageDamaged");
+   tcase_add_test(tc_LimitsImageDamaged, test_LimitsImageDamaged);
+   tcase_set_timeout(tc_LimitsImageDamaged, 5);
+   suite_add_tcase(s, tc_LimitsImageDamaged);
+
+   TCase * tc_ScanPoolReuse = tcase_create("ScanPoolReuse");
+   tcase_add_test(tc_ScanPoolReuse, test_ScanPoolReuse);
+   tcase_set_timeout(tc_ScanPoolReuse, 10);
+   suite_add_tcase(s, tc_ScanPoolReuse);
+
+   TCase * tc_InodeLimitsEmptyFiles = tcase_create("InodeLimitsEmptyFiles");
+   tcase_add_test(tc_InodeLimitsEmptyFiles, test_InodeLimitsEmptyFiles);
+   tcase_set_timeout(tc_InodeLimitsEmptyFiles, 10);
+   suite_add_tcase(s, tc_InodeLimitsEmptyFiles);
+
    return s;
 }
 